@@ -9,6 +9,7 @@ REM This script handles everything automatically:
 REM   - Uses pre-compiled DLL if available (no compiler needed!)
 REM   - Auto-installs Python packages
 REM   - Compiles C++ only if needed and compiler is available
+REM   - Regenerates core\CatalogData.h when catalog\default_catalog.csv changed
 REM ═══════════════════════════════════════════════════════════════════════════════
 
 title Smart Grocery Cart
@@ -30,6 +31,12 @@ REM ═════════════════════════
 echo [1/3] Checking C++ DLL...
 
 if exist "grocery_api.dll" (
+    REM An edited catalog needs a rebuild (exit code 1 = header out of date)
+    python tools\gen_catalog.py --check >nul 2>&1
+    if !ERRORLEVEL! EQU 1 (
+        echo    Catalog changed, rebuilding the DLL...
+        goto :compile
+    )
     echo ✅ DLL found! No compilation needed.
     echo.
     goto :check_python
@@ -39,16 +46,20 @@ echo    DLL not found, attempting to compile...
 echo.
 
 REM ═══════════════════════════════════════════════════════════════════════════════
-REM STEP 1b: Try to compile (only if DLL doesn't exist)
+REM STEP 1b: Try to compile (only if DLL doesn't exist or the catalog changed)
 REM ═══════════════════════════════════════════════════════════════════════════════
 
+:compile
+REM Catalog header from the CSV (without Python the checked-in header is used)
+python tools\gen_catalog.py >nul 2>&1
+
 set COMPILER_FOUND=0
 
 REM Try clang++ first
 where clang++ >nul 2>&1
 if %ERRORLEVEL% EQU 0 (
     echo    Found clang++, compiling...
-    clang++ -shared -o grocery_api.dll grocery_api.cpp -DBUILD_DLL -static 2>nul
+    clang++ -O2 -std=c++17 -shared -o grocery_api.dll grocery_api_new.cpp -DBUILD_DLL -static 2>nul
     if %ERRORLEVEL% EQU 0 (
         set COMPILER_FOUND=1
         echo ✅ Compiled successfully with clang++
@@ -60,7 +71,7 @@ REM Try g++ (MinGW)
 where g++ >nul 2>&1
 if %ERRORLEVEL% EQU 0 (
     echo    Found g++, compiling...
-    g++ -shared -o grocery_api.dll grocery_api.cpp -DBUILD_DLL -static 2>nul
+    g++ -O2 -std=c++17 -shared -o grocery_api.dll grocery_api_new.cpp -DBUILD_DLL -static 2>nul
     if %ERRORLEVEL% EQU 0 (
         set COMPILER_FOUND=1
         echo ✅ Compiled successfully with g++
@@ -72,7 +83,7 @@ REM Try cl.exe (Visual Studio)
 where cl >nul 2>&1
 if %ERRORLEVEL% EQU 0 (
     echo    Found MSVC cl.exe, compiling...
-    cl /LD /Fe:grocery_api.dll grocery_api.cpp /DBUILD_DLL 2>nul
+    cl /LD /O2 /std:c++17 /EHsc /Fe:grocery_api.dll grocery_api_new.cpp /DBUILD_DLL 2>nul
     if %ERRORLEVEL% EQU 0 (
         set COMPILER_FOUND=1
         echo ✅ Compiled successfully with MSVC
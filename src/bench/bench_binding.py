@@ -0,0 +1,106 @@
+"""
+═══════════════════════════════════════════════════════════════════════════════
+                    BINDING BENCHMARK - ctypes vs grocery_native
+═══════════════════════════════════════════════════════════════════════════════
+
+Calls the same library functions through the ctypes binding server.py used
+so far and through the grocery_native extension module, and reports the
+cost per call of each. Both load their own copy of the library into this
+process, so they start from the same state and do not share it.
+
+Cases:
+    cart_size     api_get_cart_size()                  bare call overhead
+    add_to_cart   api_add_to_cart(name, 1, -1)         str argument (ctypes encodes it)
+    cart_items    the cart as a list of dicts          ctypes: JSON + json.loads
+    ranked_items  the top 10 items as a list of dicts  ctypes: buffer + json.loads
+
+USAGE (from src/, after building both):
+    g++ -O2 -std=c++17 -shared -fPIC -o libgrocery_api.so grocery_api_new.cpp
+    g++ -O2 -std=c++17 -pthread -shared -fPIC -fvisibility=hidden $(python3-config --includes) \\
+        -o grocery_native$(python3-config --extension-suffix) grocery_native.cpp
+    python bench/bench_binding.py [calls=100000] [cart_lines=20]
+"""
+
+import ctypes
+import json
+import os
+import sys
+import time
+
+SRC_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+sys.path.insert(0, SRC_DIR)
+
+import grocery_native
+
+# Undo entries pile up with every add; cleared (untimed) after this many calls
+ROUND = 10000
+
+
+def load_ctypes():
+    """The few functions used here, declared as server.py declares them"""
+    name = 'grocery_api.dll' if sys.platform == 'win32' else 'libgrocery_api.so'
+    lib = ctypes.CDLL(os.path.join(SRC_DIR, name))
+    lib.api_get_cart_size.restype = ctypes.c_int
+    lib.api_add_to_cart.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_int]
+    lib.api_add_to_cart.restype = ctypes.c_uint64
+    lib.api_get_cart_items.restype = ctypes.c_char_p
+    lib.api_read_ranked_items.argtypes = [ctypes.c_int, ctypes.c_char_p, ctypes.c_int]
+    lib.api_read_ranked_items.restype = ctypes.c_int
+    lib.api_clear_undo_stack.restype = None
+    return lib
+
+
+def per_call_ns(call, calls, between_rounds):
+    total = 0.0
+    done = 0
+    while done < calls:
+        count = min(ROUND, calls - done)
+        start = time.perf_counter()
+        for _ in range(count):
+            call()
+        total += time.perf_counter() - start
+        between_rounds()
+        done += count
+    return total / calls * 1e9
+
+
+def main():
+    calls = int(sys.argv[1]) if len(sys.argv) > 1 else 100000
+    cart_lines = int(sys.argv[2]) if len(sys.argv) > 2 else 20
+
+    lib = load_ctypes()
+    native = grocery_native
+    for binding, text in ((lib, lambda s: s.encode('utf-8')), (native, lambda s: s)):
+        for i in range(cart_lines):
+            binding.api_add_to_cart(text(f'Bench Item {i}'), 1, -1)
+        binding.api_clear_undo_stack()
+
+    buffer = ctypes.create_string_buffer(8192)
+
+    def ctypes_ranked():
+        length = lib.api_read_ranked_items(0, buffer, len(buffer))
+        return json.loads(buffer.raw[:length])
+
+    name = 'Bench Item 0'
+    cases = [
+        ('cart_size', lambda: lib.api_get_cart_size(), lambda: native.api_get_cart_size()),
+        ('add_to_cart', lambda: lib.api_add_to_cart(name.encode('utf-8'), 1, -1),
+                        lambda: native.api_add_to_cart(name, 1, -1)),
+        ('cart_items', lambda: json.loads(lib.api_get_cart_items()), lambda: native.api_get_cart_items()),
+        ('ranked_items', ctypes_ranked, lambda: native.ranked_items(0)),
+    ]
+
+    # Same answers from both, before timing anything
+    assert json.loads(lib.api_get_cart_items()) == native.api_get_cart_items()
+    assert [item['name'] for item in ctypes_ranked()] == [item['name'] for item in native.ranked_items(0)]
+
+    print(f"{calls} calls per case, {cart_lines} cart lines\n")
+    print(f"{'case':<14}{'ctypes ns':>12}{'native ns':>12}{'speedup':>10}")
+    for case, via_ctypes, via_native in cases:
+        slow = per_call_ns(via_ctypes, calls, lib.api_clear_undo_stack)
+        fast = per_call_ns(via_native, calls, native.api_clear_undo_stack)
+        print(f"{case:<14}{slow:>12.0f}{fast:>12.0f}{slow / fast:>9.1f}x")
+
+
+if __name__ == '__main__':
+    main()
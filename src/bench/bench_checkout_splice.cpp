@@ -0,0 +1,88 @@
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                           SMART GROCERY CART
+ *                    Benchmark: Cart -> Checkout Queue Hand-off
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Compares the two ways of moving a cart into the checkout queue:
+ *   copy          enqueue a copy of every line, then cart.clear()
+ *                 (one allocation + one free + two Product copies per line)
+ *   splice        queue.append_chain(cart.release_chain()) - O(1)
+ *   splice+walk   splice, then read every moved line once, as
+ *                 api_start_checkout does for the purchase counts
+ *
+ * COMPILATION:
+ *   clang++ -O2 -std=c++17 -o bench_checkout_splice bench_checkout_splice.cpp
+ *
+ * USAGE:
+ *   bench_checkout_splice [total_lines_per_size=2000000]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include "../core/LinkedList.h"
+#include "../core/Queue.h"
+using namespace std;
+
+typedef chrono::steady_clock bench_clock;
+
+static void fillCart(LinkedList<Product>& cart, int lines) {
+    for (int i = 0; i < lines; i++) {
+        cart.insert_at_tail(Product("Item " + to_string(i), 1 + i % 5, 1000 + i));
+    }
+}
+
+// Mean microseconds per checkout of `lines` lines, over `rounds` checkouts
+static double timeCheckout(int lines, int rounds, int mode, long long& checksum) {
+    double totalUs = 0;
+    for (int r = 0; r < rounds; r++) {
+        LinkedList<Product> cart;
+        Queue<Product> queue;
+        fillCart(cart, lines);
+
+        auto t0 = bench_clock::now();
+        if (mode == 0) {
+            for (const Product& line : cart) {
+                queue.enqueue(line);
+            }
+            cart.clear();
+        } else {
+            LinkedList<Product>::chain_type chain = cart.release_chain();
+            if (mode == 2) {
+                for (const Product& line : chain) {
+                    checksum += line.getQuantity();
+                }
+            }
+            queue.append_chain(chain);
+        }
+        totalUs += chrono::duration<double, micro>(bench_clock::now() - t0).count();
+        checksum += queue.size();
+    }
+    return totalUs / rounds;
+}
+
+int main(int argc, char* argv[]) {
+    long long totalLines = (argc > 1) ? atoll(argv[1]) : 2000000;
+    const int sizes[] = {10, 1000, 100000};
+    const char* modes[] = {"copy", "splice", "splice+walk"};
+    long long checksum = 0;
+
+    cout << setw(8) << "lines" << setw(8) << "rounds";
+    for (const char* mode : modes) cout << setw(16) << mode;
+    cout << setw(10) << "speedup" << "   (mean us per checkout)" << endl;
+
+    for (int lines : sizes) {
+        int rounds = (int)max(5LL, totalLines / lines);
+        double us[3];
+        for (int mode = 0; mode < 3; mode++) us[mode] = timeCheckout(lines, rounds, mode, checksum);
+
+        cout << setw(8) << lines << setw(8) << rounds << fixed << setprecision(3);
+        for (int mode = 0; mode < 3; mode++) cout << setw(16) << us[mode];
+        cout << setw(9) << setprecision(0) << us[0] / us[1] << "x" << endl;
+    }
+    cout << "(checksum " << checksum << ")" << endl;
+    return 0;
+}
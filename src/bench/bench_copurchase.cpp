@@ -0,0 +1,108 @@
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                           SMART GROCERY CART
+ *                    Benchmark: Co-Purchase Graph (Bought Together)
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Records 1M synthetic checkout baskets whose items follow a Zipf distribution,
+ * then measures "bought together" query latency for random carts.
+ *
+ * COMPILATION:
+ *   clang++ -O2 -std=c++17 -o bench_copurchase bench_copurchase.cpp
+ *
+ * USAGE:
+ *   bench_copurchase [checkouts] [catalog_size] [zipf_s]
+ */
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include "../core/CoPurchase.h"
+using namespace std;
+
+// Samples item ranks 0..n-1 with P(k) proportional to 1 / (k+1)^s
+class ZipfSampler {
+private:
+    vector<double> cdf;
+
+public:
+    ZipfSampler(int n, double s) : cdf(n) {
+        double total = 0;
+        for (int k = 0; k < n; k++) {
+            total += 1.0 / pow(k + 1, s);
+            cdf[k] = total;
+        }
+        for (int k = 0; k < n; k++) cdf[k] /= total;
+    }
+
+    int operator()(mt19937_64& rng) const {
+        double u = uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return (int)(lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+    }
+};
+
+// Basket of 1..20 distinct items
+static int makeBasket(const ZipfSampler& zipf, mt19937_64& rng, int basket[]) {
+    int size = 1 + (int)(geometric_distribution<int>(0.12)(rng) % 20);
+    int count = 0;
+    while (count < size) {
+        int id = zipf(rng);
+        bool seen = false;
+        for (int i = 0; i < count; i++) {
+            if (basket[i] == id) { seen = true; break; }
+        }
+        if (!seen) basket[count++] = id;
+    }
+    return count;
+}
+
+int main(int argc, char* argv[]) {
+    long long checkouts = (argc > 1) ? atoll(argv[1]) : 1000000;
+    int catalog = (argc > 2) ? atoi(argv[2]) : 5000;
+    double s = (argc > 3) ? atof(argv[3]) : 1.1;
+
+    ZipfSampler zipf(catalog, s);
+    mt19937_64 rng(42);
+    CoPurchaseGraph graph;
+    int basket[32];
+
+    using clock = chrono::steady_clock;
+    long long lines = 0;
+    double recordSeconds = 0;
+    for (long long i = 0; i < checkouts; i++) {
+        int n = makeBasket(zipf, rng, basket);
+        lines += n;
+        auto t0 = clock::now();
+        graph.recordBasket(basket, n);
+        recordSeconds += chrono::duration<double>(clock::now() - t0).count();
+    }
+
+    // Query latency for carts of 5 items
+    const int queries = 100000;
+    vector<double> latencies;
+    latencies.reserve(queries);
+    Neighbor top[10];
+    long long found = 0;
+    for (int q = 0; q < queries; q++) {
+        int cart[5];
+        for (int i = 0; i < 5; i++) cart[i] = zipf(rng);
+        auto t0 = clock::now();
+        found += graph.recommend(cart, 5, top, 10);
+        latencies.push_back(chrono::duration<double, micro>(clock::now() - t0).count());
+    }
+    sort(latencies.begin(), latencies.end());
+
+    cout << "checkouts:          " << checkouts << " (" << lines << " lines, catalog "
+         << catalog << ", zipf s=" << s << ")" << endl;
+    cout << "record throughput:  " << (long long)(checkouts / recordSeconds) << " baskets/s" << endl;
+    cout << "tracked items:      " << graph.trackedItems() << " / " << MAX_COPURCHASE_ITEMS << endl;
+    cout << "memory:             " << graph.memoryBytes() / 1024 << " KiB (limit "
+         << CoPurchaseGraph::memoryLimitBytes() / 1024 << " KiB)" << endl;
+    cout << "query p50/p99/max:  " << latencies[queries / 2] << " / "
+         << latencies[queries * 99 / 100] << " / " << latencies.back() << " us" << endl;
+    cout << "avg results:        " << (double)found / queries << endl;
+    return 0;
+}
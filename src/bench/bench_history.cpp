@@ -0,0 +1,152 @@
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                           SMART GROCERY CART
+ *                    Benchmark: Columnar Purchase History
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Fills a PurchaseHistory with a year of checkouts (Zipf-distributed items,
+ * ~5 lines per basket) and times:
+ *   append          rows per second into the open block
+ *   top10 / month   sumBySymbol over the last 30 days (most blocks skipped)
+ *   top10 / year    sumBySymbol over everything (no timestamp decode)
+ *   weekly series   seriesFor one item, 7-day buckets over the year
+ * Each query is also run against a plain vector<Row> scan for reference,
+ * and both answers are compared.
+ *
+ * The series only gains about 2x over the row scan: an item sold every day
+ * is in every block, so no block is skipped and every row's symbol is still
+ * read (packed, in one pass with the range check). Time ranges that skip
+ * blocks are where the columnar layout pays off (top10 / month).
+ *
+ * COMPILATION:
+ *   clang++ -O2 -std=c++17 -o bench_history bench_history.cpp
+ *
+ * USAGE:
+ *   bench_history [rows=5000000] [items=2000]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include "../core/PurchaseHistory.h"
+using namespace std;
+
+typedef chrono::steady_clock bench_clock;
+
+struct Row {
+    int64_t ts;
+    uint32_t symbol;
+    int32_t quantity;
+    uint32_t session;
+};
+
+static double msSince(bench_clock::time_point t0) {
+    return chrono::duration<double, milli>(bench_clock::now() - t0).count();
+}
+
+// Best of `repeats` runs of fn, in milliseconds
+template <typename Fn>
+static double bestMs(int repeats, Fn fn) {
+    double best = 1e300;
+    for (int r = 0; r < repeats; r++) {
+        auto t0 = bench_clock::now();
+        fn();
+        best = min(best, msSince(t0));
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    long long rows = (argc > 1) ? atoll(argv[1]) : 5000000;
+    int items = (argc > 2) ? atoi(argv[2]) : 2000;
+    const int64_t start = 1700000000;
+    const int64_t year = 365 * 86400LL;
+
+    // Zipf(1.0) item popularity via a cumulative table
+    vector<double> cumulative(items);
+    double sum = 0;
+    for (int i = 0; i < items; i++) cumulative[i] = (sum += 1.0 / (i + 1));
+    uint64_t rng = 88172645463325252ULL;
+    auto next = [&]() {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        return rng;
+    };
+
+    vector<Row> generated;
+    generated.reserve((size_t)rows);
+    int64_t ts = start;
+    uint32_t session = 0;
+    int64_t meanGap = max<int64_t>(1, year / max<long long>(1, rows / 5));
+    while ((long long)generated.size() < rows) {
+        ts += 1 + (int64_t)(next() % (uint64_t)(2 * meanGap));
+        session++;
+        int lines = 1 + (int)(next() % 9);
+        for (int l = 0; l < lines && (long long)generated.size() < rows; l++) {
+            double u = (next() >> 11) * (1.0 / 9007199254740992.0) * sum;
+            uint32_t symbol = (uint32_t)(lower_bound(cumulative.begin(), cumulative.end(), u) - cumulative.begin());
+            generated.push_back({ts, symbol, 1 + (int32_t)(next() % 4), session});
+        }
+    }
+    int64_t end = ts + 1;
+
+    PurchaseHistory history;
+    auto t0 = bench_clock::now();
+    for (const Row& r : generated) history.append(r.ts, r.symbol, r.quantity, r.session);
+    double appendMs = msSince(t0);
+
+    cout << fixed << setprecision(2);
+    cout << "rows " << rows << ", items " << items << ", blocks " << history.sealedBlocks()
+         << ", span " << (end - start) / 86400 << " days" << endl;
+    cout << "append         " << setw(10) << rows / appendMs / 1000.0 << " M rows/s" << endl;
+    cout << "compressed     " << setw(10) << (double)history.compressedBytes() / (history.sealedBlocks() * (double)HISTORY_BLOCK_ROWS)
+         << " bytes/row (row struct: " << sizeof(Row) << ")" << endl;
+
+    struct Query {
+        const char* label;
+        int64_t from;
+        int64_t to;
+    };
+    Query ranges[] = {{"top10 / month", end - 30 * 86400, end}, {"top10 / year", start, end}};
+    vector<long long> columnar, reference;
+    bool allMatch = true;
+
+    cout << setw(16) << "query" << setw(14) << "columnar ms" << setw(12) << "rows ms"
+         << setw(10) << "speedup" << setw(16) << "blocks skipped" << endl;
+    for (const Query& q : ranges) {
+        double colMs = bestMs(5, [&]() { history.sumBySymbol(q.from, q.to, items, columnar); });
+        HistoryScanStats scan = history.lastScanStats();
+        double rowMs = bestMs(5, [&]() {
+            reference.assign(items, 0);
+            for (const Row& r : generated) {
+                if (r.ts >= q.from && r.ts < q.to) reference[r.symbol] += r.quantity;
+            }
+        });
+        allMatch = allMatch && columnar == reference;
+        cout << setw(16) << q.label << setw(14) << colMs << setw(12) << rowMs << setw(9) << rowMs / colMs << "x"
+             << setw(9) << scan.blocksSkipped << "/" << scan.blocksSkipped + scan.blocksScanned << endl;
+    }
+
+    // Weekly series of a mid-popularity item (its symbol is missing from some blocks)
+    uint32_t target = (uint32_t)min(items - 1, 300);
+    const int64_t week = 7 * 86400;
+    double colMs = bestMs(5, [&]() { history.seriesFor(target, start, end, week, columnar); });
+    HistoryScanStats scan = history.lastScanStats();
+    double rowMs = bestMs(5, [&]() {
+        reference.assign(columnar.size(), 0);
+        for (const Row& r : generated) {
+            if (r.symbol == target && r.ts >= start && r.ts < end) reference[(r.ts - start) / week] += r.quantity;
+        }
+    });
+    allMatch = allMatch && columnar == reference;
+    cout << setw(16) << "weekly series" << setw(14) << colMs << setw(12) << rowMs << setw(9) << rowMs / colMs << "x"
+         << setw(9) << scan.blocksSkipped << "/" << scan.blocksSkipped + scan.blocksScanned << endl;
+
+    cout << (allMatch ? "results match the row scan" : "MISMATCH against the row scan") << endl;
+    return allMatch ? 0 : 1;
+}
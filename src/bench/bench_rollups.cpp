@@ -0,0 +1,125 @@
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                           SMART GROCERY CART
+ *                    Benchmark: Rolling-window Top Items
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Feeds a year of checkouts (Zipf-distributed items) into PurchaseRollups and
+ * PurchaseHistory, then answers "top 10 in the last hour / day / week /
+ * month" both ways:
+ *   rollups   merge the pre-aggregated buckets of one ring
+ *   history   scan the raw rows of the same (bucket-aligned) range
+ * and reports how many of the rollup top 10 are also in the exact top 10.
+ *
+ * COMPILATION:
+ *   clang++ -O2 -std=c++17 -o bench_rollups bench_rollups.cpp
+ *
+ * USAGE:
+ *   bench_rollups [rows=5000000] [items=2000]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include "../core/PurchaseHistory.h"
+#include "../core/Rollups.h"
+using namespace std;
+
+typedef chrono::steady_clock bench_clock;
+
+template <typename Fn>
+static double bestUs(int repeats, Fn fn) {
+    double best = 1e300;
+    for (int r = 0; r < repeats; r++) {
+        auto t0 = bench_clock::now();
+        fn();
+        best = min(best, chrono::duration<double, micro>(bench_clock::now() - t0).count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    long long rows = (argc > 1) ? atoll(argv[1]) : 5000000;
+    int items = (argc > 2) ? atoi(argv[2]) : 2000;
+    const int64_t start = 1700000000;
+    const int64_t year = 365 * 86400LL;
+
+    vector<double> cumulative(items);
+    double sum = 0;
+    for (int i = 0; i < items; i++) cumulative[i] = (sum += 1.0 / (i + 1));
+    uint64_t rng = 88172645463325252ULL;
+    auto next = [&]() {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        return rng;
+    };
+
+    struct Line {
+        int64_t ts;
+        uint32_t symbol;
+        int32_t quantity;
+    };
+    vector<Line> lines;
+    lines.reserve((size_t)rows);
+    PurchaseHistory history;
+    int64_t ts = start;
+    int64_t meanGap = max<int64_t>(1, year / max<long long>(1, rows / 5));
+    while ((long long)lines.size() < rows) {
+        ts += 1 + (int64_t)(next() % (uint64_t)(2 * meanGap));
+        uint32_t session = history.beginSession();
+        int basket = 1 + (int)(next() % 9);
+        for (int l = 0; l < basket && (long long)lines.size() < rows; l++) {
+            double u = (next() >> 11) * (1.0 / 9007199254740992.0) * sum;
+            uint32_t symbol = (uint32_t)(lower_bound(cumulative.begin(), cumulative.end(), u) - cumulative.begin());
+            int32_t quantity = 1 + (int32_t)(next() % 4);
+            history.append(ts, symbol, quantity, session);
+            lines.push_back({ts, symbol, quantity});
+        }
+    }
+    int64_t now = ts;
+
+    PurchaseRollups rollups;
+    auto t0 = bench_clock::now();
+    for (const Line& line : lines) rollups.record(line.ts, line.symbol, line.quantity);
+    double recordUs = chrono::duration<double, micro>(bench_clock::now() - t0).count();
+
+    cout << fixed << setprecision(1);
+    cout << "rows " << rows << ", items " << items << ", rollup memory "
+         << rollups.memoryBytes() / 1024 << " KB" << endl;
+    cout << "record         " << setw(8) << recordUs * 1000.0 / rows << " ns per line (3 levels)" << endl;
+
+    struct Window {
+        const char* label;
+        long long seconds;
+    };
+    Window windows[] = {{"hour", 3600}, {"day", 86400}, {"week", 7 * 86400}, {"month", 30 * 86400}};
+
+    cout << setw(8) << "window" << setw(8) << "level" << setw(9) << "buckets" << setw(13) << "rollups us"
+         << setw(13) << "history us" << setw(10) << "speedup" << setw(12) << "top10 hit" << setw(8) << "exact" << endl;
+    for (const Window& w : windows) {
+        vector<RollupItem> top;
+        RollupWindow covered;
+        double rollUs = bestUs(20, [&]() { covered = rollups.topItems(now, w.seconds, 10, top); });
+
+        vector<long long> totals;
+        double histUs = bestUs(5, [&]() { history.sumBySymbol(covered.from, now + 1, items, totals); });
+        vector<uint32_t> order(items);
+        for (int i = 0; i < items; i++) order[i] = i;
+        partial_sort(order.begin(), order.begin() + 10, order.end(), [&](uint32_t a, uint32_t b) {
+            return totals[a] != totals[b] ? totals[a] > totals[b] : a < b;
+        });
+        int hits = 0;
+        for (const RollupItem& item : top) {
+            hits += find(order.begin(), order.begin() + 10, item.symbol) != order.begin() + 10;
+        }
+
+        cout << setw(8) << w.label << setw(8) << rollups.level(covered.level).name << setw(9) << covered.buckets
+             << setw(13) << rollUs << setw(13) << histUs << setw(9) << histUs / rollUs << "x"
+             << setw(9) << hits << "/10" << setw(8) << (covered.exact ? "yes" : "no") << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,172 @@
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                           SMART GROCERY CART
+ *                    Benchmark: Lock-free Top-Items Reads Under Writes
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Runs 1, 2, 4, ... reader threads calling api_read_ranked_items (the
+ * ranking snapshot behind GET /api/frequent-items) while one writer thread
+ * keeps checking out carts, each of which republishes the snapshot.
+ * Reports reads/s in total and per reader, and the writer's checkouts/s.
+ *
+ * Readers take no lock, so total reads/s should grow in step with the
+ * reader count until readers outnumber the cores, and the writer's rate
+ * should not drop as readers are added. The "locked" column runs the same
+ * readers through api_get_frequent_item (state lock, one item per call,
+ * ten calls per read) for comparison.
+ *
+ * Before that, the cost of one checkout (which republishes both rankings)
+ * is measured with the default store and again after importing custom
+ * items up to store_items: it should not grow with the store.
+ *
+ * COMPILATION (links the library source):
+ *   clang++ -O2 -std=c++17 -pthread -o bench_snapshot_reads bench_snapshot_reads.cpp ../grocery_api_new.cpp
+ *
+ * USAGE:
+ *   bench_snapshot_reads [max_readers=8] [seconds_per_step=1] [store_items=1000000]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+using namespace std;
+
+extern "C" {
+    int api_read_ranked_items(int mode, char* buffer, int capacity);
+    const char* api_get_frequent_item(int index);
+    unsigned long long api_add_to_cart(const char* name, int quantity, int product_id);
+    void api_start_checkout();
+    const char* api_process_checkout();
+    const char* api_import_catalog(const char* path, int threads);
+    const char* api_get_item_store_stats();
+    void api_free_string(char* str);
+}
+
+typedef chrono::steady_clock bench_clock;
+
+static void checkoutOnce(int i) {
+    const char* names[] = {"Milk", "Bread", "Eggs", "Kiwi", "Mango", "Tea"};
+    api_add_to_cart(names[i % 6], 1 + i % 3, -1);
+    api_add_to_cart(names[(i * 7 + 3) % 6], 1, -1);
+    api_start_checkout();
+    api_free_string((char*)api_process_checkout());
+}
+
+// Microseconds per checkout, one thread, no readers
+static double checkoutMicros(double seconds) {
+    long long done = 0;
+    auto t0 = bench_clock::now();
+    double elapsed = 0;
+    while (elapsed < seconds) {
+        checkoutOnce((int)done++);
+        elapsed = chrono::duration<double>(bench_clock::now() - t0).count();
+    }
+    return elapsed / done * 1e6;
+}
+
+// Grow the item store with `rows` custom items (one import, ranked once)
+static bool importItems(int rows) {
+    char path[] = "/tmp/bench_store_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) return false;
+    FILE* out = fdopen(fd, "w");
+    fprintf(out, "name,count\n");
+    for (int i = 0; i < rows; i++) fprintf(out, "Bench Item %07d,%d\n", i, 1 + i % 50);
+    fclose(out);
+    api_free_string((char*)api_import_catalog(path, 0));
+    unlink(path);
+    return true;
+}
+
+static int storeItems() {
+    const char* stats = api_get_item_store_stats();
+    string text = stats;
+    api_free_string((char*)stats);
+    size_t at = text.find("\"items\":");
+    return (at == string::npos) ? -1 : atoi(text.c_str() + at + 8);
+}
+
+struct StepResult {
+    double readsPerSec;
+    double checkoutsPerSec;
+};
+
+static StepResult runStep(int readers, double seconds, bool locked) {
+    atomic<bool> stop(false);
+    atomic<long long> reads(0);
+    atomic<long long> checkouts(0);
+
+    thread writer([&] {
+        long long done = 0;
+        for (int i = 0; !stop.load(memory_order_relaxed); i++) {
+            checkoutOnce(i);
+            done++;
+        }
+        checkouts.store(done);
+    });
+
+    vector<thread> pool;
+    for (int r = 0; r < readers; r++) {
+        pool.emplace_back([&] {
+            char buffer[8192];
+            long long done = 0;
+            long long checksum = 0;
+            while (!stop.load(memory_order_relaxed)) {
+                if (locked) {
+                    for (int i = 0; i < 10; i++) {
+                        const char* item = api_get_frequent_item(i);
+                        checksum += item[0];
+                        api_free_string((char*)item);
+                    }
+                } else {
+                    checksum += api_read_ranked_items(0, buffer, (int)sizeof(buffer));
+                }
+                done++;
+            }
+            reads.fetch_add(done + (checksum == 42 ? 1 : 0));
+        });
+    }
+
+    auto t0 = bench_clock::now();
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    stop.store(true);
+    for (thread& t : pool) t.join();
+    writer.join();
+    double elapsed = chrono::duration<double>(bench_clock::now() - t0).count();
+    return {reads.load() / elapsed, checkouts.load() / elapsed};
+}
+
+int main(int argc, char* argv[]) {
+    int maxReaders = (argc > 1) ? atoi(argv[1]) : 8;
+    double seconds = (argc > 2) ? atof(argv[2]) : 1.0;
+    int storeTarget = (argc > 3) ? atoi(argv[3]) : 1000000;
+
+    cout << "checkout: " << fixed << setprecision(1) << checkoutMicros(seconds) << " us with "
+         << storeItems() << " items";
+    if (storeTarget > storeItems() && importItems(storeTarget - storeItems())) {
+        cout << ", " << checkoutMicros(seconds) << " us with " << storeItems() << " items";
+    }
+    cout << "\n" << endl;
+
+    cout << "hardware threads: " << thread::hardware_concurrency()
+         << " (+1 writer thread checking out carts)" << endl;
+    cout << setw(8) << "readers" << setw(16) << "reads/s" << setw(16) << "per reader"
+         << setw(16) << "checkouts/s" << setw(16) << "locked reads/s" << setw(16) << "checkouts/s" << endl;
+
+    for (int readers = 1; readers <= maxReaders; readers *= 2) {
+        StepResult snapshot = runStep(readers, seconds, false);
+        StepResult locked = runStep(readers, seconds, true);
+        cout << setw(8) << readers << fixed << setprecision(0)
+             << setw(16) << snapshot.readsPerSec << setw(16) << snapshot.readsPerSec / readers
+             << setw(16) << snapshot.checkoutsPerSec
+             << setw(16) << locked.readsPerSec << setw(16) << locked.checkoutsPerSec << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,98 @@
+"""
+═══════════════════════════════════════════════════════════════════════════════
+                    HTTP BENCHMARK - Flask vs native server
+═══════════════════════════════════════════════════════════════════════════════
+
+Drives a running server with N keep-alive client threads and reports
+throughput plus latency percentiles per scenario. Point it at server.py or
+native_server in turn, on the same machine, to compare the two.
+
+Scenarios:
+    read   GET /api/cart and GET /api/frequent-items, alternating
+    mixed  9 reads : 1 add-to-cart (each add persists cart_data.json)
+
+USAGE:
+    python http_bench.py [host:port] [threads=8] [seconds=5]
+
+Mutations change the server's cart_data.json - use a scratch copy.
+"""
+
+import http.client
+import json
+import sys
+import threading
+import time
+
+READ_PATHS = ['/api/cart', '/api/frequent-items']
+
+
+def worker(host, port, scenario, deadline, latencies, errors):
+    conn = http.client.HTTPConnection(host, port, timeout=10)
+    i = 0
+    while time.perf_counter() < deadline:
+        if scenario == 'mixed' and i % 10 == 9:
+            method, path = 'POST', '/api/cart/add'
+            body = json.dumps({'name': 'Bench Item', 'quantity': 1, 'product_id': -1})
+        else:
+            method, path, body = 'GET', READ_PATHS[i % 2], None
+        i += 1
+
+        start = time.perf_counter()
+        try:
+            conn.request(method, path, body=body,
+                         headers={'Content-Type': 'application/json'})
+            response = conn.getresponse()
+            response.read()
+            if response.status != 200:
+                errors.append(response.status)
+        except (OSError, http.client.HTTPException) as e:
+            errors.append(str(e))
+            conn.close()
+            conn = http.client.HTTPConnection(host, port, timeout=10)
+            continue
+        latencies.append(time.perf_counter() - start)
+    conn.close()
+
+
+def percentile(sorted_values, fraction):
+    if not sorted_values:
+        return 0.0
+    index = min(len(sorted_values) - 1, int(fraction * len(sorted_values)))
+    return sorted_values[index]
+
+
+def run(host, port, scenario, threads, seconds):
+    deadline = time.perf_counter() + seconds
+    per_thread = [[] for _ in range(threads)]
+    errors = []
+    pool = [threading.Thread(target=worker, args=(host, port, scenario, deadline, per_thread[t], errors))
+            for t in range(threads)]
+    start = time.perf_counter()
+    for t in pool:
+        t.start()
+    for t in pool:
+        t.join()
+    elapsed = time.perf_counter() - start
+
+    latencies = sorted(l for chunk in per_thread for l in chunk)
+    print(f"{scenario:6s} {len(latencies) / elapsed:9.0f} req/s   "
+          f"p50 {percentile(latencies, 0.50) * 1000:7.2f} ms   "
+          f"p99 {percentile(latencies, 0.99) * 1000:7.2f} ms   "
+          f"errors {len(errors)}")
+
+
+if __name__ == '__main__':
+    target = sys.argv[1] if len(sys.argv) > 1 else '127.0.0.1:5000'
+    threads = int(sys.argv[2]) if len(sys.argv) > 2 else 8
+    seconds = float(sys.argv[3]) if len(sys.argv) > 3 else 5
+    host, port = target.rsplit(':', 1)
+
+    # Start from an empty cart so both servers serialize the same data
+    clear = http.client.HTTPConnection(host, int(port), timeout=10)
+    clear.request('DELETE', '/api/cart/clear')
+    clear.getresponse().read()
+    clear.close()
+
+    print(f"{target}: {threads} threads, {seconds:g} s per scenario")
+    for scenario in ('read', 'mixed'):
+        run(host, int(port), scenario, threads, seconds)
@@ -0,0 +1,578 @@
+"""
+═══════════════════════════════════════════════════════════════════════════════
+                    LOAD AND SOAK HARNESS - Realistic Shopping Sessions
+═══════════════════════════════════════════════════════════════════════════════
+
+Runs N concurrent shoppers against the library (in this process) or against
+a running server's HTTP routes. It prints, at every interval, the
+throughput, latency percentiles, the target process's RSS and how much it
+wrote to files. Over a long soak, a leak shows up as an RSS trend, and
+write amplification shows up as write volume per operation.
+
+Workload (standard library only, seeded, so runs can be repeated):
+    - Each shopper runs sessions back to back. A session is a run of cart
+      operations (on average --session-ops), then a checkout.
+    - Items are picked with Zipf-distributed popularity (--zipf s) over
+      --items names. The target's current top items are the most popular;
+      the rest are custom items.
+    - Each step picks an operation by weight (--mix):
+          add     add 1-3 of an item           POST /api/cart/add
+          remove  remove a line by handle      DELETE /api/cart/remove/handle/<h>
+          update  set a line's quantity        POST /api/cart/quantity/<h>
+          undo    undo the last add            POST /api/undo
+          cart    list the cart                GET /api/cart
+          items   list the top items           GET /api/frequent-items
+      A checkout is POST /api/checkout/start, then POST /api/checkout/process.
+    - All shoppers share the one cart, as every client of the app does. A
+      remove or update can lose the race for a line; that is counted as
+      a "miss", not an error.
+
+Targets:
+    lib              the library in this process: the ctypes binding as
+                     server.py declares it (--binding ctypes), or the
+                     grocery_native module (--binding native). Persistence
+                     writes to --data-dir, like the server does.
+    http://host:port server.py or native_server. Pass --pid, or --spawn a
+                     command, to sample that process's RSS and writes.
+
+RSS comes from /proc/<pid>/status. Writes come from /proc/<pid>/io: "wchar"
+is bytes passed to write(), and "disk" is bytes that reached storage. On
+systems without /proc, RSS is this process's peak and writes are "n/a".
+Latencies go into fixed log-scale histograms (about 4% resolution), so the
+harness's own memory stays flat over an hour-long run.
+
+USAGE (from src/):
+    python bench/soak.py lib [--binding ctypes|native] [options]
+    python bench/soak.py http://127.0.0.1:5000 --pid <server pid> [options]
+    python bench/soak.py http://127.0.0.1:18080 \\
+        --spawn "./native_server 18080 4 ../web /tmp/soak/cart_data.json" [options]
+
+    --duration 3600 --interval 60   hour-long soak, one row per minute
+    --workers 8                     concurrent shoppers
+    --csv soak.csv                  also write the interval rows as CSV
+
+HTTP runs change the server's cart_data.json and purchase history, so
+point the server at a scratch copy.
+"""
+
+import argparse
+import bisect
+import csv
+import ctypes
+import http.client
+import json
+import math
+import os
+import random
+import shlex
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+from urllib.parse import urlparse
+
+SRC_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+
+OPERATIONS = ['add', 'remove', 'update', 'undo', 'cart', 'items', 'checkout']
+DEFAULT_MIX = 'add=45,remove=10,update=5,undo=10,cart=20,items=10'
+
+# ═══════════════════════════════════════════════════════════════════════════════
+#                           MEASUREMENT
+# ═══════════════════════════════════════════════════════════════════════════════
+
+class Histogram:
+    """Latency counts in log-scale buckets: 8 per doubling, from 1 us to ~70 s"""
+    BUCKETS = 8 * 26
+
+    def __init__(self):
+        self.counts = [0] * self.BUCKETS
+        self.total = 0
+
+    def record(self, seconds):
+        micros = seconds * 1e6
+        index = int(8 * math.log2(micros)) if micros > 1 else 0
+        self.counts[min(index, self.BUCKETS - 1)] += 1
+        self.total += 1
+
+    def merge(self, other):
+        for i, count in enumerate(other.counts):
+            self.counts[i] += count
+        self.total += other.total
+
+    def percentile(self, fraction):
+        """Upper edge of the bucket holding the given fraction, in ms"""
+        if self.total == 0:
+            return 0.0
+        wanted = fraction * self.total
+        seen = 0
+        for i, count in enumerate(self.counts):
+            seen += count
+            if seen >= wanted:
+                return 2 ** ((i + 1) / 8) / 1000
+        return 2 ** (self.BUCKETS / 8) / 1000
+
+
+class Tally:
+    """One shopper's results since the last interval (swapped out by the reporter)"""
+
+    def __init__(self):
+        self.latency = {op: Histogram() for op in OPERATIONS}
+        self.misses = 0
+        self.errors = 0
+        self.last_error = ''
+
+
+class ProcessProbe:
+    """RSS and file writes of one process, from /proc where available"""
+
+    def __init__(self, pid):
+        self.pid = pid
+
+    def rss_mb(self):
+        try:
+            with open(f'/proc/{self.pid}/status') as status:
+                for line in status:
+                    if line.startswith('VmRSS:'):
+                        return int(line.split()[1]) / 1024
+        except OSError:
+            pass
+        if self.pid == os.getpid():
+            try:
+                import resource
+                peak = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+                return peak / (1024 * 1024 if sys.platform == 'darwin' else 1024)
+            except ImportError:
+                pass
+        return float('nan')
+
+    def written(self):
+        """(wchar, disk write_bytes) in bytes, or None"""
+        try:
+            fields = {}
+            with open(f'/proc/{self.pid}/io') as io:
+                for line in io:
+                    name, value = line.split(':')
+                    fields[name] = int(value)
+            return fields['wchar'], fields['write_bytes']
+        except (OSError, KeyError, ValueError):
+            return None
+
+
+def slope_per_hour(samples):
+    """Least-squares slope of (seconds, value) samples, in units per hour"""
+    if len(samples) < 2:
+        return 0.0
+    n = len(samples)
+    mean_t = sum(t for t, _ in samples) / n
+    mean_v = sum(v for _, v in samples) / n
+    spread = sum((t - mean_t) ** 2 for t, _ in samples)
+    if spread == 0:
+        return 0.0
+    return sum((t - mean_t) * (v - mean_v) for t, v in samples) / spread * 3600
+
+# ═══════════════════════════════════════════════════════════════════════════════
+#                           WORKLOAD
+# ═══════════════════════════════════════════════════════════════════════════════
+
+class Catalog:
+    """Item names ranked by popularity; pick() draws a rank from a Zipf law"""
+
+    def __init__(self, base_items, count, exponent):
+        self.items = [(item['name'], item.get('id', -1)) for item in base_items]
+        for i in range(len(self.items), count):
+            self.items.append((f'Soak Item {i:04d}', -1))
+        weights = [1 / (rank ** exponent) for rank in range(1, len(self.items) + 1)]
+        total = sum(weights)
+        self.cumulative = []
+        running = 0.0
+        for weight in weights:
+            running += weight / total
+            self.cumulative.append(running)
+
+    def pick(self, rng):
+        rank = bisect.bisect_left(self.cumulative, rng.random())
+        return self.items[min(rank, len(self.items) - 1)]
+
+
+def parse_mix(text):
+    mix = {}
+    for part in text.split(','):
+        name, weight = part.split('=')
+        if name not in OPERATIONS or name == 'checkout':
+            raise SystemExit(f"unknown operation in --mix: {name}")
+        mix[name] = float(weight)
+    return mix
+
+
+class Shopper(threading.Thread):
+    def __init__(self, index, driver, catalog, mix, session_ops, deadline, seed):
+        super().__init__(daemon=True)
+        self.driver = driver
+        self.catalog = catalog
+        self.ops = list(mix)
+        self.cumulative = []
+        running = 0.0
+        for op in self.ops:
+            running += mix[op]
+            self.cumulative.append(running)
+        self.session_ops = session_ops
+        self.deadline = deadline
+        self.rng = random.Random(seed * 1000 + index)
+        self.handles = []     # lines this shopper added (may be gone)
+        self.lock = threading.Lock()
+        self.tally = Tally()
+
+    def take_tally(self):
+        with self.lock:
+            tally, self.tally = self.tally, Tally()
+        return tally
+
+    def step(self, op):
+        rng = self.rng
+        start = time.perf_counter()
+        try:
+            if op == 'add':
+                name, product_id = self.catalog.pick(rng)
+                handle = self.driver.add(name, rng.randint(1, 3), product_id)
+                if handle:
+                    self.handles.append(handle)
+                    del self.handles[:-32]
+                ok = True
+            elif op == 'remove':
+                ok = bool(self.handles) and self.driver.remove(self.handles.pop(rng.randrange(len(self.handles))))
+            elif op == 'update':
+                ok = bool(self.handles) and self.driver.update(rng.choice(self.handles), rng.randint(1, 5))
+            elif op == 'undo':
+                ok = self.driver.undo()
+            elif op == 'cart':
+                ok = self.driver.cart()
+            elif op == 'items':
+                ok = self.driver.items()
+            else:
+                ok = self.driver.checkout()
+                self.handles.clear()
+            error = None
+        except Exception as e:   # count it and keep the soak going
+            ok, error = False, f'{op}: {e!r}'
+            self.driver.recover()
+        elapsed = time.perf_counter() - start
+        with self.lock:
+            self.tally.latency[op].record(elapsed)
+            if error:
+                self.tally.errors += 1
+                self.tally.last_error = error
+            elif not ok:
+                self.tally.misses += 1
+
+    def run(self):
+        rng = self.rng
+        while time.perf_counter() < self.deadline:
+            # Geometric session length with the requested mean
+            while time.perf_counter() < self.deadline:
+                point = rng.random() * self.cumulative[-1]
+                self.step(self.ops[bisect.bisect_left(self.cumulative, point)])
+                if rng.random() < 1 / self.session_ops:
+                    break
+            if time.perf_counter() < self.deadline:
+                self.step('checkout')
+
+# ═══════════════════════════════════════════════════════════════════════════════
+#                           TARGETS
+# ═══════════════════════════════════════════════════════════════════════════════
+
+class LibraryDriver:
+    """Calls the library directly, the way server.py's routes do"""
+
+    def __init__(self, lib, native):
+        self.lib = lib
+        self.native = native
+        self.buffer = ctypes.create_string_buffer(8192) if not native else None
+
+    def text(self, value):
+        return value if self.native else value.encode('utf-8')
+
+    def parse(self, result):
+        return result if isinstance(result, (list, dict)) else json.loads(result)
+
+    def add(self, name, quantity, product_id):
+        return self.lib.api_add_to_cart(self.text(name), quantity, product_id)
+
+    def remove(self, handle):
+        return 'error' not in self.parse(self.lib.api_remove_cart_line(handle))
+
+    def update(self, handle, quantity):
+        return bool(self.lib.api_update_cart_line(handle, quantity))
+
+    def undo(self):
+        return 'error' not in self.parse(self.lib.api_undo_last_action())
+
+    def cart(self):
+        self.parse(self.lib.api_get_cart_items())
+        return True
+
+    def items(self):
+        if self.native:
+            self.lib.ranked_items(0)
+        else:
+            length = self.lib.api_read_ranked_items(0, self.buffer, len(self.buffer))
+            json.loads(self.buffer.raw[:length])
+        return True
+
+    def checkout(self):
+        self.lib.api_start_checkout()
+        self.parse(self.lib.api_process_checkout())
+        return True
+
+    def recover(self):
+        pass
+
+    def base_items(self):
+        if self.native:
+            return self.lib.ranked_items(0)
+        length = self.lib.api_read_ranked_items(0, self.buffer, len(self.buffer))
+        return json.loads(self.buffer.raw[:length])
+
+
+class HttpDriver:
+    """One keep-alive connection per shopper"""
+
+    def __init__(self, host, port):
+        self.host = host
+        self.port = port
+        self.conn = http.client.HTTPConnection(host, port, timeout=30)
+
+    def request(self, method, path, body=None):
+        headers = {'Content-Type': 'application/json'} if body is not None else {}
+        self.conn.request(method, path, body=json.dumps(body) if body is not None else None, headers=headers)
+        response = self.conn.getresponse()
+        data = response.read()
+        if response.status >= 500:
+            raise RuntimeError(f'{method} {path}: HTTP {response.status}')
+        return response.status, data
+
+    def add(self, name, quantity, product_id):
+        status, data = self.request('POST', '/api/cart/add',
+                                    {'name': name, 'quantity': quantity, 'product_id': product_id})
+        return json.loads(data).get('handle') if status == 200 else None
+
+    def remove(self, handle):
+        return self.request('DELETE', f'/api/cart/remove/handle/{handle}')[0] == 200
+
+    def update(self, handle, quantity):
+        return self.request('POST', f'/api/cart/quantity/{handle}', {'quantity': quantity})[0] == 200
+
+    def undo(self):
+        return json.loads(self.request('POST', '/api/undo')[1]).get('success', False)
+
+    def cart(self):
+        return self.request('GET', '/api/cart')[0] == 200
+
+    def items(self):
+        return self.request('GET', '/api/frequent-items')[0] == 200
+
+    def checkout(self):
+        self.request('POST', '/api/checkout/start')
+        return self.request('POST', '/api/checkout/process')[0] == 200
+
+    def recover(self):
+        self.conn.close()
+        self.conn = http.client.HTTPConnection(self.host, self.port, timeout=30)
+
+    def base_items(self):
+        return json.loads(self.request('GET', '/api/frequent-items')[1]).get('data', [])
+
+
+def load_library(binding, data_dir):
+    """The library as server.py would load it, persisting to data_dir"""
+    sys.path.insert(0, SRC_DIR)
+    if binding == 'native':
+        import grocery_native as lib
+        text = lambda value: value
+    else:
+        name = 'grocery_api.dll' if sys.platform == 'win32' else 'libgrocery_api.so'
+        lib = ctypes.CDLL(os.path.join(SRC_DIR, name))
+        # Declared like server.py's binding, c_char_p results included
+        lib.api_add_to_cart.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_int]
+        lib.api_add_to_cart.restype = ctypes.c_uint64
+        lib.api_remove_cart_line.argtypes = [ctypes.c_uint64]
+        lib.api_remove_cart_line.restype = ctypes.c_char_p
+        lib.api_update_cart_line.argtypes = [ctypes.c_uint64, ctypes.c_int]
+        lib.api_update_cart_line.restype = ctypes.c_bool
+        lib.api_undo_last_action.restype = ctypes.c_char_p
+        lib.api_get_cart_items.restype = ctypes.c_char_p
+        lib.api_read_ranked_items.argtypes = [ctypes.c_int, ctypes.c_char_p, ctypes.c_int]
+        lib.api_read_ranked_items.restype = ctypes.c_int
+        lib.api_start_checkout.restype = None
+        lib.api_process_checkout.restype = ctypes.c_char_p
+        lib.api_set_persistence.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_int]
+        lib.api_set_persistence.restype = None
+        lib.api_flush.restype = ctypes.c_bool
+        text = lambda value: value.encode('utf-8')
+    lib.api_set_persistence(text(os.path.join(data_dir, 'cart_data.json')), 20, 0)
+    return lib
+
+# ═══════════════════════════════════════════════════════════════════════════════
+#                           REPORTING
+# ═══════════════════════════════════════════════════════════════════════════════
+
+COLUMNS = ['elapsed_s', 'ops_per_s', 'p50_ms', 'p95_ms', 'p99_ms', 'max_ms', 'misses', 'errors',
+           'rss_mb', 'rss_growth_mb', 'wchar_mb', 'disk_mb']
+
+
+def format_row(row):
+    return (f"{row['elapsed_s']:8.0f} {row['ops_per_s']:9.0f} {row['p50_ms']:8.3f} {row['p95_ms']:8.3f} "
+            f"{row['p99_ms']:8.3f} {row['max_ms']:9.2f} {row['misses']:7d} {row['errors']:6d} "
+            f"{row['rss_mb']:8.1f} {row['rss_growth_mb']:+8.1f} {row['wchar_mb']:9.2f} {row['disk_mb']:8.2f}")
+
+
+def report(shoppers, probe, args, start):
+    totals = Tally()
+    total_ops = 0
+    rss_start = probe.rss_mb()
+    written_start = probe.written()
+    rss_samples = []
+    rows = []
+    writer = None
+    if args.csv:
+        csv_file = open(args.csv, 'w', newline='')
+        writer = csv.DictWriter(csv_file, fieldnames=COLUMNS)
+        writer.writeheader()
+
+    print(f"{'elapsed':>8} {'ops/s':>9} {'p50 ms':>8} {'p95 ms':>8} {'p99 ms':>8} {'max ms':>9} "
+          f"{'misses':>7} {'errors':>6} {'rss MB':>8} {'growth':>8} {'wchar MB':>9} {'disk MB':>8}")
+    last = start
+    while any(shopper.is_alive() for shopper in shoppers):
+        for shopper in shoppers:
+            shopper.join(timeout=max(0.0, last + args.interval - time.perf_counter()))
+        now = time.perf_counter()
+        interval = Tally()
+        for shopper in shoppers:
+            tally = shopper.take_tally()
+            for op in OPERATIONS:
+                interval.latency[op].merge(tally.latency[op])
+            interval.misses += tally.misses
+            interval.errors += tally.errors
+            interval.last_error = tally.last_error or interval.last_error
+        combined = Histogram()
+        for op in OPERATIONS:
+            combined.merge(interval.latency[op])
+            totals.latency[op].merge(interval.latency[op])
+        totals.misses += interval.misses
+        totals.errors += interval.errors
+        totals.last_error = interval.last_error or totals.last_error
+        total_ops += combined.total
+
+        rss = probe.rss_mb()
+        written = probe.written()
+        wchar, disk = ((written[0] - written_start[0]) / 2**20, (written[1] - written_start[1]) / 2**20) \
+            if written and written_start else (float('nan'), float('nan'))
+        row = {
+            'elapsed_s': now - start,
+            'ops_per_s': combined.total / max(now - last, 1e-9),
+            'p50_ms': combined.percentile(0.50),
+            'p95_ms': combined.percentile(0.95),
+            'p99_ms': combined.percentile(0.99),
+            'max_ms': combined.percentile(1.0),
+            'misses': interval.misses,
+            'errors': interval.errors,
+            'rss_mb': rss,
+            'rss_growth_mb': rss - rss_start,
+            'wchar_mb': wchar,
+            'disk_mb': disk,
+        }
+        print(format_row(row), flush=True)
+        if writer:
+            writer.writerow(row)
+            csv_file.flush()
+        rows.append(row)
+        rss_samples.append((now - start, rss))
+        last = now
+
+    elapsed = last - start
+    print(f"\n{'operation':<10} {'count':>10} {'p50 ms':>8} {'p99 ms':>8}")
+    for op in OPERATIONS:
+        histogram = totals.latency[op]
+        print(f"{op:<10} {histogram.total:>10} {histogram.percentile(0.5):>8.3f} {histogram.percentile(0.99):>8.3f}")
+    print(f"\n{total_ops} operations in {elapsed:.0f} s ({total_ops / max(elapsed, 1e-9):.0f} ops/s), "
+          f"{totals.misses} misses, {totals.errors} errors")
+    if totals.last_error:
+        print(f"last error: {totals.last_error}")
+    # The first interval includes warm-up (allocator growth, caches), so the
+    # trend is fitted to the rest when there is enough of it
+    trend = rss_samples[1:]
+    print(f"RSS {rss_start:.1f} -> {rss_samples[-1][1] if rss_samples else rss_start:.1f} MB, " +
+          (f"trend {slope_per_hour(trend):+.1f} MB/hour" if len(trend) >= 3 else "too few intervals for a trend"))
+    if rows and not math.isnan(rows[-1]['wchar_mb']):
+        print(f"written {rows[-1]['wchar_mb']:.1f} MB ({rows[-1]['disk_mb']:.1f} MB to disk), "
+              f"{rows[-1]['wchar_mb'] * 2**20 / max(total_ops, 1):.0f} bytes per operation")
+    if writer:
+        csv_file.close()
+
+# ═══════════════════════════════════════════════════════════════════════════════
+#                           MAIN
+# ═══════════════════════════════════════════════════════════════════════════════
+
+def main():
+    parser = argparse.ArgumentParser(description='Load and soak harness (see the module docstring)')
+    parser.add_argument('target', help="'lib' or http://host:port")
+    parser.add_argument('--binding', choices=['ctypes', 'native'], default='ctypes', help='lib target only')
+    parser.add_argument('--data-dir', help='lib target: where cart_data.json is persisted (default: a temp dir)')
+    parser.add_argument('--pid', type=int, help='http target: server process to sample')
+    parser.add_argument('--spawn', help='http target: start this server command, sample it, stop it at the end')
+    parser.add_argument('--workers', type=int, default=8)
+    parser.add_argument('--duration', type=float, default=60, help='seconds (3600 for an hour-long soak)')
+    parser.add_argument('--interval', type=float, default=10, help='seconds between report rows')
+    parser.add_argument('--items', type=int, default=500, help='distinct item names')
+    parser.add_argument('--zipf', type=float, default=1.1, help='popularity exponent')
+    parser.add_argument('--mix', default=DEFAULT_MIX, help='operation weights, e.g. ' + DEFAULT_MIX)
+    parser.add_argument('--session-ops', type=float, default=8, help='mean operations per session')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--csv', help='also write the interval rows to this CSV file')
+    args = parser.parse_args()
+
+    server = None
+    if args.target == 'lib':
+        data_dir = args.data_dir or tempfile.mkdtemp(prefix='grocery-soak-')
+        lib = load_library(args.binding, data_dir)
+        make_driver = lambda: LibraryDriver(lib, args.binding == 'native')
+        probe = ProcessProbe(os.getpid())
+        where = f"library ({args.binding} binding), data in {data_dir}"
+    else:
+        url = urlparse(args.target)
+        if url.scheme != 'http' or not url.hostname:
+            raise SystemExit("target must be 'lib' or http://host:port")
+        port = url.port or 80
+        pid = args.pid
+        if args.spawn:
+            server = subprocess.Popen(shlex.split(args.spawn), stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+            pid = server.pid
+            for _ in range(100):   # wait for it to listen
+                try:
+                    HttpDriver(url.hostname, port).base_items()
+                    break
+                except OSError:
+                    time.sleep(0.1)
+        make_driver = lambda: HttpDriver(url.hostname, port)
+        probe = ProcessProbe(pid if pid else os.getpid())
+        where = f"{args.target}" + (f" (pid {pid})" if pid else " (no --pid: sampling this process)")
+
+    try:
+        catalog = Catalog(make_driver().base_items(), args.items, args.zipf)
+        mix = parse_mix(args.mix)
+        print(f"{where}: {args.workers} shoppers, {args.duration:g} s, Zipf {args.zipf} over "
+              f"{len(catalog.items)} items, mix {args.mix}, ~{args.session_ops:g} ops per session\n")
+        start = time.perf_counter()
+        shoppers = [Shopper(i, make_driver(), catalog, mix, args.session_ops, start + args.duration, args.seed)
+                    for i in range(args.workers)]
+        for shopper in shoppers:
+            shopper.start()
+        report(shoppers, probe, args, start)
+    finally:
+        if server:
+            server.terminate()
+            server.wait()
+
+
+if __name__ == '__main__':
+    main()
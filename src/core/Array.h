@@ -4,13 +4,37 @@
 #include <iostream>
 #include <algorithm>
 #include <cctype>
+#include <cmath>
+#include <chrono>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <type_traits>
 #include "Product.h"
+#include "Catalog.h"
+#include "SharedMemory.h"
+#include "Metrics.h"
+#include "Trace.h"
 using namespace std;
 
 // Maximum items to display as "frequent items"
 const int MAX_DISPLAY_ITEMS = 10;
+// Custom (user-added or imported) items we can store on top of the base catalog
+const int MAX_CUSTOM_ITEMS = 1 << 20;
 // Maximum total items we can store
-const int MAX_TOTAL_ITEMS = 1000;
+const int MAX_TOTAL_ITEMS = CATALOG_SIZE + MAX_CUSTOM_ITEMS;
+// Custom items looked at to pick one eviction victim
+const int EVICTION_SAMPLES = 16;
+// Default half-life of the "recent popularity" score (7 days, in seconds)
+const double DEFAULT_POPULARITY_HALF_LIFE = 7.0 * 24 * 3600;
+// Fixed reference epoch for decayed scores (2024-01-01 00:00:00 UTC)
+const double POPULARITY_REFERENCE_EPOCH = 1704067200.0;
+
+// Ranking modes for the displayed items
+const int RANK_BY_LIFETIME = 0;  // lifetime purchaseCount
+const int RANK_BY_RECENT = 1;    // exponentially decayed popularity
 
 // Case-insensitive string comparison helper
 inline bool equalsIgnoreCase(const string& a, const string& b) {
@@ -21,20 +45,45 @@ inline bool equalsIgnoreCase(const string& a, const string& b) {
     return true;
 }
 
+// Current wall-clock time in seconds
+inline double currentTimeSeconds() {
+    using namespace std::chrono;
+    return duration<double>(system_clock::now().time_since_epoch()).count();
+}
+
+// log(exp(a) + exp(b)) without overflow
+inline double logAddExp(double a, double b) {
+    if (a == -INFINITY) return b;
+    if (b == -INFINITY) return a;
+    double hi = (a > b) ? a : b;
+    double lo = (a > b) ? b : a;
+    return hi + log1p(exp(lo - hi));
+}
+
 /**
  * FrequentItem - Represents any item (default or custom) with purchase tracking
+ *
+ * decayLog is the item's exponentially decayed popularity kept in the log
+ * domain and measured against POPULARITY_REFERENCE_EPOCH:
+ *     decayLog = log( sum of quantity * e^(rate * (t_purchase - epoch)) )
+ * Every item shares the same e^(-rate * (now - epoch)) factor, so comparing
+ * decayLog values ranks items by their current decayed score without ever
+ * rescoring the items that were not purchased.
  */
 struct FrequentItem {
     int id;
-    string name;
+    InlineName name;  // inline, so the array can live in shared memory
     int purchaseCount;
     bool isCustom;  // true if user-added, false if default item
+    double decayLog;  // -INFINITY until the first purchase
+    int cartLines;  // cart / checkout-queue lines naming a custom item; > 0 pins it
     
     FrequentItem() {
         id = -1;
-        name = "";
         purchaseCount = 0;
         isCustom = false;
+        decayLog = -INFINITY;
+        cartLines = 0;
     }
     
     FrequentItem(int itemId, string n, int count = 0, bool custom = false) {
@@ -42,13 +91,46 @@ struct FrequentItem {
         name = n;
         purchaseCount = count;
         isCustom = custom;
+        decayLog = -INFINITY;
+        cartLines = 0;
     }
+
+    // A base-catalog item with no purchases (compile-time)
+    constexpr FrequentItem(int itemId, const InlineName& n)
+        : id(itemId), name(n), purchaseCount(0), isCustom(false), decayLog(-INFINITY), cartLines(0) {}
     
     bool operator>(const FrequentItem& other) const {
         return purchaseCount > other.purchaseCount;
     }
 };
 
+static_assert(is_trivially_copyable<FrequentItem>::value, "the catalog image is copied with memcpy");
+
+template <size_t... I>
+constexpr array<FrequentItem, sizeof...(I)> makeCatalogImage(index_sequence<I...>) {
+    return {{FrequentItem(CATALOG_ITEMS[I].id,
+                          InlineName(CATALOG_ITEMS[I].name, (size_t)CATALOG_ITEMS[I].nameLength))...}};
+}
+
+constexpr array<int, CATALOG_SIZE> makeCatalogPositions() {
+    array<int, CATALOG_SIZE> positions = {};
+    for (int i = 0; i < CATALOG_SIZE; i++) positions[i] = i;
+    return positions;
+}
+
+// records, order and rankOf as they are after a reset, built by the compiler
+constexpr array<FrequentItem, CATALOG_SIZE> CATALOG_IMAGE = makeCatalogImage(make_index_sequence<CATALOG_SIZE>());
+constexpr array<int, CATALOG_SIZE> CATALOG_POSITIONS = makeCatalogPositions();
+
+// Cart lines naming a custom item the store does not hold (yet)
+struct PendingCartLines {
+    InlineName name;
+    int lines;   // 0 = free slot
+
+    PendingCartLines() : lines(0) {}
+    PendingCartLines(const char* s, size_t n, int count) : name(s, n), lines(count) {}
+};
+
 /**
  * ═══════════════════════════════════════════════════════════════════════════════
  *                    UNIFIED ITEMS ARRAY (Single Storage)
@@ -62,41 +144,347 @@ struct FrequentItem {
  * - Automatic sorting by purchase count
  * - Top 10 items shown as frequent items
  * - Custom items automatically get promoted when purchased frequently
+ *
+ * Records are stored in insertion order and never move; `order` is the
+ * ranking (index i = i-th most purchased) and `rankOf` its inverse, so the
+ * public "index" of an item is its rank. A purchase moves one entry of
+ * `order` up past the items it now outsells - O(distance), not a full sort.
+ *
+ * Base-catalog items are records 0..CATALOG_SIZE-1, copied from
+ * CATALOG_IMAGE (one memcpy, however big the catalog) and found through the
+ * compile-time perfect hash. Custom items are found through two
+ * open-addressing tables (folded name, id). Everything lives in
+ * SegmentVectors, so the store grows on demand - in the shared segment too.
+ *
+ * BOUNDED CUSTOM ITEMS:
+ * At most customCapacity() custom items are kept (MAX_CUSTOM_ITEMS unless
+ * set lower). When the store is full, evictCustom() removes the least
+ * frequently used custom item, where frequency ages with the recent-score
+ * half-life (decayLog, then lifetime count). The victim is the best of
+ * EVICTION_SAMPLES random custom items, so eviction costs O(samples), not
+ * O(n). Base-catalog items are never evicted, and the caller can pin any
+ * other item. The last custom record is moved into the hole, so records
+ * stay dense.
+ *
+ * Each custom record counts the cart and checkout-queue lines that name it
+ * (countCartLine), so "is it in a cart" is one field read. Lines of a name
+ * with no record wait in pendingLines and move onto the record when the
+ * item is added, and back if it is ever removed while still in a cart.
  */
 class FrequentItemsArray {
 private:
-    FrequentItem items[MAX_TOTAL_ITEMS];
-    int current_size;
-    int nextCustomId;  // ID generator for custom items (starts at 1000)
+    SegmentVector<FrequentItem> records;  // insertion order; a record never moves
+    SegmentVector<int> order;             // rank -> record (purchaseCount descending, stable)
+    SegmentVector<int> rankOf;            // record -> rank
+    SegmentVector<int> nameSlots;         // custom records by folded name (record + 1, 0 = free)
+    SegmentVector<int> idSlots;           // custom records by id (record + 1, 0 = free)
+    SegmentVector<PendingCartLines> pendingLines;   // by folded name, for names with no record
+    int pendingCount;  // used slots of pendingLines
+    int peak_size;     // high-water mark of totalSize()
+    int nextCustomId;  // ID generator for custom items (starts at CATALOG_FIRST_CUSTOM_ID)
+    double decayRate;  // ln(2) / half-life, per second
+    int customLimit;   // custom items kept before evicting (<= MAX_CUSTOM_ITEMS)
+    long long evictions;
+    uint32_t sampleState;  // xorshift32 for eviction sampling
+    atomic<uint64_t> changes;  // bumped by every change a listing could show
+    // Top purchased records by decayLog, best first (see topRecentIndices)
+    mutable int recentTop[MAX_DISPLAY_ITEMS];
+    mutable int recentTopCount;
+    mutable bool recentTopStale;   // a score fell or a listed item left: rescan once
+
+    void changed() { changes.fetch_add(1, memory_order_release); }
+
+    static uint32_t idKey(int id) {
+        uint32_t h = (uint32_t)id * 2654435761u;
+        return h ^ (h >> 16);
+    }
+
+    int customCount() const { return (int)records.size() - CATALOG_SIZE; }
+
+    int findCustomByName(const char* s, size_t n, uint32_t hash) const {
+        if (nameSlots.empty()) return -1;
+        size_t mask = nameSlots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            int record = nameSlots[i] - 1;
+            if (record < 0) return -1;
+            if (records[record].name.equalsIgnoreCase(s, n)) return record;
+        }
+    }
+
+    int findCustomById(int itemId) const {
+        if (idSlots.empty()) return -1;
+        size_t mask = idSlots.size() - 1;
+        for (size_t i = idKey(itemId) & mask;; i = (i + 1) & mask) {
+            int record = idSlots[i] - 1;
+            if (record < 0) return -1;
+            if (records[record].id == itemId) return record;
+        }
+    }
+
+    void indexCustom(int record) {
+        const FrequentItem& item = records[record];
+        size_t mask = nameSlots.size() - 1;
+        size_t i = nameKey(item.name.c_str(), item.name.size()) & mask;
+        while (nameSlots[i] != 0) i = (i + 1) & mask;
+        nameSlots[i] = record + 1;
+        i = idKey(item.id) & mask;
+        while (idSlots[i] != 0) i = (i + 1) & mask;
+        idSlots[i] = record + 1;
+    }
+
+    // Hash of `record` in `slots` (nameSlots or idSlots)
+    uint32_t slotKey(const SegmentVector<int>& slots, int record) const {
+        const FrequentItem& item = records[record];
+        return (&slots == &nameSlots) ? nameKey(item.name.c_str(), item.name.size()) : idKey(item.id);
+    }
+
+    // Slot in `slots` holding `record`
+    size_t slotOfRecord(const SegmentVector<int>& slots, int record) const {
+        size_t mask = slots.size() - 1;
+        size_t i = slotKey(slots, record) & mask;
+        while (slots[i] != record + 1) i = (i + 1) & mask;
+        return i;
+    }
+
+    // Remove `record` from one table; later entries of its probe run shift back
+    void unindexFrom(SegmentVector<int>& slots, int record) {
+        size_t mask = slots.size() - 1;
+        size_t hole = slotOfRecord(slots, record);
+        for (size_t j = (hole + 1) & mask; slots[j] != 0; j = (j + 1) & mask) {
+            size_t home = slotKey(slots, slots[j] - 1) & mask;
+            // The entry may fill the hole unless its home lies in (hole, j]
+            if (((j - home) & mask) >= ((j - hole) & mask)) {
+                slots[hole] = slots[j];
+                hole = j;
+            }
+        }
+        slots[hole] = 0;
+    }
+
+    // Slot of `s` in pendingLines, or the free slot it would take
+    size_t pendingSlot(const char* s, size_t n) const {
+        size_t mask = pendingLines.size() - 1;
+        size_t i = nameKey(s, n) & mask;
+        while (pendingLines[i].lines != 0 && !pendingLines[i].name.equalsIgnoreCase(s, n)) i = (i + 1) & mask;
+        return i;
+    }
+
+    // Keep pendingLines at most half full for `names` names
+    void reservePending(int names) {
+        size_t wanted = 16;
+        while (wanted < (size_t)names * 2) wanted *= 2;
+        if (wanted <= pendingLines.size()) return;
+        vector<PendingCartLines> kept;
+        for (size_t i = 0; i < pendingLines.size(); i++) {
+            if (pendingLines[i].lines != 0) kept.push_back(pendingLines[i]);
+        }
+        pendingLines.fill(wanted, PendingCartLines());
+        for (const PendingCartLines& entry : kept) {
+            pendingLines[pendingSlot(entry.name.c_str(), entry.name.size())] = entry;
+        }
+    }
+
+    // Remove the lines waiting for `s` and return how many there were
+    int takePendingLines(const char* s, size_t n) {
+        if (pendingCount == 0) return 0;
+        size_t mask = pendingLines.size() - 1;
+        size_t hole = pendingSlot(s, n);
+        int lines = pendingLines[hole].lines;
+        if (lines == 0) return 0;
+        // Later entries of the probe run shift back, as in unindexFrom
+        for (size_t j = (hole + 1) & mask; pendingLines[j].lines != 0; j = (j + 1) & mask) {
+            const InlineName& name = pendingLines[j].name;
+            size_t home = nameKey(name.c_str(), name.size()) & mask;
+            if (((j - home) & mask) >= ((j - hole) & mask)) {
+                pendingLines[hole] = pendingLines[j];
+                hole = j;
+            }
+        }
+        pendingLines[hole] = PendingCartLines();
+        pendingCount--;
+        return lines;
+    }
+
+    void addPendingLines(const char* s, size_t n, int delta) {
+        int lines = takePendingLines(s, n) + delta;
+        if (lines <= 0) return;
+        reservePending(pendingCount + 1);
+        pendingLines[pendingSlot(s, n)] = PendingCartLines(s, n, lines);
+        pendingCount++;
+    }
+
+    /**
+     * Drop a custom record: out of both tables and the ranking, then the
+     * last record takes its place (O(1) plus the ranks below it shifting up)
+     */
+    void removeCustom(int record) {
+        const FrequentItem& item = records[record];
+        if (item.cartLines > 0) addPendingLines(item.name.c_str(), item.name.size(), item.cartLines);
+        forgetRecent(record, totalSize() - 1);
+        unindexFrom(nameSlots, record);
+        unindexFrom(idSlots, record);
+
+        int n = totalSize();
+        for (int rank = rankOf[record]; rank < n - 1; rank++) {
+            order[rank] = order[rank + 1];
+            rankOf[order[rank]] = rank;
+        }
+        order.pop_back();
+
+        int last = n - 1;
+        if (record != last) {
+            nameSlots[slotOfRecord(nameSlots, last)] = record + 1;
+            idSlots[slotOfRecord(idSlots, last)] = record + 1;
+            records[record] = records[last];
+            rankOf[record] = rankOf[last];
+            order[rankOf[record]] = record;
+        }
+        records.pop_back();
+        rankOf.pop_back();
+        changed();
+    }
+
+    // Less worth keeping: lower aged frequency, then fewer lifetime purchases
+    static bool evictsBefore(const FrequentItem& a, const FrequentItem& b) {
+        if (a.decayLog != b.decayLog) return a.decayLog < b.decayLog;
+        return a.purchaseCount < b.purchaseCount;
+    }
+
+    uint32_t nextSample() {
+        sampleState ^= sampleState << 13;
+        sampleState ^= sampleState >> 17;
+        sampleState ^= sampleState << 5;
+        return sampleState;
+    }
+
+    // Keep both tables at most half full for `customs` custom items
+    void reserveIndex(size_t customs) {
+        size_t wanted = 16;
+        while (wanted < customs * 2) wanted *= 2;
+        if (wanted <= nameSlots.size()) return;
+        nameSlots.fill(wanted, 0);
+        idSlots.fill(wanted, 0);
+        for (int r = CATALOG_SIZE; r < (int)records.size(); r++) indexCustom(r);
+    }
+
+    // Append a custom record at the bottom of the ranking; -1 when full
+    int appendCustom(const char* name, size_t n, int forceId, int count) {
+        if (isFull()) return -1;
+        // Assign ID: use forceId if provided, otherwise generate new custom ID
+        // (base-catalog and already-used ids are never reused)
+        int newId = (forceId >= 0 && !isCatalogId(forceId) && findCustomById(forceId) < 0)
+                        ? forceId : nextCustomId++;
+        // Ensure nextCustomId stays ahead of manually assigned IDs
+        if (newId >= nextCustomId) nextCustomId = newId + 1;
+
+        reserveIndex((size_t)customCount() + 1);
+        int record = (int)records.size();
+        records.push_back(FrequentItem(newId, string(name, n), count, true));
+        records[record].cartLines = takePendingLines(name, n);
+        order.push_back(record);
+        rankOf.push_back(record);
+        indexCustom(record);
+        if (totalSize() > peak_size) peak_size = totalSize();
+        changed();
+        return record;
+    }
+
+    // Move the item at `rank` up past items with fewer purchases (its count just grew)
+    int promote(int rank) {
+        TRACE_SCOPE("promote");
+        METRIC_ADD(METRIC_SORT_PASSES, 1);
+        changed();
+        int record = order[rank];
+        int count = records[record].purchaseCount;
+        long long compared = 1;
+        while (rank > 0 && records[order[rank - 1]].purchaseCount < count) {
+            order[rank] = order[rank - 1];
+            rankOf[order[rank]] = rank;
+            rank--;
+            compared++;
+        }
+        order[rank] = record;
+        rankOf[record] = rank;
+        recentScoreRose(record);   // now ahead of the items it passed on a score tie
+        METRIC_ADD(METRIC_SORT_COMPARISONS, compared);
+        return rank;
+    }
+
+    const FrequentItem& at(int rank) const { return records[order[rank]]; }
+    FrequentItem& at(int rank) { return records[order[rank]]; }
+
+    // Recent order: higher decayLog first, ties in lifetime order
+    bool recentBefore(int a, int b) const {
+        if (records[a].decayLog != records[b].decayLog) return records[a].decayLog > records[b].decayLog;
+        return rankOf[a] < rankOf[b];
+    }
+
+    // `record` gained score or rank: it can only enter recentTop or move up in it (O(k))
+    void recentScoreRose(int record) {
+        if (recentTopStale || records[record].decayLog == -INFINITY) return;
+        int pos = 0;
+        while (pos < recentTopCount && recentTop[pos] != record) pos++;
+        if (pos == recentTopCount) {
+            if (recentTopCount < MAX_DISPLAY_ITEMS) {
+                recentTopCount++;
+            } else if (recentBefore(record, recentTop[MAX_DISPLAY_ITEMS - 1])) {
+                pos = MAX_DISPLAY_ITEMS - 1;
+            } else {
+                return;
+            }
+        }
+        while (pos > 0 && recentBefore(record, recentTop[pos - 1])) {
+            recentTop[pos] = recentTop[pos - 1];
+            pos--;
+        }
+        recentTop[pos] = record;
+    }
+
+    // `record` is being removed and `last` will take its place
+    void forgetRecent(int record, int last) {
+        for (int i = 0; i < recentTopCount; i++) {
+            if (recentTop[i] == record) recentTopStale = true;   // the next item is unknown
+            else if (recentTop[i] == last) recentTop[i] = record;
+        }
+    }
+
+    // Rebuild recentTop from every purchased record - O(n·k), only after recentTopStale
+    void rescanRecentTop() const {
+        TRACE_SCOPE("rescanRecentTop");
+        METRIC_ADD(METRIC_SORT_PASSES, 1);
+        METRIC_ADD(METRIC_SORT_COMPARISONS, totalSize());
+        recentTopCount = 0;
+        for (int record = 0; record < totalSize(); record++) {
+            if (records[record].decayLog == -INFINITY) continue;
+            int pos = recentTopCount;
+            while (pos > 0 && recentBefore(record, recentTop[pos - 1])) pos--;
+            if (pos >= MAX_DISPLAY_ITEMS) continue;
+            int last = (recentTopCount < MAX_DISPLAY_ITEMS) ? recentTopCount++ : MAX_DISPLAY_ITEMS - 1;
+            for (int j = last; j > pos; j--) recentTop[j] = recentTop[j - 1];
+            recentTop[pos] = record;
+        }
+        recentTopStale = false;
+    }
 
 public:
-    FrequentItemsArray() : current_size(0), nextCustomId(1000) {
-        // Add default items (id 0-9, isCustom = false)
-        addDefaultItem(0, "Milk");
-        addDefaultItem(1, "Bread");
-        addDefaultItem(2, "Eggs");
-        addDefaultItem(3, "Butter");
-        addDefaultItem(4, "Cheese");
-        addDefaultItem(5, "Chicken");
-        addDefaultItem(6, "Rice");
-        addDefaultItem(7, "Pasta");
-        addDefaultItem(8, "Tomato Sauce");
-        addDefaultItem(9, "Orange Juice");
-    }
-
-    // Add a default (non-custom) item
-    void addDefaultItem(int id, const string& name) {
-        if (current_size >= MAX_TOTAL_ITEMS) return;
-        items[current_size] = FrequentItem(id, name, 0, false);
-        current_size++;
+    FrequentItemsArray()
+        : pendingCount(0), peak_size(0), nextCustomId(CATALOG_FIRST_CUSTOM_ID),
+          decayRate(log(2.0) / DEFAULT_POPULARITY_HALF_LIFE), customLimit(MAX_CUSTOM_ITEMS),
+          evictions(0), sampleState(2463534242u), changes(0), recentTopCount(0), recentTopStale(false) {
+        resetToDefaults();
+    }
+
+    // Hash key of a name as the custom-name table sees it (folded, cut like InlineName)
+    static uint32_t nameKey(const char* s, size_t n) {
+        return catalogHash(s, InlineName::storedLength(s, n));
     }
 
     // Get item at index (O(1) access)
     FrequentItem getItem(int index) const {
-        if (index < 0 || index >= current_size) {
+        if (index < 0 || index >= totalSize()) {
             return FrequentItem();
         }
-        return items[index];
+        return at(index);
     }
 
     FrequentItem operator[](int index) const {
@@ -104,110 +492,305 @@ public:
     }
 
     // Total number of items stored
-    int totalSize() const { return current_size; }
+    int totalSize() const { return (int)records.size(); }
     
     // Number of items to display (max 10)
     int size() const { 
-        return (current_size < MAX_DISPLAY_ITEMS) ? current_size : MAX_DISPLAY_ITEMS; 
+        return (totalSize() < MAX_DISPLAY_ITEMS) ? totalSize() : MAX_DISPLAY_ITEMS; 
     }
     
-    bool isFull() const { return current_size >= MAX_TOTAL_ITEMS; }
-    bool isEmpty() const { return current_size == 0; }
+    bool isFull() const { return customCount() >= customLimit; }
+    int peakSize() const { return peak_size; }
+    size_t capacity() const { return records.capacity(); }
+
+    // Bytes reserved for records, ranking and indexes
+    size_t storageBytes() const {
+        return records.capacity() * sizeof(FrequentItem)
+             + (order.capacity() + rankOf.capacity() + nameSlots.capacity() + idSlots.capacity()) * sizeof(int)
+             + pendingLines.capacity() * sizeof(PendingCartLines);
+    }
+
+    bool isEmpty() const { return totalSize() == 0; }
 
     // Case-insensitive search by name - searches ALL items
     int findByName(const string& name) const {
-        for (int i = 0; i < current_size; i++) {
-            if (equalsIgnoreCase(items[i].name, name)) return i;
-        }
-        return -1;
+        int base = catalogIndexOfName(name.data(), name.size());
+        if (base >= 0) return rankOf[base];
+        int record = findCustomByName(name.data(), name.size(), nameKey(name.data(), name.size()));
+        return record < 0 ? -1 : rankOf[record];
     }
     
     // Find item by ID
     int findById(int itemId) const {
-        for (int i = 0; i < current_size; i++) {
-            if (items[i].id == itemId) return i;
-        }
-        return -1;
+        int base = catalogIndexOfId(itemId);
+        if (base >= 0) return rankOf[base];
+        int record = findCustomById(itemId);
+        return record < 0 ? -1 : rankOf[record];
     }
 
     /**
      * Add or update an item with purchase count
      * - If item exists: increment purchase count
      * - If new item: add to the array
+     * countAsRecent = false is used when restoring saved lifetime counts
      * Returns the item's ID
      */
-    int addOrUpdateItem(const string& name, int quantity = 1, int forceId = -1) {
+    int addOrUpdateItem(const string& name, int quantity = 1, int forceId = -1,
+                        bool countAsRecent = true) {
         // Check if item already exists (case-insensitive)
         int existingIndex = findByName(name);
         
         if (existingIndex != -1) {
             // Item exists - increment purchase count
-            items[existingIndex].purchaseCount += quantity;
-            sortByFrequency();
-            return items[existingIndex].id;
-        }
-        
-        // New item - add it
-        if (isFull()) {
-            // Array full - can't add more items
-            return -1;
+            at(existingIndex).purchaseCount += quantity;
+            if (countAsRecent) recordRecentPurchase(existingIndex, quantity);
+            return at(promote(existingIndex)).id;
         }
         
-        // Assign ID: use forceId if provided, otherwise generate new custom ID
-        int newId = (forceId >= 0) ? forceId : nextCustomId++;
-        
-        // Ensure nextCustomId stays ahead of manually assigned IDs
-        if (newId >= nextCustomId) {
-            nextCustomId = newId + 1;
-        }
-        
-        items[current_size] = FrequentItem(newId, name, quantity, true);
-        current_size++;
-        sortByFrequency();
-        
-        return newId;
-    }
-
-    // Sort items by purchase count (descending) - Bubble Sort
-    void sortByFrequency() {
-        for (int i = 0; i < current_size - 1; i++) {
-            for (int j = 0; j < current_size - i - 1; j++) {
-                if (items[j].purchaseCount < items[j + 1].purchaseCount) {
-                    FrequentItem temp = items[j];
-                    items[j] = items[j + 1];
-                    items[j + 1] = temp;
-                }
-            }
-        }
+        // New item - add it (-1 when the array is full)
+        int record = appendCustom(name.data(), name.size(), forceId, quantity);
+        if (record < 0) return -1;
+        if (countAsRecent) recordRecentPurchase(rankOf[record], quantity);
+        promote(rankOf[record]);
+        return records[record].id;
     }
 
     // Increment purchase count for item at index
     void incrementPurchaseCount(int index) {
-        if (index >= 0 && index < current_size) {
-            items[index].purchaseCount++;
-            sortByFrequency();
+        if (index >= 0 && index < totalSize()) {
+            at(index).purchaseCount++;
+            recordRecentPurchase(index, 1);
+            promote(index);
         }
     }
 
     // Get purchase count for item at index
     int getPurchaseCount(int index) const {
-        if (index >= 0 && index < current_size) {
-            return items[index].purchaseCount;
+        if (index >= 0 && index < totalSize()) {
+            return at(index).purchaseCount;
         }
         return 0;
     }
 
-    // Increment purchase count by item ID
-    bool incrementPurchaseCountById(int itemId) {
+    // Add `quantity` purchases to the item with this ID (one score update, one promote)
+    bool incrementPurchaseCountById(int itemId, int quantity = 1) {
         int index = findById(itemId);
         if (index != -1) {
-            items[index].purchaseCount++;
-            sortByFrequency();
+            at(index).purchaseCount += quantity;
+            recordRecentPurchase(index, quantity);
+            promote(index);
             return true;
         }
         return false;
     }
 
+    // Restore a saved lifetime count without counting it as a recent purchase
+    bool restorePurchaseCountById(int itemId, int count) {
+        int index = findById(itemId);
+        if (index == -1) return false;
+        at(index).purchaseCount += count;
+        promote(index);
+        return true;
+    }
+
+    // ─────────────────────────────────────────────────────────────────────────
+    //  Bulk import (no ranking until rebuildRanking)
+    // ─────────────────────────────────────────────────────────────────────────
+
+    // Make room for `rows` more items so an import does not regrow per row
+    void reserveForImport(size_t rows) {
+        size_t customs = (size_t)customCount() + rows;
+        size_t limit = (size_t)MAX_TOTAL_ITEMS;
+        size_t total = min(records.size() + rows, limit);
+        records.reserve(total);
+        order.reserve(total);
+        rankOf.reserve(total);
+        reserveIndex(min(customs, limit));
+    }
+
+    /**
+     * Add one imported row, or merge it into the item with the same folded
+     * name. `hash` is nameKey(name, n). The ranking is left stale: call
+     * rebuildRanking() once after the last row.
+     * Returns 1 = added, 0 = merged, -1 = store full
+     */
+    int importItem(const char* name, size_t n, uint32_t hash, int count, int forceId) {
+        int record = catalogIndexOfName(name, n);
+        if (record < 0) record = findCustomByName(name, n, hash);
+        if (record >= 0) {
+            records[record].purchaseCount += count;
+            changed();
+            return 0;
+        }
+        return appendCustom(name, n, forceId, count) < 0 ? -1 : 1;
+    }
+
+    // Rank every item from scratch - one stable sort (ties keep their order)
+    void rebuildRanking() {
+        TRACE_SCOPE("rebuildRanking");
+        METRIC_ADD(METRIC_SORT_PASSES, 1);
+        changed();
+        int n = totalSize();
+        if (n == 0) return;
+        int* ranked = &order[0];
+        stable_sort(ranked, ranked + n, [this](int a, int b) {
+            return records[a].purchaseCount > records[b].purchaseCount;
+        });
+        for (int rank = 0; rank < n; rank++) rankOf[order[rank]] = rank;
+        recentTopStale = true;   // score ties may now break the other way
+    }
+
+    // ─────────────────────────────────────────────────────────────────────────
+    //  Capacity and eviction (custom items only)
+    // ─────────────────────────────────────────────────────────────────────────
+
+    int customSize() const { return customCount(); }
+    int customCapacity() const { return customLimit; }
+    long long evictionCount() const { return evictions; }
+
+    // Clamped to [1, MAX_CUSTOM_ITEMS]; lowering it evicts nothing by itself
+    void setCustomCapacity(int capacity) {
+        customLimit = max(1, min(capacity, MAX_CUSTOM_ITEMS));
+    }
+
+    bool overCapacity() const { return customCount() > customLimit; }
+
+    /**
+     * A cart or checkout-queue line naming this item appeared (+1) or went
+     * away (-1). Counted on custom items only (base-catalog items are never
+     * evicted); see FrequentItem::cartLines.
+     */
+    void countCartLine(const char* name, size_t n, int delta) {
+        if (catalogIndexOfName(name, n) >= 0) return;
+        int record = findCustomByName(name, n, nameKey(name, n));
+        if (record >= 0) {
+            records[record].cartLines += delta;
+        } else {
+            addPendingLines(name, n, delta);
+        }
+    }
+
+    /**
+     * Evict the least frequently used custom item for which pinned(item) is
+     * false, copying it to `victim` first. Samples EVICTION_SAMPLES custom
+     * items; if every sample is pinned, scans them all.
+     * Returns false if there is no custom item that may be evicted.
+     */
+    template <typename Pinned>
+    bool evictCustom(Pinned pinned, FrequentItem* victim = nullptr) {
+        TRACE_SCOPE("evictCustom");
+        int customs = customCount();
+        if (customs <= 0) return false;
+        int best = -1;
+        for (int i = 0; i < EVICTION_SAMPLES; i++) {
+            int record = CATALOG_SIZE + (int)(nextSample() % (uint32_t)customs);
+            if ((best < 0 || evictsBefore(records[record], records[best])) && !pinned(records[record])) {
+                best = record;
+            }
+        }
+        if (best < 0) {
+            for (int record = CATALOG_SIZE; record < totalSize(); record++) {
+                if ((best < 0 || evictsBefore(records[record], records[best])) && !pinned(records[record])) {
+                    best = record;
+                }
+            }
+        }
+        if (best < 0) return false;
+        if (victim != nullptr) *victim = records[best];
+        removeCustom(best);
+        evictions++;
+        METRIC_ADD(METRIC_ITEM_EVICTIONS, 1);
+        return true;
+    }
+
+    // ─────────────────────────────────────────────────────────────────────────
+    //  Recent popularity (exponential decay, log domain)
+    // ─────────────────────────────────────────────────────────────────────────
+
+    // Credit `quantity` purchases made at time `now` - touches only this item
+    void recordRecentPurchase(int index, int quantity, double now = currentTimeSeconds()) {
+        if (index < 0 || index >= totalSize() || quantity <= 0) return;
+        double term = log((double)quantity) + decayRate * (now - POPULARITY_REFERENCE_EPOCH);
+        at(index).decayLog = logAddExp(at(index).decayLog, term);
+        recentScoreRose(order[index]);
+        changed();
+    }
+
+    // Decayed score of item at index, as seen at time `now`
+    double recentScore(int index, double now = currentTimeSeconds()) const {
+        if (index < 0 || index >= totalSize()) return 0.0;
+        return recentScoreOf(at(index), now);
+    }
+
+    // Decayed score of any item record (e.g. one just evicted) at time `now`
+    double recentScoreOf(const FrequentItem& item, double now = currentTimeSeconds()) const {
+        if (item.decayLog == -INFINITY) return 0.0;
+        return exp(item.decayLog - decayRate * (now - POPULARITY_REFERENCE_EPOCH));
+    }
+
+    // Restore a saved decayed score that was `score` at time `savedAt`
+    bool restoreRecentScoreById(int itemId, double score, double savedAt) {
+        int index = findById(itemId);
+        if (index == -1 || score <= 0.0) return false;
+        double previous = at(index).decayLog;
+        at(index).decayLog = log(score) + decayRate * (savedAt - POPULARITY_REFERENCE_EPOCH);
+        if (at(index).decayLog >= previous) {
+            recentScoreRose(order[index]);
+        } else {
+            forgetRecent(order[index], -1);
+        }
+        changed();
+        return true;
+    }
+
+    double getHalfLife() const { return log(2.0) / decayRate; }
+
+    /**
+     * Change counter: differs whenever the ranking, a count or a score may
+     * have changed since it was last read. Readable without the state lock.
+     */
+    uint64_t changeCount() const { return changes.load(memory_order_acquire); }
+
+    /**
+     * Change the half-life. Stored scores carry the old rate, so each one is
+     * converted once at `now` (O(n), only on reconfiguration).
+     */
+    void setHalfLife(double seconds, double now = currentTimeSeconds()) {
+        if (seconds <= 0.0) return;
+        double newRate = log(2.0) / seconds;
+        for (int r = 0; r < totalSize(); r++) {
+            FrequentItem& item = records[r];
+            if (item.decayLog == -INFINITY) continue;
+            double logNow = item.decayLog - decayRate * (now - POPULARITY_REFERENCE_EPOCH);
+            item.decayLog = logNow + newRate * (now - POPULARITY_REFERENCE_EPOCH);
+        }
+        decayRate = newRate;
+        recentTopStale = true;   // rounding may reorder near-equal scores
+        changed();
+    }
+
+    /**
+     * Fill `out` with the indices of the top `k` (<= MAX_DISPLAY_ITEMS) items
+     * by decayed score (descending). Items never purchased rank after all
+     * others, keeping the lifetime order among themselves. Returns the number
+     * of indices written.
+     *
+     * Purchases only raise scores, so recentTop is kept up to date as they
+     * are recorded and this costs O(k). Only a score restored lower or an
+     * evicted listed item makes the next call rescan the store.
+     */
+    int topRecentIndices(int out[], int k) const {
+        TRACE_SCOPE("topRecentIndices");
+        if (recentTopStale) rescanRecentTop();
+        int filled = 0;
+        for (; filled < k && filled < recentTopCount; filled++) out[filled] = rankOf[recentTop[filled]];
+        // Fewer than k items were ever purchased, so this passes fewer than 2k ranks
+        for (int rank = 0; filled < k && rank < totalSize(); rank++) {
+            if (at(rank).decayLog == -INFINITY) out[filled++] = rank;
+        }
+        return filled;
+    }
+
     // Search by name (returns index)
     int search(const string& name) const {
         return findByName(name);
@@ -217,23 +800,23 @@ public:
     FrequentItem getLastItem() const {
         int displaySize = size();
         if (displaySize == 0) return FrequentItem();
-        return items[displaySize - 1];
+        return at(displaySize - 1);
     }
     
-    // Reset to default state (10 default items with 0 purchase count)
+    // Reset to default state (the base catalog with 0 purchase count)
     void resetToDefaults() {
-        current_size = 0;
-        nextCustomId = 1000;
-        addDefaultItem(0, "Milk");
-        addDefaultItem(1, "Bread");
-        addDefaultItem(2, "Eggs");
-        addDefaultItem(3, "Butter");
-        addDefaultItem(4, "Cheese");
-        addDefaultItem(5, "Chicken");
-        addDefaultItem(6, "Rice");
-        addDefaultItem(7, "Pasta");
-        addDefaultItem(8, "Tomato Sauce");
-        addDefaultItem(9, "Orange Juice");
+        records.assign(CATALOG_IMAGE.data(), CATALOG_SIZE);
+        order.assign(CATALOG_POSITIONS.data(), CATALOG_SIZE);
+        rankOf.assign(CATALOG_POSITIONS.data(), CATALOG_SIZE);
+        nameSlots.clear();
+        idSlots.clear();
+        pendingLines.clear();   // the caller empties every cart along with the store
+        pendingCount = 0;
+        recentTopCount = 0;
+        recentTopStale = false;
+        if (totalSize() > peak_size) peak_size = totalSize();
+        nextCustomId = CATALOG_FIRST_CUSTOM_ID;
+        changed();
     }
 
     // Get next available custom ID
@@ -251,19 +834,15 @@ public:
     // Display items (for debugging)
     void display() const {
         cout << "\n=== ALL ITEMS (Top " << size() << " shown as frequent) ===" << endl;
-        for (int i = 0; i < current_size; i++) {
+        for (int i = 0; i < totalSize(); i++) {
+            const FrequentItem& item = at(i);
             string marker = (i < MAX_DISPLAY_ITEMS) ? "[FREQ] " : "[    ] ";
-            cout << marker << "[" << i << "] " << items[i].name 
-                 << " (ID: " << items[i].id 
-                 << ", Purchases: " << items[i].purchaseCount 
-                 << ", Custom: " << (items[i].isCustom ? "Yes" : "No") << ")" << endl;
+            cout << marker << "[" << i << "] " << item.name 
+                 << " (ID: " << item.id 
+                 << ", Purchases: " << item.purchaseCount 
+                 << ", Custom: " << (item.isCustom ? "Yes" : "No") << ")" << endl;
         }
     }
-    
-    // Get all items as a pointer (for iteration)
-    const FrequentItem* getAllItems() const {
-        return items;
-    }
 };
 
 #endif
@@ -0,0 +1,263 @@
+#ifndef CARTINDEX_H
+#define CARTINDEX_H
+
+#include <cstdint>
+#include "Node.h"
+#include "SharedMemory.h"
+using namespace std;
+
+// Handle layout: serial in the high bits, pool slot in the low 24 bits
+// (so up to 16M lines per cart). Serials stay below 2^29, so every handle
+// is below 2^53 and survives a round trip through JSON / JavaScript numbers.
+const int CART_HANDLE_SLOT_BITS = 24;
+const uint64_t CART_HANDLE_SLOT_MASK = (1ULL << CART_HANDLE_SLOT_BITS) - 1;
+const uint32_t CART_HANDLE_MAX_SERIAL = (1U << 29) - 1;
+const uint64_t INVALID_CART_HANDLE = 0;
+
+template <typename N>
+struct IndexEntry {
+    OffsetPtr<N> node;
+    uint32_t serial;     // 0 = free slot
+    uint32_t priority;   // treap heap key
+    int left;
+    int right;
+    int parent;
+    int size;            // entries in this subtree
+};
+
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                    CART INDEX (Implicit Treap over List Nodes)
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Order-statistic index kept beside the cart's linked list: entry k of the
+ * in-order traversal points at the k-th node. Subtree sizes answer positional
+ * questions, parent links answer "where is this line now".
+ *
+ * - Handle -> node: O(1) (slot lookup + serial check)
+ * - select(pos), rankOf(slot), insertAt(pos), erase(slot): O(log n) expected
+ * - clear(): O(1) - the pool is truncated, serials are never reused, so every
+ *   old handle simply stops resolving
+ *
+ * Entries live in one array (indices instead of pointers), so the index is
+ * a single allocation that keeps its capacity across carts. The arrays are
+ * SegmentVectors, so the index can live in shared memory with its list.
+ *
+ * N is the list's node type; it must derive from ListHook<N>, which holds
+ * the node's slot here.
+ */
+template <typename N>
+class CartIndex {
+private:
+    SegmentVector<IndexEntry<N>> pool;
+    SegmentVector<int> freeSlots;
+    int root;
+    uint32_t nextSerial;
+    uint32_t rngState;
+
+    int sz(int i) const { return i < 0 ? 0 : pool[i].size; }
+
+    void pull(int i) { pool[i].size = 1 + sz(pool[i].left) + sz(pool[i].right); }
+
+    void setLeft(int t, int child) {
+        pool[t].left = child;
+        if (child >= 0) pool[child].parent = t;
+    }
+
+    void setRight(int t, int child) {
+        pool[t].right = child;
+        if (child >= 0) pool[child].parent = t;
+    }
+
+    uint32_t nextPriority() {
+        // xorshift32 - only needs to look random to the treap
+        rngState ^= rngState << 13;
+        rngState ^= rngState >> 17;
+        rngState ^= rngState << 5;
+        return rngState;
+    }
+
+    uint32_t takeSerial() {
+        uint32_t serial = nextSerial;
+        nextSerial = (nextSerial >= CART_HANDLE_MAX_SERIAL) ? 1 : nextSerial + 1;
+        return serial;
+    }
+
+    // First k entries of t into a, the rest into b
+    void split(int t, int k, int& a, int& b) {
+        if (t < 0) {
+            a = b = -1;
+            return;
+        }
+        if (sz(pool[t].left) < k) {
+            int rest;
+            split(pool[t].right, k - sz(pool[t].left) - 1, a, rest);
+            setRight(t, a);
+            pull(t);
+            a = t;
+            b = rest;
+        } else {
+            int first;
+            split(pool[t].left, k, first, b);
+            setLeft(t, b);
+            pull(t);
+            a = first;
+            b = t;
+        }
+    }
+
+    int merge(int a, int b) {
+        if (a < 0) return b;
+        if (b < 0) return a;
+        if (pool[a].priority > pool[b].priority) {
+            setRight(a, merge(pool[a].right, b));
+            pull(a);
+            return a;
+        }
+        setLeft(b, merge(a, pool[b].left));
+        pull(b);
+        return b;
+    }
+
+    void setRoot(int t) {
+        root = t;
+        if (root >= 0) pool[root].parent = -1;
+    }
+
+    // Place a prepared entry at position pos (0-based)
+    void link(int slot, int pos) {
+        int a, b;
+        split(root, pos, a, b);
+        setRoot(merge(merge(a, slot), b));
+    }
+
+    void initEntry(int slot, N* node, uint32_t serial) {
+        IndexEntry<N>& e = pool[slot];
+        e.node = node;
+        e.serial = serial;
+        e.priority = nextPriority();
+        e.left = e.right = e.parent = -1;
+        e.size = 1;
+        node->setIndexSlot(slot);
+    }
+
+public:
+    CartIndex() : root(-1), nextSerial(1), rngState(2463534242u) {
+        pool.reserve(16);
+        freeSlots.reserve(16);
+    }
+
+    int size() const { return sz(root); }
+
+    static uint64_t makeHandle(uint32_t serial, int slot) {
+        return ((uint64_t)serial << CART_HANDLE_SLOT_BITS) | (uint64_t)slot;
+    }
+
+    uint64_t handleOf(const N* node) const {
+        int slot = node->indexSlot();
+        if (slot < 0 || slot >= (int)pool.size() || pool[slot].node != node) return INVALID_CART_HANDLE;
+        return makeHandle(pool[slot].serial, slot);
+    }
+
+    // Slot for a live handle, or -1 (stale, cleared or never issued)
+    int slotOf(uint64_t handle) const {
+        int slot = (int)(handle & CART_HANDLE_SLOT_MASK);
+        uint32_t serial = (uint32_t)(handle >> CART_HANDLE_SLOT_BITS);
+        if (serial == 0 || slot >= (int)pool.size() || pool[slot].serial != serial) return -1;
+        return slot;
+    }
+
+    N* nodeAt(int slot) const { return pool[slot].node; }
+
+    // Index a new node at position pos (0-based); returns its handle
+    uint64_t insertAt(int pos, N* node) {
+        int slot = -1;
+        while (!freeSlots.empty() && slot < 0) {
+            int candidate = freeSlots.back();
+            freeSlots.pop_back();
+            if (candidate < (int)pool.size() && pool[candidate].serial == 0) slot = candidate;
+        }
+        if (slot < 0) {
+            slot = (int)pool.size();
+            pool.push_back(IndexEntry<N>());
+        }
+        uint32_t serial = takeSerial();
+        initEntry(slot, node, serial);
+        link(slot, pos);
+        return makeHandle(serial, slot);
+    }
+
+    /**
+     * Index a node under a previously issued handle (a batch rollback, or a
+     * session moved from another list); falls back to a fresh handle if that
+     * slot is taken
+     */
+    uint64_t insertWithHandle(int pos, N* node, uint64_t handle) {
+        int slot = (int)(handle & CART_HANDLE_SLOT_MASK);
+        uint32_t serial = (uint32_t)(handle >> CART_HANDLE_SLOT_BITS);
+        if (serial == 0 || (slot < (int)pool.size() && pool[slot].serial != 0)) {
+            return insertAt(pos, node);
+        }
+        while ((int)pool.size() <= slot) {
+            // Gap slots become free; stale free-list entries are skipped later
+            freeSlots.push_back((int)pool.size());
+            pool.push_back(IndexEntry<N>());
+        }
+        initEntry(slot, node, serial);
+        link(slot, pos);
+        if (serial >= nextSerial && serial < CART_HANDLE_MAX_SERIAL) nextSerial = serial + 1;
+        return handle;
+    }
+
+    // Node at position pos (0-based), or nullptr
+    N* select(int pos) const {
+        if (pos < 0 || pos >= size()) return nullptr;
+        int t = root;
+        while (true) {
+            int leftSize = sz(pool[t].left);
+            if (pos < leftSize) {
+                t = pool[t].left;
+            } else if (pos == leftSize) {
+                return pool[t].node;
+            } else {
+                pos -= leftSize + 1;
+                t = pool[t].right;
+            }
+        }
+    }
+
+    // Position (0-based) of the entry in this slot
+    int rankOf(int slot) const {
+        int rank = sz(pool[slot].left);
+        for (int t = slot; pool[t].parent >= 0; t = pool[t].parent) {
+            int p = pool[t].parent;
+            if (pool[p].right == t) rank += sz(pool[p].left) + 1;
+        }
+        return rank;
+    }
+
+    // Remove the entry in this slot; its handle stops resolving
+    void erase(int slot) {
+        int rank = rankOf(slot);
+        int a, b, mid, c;
+        split(root, rank, a, b);
+        split(b, 1, mid, c);
+        setRoot(merge(a, c));
+        pool[slot].node->setIndexSlot(-1);
+        pool[slot] = IndexEntry<N>();
+        pool[slot].serial = 0;
+        freeSlots.push_back(slot);
+    }
+
+    void clear() {
+        pool.clear();
+        freeSlots.clear();
+        root = -1;
+    }
+
+    size_t memoryBytes() const {
+        return pool.capacity() * sizeof(IndexEntry<N>) + freeSlots.capacity() * sizeof(int);
+    }
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <cstddef>
+#include <cstdint>
+using namespace std;
+
+// One base-catalog SKU (names are string literals, so entries are constexpr)
+struct CatalogEntry {
+    int id;
+    const char* name;
+    int nameLength;
+    int category;     // index into CATALOG_CATEGORIES
+};
+
+#include "CatalogData.h"
+
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                    BASE CATALOG (Compile-Time Tables)
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * The base catalog comes from catalog/default_catalog.csv, turned into
+ * CatalogData.h by tools/gen_catalog.py at build time. Everything here is
+ * constexpr: no strings are built at startup, and name -> id is one FNV-1a
+ * hash, one displacement lookup and one compare (a perfect hash - no probing,
+ * whatever the catalog size).
+ *
+ * The hash must stay in step with gen_catalog.py; the static_assert at the
+ * bottom fails the build if the generated tables and this code disagree.
+ */
+
+constexpr unsigned char catalogFold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + 32) : c;
+}
+
+// FNV-1a 32 of the ASCII-lowercased bytes
+constexpr uint32_t catalogHash(const char* s, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++) {
+        h ^= catalogFold((unsigned char)s[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+constexpr uint32_t catalogSlot(uint32_t h) {
+    uint64_t step = (h >> 16) | 1u;
+    uint64_t d = CATALOG_HASH_DISPLACEMENT[h % CATALOG_HASH_BUCKETS];
+    return (uint32_t)((h + d * step) % CATALOG_HASH_SLOTS);
+}
+
+constexpr bool catalogNameEquals(const CatalogEntry& entry, const char* s, size_t n) {
+    if ((size_t)entry.nameLength != n) return false;
+    for (size_t i = 0; i < n; i++) {
+        if (catalogFold((unsigned char)entry.name[i]) != catalogFold((unsigned char)s[i])) return false;
+    }
+    return true;
+}
+
+// Index into CATALOG_ITEMS of a name (case-insensitive), -1 if not a base item
+constexpr int catalogIndexOfName(const char* s, size_t n) {
+    int index = CATALOG_HASH_TABLE[catalogSlot(catalogHash(s, n))];
+    return (index >= 0 && catalogNameEquals(CATALOG_ITEMS[index], s, n)) ? index : -1;
+}
+
+// Index into CATALOG_ITEMS of an id (binary search), -1 if not a base item
+constexpr int catalogIndexOfId(int id) {
+    int lo = 0, hi = CATALOG_SIZE - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (CATALOG_ITEMS[mid].id == id) return mid;
+        if (CATALOG_ITEMS[mid].id < id) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+constexpr bool isCatalogId(int id) { return catalogIndexOfId(id) >= 0; }
+
+inline const char* catalogCategoryOf(int id) {
+    int index = catalogIndexOfId(id);
+    return index < 0 ? "Custom" : CATALOG_CATEGORIES[CATALOG_ITEMS[index].category];
+}
+
+// Generator/lookup agreement, checked on a prefix to stay inside compiler step limits
+constexpr bool catalogTablesAgree() {
+    for (int i = 0; i < CATALOG_SIZE && i < 256; i++) {
+        if (catalogIndexOfName(CATALOG_ITEMS[i].name, (size_t)CATALOG_ITEMS[i].nameLength) != i) return false;
+    }
+    return true;
+}
+
+static_assert(catalogTablesAgree(), "CatalogData.h does not match catalogHash - rerun tools/gen_catalog.py");
+
+#endif
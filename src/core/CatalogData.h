@@ -0,0 +1,43 @@
+// Generated by tools/gen_catalog.py from catalog/default_catalog.csv - do not edit.
+// Included by Catalog.h, which defines CatalogEntry.
+#ifndef CATALOGDATA_H
+#define CATALOGDATA_H
+
+constexpr int CATALOG_SIZE = 10;
+constexpr int CATALOG_FIRST_CUSTOM_ID = 1000;
+constexpr int CATALOG_CATEGORY_COUNT = 5;
+constexpr uint32_t CATALOG_HASH_BUCKETS = 3;
+constexpr uint32_t CATALOG_HASH_SLOTS = 16;
+
+constexpr const char* CATALOG_CATEGORIES[CATALOG_CATEGORY_COUNT] = {
+    "Dairy",
+    "Bakery",
+    "Meat",
+    "Pantry",
+    "Beverages",
+};
+
+// Sorted by id
+constexpr CatalogEntry CATALOG_ITEMS[CATALOG_SIZE] = {
+    {0, "Milk", 4, 0},
+    {1, "Bread", 5, 1},
+    {2, "Eggs", 4, 0},
+    {3, "Butter", 6, 0},
+    {4, "Cheese", 6, 0},
+    {5, "Chicken", 7, 2},
+    {6, "Rice", 4, 3},
+    {7, "Pasta", 5, 3},
+    {8, "Tomato Sauce", 12, 3},
+    {9, "Orange Juice", 12, 4},
+};
+
+constexpr uint32_t CATALOG_HASH_DISPLACEMENT[CATALOG_HASH_BUCKETS] = {
+    1, 0, 0,
+};
+
+// Slot -> index into CATALOG_ITEMS, -1 = free
+constexpr int CATALOG_HASH_TABLE[CATALOG_HASH_SLOTS] = {
+    6, -1, 0, -1, 7, 1, -1, 8, 4, -1, -1, -1, 9, 5, 3, 2,
+};
+
+#endif
@@ -0,0 +1,412 @@
+#ifndef CATALOGIMPORT_H
+#define CATALOGIMPORT_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <new>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "Array.h"
+using namespace std;
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  MappedFile - read-only view of a whole file
+// ─────────────────────────────────────────────────────────────────────────────
+
+/**
+ * mmap on POSIX (pages are read in as the parser reaches them, nothing is
+ * copied); other platforms read the file into one buffer.
+ */
+class MappedFile {
+private:
+    const char* bytes;
+    size_t length;
+    bool mapped;
+    string buffer;
+
+public:
+    MappedFile() : bytes(nullptr), length(0), mapped(false) {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const string& path) {
+        close();
+#ifdef _WIN32
+        FILE* f = fopen(path.c_str(), "rb");
+        if (f == nullptr) return false;
+        char chunk[1 << 16];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) buffer.append(chunk, n);
+        fclose(f);
+        bytes = buffer.data();
+        length = buffer.size();
+        return true;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+            ::close(fd);
+            return false;
+        }
+        length = (size_t)info.st_size;
+        if (length > 0) {
+            void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view == MAP_FAILED) {
+                ::close(fd);
+                length = 0;
+                return false;
+            }
+            madvise(view, length, MADV_SEQUENTIAL);
+            bytes = (const char*)view;
+            mapped = true;
+        }
+        ::close(fd);   // the mapping keeps the file open
+        return true;
+#endif
+    }
+
+    void close() {
+#ifndef _WIN32
+        if (mapped) munmap((void*)bytes, length);
+#endif
+        buffer.clear();
+        bytes = nullptr;
+        length = 0;
+        mapped = false;
+    }
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Rows, chunks and the report
+// ─────────────────────────────────────────────────────────────────────────────
+
+// Columns found in the header line (or the defaults for a file without one)
+struct ImportFormat {
+    char delimiter;      // ',' or '\t'
+    bool header;
+    int nameColumn;
+    int countColumn;     // -1 = no purchase counts
+    int idColumn;        // -1 = ids are assigned
+};
+
+struct ImportRow {
+    const char* name;    // into the mapped file, or a chunk's `unquoted` strings
+    uint32_t length;
+    uint32_t hash;       // FrequentItemsArray::nameKey
+    int count;
+    int id;
+};
+
+// A line-aligned slice of the file, parsed by one thread
+struct ImportChunk {
+    const char* begin;
+    const char* end;
+    vector<ImportRow> rows;
+    deque<string> unquoted;     // quoted names with "" escapes (stable addresses)
+    size_t skipped;             // lines without a usable name (none, or too long)
+};
+
+struct CatalogImportReport {
+    bool ok;
+    const char* error;          // static text, nullptr when ok
+    size_t bytes;
+    size_t rows;                // data rows parsed
+    size_t added;               // new items
+    size_t merged;              // rows folded into an existing item or earlier row
+    size_t skipped;
+    size_t rejected;            // store full / out of memory
+    int threads;
+    double parseSeconds;
+    double buildSeconds;
+
+    double seconds() const { return parseSeconds + buildSeconds; }
+    double rowsPerSecond() const { return seconds() > 0 ? rows / seconds() : 0.0; }
+    double megabytesPerSecond() const { return seconds() > 0 ? bytes / 1048576.0 / seconds() : 0.0; }
+};
+
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                    CATALOG IMPORT (Bulk CSV / TSV Load)
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Loads a store export - one item per line - into FrequentItemsArray in two
+ * phases:
+ *
+ *   parse(path, threads)   no store access, so no lock is needed
+ *       The file is mapped and cut into line-aligned chunks, one per
+ *       thread. Each thread walks its chunk with memchr (lines, then
+ *       fields), keeps names as pointers into the mapping and hashes them.
+ *   build(store)           under the state lock
+ *       Rows are applied in file order with FrequentItemsArray::importItem:
+ *       a name already in the store (or earlier in the file), compared
+ *       case-insensitively, gets its count added; a new one is appended.
+ *       The ranking is rebuilt once at the end.
+ *
+ * Format: the delimiter is a tab if the first line has one, else a comma. A
+ * first line with a "name" column is a header; "purchaseCount" / "count"
+ * and "id" columns are used when present. Without a header the first
+ * column is the name and the second, if any, the count. Fields may be
+ * double-quoted ("" for a quote) but may not contain line breaks. Rows
+ * whose name is empty or longer than MAX_ITEM_NAME_BYTES are skipped.
+ */
+class CatalogImport {
+private:
+    MappedFile file;
+    ImportFormat format;
+    vector<ImportChunk> chunks;
+    CatalogImportReport summary;
+
+    static bool sameIgnoreCase(const char* s, size_t n, const char* word) {
+        size_t w = strlen(word);
+        if (n != w) return false;
+        for (size_t i = 0; i < n; i++) {
+            if (tolower((unsigned char)s[i]) != word[i]) return false;
+        }
+        return true;
+    }
+
+    static void trim(const char*& s, const char*& e) {
+        while (s < e && (*s == ' ' || *s == '\t')) s++;
+        while (e > s && (e[-1] == ' ' || e[-1] == '\t')) e--;
+    }
+
+    static long long parseInteger(const char* s, const char* e, long long fallback) {
+        trim(s, e);
+        bool negative = (s < e && *s == '-');
+        if (negative) s++;
+        if (s == e) return fallback;
+        long long value = 0;
+        for (; s < e; s++) {
+            if (*s < '0' || *s > '9') return fallback;
+            if (value < 1000000000000LL) value = value * 10 + (*s - '0');
+        }
+        return negative ? -value : value;
+    }
+
+    // Field starting at s (line ends at e): sets [fieldBegin, fieldEnd), returns where the next one starts
+    static const char* nextField(const char* s, const char* e, char delimiter,
+                                 const char*& fieldBegin, const char*& fieldEnd, bool& escaped) {
+        escaped = false;
+        if (s >= e) {
+            fieldBegin = fieldEnd = e;
+            return nullptr;
+        }
+        const char* p = s;
+        while (p < e && *p == ' ') p++;
+        if (p < e && *p == '"') {
+            const char* q = p + 1;
+            while (true) {
+                const char* quote = (const char*)memchr(q, '"', e - q);
+                if (quote == nullptr) { q = e; break; }
+                if (quote + 1 < e && quote[1] == '"') {
+                    escaped = true;
+                    q = quote + 2;
+                    continue;
+                }
+                q = quote;
+                break;
+            }
+            fieldBegin = p + 1;
+            fieldEnd = q;
+            const char* after = (q < e) ? q + 1 : e;
+            const char* next = (const char*)memchr(after, delimiter, e - after);
+            return next == nullptr ? nullptr : next + 1;
+        }
+        const char* next = (const char*)memchr(s, delimiter, e - s);
+        fieldBegin = s;
+        fieldEnd = (next == nullptr) ? e : next;
+        return next == nullptr ? nullptr : next + 1;
+    }
+
+    void detectFormat(const char* data, size_t size, const char*& body) {
+        const char* lineEnd = (const char*)memchr(data, '\n', size);
+        const char* e = (lineEnd == nullptr) ? data + size : lineEnd;
+        const char* line = data;
+        if (e - line >= 3 && memcmp(line, "\xEF\xBB\xBF", 3) == 0) line += 3;   // UTF-8 BOM
+        if (e > line && e[-1] == '\r') e--;
+
+        format = {memchr(line, '\t', e - line) != nullptr ? '\t' : ',', false, 0, -1, -1};
+        int columns = 0;
+        const char* p = line;
+        while (p != nullptr) {
+            const char *fb, *fe;
+            bool escaped;
+            p = nextField(p, e, format.delimiter, fb, fe, escaped);
+            trim(fb, fe);
+            size_t n = fe - fb;
+            if (sameIgnoreCase(fb, n, "name")) {
+                format.header = true;
+                format.nameColumn = columns;
+            } else if (sameIgnoreCase(fb, n, "purchasecount") || sameIgnoreCase(fb, n, "count")) {
+                format.countColumn = columns;
+            } else if (sameIgnoreCase(fb, n, "id")) {
+                format.idColumn = columns;
+            }
+            columns++;
+        }
+        if (format.header) {
+            body = (lineEnd == nullptr) ? data + size : lineEnd + 1;
+        } else {
+            format.countColumn = (columns > 1) ? 1 : -1;
+            format.idColumn = -1;
+            body = data;
+        }
+    }
+
+    void parseChunk(ImportChunk& chunk) const {
+        const char* p = chunk.begin;
+        while (p < chunk.end) {
+            const char* newline = (const char*)memchr(p, '\n', chunk.end - p);
+            const char* e = (newline == nullptr) ? chunk.end : newline;
+            const char* line = p;
+            p = (newline == nullptr) ? chunk.end : newline + 1;
+            if (e > line && e[-1] == '\r') e--;
+            if (e == line) continue;
+
+            const char* name = nullptr;
+            const char* nameEnd = nullptr;
+            bool nameEscaped = false;
+            int count = 0;
+            int id = -1;
+            int column = 0;
+            const char* f = line;
+            while (f != nullptr) {
+                const char *fb, *fe;
+                bool escaped;
+                f = nextField(f, e, format.delimiter, fb, fe, escaped);
+                if (column == format.nameColumn) {
+                    name = fb;
+                    nameEnd = fe;
+                    nameEscaped = escaped;
+                } else if (column == format.countColumn) {
+                    long long value = parseInteger(fb, fe, 0);
+                    count = (int)max(0LL, min(value, 1000000000LL));
+                } else if (column == format.idColumn) {
+                    long long value = parseInteger(fb, fe, -1);
+                    id = (value >= 0 && value <= 2000000000LL) ? (int)value : -1;
+                }
+                column++;
+            }
+            if (name == nullptr) {
+                chunk.skipped++;
+                continue;
+            }
+            if (nameEscaped) {
+                string text;
+                for (const char* c = name; c < nameEnd; c++) {
+                    text += *c;
+                    if (*c == '"' && c + 1 < nameEnd && c[1] == '"') c++;
+                }
+                chunk.unquoted.push_back(text);
+                name = chunk.unquoted.back().data();
+                nameEnd = name + chunk.unquoted.back().size();
+            }
+            trim(name, nameEnd);
+            size_t n = nameEnd - name;
+            if (n == 0 || n > MAX_ITEM_NAME_BYTES) {
+                chunk.skipped++;
+                continue;
+            }
+            chunk.rows.push_back({name, (uint32_t)n, FrequentItemsArray::nameKey(name, n), count, id});
+        }
+    }
+
+public:
+    CatalogImport() : format(), summary() {}
+
+    /**
+     * Map and tokenize path. threads <= 0 picks one per core (small files
+     * always use one). Returns false if the file cannot be read.
+     */
+    bool parse(const string& path, int threads) {
+        auto t0 = chrono::steady_clock::now();
+        summary = CatalogImportReport();
+        chunks.clear();
+        if (!file.open(path)) {
+            summary.error = "cannot open file";
+            return false;
+        }
+        summary.bytes = file.size();
+        const char* data = file.data();
+        size_t size = file.size();
+        const char* body = data;
+        if (size > 0) detectFormat(data, size, body);
+        const char* end = data + size;
+
+        // One chunk per 1 MB at most, so small files stay single-threaded
+        if (threads <= 0) threads = (int)max(1u, thread::hardware_concurrency());
+        size_t remaining = (size_t)(end - body);
+        int parts = (int)max<size_t>(1, min<size_t>((size_t)threads, remaining / (1 << 20) + 1));
+        chunks.resize(parts);
+        const char* cut = body;
+        for (int i = 0; i < parts; i++) {
+            chunks[i].begin = cut;
+            const char* target = (i == parts - 1) ? end : body + remaining * (i + 1) / parts;
+            if (target < cut) target = cut;
+            const char* newline = (target < end) ? (const char*)memchr(target, '\n', end - target) : nullptr;
+            cut = (i == parts - 1 || newline == nullptr) ? end : newline + 1;
+            chunks[i].end = cut;
+            chunks[i].skipped = 0;
+            chunks[i].rows.reserve((size_t)(cut - chunks[i].begin) / 16 + 1);
+        }
+
+        if (parts == 1) {
+            parseChunk(chunks[0]);
+        } else {
+            vector<thread> workers;
+            for (int i = 1; i < parts; i++) workers.emplace_back(&CatalogImport::parseChunk, this, ref(chunks[i]));
+            parseChunk(chunks[0]);
+            for (thread& worker : workers) worker.join();
+        }
+
+        for (const ImportChunk& chunk : chunks) {
+            summary.rows += chunk.rows.size();
+            summary.skipped += chunk.skipped;
+        }
+        summary.threads = parts;
+        summary.parseSeconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        return true;
+    }
+
+    // Apply the parsed rows to store (caller holds the state lock)
+    void build(FrequentItemsArray& store) {
+        auto t0 = chrono::steady_clock::now();
+        summary.ok = true;
+        try {
+            store.reserveForImport(summary.rows);
+            for (const ImportChunk& chunk : chunks) {
+                for (const ImportRow& row : chunk.rows) {
+                    int result = store.importItem(row.name, row.length, row.hash, row.count, row.id);
+                    if (result > 0) summary.added++;
+                    else if (result == 0) summary.merged++;
+                    else summary.rejected++;
+                }
+            }
+        } catch (const bad_alloc&) {
+            summary.ok = false;
+            summary.error = "out of memory";
+            summary.rejected = summary.rows - summary.added - summary.merged;
+        }
+        store.rebuildRanking();
+        summary.buildSeconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    }
+
+    const CatalogImportReport& report() const { return summary; }
+};
+
+#endif
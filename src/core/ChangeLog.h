@@ -0,0 +1,121 @@
+#ifndef CHANGELOG_H
+#define CHANGELOG_H
+
+#include <cstdint>
+#include <string>
+#include "SharedMemory.h"
+using namespace std;
+
+// Records kept for readers that fall behind (older ones are overwritten)
+const int CHANGE_LOG_SIZE = 256;
+
+// Session tags: each record belongs to the cart session that made it
+const uint32_t MAIN_SESSION = 0;            // callers that select no session
+const uint32_t ALL_SESSIONS = 0xFFFFFFFF;   // seen by every session (factory reset)
+
+enum ChangeKind {
+    CHANGE_CART,        // a cart line changed
+    CHANGE_UNDO,        // the undo stack changed
+    CHANGE_CHECKOUT,    // the checkout queue changed
+    CHANGE_ALL          // many structures at once: re-read everything
+};
+
+enum ChangeOp {
+    CHANGE_ADD,         // cart: quantity added to `name`
+    CHANGE_REMOVE,      // cart: line `name` removed
+    CHANGE_UPDATE,      // cart: line `name` now holds `quantity`
+    CHANGE_CLEAR,       // cart / undo: emptied
+    CHANGE_PUSH,        // undo: entry pushed
+    CHANGE_POP,         // undo: entry popped (its line removed)
+    CHANGE_START,       // checkout: `quantity` lines moved to the queue
+    CHANGE_DONE,        // checkout: `quantity` lines processed
+    CHANGE_BATCH,       // all: a batch was applied
+    CHANGE_RESET        // all: reset / factory reset
+};
+
+struct ChangeRecord {
+    uint64_t seq;
+    uint32_t session;
+    uint8_t kind;
+    uint8_t op;
+    int32_t quantity;
+    InlineName name;
+};
+
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                    CHANGE LOG (cart, undo and checkout mutations)
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Fixed ring of the last CHANGE_LOG_SIZE mutations, numbered by `seq` from
+ * 1. Appending is a copy into the ring - no allocation. The ring lives in
+ * LibraryState, so with shared state every process sees every process's
+ * changes. A reader remembers the last seq it saw. If that fell out of the
+ * ring, it cannot tell what changed and must re-read everything (gap).
+ * Sessions share the one ring; a reader skips records of other sessions.
+ */
+class ChangeLog {
+private:
+    ChangeRecord ring[CHANGE_LOG_SIZE];
+    uint64_t last;
+
+    static const char* kindName(int kind) {
+        static const char* names[] = {"cart", "undo", "checkout", "all"};
+        return (kind >= 0 && kind <= CHANGE_ALL) ? names[kind] : "";
+    }
+
+    static const char* opName(int op) {
+        static const char* names[] = {"add", "remove", "update", "clear", "push",
+                                      "pop", "start", "done", "batch", "reset"};
+        return (op >= 0 && op <= CHANGE_RESET) ? names[op] : "";
+    }
+
+public:
+    ChangeLog() : last(0) {}
+
+    uint64_t append(uint32_t session, ChangeKind kind, ChangeOp op, const InlineName& name, int quantity = 0) {
+        ChangeRecord& record = ring[++last % CHANGE_LOG_SIZE];
+        record.seq = last;
+        record.session = session;
+        record.kind = (uint8_t)kind;
+        record.op = (uint8_t)op;
+        record.quantity = quantity;
+        record.name = name;
+        return last;
+    }
+
+    uint64_t append(uint32_t session, ChangeKind kind, ChangeOp op, const string& name = string(), int quantity = 0) {
+        return append(session, kind, op, InlineName(name.data(), name.size()), quantity);
+    }
+
+    uint64_t latest() const { return last; }
+    uint64_t oldest() const { return (last > (uint64_t)CHANGE_LOG_SIZE) ? last - CHANGE_LOG_SIZE + 1 : 1; }
+
+    // Record `seq`, for oldest() <= seq <= latest()
+    const ChangeRecord& at(uint64_t seq) const { return ring[seq % CHANGE_LOG_SIZE]; }
+
+    static bool visibleTo(const ChangeRecord& record, uint32_t session) {
+        return record.session == session || record.session == ALL_SESSIONS;
+    }
+
+    // {"seq":..,"kind":"cart","op":"add","name":"Milk","quantity":2}
+    static void writeJson(string& out, const ChangeRecord& record) {
+        out += "{\"seq\":";
+        out += to_string(record.seq);
+        out += ",\"kind\":\"";
+        out += kindName(record.kind);
+        out += "\",\"op\":\"";
+        out += opName(record.op);
+        out += "\"";
+        if (!record.name.empty()) {
+            out += ",\"name\":\"";
+            out.append(record.name.c_str(), record.name.size());
+            out += "\"";
+        }
+        out += ",\"quantity\":";
+        out += to_string(record.quantity);
+        out += "}";
+    }
+};
+
+#endif
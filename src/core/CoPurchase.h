@@ -0,0 +1,216 @@
+#ifndef COPURCHASE_H
+#define COPURCHASE_H
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+using namespace std;
+
+// Neighbors remembered per item ("bought together" candidates)
+const int MAX_NEIGHBORS = 16;
+// Items that can own a neighbor list
+const int MAX_COPURCHASE_ITEMS = 1000;
+// Only the first distinct items of a basket form pairs (bounds the O(m^2) update)
+const int MAX_BASKET_PAIR_ITEMS = 32;
+// Lists sampled when a new item needs one and every slot is taken
+const int LIST_EVICTION_SAMPLES = 16;
+
+struct Neighbor {
+    int id;
+    int count;
+};
+
+struct NeighborList {
+    Neighbor entries[MAX_NEIGHBORS];
+    int size;
+    int owner;           // item id the list belongs to
+    long long weight;    // pairs recorded for the owner (plus any inherited)
+
+    NeighborList() : size(0), owner(-1), weight(0) {}
+};
+
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                    CO-PURCHASE GRAPH ("Bought Together")
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Sparse item-item co-occurrence counts, updated once per checkout basket.
+ *
+ * MEMORY BOUND:
+ * - At most MAX_COPURCHASE_ITEMS items own a neighbor list at a time
+ * - Each list holds at most MAX_NEIGHBORS entries, so the graph never exceeds
+ *   MAX_COPURCHASE_ITEMS * sizeof(NeighborList) bytes of list storage
+ *
+ * PRUNING POLICY (Space-Saving, at both levels):
+ * - When a list is full, the entry with the lowest count is replaced by the new
+ *   neighbor, which inherits that count + 1. Counts can only be overestimated,
+ *   and by at most the smallest count in the list, so strong pairs survive
+ *   while one-off pairs are recycled
+ * - When every list is owned, a new item takes over the lightest of
+ *   LIST_EVICTION_SAMPLES sampled lists (by weight, the pairs recorded for
+ *   its owner) and inherits that weight, so items that stopped selling give
+ *   their slot to new ones instead of the first items owning lists forever
+ */
+class CoPurchaseGraph {
+private:
+    unordered_map<int, int> slotOf;   // item id -> index into lists
+    vector<NeighborList> lists;
+    long long basketsRecorded;
+    long long listsRecycled;
+    uint32_t sampleState;             // xorshift32 state for eviction sampling
+    vector<Neighbor> scratch;         // reused by recommend() (no allocation)
+
+    uint32_t nextSample() {
+        sampleState ^= sampleState << 13;
+        sampleState ^= sampleState >> 17;
+        sampleState ^= sampleState << 5;
+        return sampleState;
+    }
+
+    NeighborList* listFor(int itemId, bool create) {
+        auto it = slotOf.find(itemId);
+        if (it != slotOf.end()) return &lists[it->second];
+        if (!create) return nullptr;
+        if ((int)lists.size() < MAX_COPURCHASE_ITEMS) {
+            slotOf[itemId] = (int)lists.size();
+            lists.push_back(NeighborList());
+            lists.back().owner = itemId;
+            return &lists.back();
+        }
+        // Every slot is owned - recycle the lightest sampled list
+        int victim = (int)(nextSample() % (uint32_t)lists.size());
+        for (int i = 1; i < LIST_EVICTION_SAMPLES; i++) {
+            int slot = (int)(nextSample() % (uint32_t)lists.size());
+            if (lists[slot].weight < lists[victim].weight) victim = slot;
+        }
+        NeighborList& list = lists[victim];
+        slotOf.erase(list.owner);
+        slotOf[itemId] = victim;
+        list.size = 0;
+        list.owner = itemId;   // keeps the weight: a newcomer must outsell it to stay
+        listsRecycled++;
+        return &list;
+    }
+
+    static void bump(NeighborList& list, int neighborId) {
+        list.weight++;
+        int minPos = 0;
+        for (int i = 0; i < list.size; i++) {
+            if (list.entries[i].id == neighborId) {
+                list.entries[i].count++;
+                return;
+            }
+            if (list.entries[i].count < list.entries[minPos].count) minPos = i;
+        }
+        if (list.size < MAX_NEIGHBORS) {
+            list.entries[list.size].id = neighborId;
+            list.entries[list.size].count = 1;
+            list.size++;
+            return;
+        }
+        // Full - recycle the weakest entry
+        list.entries[minPos].id = neighborId;
+        list.entries[minPos].count++;
+    }
+
+public:
+    CoPurchaseGraph() : basketsRecorded(0), listsRecycled(0), sampleState(2463534242u) {
+        lists.reserve(MAX_COPURCHASE_ITEMS);
+        scratch.reserve(MAX_BASKET_PAIR_ITEMS * MAX_NEIGHBORS);
+    }
+
+    /**
+     * Record one checkout basket: every pair of distinct items counts once,
+     * however many lines hold the same item.
+     * O(m^2 * MAX_NEIGHBORS) with m capped at MAX_BASKET_PAIR_ITEMS
+     */
+    void recordBasket(const int ids[], int count) {
+        int distinct[MAX_BASKET_PAIR_ITEMS];
+        int m = 0;
+        for (int i = 0; i < count && m < MAX_BASKET_PAIR_ITEMS; i++) {
+            if (ids[i] < 0) continue;
+            int j = 0;
+            while (j < m && distinct[j] != ids[i]) j++;
+            if (j == m) distinct[m++] = ids[i];
+        }
+        for (int i = 0; i < m; i++) {
+            NeighborList* list = listFor(distinct[i], true);
+            for (int j = 0; j < m; j++) {
+                if (j != i) bump(*list, distinct[j]);
+            }
+        }
+        basketsRecorded++;
+    }
+
+    /**
+     * Top `n` items most often bought with the items in `cartIds`, excluding
+     * the cart items themselves. Writes into `out`, returns the count written.
+     * Cost: O(c * MAX_NEIGHBORS * log) with c capped at MAX_BASKET_PAIR_ITEMS
+     */
+    int recommend(const int cartIds[], int cartCount, Neighbor out[], int n) {
+        if (cartCount > MAX_BASKET_PAIR_ITEMS) cartCount = MAX_BASKET_PAIR_ITEMS;
+        scratch.clear();
+        for (int i = 0; i < cartCount; i++) {
+            NeighborList* list = listFor(cartIds[i], false);
+            if (list == nullptr) continue;
+            for (int k = 0; k < list->size; k++) {
+                scratch.push_back(list->entries[k]);
+            }
+        }
+
+        // Merge duplicate candidates (sorted by id), dropping cart items
+        sort(scratch.begin(), scratch.end(),
+             [](const Neighbor& a, const Neighbor& b) { return a.id < b.id; });
+        int merged = 0;
+        for (size_t i = 0; i < scratch.size(); i++) {
+            bool inCart = false;
+            for (int c = 0; c < cartCount; c++) {
+                if (cartIds[c] == scratch[i].id) { inCart = true; break; }
+            }
+            if (inCart) continue;
+            if (merged > 0 && scratch[merged - 1].id == scratch[i].id) {
+                scratch[merged - 1].count += scratch[i].count;
+            } else {
+                scratch[merged++] = scratch[i];
+            }
+        }
+
+        int take = (merged < n) ? merged : n;
+        partial_sort(scratch.begin(), scratch.begin() + take, scratch.begin() + merged,
+                     [](const Neighbor& a, const Neighbor& b) {
+                         return a.count > b.count || (a.count == b.count && a.id < b.id);
+                     });
+        for (int i = 0; i < take; i++) out[i] = scratch[i];
+        return take;
+    }
+
+    int trackedItems() const { return (int)lists.size(); }
+    long long baskets() const { return basketsRecorded; }
+    long long recycledLists() const { return listsRecycled; }
+
+    // Bytes held by neighbor lists and the id index (approximate for the map)
+    size_t memoryBytes() const {
+        return lists.capacity() * sizeof(NeighborList)
+             + slotOf.size() * (sizeof(int) * 2 + sizeof(void*) * 2)
+             + slotOf.bucket_count() * sizeof(void*)
+             + scratch.capacity() * sizeof(Neighbor);
+    }
+
+    // Worst-case bytes this graph can ever use (index buckets approximated
+    // at two per item, the load factor unordered_map grows to)
+    static size_t memoryLimitBytes() {
+        return (size_t)MAX_COPURCHASE_ITEMS * sizeof(NeighborList)
+             + (size_t)MAX_COPURCHASE_ITEMS * (sizeof(int) * 2 + sizeof(void*) * 4)
+             + (size_t)MAX_BASKET_PAIR_ITEMS * MAX_NEIGHBORS * sizeof(Neighbor);
+    }
+
+    void clear() {
+        slotOf.clear();
+        lists.clear();
+        basketsRecorded = 0;
+        listsRecycled = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,243 @@
+#ifndef GROUPCOMMIT_H
+#define GROUPCOMMIT_H
+
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+// Counters reported by GroupCommitWriter::stats()
+struct GroupCommitStats {
+    bool running;
+    bool durable;
+    long long windowMs;
+    uint64_t pending;            // mutations not yet on disk
+    uint64_t mutations;          // marked since start
+    uint64_t commits;            // snapshots written (each covers >= 1 mutation)
+    uint64_t failures;
+    long long lastCommitUs;      // snapshot + write + fsync + rename
+    long long maxCommitUs;
+    size_t lastBytes;
+};
+
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                    GROUP COMMIT WRITER (Background Persistence)
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Owns one file and one background thread. Each mutation calls markDirty(),
+ * which only bumps a sequence number - O(1), no I/O - and returns that
+ * number. The thread waits `window` after the first pending mutation so
+ * others can join, then takes one snapshot and writes it durably:
+ *     write path.<pid>.tmp -> fsync -> rename over path -> fsync directory
+ * Every mutation marked before the snapshot is covered by that single
+ * write, so the fsync cost is shared by all of them.
+ *
+ * waitFor(seq, hurry) blocks until a commit covers seq (durable mode, flush
+ * barriers); it must be called without holding the lock the snapshot
+ * function takes, or the writer can never make progress.
+ */
+class GroupCommitWriter {
+private:
+    mutex lock;
+    condition_variable wake;         // writer: new work, urgency or stop
+    condition_variable committed;    // waiters: committedSeq moved
+    thread worker;
+
+    string path;
+    function<string()> snapshot;
+    chrono::milliseconds window;
+    bool durable;
+    bool running;
+    bool stopping;
+    bool urgent;                     // a waiter wants the window skipped
+
+    uint64_t dirtySeq;               // last mutation marked
+    uint64_t committedSeq;           // last mutation covered by a finished commit
+    uint64_t failedSeq;              // last mutation covered by a failed commit
+    GroupCommitStats counters;
+
+    static bool writeFileDurably(const string& target, const string& data) {
+#ifdef _WIN32
+        string tmp = target + ".tmp";
+        FILE* f = fopen(tmp.c_str(), "wb");
+        if (f == nullptr) return false;
+        bool ok = fwrite(data.data(), 1, data.size(), f) == data.size() && fflush(f) == 0
+                  && _commit(_fileno(f)) == 0;
+        ok = (fclose(f) == 0) && ok;
+        if (!ok) return false;
+        remove(target.c_str());
+        return rename(tmp.c_str(), target.c_str()) == 0;
+#else
+        string tmp = target + "." + to_string(getpid()) + ".tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+            if (n <= 0) break;
+            written += (size_t)n;
+        }
+        bool ok = written == data.size() && fsync(fd) == 0;
+        ok = (::close(fd) == 0) && ok;
+        if (!ok || rename(tmp.c_str(), target.c_str()) != 0) {
+            unlink(tmp.c_str());
+            return false;
+        }
+        // Make the rename itself durable
+        size_t slash = target.rfind('/');
+        string dir = (slash == string::npos) ? "." : (slash == 0 ? "/" : target.substr(0, slash));
+        int dirFd = ::open(dir.c_str(), O_RDONLY);
+        if (dirFd >= 0) {
+            fsync(dirFd);
+            ::close(dirFd);
+        }
+        return true;
+#endif
+    }
+
+    void run() {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            wake.wait(guard, [&]() { return stopping || dirtySeq > committedSeq; });
+            if (dirtySeq == committedSeq) break;   // stopping with nothing pending
+
+            // Coalescing window: let concurrent mutations join this commit
+            if (window.count() > 0 && !stopping && !urgent) {
+                wake.wait_for(guard, window, [&]() { return stopping || urgent; });
+            }
+            urgent = false;
+            uint64_t target = dirtySeq;
+            guard.unlock();
+
+            auto t0 = chrono::steady_clock::now();
+            string data = snapshot();
+            bool ok = writeFileDurably(path, data);
+            long long us = (long long)chrono::duration_cast<chrono::microseconds>(
+                               chrono::steady_clock::now() - t0).count();
+
+            guard.lock();
+            committedSeq = target;
+            if (ok) {
+                counters.commits++;
+            } else {
+                counters.failures++;
+                failedSeq = target;
+                fprintf(stderr, "GroupCommitWriter: could not write %s\n", path.c_str());
+            }
+            counters.lastCommitUs = us;
+            if (us > counters.maxCommitUs) counters.maxCommitUs = us;
+            counters.lastBytes = data.size();
+            committed.notify_all();
+        }
+    }
+
+public:
+    GroupCommitWriter()
+        : window(0), durable(false), running(false), stopping(false), urgent(false),
+          dirtySeq(0), committedSeq(0), failedSeq(0), counters() {}
+
+    ~GroupCommitWriter() { stop(); }
+
+    /**
+     * Start persisting snapshot() to target. Restarting with new settings
+     * first commits whatever the previous configuration had pending.
+     */
+    void start(const string& target, long long windowMs, bool durableMode, function<string()> snapshotFn) {
+        stop();
+        lock_guard<mutex> guard(lock);
+        path = target;
+        snapshot = snapshotFn;
+        window = chrono::milliseconds(windowMs < 0 ? 0 : windowMs);
+        durable = durableMode;
+        stopping = false;
+        urgent = false;
+        running = true;
+        counters = GroupCommitStats();
+        worker = thread(&GroupCommitWriter::run, this);
+    }
+
+    // Commit what is pending, then end the thread
+    void stop() {
+        {
+            lock_guard<mutex> guard(lock);
+            if (!running) return;
+            stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+        lock_guard<mutex> guard(lock);
+        running = false;
+        committed.notify_all();
+    }
+
+    bool isRunning() {
+        lock_guard<mutex> guard(lock);
+        return running;
+    }
+
+    bool isDurable() {
+        lock_guard<mutex> guard(lock);
+        return running && durable;
+    }
+
+    // Note one mutation; returns the sequence to wait for (0 = not persisting)
+    uint64_t markDirty() {
+        lock_guard<mutex> guard(lock);
+        if (!running || stopping) return 0;
+        counters.mutations++;
+        uint64_t seq = ++dirtySeq;
+        if (dirtySeq == committedSeq + 1) wake.notify_one();
+        return seq;
+    }
+
+    // Sequence covering everything marked so far (for a flush barrier)
+    uint64_t pendingSeq() {
+        lock_guard<mutex> guard(lock);
+        return running ? dirtySeq : 0;
+    }
+
+    /**
+     * Block until a commit covers seq; false if that commit failed.
+     * hurry skips the rest of the coalescing window (flush barriers);
+     * durable-mode writers wait it out so their commits are shared.
+     */
+    bool waitFor(uint64_t seq, bool hurry) {
+        unique_lock<mutex> guard(lock);
+        if (seq == 0 || committedSeq >= seq) return seq == 0 || failedSeq < seq;
+        if (hurry) {
+            urgent = true;
+            wake.notify_one();
+        }
+        committed.wait(guard, [&]() { return committedSeq >= seq || !running; });
+        return committedSeq >= seq && failedSeq < seq;
+    }
+
+    GroupCommitStats stats() {
+        lock_guard<mutex> guard(lock);
+        GroupCommitStats s = counters;
+        s.running = running;
+        s.durable = durable;
+        s.windowMs = (long long)window.count();
+        s.pending = dirtySeq - committedSeq;
+        return s;
+    }
+
+    string target() {
+        lock_guard<mutex> guard(lock);
+        return path;
+    }
+};
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef HEAVYHITTERS_H
+#define HEAVYHITTERS_H
+
+#include <string>
+#include <cctype>
+#include <unordered_map>
+#include "MemoryStats.h"
+using namespace std;
+
+// Counters kept by the sketch (fixed memory, independent of vocabulary size)
+const int HEAVY_HITTER_CAPACITY = 256;
+
+struct HeavyHitter {
+    string key;    // case-folded name ("" = free slot)
+    string name;   // name as first typed
+    long long count;  // estimated frequency (never underestimates)
+    long long error;  // maximum overestimation of count
+
+    HeavyHitter() : count(0), error(0) {}
+
+    long long guaranteed() const { return count - error; }
+};
+
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                    SPACE-SAVING HEAVY HITTERS (Custom Items)
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Tracks purchase frequency for an unbounded stream of custom item names using
+ * exactly HEAVY_HITTER_CAPACITY counters, kept in a min-heap by count.
+ *
+ * - Known name: add to its counter, sift down - O(log m)
+ * - Unknown name: take over the minimum counter; the newcomer inherits that
+ *   count as its error - O(log m)
+ *
+ * ERROR BOUNDS (N = total quantity added, m = capacity):
+ * - count - error <= true frequency <= count
+ * - error <= N / m, so any name bought more than N / m times is always present
+ */
+class HeavyHitterSketch {
+private:
+    HeavyHitter slots[HEAVY_HITTER_CAPACITY];
+    int heap[HEAVY_HITTER_CAPACITY];      // slot indices, min count at heap[0]
+    int heapPos[HEAVY_HITTER_CAPACITY];   // slot -> position in heap
+    unordered_map<string, int> slotOf;    // folded key -> slot
+    long long streamTotal;
+
+    static string fold(const string& name) {
+        string key = name;
+        for (size_t i = 0; i < key.size(); i++) {
+            key[i] = (char)tolower((unsigned char)key[i]);
+        }
+        return key;
+    }
+
+    void swapHeap(int a, int b) {
+        int tmp = heap[a];
+        heap[a] = heap[b];
+        heap[b] = tmp;
+        heapPos[heap[a]] = a;
+        heapPos[heap[b]] = b;
+    }
+
+    void siftUp(int pos) {
+        while (pos > 0) {
+            int parent = (pos - 1) / 2;
+            if (slots[heap[parent]].count <= slots[heap[pos]].count) break;
+            swapHeap(pos, parent);
+            pos = parent;
+        }
+    }
+
+    void siftDown(int pos) {
+        while (true) {
+            int smallest = pos;
+            int left = 2 * pos + 1;
+            int right = left + 1;
+            if (left < HEAVY_HITTER_CAPACITY && slots[heap[left]].count < slots[heap[smallest]].count) smallest = left;
+            if (right < HEAVY_HITTER_CAPACITY && slots[heap[right]].count < slots[heap[smallest]].count) smallest = right;
+            if (smallest == pos) break;
+            swapHeap(pos, smallest);
+            pos = smallest;
+        }
+    }
+
+public:
+    HeavyHitterSketch() {
+        clear();
+    }
+
+    /**
+     * Add `quantity` purchases of `name`
+     * Returns the slot now holding the name
+     */
+    int add(const string& name, int quantity) {
+        string key = fold(name);
+        streamTotal += quantity;
+
+        auto it = slotOf.find(key);
+        if (it != slotOf.end()) {
+            int slot = it->second;
+            slots[slot].count += quantity;
+            siftDown(heapPos[slot]);
+            return slot;
+        }
+
+        // Replace the minimum counter
+        int slot = heap[0];
+        HeavyHitter& victim = slots[slot];
+        if (!victim.key.empty()) slotOf.erase(victim.key);
+        victim.error = victim.count;
+        victim.count += quantity;
+        victim.key = key;
+        victim.name = name;
+        slotOf[key] = slot;
+        siftDown(0);
+        return slot;
+    }
+
+    const HeavyHitter& get(int slot) const { return slots[slot]; }
+
+    // Free a slot (item promoted to the exact store)
+    void remove(int slot) {
+        slotOf.erase(slots[slot].key);
+        slots[slot] = HeavyHitter();
+        siftUp(heapPos[slot]);
+    }
+
+    // Largest possible overestimation of any count (N / m)
+    long long errorBound() const { return streamTotal / HEAVY_HITTER_CAPACITY; }
+    long long total() const { return streamTotal; }
+    int capacity() const { return HEAVY_HITTER_CAPACITY; }
+    int used() const { return (int)slotOf.size(); }
+
+    // Fixed counters plus name strings and the key index (approximate for the map)
+    size_t memoryBytes() const {
+        size_t total = sizeof(*this) + slotOf.bucket_count() * sizeof(void*);
+        for (int i = 0; i < HEAVY_HITTER_CAPACITY; i++) {
+            total += stringHeapBytes(slots[i].key) + stringHeapBytes(slots[i].name);
+        }
+        for (const auto& entry : slotOf) {
+            total += sizeof(entry) + sizeof(void*) + stringHeapBytes(entry.first);
+        }
+        return total;
+    }
+
+    void clear() {
+        for (int i = 0; i < HEAVY_HITTER_CAPACITY; i++) {
+            slots[i] = HeavyHitter();
+            heap[i] = i;
+            heapPos[i] = i;
+        }
+        slotOf.clear();
+        streamTotal = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,239 @@
+#ifndef ITEMSPILL_H
+#define ITEMSPILL_H
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Array.h"
+using namespace std;
+
+// One evicted custom item as written to the spill file
+struct SpilledItem {
+    int32_t id;             // -1 = free record
+    int32_t purchaseCount;
+    double recentScore;     // decayed score at spilledAt
+    double spilledAt;       // wall-clock seconds
+    InlineName name;
+};
+
+static_assert(is_trivially_copyable<SpilledItem>::value, "spill records are written as raw bytes");
+
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                    ITEM SPILL FILE (Evicted Custom Items)
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Keeps custom items evicted from the item store on disk, so a later
+ * purchase of one can bring back its counts instead of starting from zero.
+ *
+ * FILE: "GRSPIL01", record size (uint32), then fixed-size SpilledItem
+ * records. take() frees a record (id = -1), and the next spill reuses it.
+ * So the file holds at most as many records as items were ever spilled and
+ * not yet restored.
+ *
+ * Memory per spilled item is its folded-name hash plus one table slot
+ * (~12 bytes). The record itself is read from disk only on a hash match.
+ */
+class ItemSpill {
+private:
+    FILE* file;
+    string filePath;
+    vector<uint32_t> recordKey;   // record -> folded-name hash
+    vector<int> slots;            // open addressing by hash (record + 1, 0 = free)
+    vector<int> freeRecords;
+    int live;
+    long long spilledTotal;
+    long long restoredTotal;
+
+    static const size_t HEADER_BYTES = 12;
+
+    static uint32_t keyOf(const char* s, size_t n) { return FrequentItemsArray::nameKey(s, n); }
+
+    long recordOffset(int record) const { return (long)(HEADER_BYTES + (size_t)record * sizeof(SpilledItem)); }
+
+    bool readRecord(int record, SpilledItem& out) const {
+        return fseek(file, recordOffset(record), SEEK_SET) == 0 && fread(&out, sizeof(out), 1, file) == 1;
+    }
+
+    bool writeRecord(int record, const SpilledItem& item) {
+        return fseek(file, recordOffset(record), SEEK_SET) == 0 && fwrite(&item, sizeof(item), 1, file) == 1
+            && fflush(file) == 0;
+    }
+
+    void index(int record) {
+        if ((size_t)(live + 1) * 2 > slots.size()) {
+            vector<int> old(slots.empty() ? 16 : slots.size() * 2, 0);
+            old.swap(slots);
+            for (int entry : old) {
+                if (entry != 0) insertSlot(entry - 1);
+            }
+        }
+        insertSlot(record);
+        live++;
+    }
+
+    void insertSlot(int record) {
+        size_t mask = slots.size() - 1;
+        size_t i = recordKey[record] & mask;
+        while (slots[i] != 0) i = (i + 1) & mask;
+        slots[i] = record + 1;
+    }
+
+    // Remove the entry at slot `hole`; later entries of its probe run shift back
+    void unindexSlot(size_t hole) {
+        size_t mask = slots.size() - 1;
+        for (size_t j = (hole + 1) & mask; slots[j] != 0; j = (j + 1) & mask) {
+            size_t home = recordKey[slots[j] - 1] & mask;
+            if (((j - home) & mask) >= ((j - hole) & mask)) {
+                slots[hole] = slots[j];
+                hole = j;
+            }
+        }
+        slots[hole] = 0;
+        live--;
+    }
+
+    // Table slot of the live record named s[0..n), or -1; fills `item`
+    long findSlot(const char* s, size_t n, SpilledItem& item) const {
+        if (slots.empty()) return -1;
+        uint32_t key = keyOf(s, n);
+        size_t mask = slots.size() - 1;
+        for (size_t i = key & mask; slots[i] != 0; i = (i + 1) & mask) {
+            int record = slots[i] - 1;
+            if (recordKey[record] == key && readRecord(record, item) && item.name.equalsIgnoreCase(s, n)) {
+                return (long)i;
+            }
+        }
+        return -1;
+    }
+
+    void reset() {
+        recordKey.clear();
+        slots.clear();
+        freeRecords.clear();
+        live = 0;
+    }
+
+    bool writeHeader() {
+        uint32_t recordSize = (uint32_t)sizeof(SpilledItem);
+        return fseek(file, 0, SEEK_SET) == 0 && fwrite("GRSPIL01", 1, 8, file) == 8
+            && fwrite(&recordSize, sizeof(recordSize), 1, file) == 1 && fflush(file) == 0;
+    }
+
+public:
+    ItemSpill() : file(nullptr), live(0), spilledTotal(0), restoredTotal(0) {}
+    ~ItemSpill() { close(); }
+
+    ItemSpill(const ItemSpill&) = delete;
+    ItemSpill& operator=(const ItemSpill&) = delete;
+
+    /**
+     * Open (or create) the spill file at `path` and index its records.
+     * A file written by a build with another record layout is started over.
+     */
+    bool open(const char* path) {
+        close();
+        file = fopen(path, "r+b");
+        char magic[8];
+        uint32_t recordSize = 0;
+        bool valid = file != nullptr && fread(magic, 1, 8, file) == 8 && memcmp(magic, "GRSPIL01", 8) == 0
+                  && fread(&recordSize, sizeof(recordSize), 1, file) == 1 && recordSize == sizeof(SpilledItem);
+        if (!valid) {
+            if (file != nullptr) fclose(file);
+            file = fopen(path, "w+b");
+            if (file == nullptr || !writeHeader()) {
+                close();
+                return false;
+            }
+        }
+        filePath = path;
+        SpilledItem item;
+        for (int record = 0; valid && readRecord(record, item); record++) {
+            recordKey.push_back(keyOf(item.name.c_str(), item.name.size()));
+            if (item.id < 0) {
+                freeRecords.push_back(record);
+            } else {
+                index(record);
+            }
+        }
+        return true;
+    }
+
+    void close() {
+        if (file != nullptr) fclose(file);
+        file = nullptr;
+        filePath.clear();
+        reset();
+    }
+
+    bool enabled() const { return file != nullptr; }
+    const string& path() const { return filePath; }
+    int size() const { return live; }
+    long long spilled() const { return spilledTotal; }
+    long long restored() const { return restoredTotal; }
+
+    // Keep an evicted item (replaces an older record of the same name)
+    bool spill(const FrequentItem& evicted, double recentScore, double now) {
+        if (file == nullptr) return false;
+        SpilledItem item;
+        item.id = evicted.id;
+        item.purchaseCount = evicted.purchaseCount;
+        item.recentScore = recentScore;
+        item.spilledAt = now;
+        item.name = evicted.name;
+
+        SpilledItem existing;
+        long slot = findSlot(item.name.c_str(), item.name.size(), existing);
+        int record;
+        if (slot >= 0) {
+            record = slots[slot] - 1;
+        } else if (!freeRecords.empty()) {
+            record = freeRecords.back();
+            freeRecords.pop_back();
+        } else {
+            record = (int)recordKey.size();
+            recordKey.push_back(0);
+        }
+        if (!writeRecord(record, item)) return false;
+        if (slot < 0) {
+            recordKey[record] = keyOf(item.name.c_str(), item.name.size());
+            index(record);
+        }
+        spilledTotal++;
+        return true;
+    }
+
+    // Remove the item named s[0..n) from the file into `out`; false if absent
+    bool take(const char* s, size_t n, SpilledItem& out) {
+        if (file == nullptr) return false;
+        long slot = findSlot(s, n, out);
+        if (slot < 0) return false;
+        int record = slots[slot] - 1;
+        SpilledItem freed = out;
+        freed.id = -1;
+        writeRecord(record, freed);
+        unindexSlot((size_t)slot);
+        freeRecords.push_back(record);
+        restoredTotal++;
+        return true;
+    }
+
+    // Forget every spilled item (factory reset)
+    void clear() {
+        reset();
+        if (file == nullptr) return;
+        string path = filePath;
+        fclose(file);
+        file = fopen(path.c_str(), "w+b");
+        if (file == nullptr || !writeHeader()) close();
+    }
+
+    size_t memoryBytes() const {
+        return recordKey.capacity() * sizeof(uint32_t)
+             + (slots.capacity() + freeRecords.capacity()) * sizeof(int);
+    }
+};
+
+#endif
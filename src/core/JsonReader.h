@@ -0,0 +1,204 @@
+#ifndef JSONREADER_H
+#define JSONREADER_H
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
+using namespace std;
+
+struct JsonValue {
+    enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT } type = NUL;
+    bool boolean = false;
+    double number = 0;
+    string str;
+    vector<JsonValue> items;
+    vector<pair<string, JsonValue>> fields;
+    size_t offset = 0;    // where the value's text starts in the parsed document
+    size_t length = 0;    // and its length, to pass a nested document on as-is
+
+    const JsonValue* get(const string& key) const {
+        for (const auto& field : fields) {
+            if (field.first == key) return &field.second;
+        }
+        return nullptr;
+    }
+
+    double numberOr(const string& key, double fallback) const {
+        const JsonValue* v = get(key);
+        return (v && v->type == NUMBER) ? v->number : fallback;
+    }
+
+    string stringOr(const string& key, const string& fallback) const {
+        const JsonValue* v = get(key);
+        return (v && v->type == STRING) ? v->str : fallback;
+    }
+};
+
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                    MINIMAL JSON READER (request bodies, data file, sessions)
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Parses a whole document into a JsonValue tree. Enough for the small
+ * documents the servers and the library exchange: nesting is capped at 32
+ * levels, numbers are doubles and \u escapes become UTF-8. Each value
+ * keeps its span in the text, so a nested document can be handed on.
+ */
+class JsonReader {
+private:
+    const string& text;
+    size_t pos;
+
+    void skipSpace() {
+        while (pos < text.size() && isspace((unsigned char)text[pos])) pos++;
+    }
+
+    bool literal(const char* word) {
+        size_t len = strlen(word);
+        if (text.compare(pos, len, word) != 0) return false;
+        pos += len;
+        return true;
+    }
+
+    static void appendUtf8(string& out, unsigned code) {
+        if (code < 0x80) {
+            out += (char)code;
+        } else if (code < 0x800) {
+            out += (char)(0xC0 | (code >> 6));
+            out += (char)(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += (char)(0xE0 | (code >> 12));
+            out += (char)(0x80 | ((code >> 6) & 0x3F));
+            out += (char)(0x80 | (code & 0x3F));
+        } else {
+            out += (char)(0xF0 | (code >> 18));
+            out += (char)(0x80 | ((code >> 12) & 0x3F));
+            out += (char)(0x80 | ((code >> 6) & 0x3F));
+            out += (char)(0x80 | (code & 0x3F));
+        }
+    }
+
+    bool parseHex4(unsigned& code) {
+        if (pos + 4 > text.size()) return false;
+        code = (unsigned)strtoul(text.substr(pos, 4).c_str(), nullptr, 16);
+        pos += 4;
+        return true;
+    }
+
+    bool parseString(string& out) {
+        if (text[pos] != '"') return false;
+        pos++;
+        while (pos < text.size() && text[pos] != '"') {
+            char c = text[pos++];
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos >= text.size()) return false;
+            char e = text[pos++];
+            switch (e) {
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'r': out += '\r'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u': {
+                    unsigned code;
+                    if (!parseHex4(code)) return false;
+                    if (code >= 0xD800 && code < 0xDC00 && text.compare(pos, 2, "\\u") == 0) {
+                        pos += 2;
+                        unsigned low;
+                        if (!parseHex4(low)) return false;
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(out, code);
+                    break;
+                }
+                default: out += e;
+            }
+        }
+        if (pos >= text.size()) return false;
+        pos++;
+        return true;
+    }
+
+    bool parseValue(JsonValue& out, int depth) {
+        if (depth > 32) return false;
+        skipSpace();
+        out.offset = pos;
+        bool parsed = parseBareValue(out, depth);
+        out.length = pos - out.offset;
+        return parsed;
+    }
+
+    bool parseBareValue(JsonValue& out, int depth) {
+        if (pos >= text.size()) return false;
+        char c = text[pos];
+        if (c == '{') {
+            out.type = JsonValue::OBJECT;
+            pos++;
+            skipSpace();
+            if (pos < text.size() && text[pos] == '}') { pos++; return true; }
+            while (true) {
+                skipSpace();
+                string key;
+                if (pos >= text.size() || !parseString(key)) return false;
+                skipSpace();
+                if (pos >= text.size() || text[pos] != ':') return false;
+                pos++;
+                JsonValue value;
+                if (!parseValue(value, depth + 1)) return false;
+                out.fields.emplace_back(key, std::move(value));
+                skipSpace();
+                if (pos < text.size() && text[pos] == ',') { pos++; continue; }
+                if (pos < text.size() && text[pos] == '}') { pos++; return true; }
+                return false;
+            }
+        }
+        if (c == '[') {
+            out.type = JsonValue::ARRAY;
+            pos++;
+            skipSpace();
+            if (pos < text.size() && text[pos] == ']') { pos++; return true; }
+            while (true) {
+                JsonValue value;
+                if (!parseValue(value, depth + 1)) return false;
+                out.items.push_back(std::move(value));
+                skipSpace();
+                if (pos < text.size() && text[pos] == ',') { pos++; continue; }
+                if (pos < text.size() && text[pos] == ']') { pos++; return true; }
+                return false;
+            }
+        }
+        if (c == '"') {
+            out.type = JsonValue::STRING;
+            return parseString(out.str);
+        }
+        if (literal("true")) { out.type = JsonValue::BOOL; out.boolean = true; return true; }
+        if (literal("false")) { out.type = JsonValue::BOOL; out.boolean = false; return true; }
+        if (literal("null")) { out.type = JsonValue::NUL; return true; }
+
+        const char* start = text.c_str() + pos;
+        char* end = nullptr;
+        out.number = strtod(start, &end);
+        if (end == start) return false;
+        out.type = JsonValue::NUMBER;
+        pos += (size_t)(end - start);
+        return true;
+    }
+
+public:
+    explicit JsonReader(const string& t) : text(t), pos(0) {}
+
+    bool parse(JsonValue& out) {
+        if (!parseValue(out, 0)) return false;
+        skipSpace();
+        return pos == text.size();
+    }
+};
+
+
+#endif
@@ -4,6 +4,9 @@
 #include <iostream>
 #include <cctype>
 #include "Node.h"
+#include "CartIndex.h"
+#include "Trace.h"
+#include "MemoryStats.h"
 using namespace std;
 
 // Case-insensitive string comparison
@@ -15,175 +18,251 @@ inline bool strEqualsIgnoreCase(const string& a, const string& b) {
     return true;
 }
 
+/**
+ * LinkedList<T, Alloc> - singly linked list with a position/handle index
+ *
+ * Nodes are T itself when T embeds a ListHook, else Node<T>. The by-name and
+ * quantity members (find, push_item, update_quantity, total_quantity) are
+ * only compiled for records that have nameRef() / getQuantity() /
+ * setQuantity() - i.e. the cart's LinkedList<Product>.
+ */
+template <typename T, typename Alloc = StateAllocator>
 class LinkedList {
+public:
+    typedef typename NodeTraits<T>::node_type node_type;
+    typedef SListIterator<T, false> iterator;
+    typedef SListIterator<T, true> const_iterator;
+    typedef NodeChain<T, Alloc> chain_type;
+
 private:
-    Node* list_head;
+    static_assert(is_base_of<ListHook<node_type>, node_type>::value,
+                  "LinkedList nodes need a ListHook (for the line index)");
+
+    OffsetPtr<node_type> list_head;
+    OffsetPtr<node_type> list_tail;   // last node, so appends and chain hand-off are O(1)
     int item_count;
+    MemoryStats mem;
+    CartIndex<node_type> index;   // position <-> node, stable handles
+
+    static T& value(node_type* node) { return NodeTraits<T>::value(*node); }
+
+    // Insert after pred (nullptr = at head); pos is the new node's 0-based position
+    uint64_t link_after(node_type* pred, const T& val, int pos, uint64_t handle = INVALID_CART_HANDLE) {
+        node_type* new_node = createNode<node_type, Alloc>(val);
+        new_node->set_next(pred == nullptr ? list_head.get() : pred->next());
+        mem.onAllocate(sizeof(node_type));
+        if (pred == nullptr) {
+            list_head = new_node;
+        } else {
+            pred->set_next(new_node);
+        }
+        if (pred == list_tail) list_tail = new_node;
+        item_count++;
+        return (handle == INVALID_CART_HANDLE) ? index.insertAt(pos, new_node)
+                                               : index.insertWithHandle(pos, new_node, handle);
+    }
+
+    // Remove the node after pred (nullptr = the head)
+    T unlink_after(node_type* pred) {
+        node_type* to_delete = (pred == nullptr) ? list_head.get() : pred->next();
+        T deleted_item = value(to_delete);
+        if (pred == nullptr) {
+            list_head = to_delete->next();
+        } else {
+            pred->set_next(to_delete->next());
+        }
+        if (to_delete == list_tail) list_tail = pred;
+        index.erase(to_delete->indexSlot());
+        mem.onFree(sizeof(node_type));
+        destroyNode<node_type, Alloc>(to_delete);
+        item_count--;
+        return deleted_item;
+    }
 
 public:
     LinkedList() {
         list_head = nullptr;
+        list_tail = nullptr;
         item_count = 0;
     }
 
     ~LinkedList() { clear(); }
 
+    LinkedList(const LinkedList&) = delete;
+    LinkedList& operator=(const LinkedList&) = delete;
+
     bool empty() const { return list_head == nullptr; }
-    Node* head() const { return list_head; }
     int size() const { return item_count; }
+    const MemoryStats& memory_stats() const { return mem; }
 
-    Product front() const {
-        if (empty()) return Product();
-        return list_head->retrieve();
+    iterator begin() { return iterator(list_head.get()); }
+    iterator end() { return iterator(); }
+    const_iterator begin() const { return const_iterator(list_head.get()); }
+    const_iterator end() const { return const_iterator(); }
+
+    T front() const {
+        if (empty()) return T();
+        return value(list_head);
     }
 
-    Product back() const {
-        if (empty()) return Product();
-        Node* ptr = list_head;
-        while (ptr->next() != nullptr) {
-            ptr = ptr->next();
-        }
-        return ptr->retrieve();
+    T back() const {
+        if (empty()) return T();
+        return value(list_tail);
     }
 
     int total_quantity() const {
         int total = 0;
-        for (Node* ptr = list_head; ptr != nullptr; ptr = ptr->next()) {
-            total += ptr->retrieve().getQuantity();
-        }
+        for (const T& line : *this) total += line.getQuantity();
         return total;
     }
 
-    Node* find(string productName) const {
-        for (Node* ptr = list_head; ptr != nullptr; ptr = ptr->next()) {
-            if (strEqualsIgnoreCase(ptr->retrieve().getName(), productName)) {
-                return ptr;
+    // First line with this name (case-insensitive), or end()
+    iterator find(const string& productName) {
+        TRACE_SCOPE("LinkedList::find");
+        METRIC_ADD(METRIC_LIST_FINDS, 1);
+        int walked = 0;
+        for (iterator it = begin(); it != end(); ++it) {
+            walked++;
+            if (it->nameRef().equalsIgnoreCase(productName)) {
+                METRIC_ADD(METRIC_LIST_NODES_WALKED, walked);
+                return it;
             }
         }
-        return nullptr;
+        METRIC_ADD(METRIC_LIST_NODES_WALKED, walked);
+        return end();
     }
 
-    Product get_at_position(int position) const {
-        if (position < 1 || position > item_count) return Product();
-        Node* ptr = list_head;
-        for (int i = 1; i < position; i++) {
-            ptr = ptr->next();
-        }
-        return ptr->retrieve();
+    // Line at position (1-indexed), or end() - O(log n) via the index
+    const_iterator line_at(int position) const {
+        return const_iterator(index.select(position - 1));
     }
 
-    void insert_at_head(Product val) {
-        Node* new_node = new Node(val, list_head);
-        list_head = new_node;
-        item_count++;
+    T get_at_position(int position) const {
+        if (position < 1 || position > item_count) return T();
+        return value(index.select(position - 1));
     }
 
-    void insert_at_tail(Product val) {
-        if (empty()) {
-            insert_at_head(val);
-            return;
-        }
-        Node* ptr = list_head;
-        while (ptr->next() != nullptr) {
-            ptr = ptr->next();
-        }
-        ptr->set_next(new Node(val, nullptr));
-        item_count++;
+    void insert_at_head(const T& val) {
+        link_after(nullptr, val, 0);
     }
 
-    void insert_at_position(Product val, int position) {
+    uint64_t insert_at_tail(const T& val) {
+        TRACE_SCOPE("LinkedList::insert_at_tail");
+        return link_after(list_tail, val, item_count);
+    }
+
+    void insert_at_position(const T& val, int position) {
         if (position < 1 || position > item_count + 1) return;
-        if (position == 1) {
-            insert_at_head(val);
-            return;
-        }
-        Node* ptr = list_head;
-        for (int i = 1; i < position - 1; i++) {
-            ptr = ptr->next();
-        }
-        Node* new_node = new Node(val, ptr->next());
-        ptr->set_next(new_node);
-        item_count++;
+        node_type* pred = (position == 1) ? nullptr : index.select(position - 2);
+        link_after(pred, val, position - 1);
     }
 
-    void push_item(Product val) {
-        Node* existing = find(val.getName());
-        if (existing != nullptr) {
-            Product updated = existing->retrieve();
-            updated.setQuantity(updated.getQuantity() + val.getQuantity());
-            existing->set_data(updated);
-            return;
+    // Add to an existing line (same name) or append a new one; returns the line's handle
+    uint64_t push_item(const T& val) {
+        iterator existing = find(val.getName());
+        if (existing != end()) {
+            existing->setQuantity(existing->getQuantity() + val.getQuantity());
+            return index.handleOf(existing.node());
         }
-        insert_at_tail(val);
+        return insert_at_tail(val);
     }
 
-    Product delete_at_head() {
-        if (empty()) return Product();
-        Node* temp = list_head;
-        Product deleted_item = temp->retrieve();
-        list_head = list_head->next();
-        delete temp;
-        item_count--;
-        return deleted_item;
+    T delete_at_head() {
+        if (empty()) return T();
+        return unlink_after(nullptr);
     }
 
-    Product delete_at_tail() {
-        if (empty()) return Product();
-        if (item_count == 1) return delete_at_head();
-        
-        Node* ptr = list_head;
-        while (ptr->next()->next() != nullptr) {
-            ptr = ptr->next();
-        }
-        Product deleted_item = ptr->next()->retrieve();
-        delete ptr->next();
-        ptr->set_next(nullptr);
-        item_count--;
-        return deleted_item;
+    T delete_at_tail() {
+        if (empty()) return T();
+        return unlink_after(index.select(item_count - 2));
     }
 
-    Product delete_at_position(int position) {
-        if (position < 1 || position > item_count) return Product();
-        if (position == 1) return delete_at_head();
-        
-        Node* ptr = list_head;
-        for (int i = 1; i < position - 1; i++) {
-            ptr = ptr->next();
-        }
-        Node* to_delete = ptr->next();
-        Product deleted_item = to_delete->retrieve();
-        ptr->set_next(to_delete->next());
-        delete to_delete;
-        item_count--;
-        return deleted_item;
+    T delete_at_position(int position) {
+        TRACE_SCOPE("LinkedList::delete_at_position");
+        if (position < 1 || position > item_count) return T();
+        return unlink_after(index.select(position - 2));
     }
 
-    bool delete_by_name(string productName) {
-        if (empty()) return false;
-        
-        if (strEqualsIgnoreCase(list_head->retrieve().getName(), productName)) {
-            delete_at_head();
-            return true;
-        }
-        
-        Node* ptr = list_head;
-        while (ptr->next() != nullptr) {
-            if (strEqualsIgnoreCase(ptr->next()->retrieve().getName(), productName)) {
-                Node* to_delete = ptr->next();
-                ptr->set_next(to_delete->next());
-                delete to_delete;
-                item_count--;
+    bool delete_by_name(const string& productName) {
+        TRACE_SCOPE("LinkedList::delete_by_name");
+        node_type* pred = nullptr;
+        for (node_type* ptr = list_head; ptr != nullptr; pred = ptr, ptr = ptr->next()) {
+            METRIC_ADD(METRIC_LIST_NODES_WALKED, 1);
+            if (value(ptr).nameRef().equalsIgnoreCase(productName)) {
+                unlink_after(pred);
                 return true;
             }
-            ptr = ptr->next();
         }
         return false;
     }
 
+    // ─── Stable line handles ─────────────────────────────────────────────────
+
+    uint64_t handle_of(const_iterator line) const { return index.handleOf(line.node()); }
+
+    // Line for a handle, or end() once it was removed - O(1)
+    iterator find_by_handle(uint64_t handle) {
+        int slot = index.slotOf(handle);
+        return (slot < 0) ? end() : iterator(index.nodeAt(slot));
+    }
+
+    // 1-indexed position of a line, or 0 - O(log n)
+    int position_of(uint64_t handle) const {
+        int slot = index.slotOf(handle);
+        return (slot < 0) ? 0 : index.rankOf(slot) + 1;
+    }
+
+    // O(1): the line stays where it is, only its payload changes
+    bool update_quantity(uint64_t handle, int quantity) {
+        iterator line = find_by_handle(handle);
+        if (line == end()) return false;
+        line->setQuantity(quantity);
+        return true;
+    }
+
+    // O(log n): finds the predecessor through the index instead of walking
+    bool delete_by_handle(uint64_t handle, T* removed = nullptr) {
+        int slot = index.slotOf(handle);
+        if (slot < 0) return false;
+        int rank = index.rankOf(slot);
+        T item = unlink_after(rank == 0 ? nullptr : index.select(rank - 1));
+        if (removed != nullptr) *removed = item;
+        return true;
+    }
+
+    // Append a line under a handle it had before (rollback); returns the handle used
+    uint64_t restore_at_tail(const T& val, uint64_t handle) {
+        return link_after(list_tail, val, item_count, handle);
+    }
+
+    const CartIndex<node_type>& line_index() const { return index; }
+
     void clear() {
-        while (!empty()) {
-            delete_at_head();
+        node_type* ptr = list_head;
+        while (ptr != nullptr) {
+            node_type* next = ptr->next();
+            mem.onFree(sizeof(node_type));
+            destroyNode<node_type, Alloc>(ptr);
+            ptr = next;
         }
+        list_head = nullptr;
+        list_tail = nullptr;
+        item_count = 0;
+        index.clear();
+    }
+
+    /**
+     * Detach every node as one chain - O(1), no copies, no frees.
+     * The list is left empty; whoever receives the chain owns the nodes.
+     */
+    chain_type release_chain() {
+        chain_type chain = {list_head, list_tail, item_count, mem.bytes};
+        mem.onRelease(item_count, mem.bytes);
+        list_head = nullptr;
+        list_tail = nullptr;
+        item_count = 0;
+        index.clear();
+        return chain;
     }
 
     void traverse() const {
@@ -193,25 +272,17 @@ public:
             return;
         }
         int pos = 1;
-        for (Node* ptr = list_head; ptr != nullptr; ptr = ptr->next()) {
-            Product p = ptr->retrieve();
-            cout << "[" << pos++ << "] " << p.getName() 
-                 << " x " << p.getQuantity() << endl;
+        for (const T& line : *this) {
+            cout << "[" << pos++ << "] " << line << endl;
         }
-        cout << "Total items: " << total_quantity() << endl;
     }
 
     void display_visual() const {
         cout << "head -> ";
-        if (empty()) {
-            cout << "NULL" << endl;
-            return;
-        }
-        for (Node* ptr = list_head; ptr != nullptr; ptr = ptr->next()) {
-            cout << "[" << ptr->retrieve().getName() << "]";
-            if (ptr->next() != nullptr) cout << " -> ";
+        for (const T& line : *this) {
+            cout << "[" << line << "] -> ";
         }
-        cout << " -> NULL" << endl;
+        cout << "NULL" << endl;
     }
 };
 
@@ -0,0 +1,53 @@
+#ifndef MEMORYSTATS_H
+#define MEMORYSTATS_H
+
+#include <string>
+using namespace std;
+
+// Heap bytes owned by a string (0 when it fits in the small-string buffer)
+inline size_t stringHeapBytes(const string& s) {
+    const char* data = s.data();
+    const char* self = reinterpret_cast<const char*>(&s);
+    if (data >= self && data < self + sizeof(string)) return 0;
+    return s.capacity() + 1;
+}
+
+/**
+ * MemoryStats - live objects / bytes of one container, with high-water marks
+ * Updated by the container on every allocation and free (O(1))
+ */
+struct MemoryStats {
+    long long live;
+    long long bytes;
+    long long peakLive;
+    long long peakBytes;
+
+    MemoryStats() : live(0), bytes(0), peakLive(0), peakBytes(0) {}
+
+    void onAllocate(size_t size) {
+        live++;
+        bytes += (long long)size;
+        if (live > peakLive) peakLive = live;
+        if (bytes > peakBytes) peakBytes = bytes;
+    }
+
+    void onFree(size_t size) {
+        live--;
+        bytes -= (long long)size;
+    }
+
+    // A whole chain of objects moved in from / out to another container (O(1))
+    void onAdopt(long long count, long long size) {
+        live += count;
+        bytes += size;
+        if (live > peakLive) peakLive = live;
+        if (bytes > peakBytes) peakBytes = bytes;
+    }
+
+    void onRelease(long long count, long long size) {
+        live -= count;
+        bytes -= size;
+    }
+};
+
+#endif
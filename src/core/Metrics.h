@@ -0,0 +1,166 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                    METRICS (compile-time switchable)
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Build with -DGROCERY_METRICS to enable. Without it every macro below expands
+ * to nothing, so a disabled build pays zero cost.
+ *
+ * - METRIC_API_SCOPE()     : call count + latency histogram of the enclosing
+ *                            function, keyed by __func__
+ * - METRIC_ADD(counter, n) : bump one of the internal operation counters
+ *
+ * Latency histograms are log-bucketed: 4 buckets per power of two of
+ * nanoseconds, so any percentile is reported within ~19% of the true value.
+ */
+
+enum MetricCounter {
+    METRIC_SORT_PASSES,         // ranking passes (sortByFrequency, top-K selection)
+    METRIC_SORT_COMPARISONS,    // items compared while ranking
+    METRIC_LIST_FINDS,          // LinkedList::find calls
+    METRIC_LIST_NODES_WALKED,   // nodes visited by list finds and positional walks
+    METRIC_NODE_ALLOCATIONS,    // Nodes allocated (cart, undo stack, queue)
+    METRIC_NODE_FREES,          // Nodes freed
+    METRIC_RESULT_STRINGS,      // malloc'd strings returned to the caller
+    METRIC_RESULT_BYTES,        // bytes in those strings
+    METRIC_STREAM_CHUNKS,       // chunks written by api_stream_next
+    METRIC_STREAM_BYTES,        // bytes in those chunks (caller-owned buffers)
+    METRIC_ITEM_EVICTIONS,      // custom items evicted from the full item store
+    METRIC_ITEM_RESTORES,       // evicted items brought back from the spill file
+    METRIC_COUNTER_COUNT
+};
+
+inline const char* metricCounterName(int counter) {
+    static const char* names[METRIC_COUNTER_COUNT] = {
+        "sort_passes",
+        "sort_comparisons",
+        "list_finds",
+        "list_nodes_walked",
+        "node_allocations",
+        "node_frees",
+        "result_strings",
+        "result_bytes",
+        "stream_chunks",
+        "stream_bytes",
+        "item_evictions",
+        "item_restores"
+    };
+    return (counter >= 0 && counter < METRIC_COUNTER_COUNT) ? names[counter] : "";
+}
+
+#ifdef GROCERY_METRICS
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+const int LATENCY_SUB_BUCKETS = 4;                       // per power of two
+const int LATENCY_BUCKETS = 40 * LATENCY_SUB_BUCKETS;    // up to 2^40 ns (~18 min)
+const int MAX_API_METRICS = 128;
+
+// Histogram bucket for a latency in nanoseconds
+inline int latencyBucket(uint64_t ns) {
+    if (ns < 2) return 0;
+#if defined(__GNUC__) || defined(__clang__)
+    int octave = 63 - __builtin_clzll(ns);
+#else
+    int octave = 0;
+    while ((ns >> (octave + 1)) != 0) octave++;
+#endif
+    int sub = (octave >= 2) ? (int)((ns >> (octave - 2)) & 3) : 0;
+    int bucket = octave * LATENCY_SUB_BUCKETS + sub;
+    return (bucket < LATENCY_BUCKETS) ? bucket : LATENCY_BUCKETS - 1;
+}
+
+// Upper bound (ns) of a histogram bucket
+inline uint64_t latencyBucketUpperNs(int bucket) {
+    int octave = bucket / LATENCY_SUB_BUCKETS;
+    int sub = bucket % LATENCY_SUB_BUCKETS;
+    if (octave < 2) return (uint64_t)2 << octave;
+    return ((uint64_t)(4 + sub + 1)) << (octave - 2);
+}
+
+struct ApiMetric {
+    const char* name;
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> totalNs;
+    std::atomic<uint64_t> buckets[LATENCY_BUCKETS];
+
+    explicit ApiMetric(const char* functionName);
+
+    void record(uint64_t ns) {
+        calls.fetch_add(1, std::memory_order_relaxed);
+        totalNs.fetch_add(ns, std::memory_order_relaxed);
+        buckets[latencyBucket(ns)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Latency (ns) below which `fraction` of the calls completed
+    uint64_t percentileNs(double fraction) const {
+        uint64_t total = calls.load(std::memory_order_relaxed);
+        if (total == 0) return 0;
+        uint64_t target = (uint64_t)(fraction * (double)total);
+        if (target >= total) target = total - 1;
+        uint64_t seen = 0;
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            seen += buckets[b].load(std::memory_order_relaxed);
+            if (seen > target) return latencyBucketUpperNs(b);
+        }
+        return latencyBucketUpperNs(LATENCY_BUCKETS - 1);
+    }
+};
+
+struct MetricsRegistry {
+    std::atomic<uint64_t> counters[METRIC_COUNTER_COUNT];
+    ApiMetric* apis[MAX_API_METRICS];
+    std::atomic<int> apiCount;
+
+    MetricsRegistry() : apiCount(0) {
+        for (int i = 0; i < METRIC_COUNTER_COUNT; i++) counters[i].store(0);
+        for (int i = 0; i < MAX_API_METRICS; i++) apis[i] = nullptr;
+    }
+};
+
+inline MetricsRegistry& metricsRegistry() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+inline ApiMetric::ApiMetric(const char* functionName) : name(functionName), calls(0), totalNs(0) {
+    for (int b = 0; b < LATENCY_BUCKETS; b++) buckets[b].store(0);
+    MetricsRegistry& registry = metricsRegistry();
+    int slot = registry.apiCount.fetch_add(1);
+    if (slot < MAX_API_METRICS) registry.apis[slot] = this;
+}
+
+// Records the lifetime of the enclosing scope into an ApiMetric
+class ApiTimer {
+private:
+    ApiMetric& metric;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit ApiTimer(ApiMetric& m) : metric(m), start(std::chrono::steady_clock::now()) {}
+    ~ApiTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        metric.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+};
+
+#define METRIC_API_SCOPE() \
+    static ApiMetric api_metric_(__func__); \
+    ApiTimer api_timer_(api_metric_)
+
+#define METRIC_ADD(counter, n) \
+    metricsRegistry().counters[counter].fetch_add((uint64_t)(n), std::memory_order_relaxed)
+
+#else
+
+#define METRIC_API_SCOPE()
+#define METRIC_ADD(counter, n) ((void)0)
+
+#endif
+
+#endif
@@ -1,33 +1,175 @@
 #ifndef NODE_H
 #define NODE_H
 
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <type_traits>
 #include "Product.h"
+#include "Metrics.h"
 
-class Node {
+// ─────────────────────────────────────────────────────────────────────────────
+//  Hooks - the link fields a record embeds to be linked without a wrapper
+// ─────────────────────────────────────────────────────────────────────────────
+
+/**
+ * SListHook<Derived> - one "next" link (enough for Stack and Queue)
+ * Copying a record never copies its links: the copy starts unlinked.
+ */
+template <typename Derived>
+class SListHook {
+private:
+    OffsetPtr<Derived> hook_next;
+
+public:
+    SListHook() : hook_next(nullptr) {}
+    SListHook(const SListHook&) : hook_next(nullptr) {}
+    SListHook& operator=(const SListHook&) { return *this; }
+
+    Derived* next() const { return hook_next; }
+    void set_next(Derived* next) { hook_next = next; }
+};
+
+/**
+ * ListHook<Derived> - next link plus the slot of the record's entry in the
+ * owning LinkedList's CartIndex (what LinkedList needs)
+ */
+template <typename Derived>
+class ListHook : public SListHook<Derived> {
+private:
+    int index_slot;    // -1 = not indexed
+
+public:
+    ListHook() : index_slot(-1) {}
+    ListHook(const ListHook& other) : SListHook<Derived>(other), index_slot(-1) {}
+    ListHook& operator=(const ListHook&) { return *this; }
+
+    int indexSlot() const { return index_slot; }
+    void setIndexSlot(int slot) { index_slot = slot; }
+};
+
+/**
+ * Node<T> - wraps a record that has no hook of its own (e.g. Product)
+ */
+template <typename T>
+class Node : public ListHook<Node<T>> {
 private:
-    Product data;
-    Node* next_node;
+    T data;
 
 public:
-    Node() {
-        data = Product();
-        next_node = nullptr;
+    explicit Node(const T& val) : data(val) {}
+
+    T retrieve() const { return data; }
+    const T& peek() const { return data; }   // read without copying
+    T& value() { return data; }
+    void set_data(const T& val) { data = val; }
+};
+
+// How a container stores T: T itself if it embeds a hook, else Node<T>
+template <typename T, bool Intrusive = is_base_of<SListHook<T>, T>::value>
+struct NodeTraits {
+    typedef Node<T> node_type;
+    static const T& value(const node_type& node) { return node.peek(); }
+    static T& value(node_type& node) { return node.value(); }
+};
+
+template <typename T>
+struct NodeTraits<T, true> {
+    typedef T node_type;
+    static const T& value(const T& node) { return node; }
+    static T& value(T& node) { return node; }
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Allocator policies - where container nodes come from
+// ─────────────────────────────────────────────────────────────────────────────
+
+// The shared segment while one is attached, else the process heap (default)
+struct StateAllocator {
+    static void* allocate(size_t bytes) { return stateAllocate(bytes); }
+    static void deallocate(void* p, size_t bytes) { stateFree(p, bytes); }
+};
+
+// Always the process heap (containers that must never enter the segment)
+struct HeapAllocator {
+    static void* allocate(size_t bytes) { return ::operator new(bytes); }
+    static void deallocate(void* p, size_t) { ::operator delete(p); }
+};
+
+// Construct / destroy one node through an allocator policy
+template <typename N, typename Alloc, typename V>
+N* createNode(const V& value) {
+    N* node = new (Alloc::allocate(sizeof(N))) N(value);
+    METRIC_ADD(METRIC_NODE_ALLOCATIONS, 1);
+    return node;
+}
+
+template <typename N, typename Alloc>
+void destroyNode(N* node) {
+    node->~N();
+    Alloc::deallocate(node, sizeof(N));
+    METRIC_ADD(METRIC_NODE_FREES, 1);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  Iterator and chains
+// ─────────────────────────────────────────────────────────────────────────────
+
+// Forward iterator over a chain of nodes, yielding T& (or const T&)
+template <typename T, bool Const>
+class SListIterator {
+public:
+    typedef typename NodeTraits<T>::node_type node_type;
+    typedef typename conditional<Const, const node_type, node_type>::type stored_node;
+    typedef forward_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef ptrdiff_t difference_type;
+    typedef typename conditional<Const, const T*, T*>::type pointer;
+    typedef typename conditional<Const, const T&, T&>::type reference;
+
+private:
+    stored_node* current;
+
+public:
+    explicit SListIterator(stored_node* node = nullptr) : current(node) {}
+    // iterator -> const_iterator
+    template <bool WasConst, typename = typename enable_if<Const && !WasConst>::type>
+    SListIterator(const SListIterator<T, WasConst>& other) : current(other.node()) {}
+
+    reference operator*() const { return NodeTraits<T>::value(*current); }
+    pointer operator->() const { return &NodeTraits<T>::value(*current); }
+
+    SListIterator& operator++() {
+        current = current->next();
+        return *this;
     }
-    
-    Node(Product val, Node* next = nullptr) {
-        data = val;
-        next_node = next;
+
+    SListIterator operator++(int) {
+        SListIterator before = *this;
+        current = current->next();
+        return before;
     }
 
-    Product retrieve() const { return data; }
-    Node* next() const { return next_node; }
+    bool operator==(const SListIterator& other) const { return current == other.current; }
+    bool operator!=(const SListIterator& other) const { return current != other.current; }
+
+    stored_node* node() const { return current; }
+};
+
+// A detached run of nodes (head ... tail), handed in O(1) between containers
+// that share an allocator policy
+template <typename T, typename Alloc = StateAllocator>
+struct NodeChain {
+    typedef typename NodeTraits<T>::node_type node_type;
+    typedef SListIterator<T, true> const_iterator;
 
-    void set_data(Product val) { data = val; }
-    void set_next(Node* next) { next_node = next; }
+    node_type* head;
+    node_type* tail;
+    int count;
+    long long bytes;   // summed footprint, moves with the nodes for MemoryStats
 
-    friend class LinkedList;
-    friend class Stack;
-    friend class Queue;
+    const_iterator begin() const { return const_iterator(head); }
+    const_iterator end() const { return const_iterator(nullptr); }
 };
 
 #endif
@@ -3,17 +3,18 @@
 
 #include <iostream>
 #include <string>
+#include "SharedMemory.h"
 using namespace std;
 
+// Name is stored inline (InlineName) so products can sit in shared memory
 class Product {
 private:
-    string name;
+    InlineName name;
     int quantity;
     int product_id;
 
 public:
     Product() {
-        name = "";
         quantity = 1;
         product_id = 0;
     }
@@ -30,9 +31,12 @@ public:
         product_id = other.product_id;
     }
 
+    Product& operator=(const Product&) = default;
+
     ~Product() {}
 
-    string getName() const { return name; }
+    string getName() const { return name.str(); }
+    const InlineName& nameRef() const { return name; }   // compare without copying
     int getQuantity() const { return quantity; }
     int getProductId() const { return product_id; }
 
@@ -0,0 +1,578 @@
+#ifndef PURCHASEHISTORY_H
+#define PURCHASEHISTORY_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "SymbolTable.h"
+using namespace std;
+
+const int HISTORY_BLOCK_ROWS = 4096;      // rows per sealed block
+const int HISTORY_COLUMNS = 4;            // timestamp, symbol, quantity, session
+
+enum HistoryColumn { HIST_TS = 0, HIST_SYMBOL = 1, HIST_QTY = 2, HIST_SESSION = 3 };
+
+// ─── Bit-packed columns ──────────────────────────────────────────────────────
+//
+// A column is stored as: first (int64), base (int64), width (uint8), then
+// every value as (v - base) in `width` bits (frame of reference). Delta
+// columns store differences to the previous row (first row: 0) and rebuild
+// values from `first` by a running sum. Fixed widths make decoding a
+// branch-free loop of unaligned 64-bit loads (blocks end with 8 bytes of
+// padding), and give non-delta columns O(1) access to any row.
+
+const int HISTORY_COLUMN_HEADER = 17;
+
+inline void packColumn(vector<uint8_t>& out, const int64_t* v, int n, int64_t first) {
+    int64_t lo = v[0], hi = v[0];
+    for (int i = 1; i < n; i++) {
+        lo = (v[i] < lo) ? v[i] : lo;
+        hi = (v[i] > hi) ? v[i] : hi;
+    }
+    uint64_t range = (uint64_t)hi - (uint64_t)lo;
+    int width = 0;
+    while (width < 64 && (range >> width) != 0) width++;
+    if (width > 56) width = 64;     // too wide for one unaligned load: whole words
+
+    size_t at = out.size();
+    out.resize(at + HISTORY_COLUMN_HEADER);
+    memcpy(&out[at], &first, 8);
+    memcpy(&out[at + 8], &lo, 8);
+    out[at + 16] = (uint8_t)width;
+
+    at = out.size();
+    out.resize(at + ((size_t)n * width + 7) / 8, 0);
+    for (int i = 0; i < n; i++) {
+        uint64_t x = (uint64_t)v[i] - (uint64_t)lo;
+        if (width == 64) {
+            memcpy(&out[at + (size_t)i * 8], &x, 8);
+            continue;
+        }
+        uint64_t bit = (uint64_t)i * width;
+        int shift = (int)(bit & 7);
+        x <<= shift;
+        for (int k = 0; k * 8 < width + shift; k++) out[at + (bit >> 3) + k] |= (uint8_t)(x >> (8 * k));
+    }
+}
+
+// Row i of a non-delta column
+inline int64_t columnValueAt(const uint8_t* p, int i) {
+    int64_t base;
+    memcpy(&base, p + 8, 8);
+    int width = p[16];
+    p += HISTORY_COLUMN_HEADER;
+    uint64_t x;
+    if (width == 64) {
+        memcpy(&x, p + (size_t)i * 8, 8);
+        return (int64_t)(x + (uint64_t)base);
+    }
+    uint64_t bit = (uint64_t)i * width;
+    memcpy(&x, p + (bit >> 3), 8);
+    return base + (int64_t)((x >> (bit & 7)) & ((1ULL << width) - 1));
+}
+
+// Decode n values of the column at p into out; returns the end of the column
+template <typename T>
+inline const uint8_t* unpackColumn(const uint8_t* p, int n, bool delta, T* out) {
+    int64_t first, base;
+    memcpy(&first, p, 8);
+    memcpy(&base, p + 8, 8);
+    int width = p[16];
+    p += HISTORY_COLUMN_HEADER;
+
+    if (width == 64) {
+        int64_t running = first;
+        for (int i = 0; i < n; i++) {
+            uint64_t x;
+            memcpy(&x, p + (size_t)i * 8, 8);
+            int64_t v = (int64_t)(x + (uint64_t)base);
+            running = delta ? running + v : v;
+            out[i] = (T)running;
+        }
+        return p + (size_t)n * 8;
+    }
+
+    uint64_t mask = (1ULL << width) - 1;
+    if (delta) {
+        int64_t running = first;
+        for (int i = 0; i < n; i++) {
+            uint64_t bit = (uint64_t)i * width, word;
+            memcpy(&word, p + (bit >> 3), 8);
+            running += base + (int64_t)((word >> (bit & 7)) & mask);
+            out[i] = (T)running;
+        }
+    } else {
+        for (int i = 0; i < n; i++) {
+            uint64_t bit = (uint64_t)i * width, word;
+            memcpy(&word, p + (bit >> 3), 8);
+            out[i] = (T)(base + (int64_t)((word >> (bit & 7)) & mask));
+        }
+    }
+    return p + ((size_t)n * width + 7) / 8;
+}
+
+/**
+ * One sealed block: HISTORY_BLOCK_ROWS rows (fewer for the last block of a
+ * loaded file), each column bit-packed separately in `data`:
+ *   timestamp : offset from the block's minTs
+ *   symbol    : value
+ *   quantity  : value
+ *   session   : delta to the previous row
+ * minTs/maxTs and symbolMask (bit symbol % 256) let scans skip whole blocks.
+ */
+struct HistoryBlock {
+    int rows;
+    int64_t minTs;
+    int64_t maxTs;
+    uint64_t symbolMask[4];
+    uint32_t columnOffset[HISTORY_COLUMNS + 1];
+    vector<uint8_t> data;
+
+    bool mayContain(uint32_t symbol) const {
+        return (symbolMask[(symbol & 255) >> 6] >> (symbol & 63)) & 1;
+    }
+};
+
+// Blocks visited / skipped by the last query (shows how well zone maps prune)
+struct HistoryScanStats {
+    long long blocksScanned;
+    long long blocksSkipped;
+    long long rowsScanned;
+};
+
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                    PURCHASE HISTORY (Append-only Columnar Store)
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Every checkout line becomes a row (timestamp, item symbol, quantity,
+ * session). Rows collect in an uncompressed open block; every
+ * HISTORY_BLOCK_ROWS rows the block is sealed into delta-encoded,
+ * bit-packed columns (typically 2-4 bytes per row instead of 24).
+ *
+ * Queries decode only the columns they need, one block at a time, into
+ * fixed scratch arrays and run branch-free loops over them:
+ * - blocks outside [from, to) are skipped by their min/max timestamp
+ * - per-item queries also skip blocks whose symbol mask lacks the item
+ * - blocks fully inside the range never decode the timestamp column
+ * - per-item queries decode only the symbol column and read the timestamp
+ *   and quantity of matching rows in place
+ */
+class PurchaseHistory {
+private:
+    vector<HistoryBlock> sealed;
+
+    // Open (uncompressed) block
+    vector<int64_t> openTs;
+    vector<uint32_t> openSymbol;
+    vector<int32_t> openQty;
+    vector<uint32_t> openSession;
+
+    uint32_t nextSession;
+    long long totalRows;
+    mutable HistoryScanStats lastScan;
+
+    // Decode scratch (one block at a time)
+    mutable int64_t scratchTs[HISTORY_BLOCK_ROWS];
+    mutable uint32_t scratchSymbol[HISTORY_BLOCK_ROWS];
+    mutable int32_t scratchQty[HISTORY_BLOCK_ROWS];
+
+    static HistoryBlock encode(const int64_t* ts, const uint32_t* symbol, const int32_t* qty,
+                               const uint32_t* session, int rows) {
+        HistoryBlock block;
+        block.rows = rows;
+        block.minTs = ts[0];
+        block.maxTs = ts[0];
+        memset(block.symbolMask, 0, sizeof(block.symbolMask));
+        vector<int64_t> values(rows);
+
+        for (int i = 0; i < rows; i++) {
+            if (ts[i] < block.minTs) block.minTs = ts[i];
+            if (ts[i] > block.maxTs) block.maxTs = ts[i];
+        }
+        block.columnOffset[HIST_TS] = 0;
+        packColumn(block.data, ts, rows, 0);
+
+        for (int i = 0; i < rows; i++) {
+            values[i] = symbol[i];
+            block.symbolMask[(symbol[i] & 255) >> 6] |= 1ULL << (symbol[i] & 63);
+        }
+        block.columnOffset[HIST_SYMBOL] = (uint32_t)block.data.size();
+        packColumn(block.data, values.data(), rows, 0);
+
+        for (int i = 0; i < rows; i++) values[i] = qty[i];
+        block.columnOffset[HIST_QTY] = (uint32_t)block.data.size();
+        packColumn(block.data, values.data(), rows, 0);
+
+        for (int i = 0; i < rows; i++) values[i] = (i > 0) ? (int64_t)session[i] - session[i - 1] : 0;
+        block.columnOffset[HIST_SESSION] = (uint32_t)block.data.size();
+        packColumn(block.data, values.data(), rows, session[0]);
+
+        block.data.resize(block.data.size() + 8, 0);    // padding for the last unaligned load
+        block.columnOffset[HISTORY_COLUMNS] = (uint32_t)block.data.size();
+        block.data.shrink_to_fit();
+        return block;
+    }
+
+    void sealOpenBlock() {
+        if (openTs.empty()) return;
+        sealed.push_back(encode(openTs.data(), openSymbol.data(), openQty.data(),
+                                openSession.data(), (int)openTs.size()));
+        openTs.clear();
+        openSymbol.clear();
+        openQty.clear();
+        openSession.clear();
+    }
+
+    void decodeTs(const HistoryBlock& b) const {
+        unpackColumn(b.data.data() + b.columnOffset[HIST_TS], b.rows, false, scratchTs);
+    }
+
+    void decodeSymbols(const HistoryBlock& b) const {
+        unpackColumn(b.data.data() + b.columnOffset[HIST_SYMBOL], b.rows, false, scratchSymbol);
+    }
+
+    void decodeQty(const HistoryBlock& b) const {
+        unpackColumn(b.data.data() + b.columnOffset[HIST_QTY], b.rows, false, scratchQty);
+    }
+
+    void decodeSessions(const HistoryBlock& b, uint32_t* out) const {
+        unpackColumn(b.data.data() + b.columnOffset[HIST_SESSION], b.rows, true, out);
+    }
+
+    // ─── Scan kernels (branch-free inner loops) ─────────────────────────────
+
+    // Block fully inside the range: decode symbol and quantity in one pass
+    static void sumAll(const uint8_t* symbolColumn, const uint8_t* qtyColumn, int n, long long* acc) {
+        int64_t symbolBase, qtyBase;
+        memcpy(&symbolBase, symbolColumn + 8, 8);
+        memcpy(&qtyBase, qtyColumn + 8, 8);
+        int symbolWidth = symbolColumn[16], qtyWidth = qtyColumn[16];
+        if (symbolWidth == 64 || qtyWidth == 64) {
+            for (int i = 0; i < n; i++) acc[columnValueAt(symbolColumn, i)] += columnValueAt(qtyColumn, i);
+            return;
+        }
+        const uint8_t* symbolBits = symbolColumn + HISTORY_COLUMN_HEADER;
+        const uint8_t* qtyBits = qtyColumn + HISTORY_COLUMN_HEADER;
+        uint64_t symbolMask = (1ULL << symbolWidth) - 1, qtyMask = (1ULL << qtyWidth) - 1;
+        uint64_t symbolBit = 0, qtyBit = 0;
+        for (int i = 0; i < n; i++) {
+            uint64_t s, q;
+            memcpy(&s, symbolBits + (symbolBit >> 3), 8);
+            memcpy(&q, qtyBits + (qtyBit >> 3), 8);
+            acc[symbolBase + (int64_t)((s >> (symbolBit & 7)) & symbolMask)]
+                += qtyBase + (int64_t)((q >> (qtyBit & 7)) & qtyMask);
+            symbolBit += symbolWidth;
+            qtyBit += qtyWidth;
+        }
+    }
+
+    static void sumInRange(const int64_t* ts, const uint32_t* symbol, const int32_t* qty, int n,
+                           int64_t from, int64_t to, long long* acc) {
+        for (int i = 0; i < n; i++) {
+            long long in = (ts[i] >= from) & (ts[i] < to);
+            acc[symbol[i]] += in * qty[i];
+        }
+    }
+
+    // Sealed block: one pass over the packed symbol column, compared in its
+    // packed form; timestamp and quantity are read only for matching rows
+    static void seriesPacked(const uint8_t* symbolColumn, const uint8_t* tsColumn, const uint8_t* qtyColumn,
+                             int n, uint32_t target, int64_t from, int64_t to, int64_t bucketSeconds,
+                             long long* out) {
+        int64_t symbolBase;
+        memcpy(&symbolBase, symbolColumn + 8, 8);
+        int width = symbolColumn[16];
+        if ((int64_t)target < symbolBase) return;
+        uint64_t packed = (uint64_t)((int64_t)target - symbolBase);
+        if (width < 64 && (packed >> width) != 0) return;   // above every symbol in the block
+        const uint8_t* bits = symbolColumn + HISTORY_COLUMN_HEADER;
+        uint64_t mask = (width == 64) ? ~0ULL : (1ULL << width) - 1;
+        uint64_t bit = 0;
+        for (int i = 0; i < n; i++, bit += width) {
+            uint64_t word;
+            memcpy(&word, bits + (bit >> 3), 8);
+            if (((word >> (bit & 7)) & mask) != packed) continue;
+            int64_t ts = columnValueAt(tsColumn, i);
+            if (ts < from || ts >= to) continue;
+            out[(size_t)((ts - from) / bucketSeconds)] += columnValueAt(qtyColumn, i);
+        }
+    }
+
+    static void seriesKernel(const int64_t* ts, const uint32_t* symbol, const int32_t* qty, int n,
+                             uint32_t target, int64_t from, int64_t to, int64_t bucketSeconds,
+                             long long* out) {
+        for (int i = 0; i < n; i++) {
+            long long hit = (symbol[i] == target) & (ts[i] >= from) & (ts[i] < to);
+            int64_t bucket = hit ? (ts[i] - from) / bucketSeconds : 0;
+            out[bucket] += hit * qty[i];
+        }
+    }
+
+    // Column headers and sizes of a block read from disk fit inside its data
+    static bool validBlock(const HistoryBlock& b) {
+        for (int c = 0; c < HISTORY_COLUMNS; c++) {
+            size_t at = b.columnOffset[c];
+            size_t limit = b.columnOffset[c + 1] - (c == HISTORY_COLUMNS - 1 ? 8 : 0);
+            if (b.columnOffset[c + 1] < b.columnOffset[c] + 8 || at + HISTORY_COLUMN_HEADER > limit) return false;
+            int width = b.data[at + 16];
+            if (width > 64 || (width > 56 && width < 64)) return false;
+            if (at + HISTORY_COLUMN_HEADER + ((size_t)b.rows * width + 7) / 8 > limit) return false;
+        }
+        return b.columnOffset[HIST_TS] == 0;
+    }
+
+    bool overlaps(int64_t minTs, int64_t maxTs, int64_t from, int64_t to) const {
+        return maxTs >= from && minTs < to;
+    }
+
+public:
+    PurchaseHistory() : nextSession(1), totalRows(0) {
+        lastScan = {0, 0, 0};
+    }
+
+    // New session id for the rows of one checkout
+    uint32_t beginSession() { return nextSession++; }
+
+    void append(int64_t ts, uint32_t symbol, int32_t quantity, uint32_t session) {
+        if (openTs.capacity() == 0) {
+            openTs.reserve(HISTORY_BLOCK_ROWS);
+            openSymbol.reserve(HISTORY_BLOCK_ROWS);
+            openQty.reserve(HISTORY_BLOCK_ROWS);
+            openSession.reserve(HISTORY_BLOCK_ROWS);
+        }
+        openTs.push_back(ts);
+        openSymbol.push_back(symbol);
+        openQty.push_back(quantity);
+        openSession.push_back(session);
+        totalRows++;
+        if ((int)openTs.size() == HISTORY_BLOCK_ROWS) sealOpenBlock();
+    }
+
+    /**
+     * Total quantity per symbol over [from, to)
+     * acc is resized to symbolCount and zeroed first
+     */
+    void sumBySymbol(int64_t from, int64_t to, uint32_t symbolCount, vector<long long>& acc) const {
+        acc.assign(symbolCount, 0);
+        lastScan = {0, 0, 0};
+        for (const HistoryBlock& b : sealed) {
+            if (!overlaps(b.minTs, b.maxTs, from, to)) {
+                lastScan.blocksSkipped++;
+                continue;
+            }
+            lastScan.blocksScanned++;
+            lastScan.rowsScanned += b.rows;
+            if (b.minTs >= from && b.maxTs < to) {
+                sumAll(b.data.data() + b.columnOffset[HIST_SYMBOL], b.data.data() + b.columnOffset[HIST_QTY],
+                       b.rows, acc.data());
+            } else {
+                decodeSymbols(b);
+                decodeQty(b);
+                decodeTs(b);
+                sumInRange(scratchTs, scratchSymbol, scratchQty, b.rows, from, to, acc.data());
+            }
+        }
+        if (!openTs.empty()) {
+            lastScan.blocksScanned++;
+            lastScan.rowsScanned += (long long)openTs.size();
+            sumInRange(openTs.data(), openSymbol.data(), openQty.data(), (int)openTs.size(),
+                       from, to, acc.data());
+        }
+    }
+
+    /**
+     * Quantity of one symbol per bucket of bucketSeconds over [from, to)
+     * out[i] covers [from + i*bucketSeconds, from + (i+1)*bucketSeconds)
+     * Blocks outside the range or without the symbol are skipped; in the
+     * others every row's symbol is read, so a popular item costs O(rows).
+     */
+    void seriesFor(uint32_t symbol, int64_t from, int64_t to, int64_t bucketSeconds,
+                   vector<long long>& out) const {
+        lastScan = {0, 0, 0};
+        if (bucketSeconds <= 0 || to <= from) {
+            out.clear();
+            return;
+        }
+        out.assign((size_t)((to - from + bucketSeconds - 1) / bucketSeconds), 0);
+        for (const HistoryBlock& b : sealed) {
+            if (!overlaps(b.minTs, b.maxTs, from, to) || !b.mayContain(symbol)) {
+                lastScan.blocksSkipped++;
+                continue;
+            }
+            lastScan.blocksScanned++;
+            lastScan.rowsScanned += b.rows;
+            seriesPacked(b.data.data() + b.columnOffset[HIST_SYMBOL], b.data.data() + b.columnOffset[HIST_TS],
+                         b.data.data() + b.columnOffset[HIST_QTY], b.rows, symbol, from, to, bucketSeconds,
+                         out.data());
+        }
+        if (!openTs.empty()) {
+            lastScan.blocksScanned++;
+            lastScan.rowsScanned += (long long)openTs.size();
+            seriesKernel(openTs.data(), openSymbol.data(), openQty.data(), (int)openTs.size(),
+                         symbol, from, to, bucketSeconds, out.data());
+        }
+    }
+
+    // Visit every row with timestamp >= from, oldest block first: fn(ts, symbol, quantity)
+    template <typename Fn>
+    void forEachRow(int64_t from, Fn fn) const {
+        for (const HistoryBlock& b : sealed) {
+            if (b.maxTs < from) continue;
+            decodeTs(b);
+            decodeSymbols(b);
+            decodeQty(b);
+            for (int i = 0; i < b.rows; i++) {
+                if (scratchTs[i] >= from) fn(scratchTs[i], scratchSymbol[i], scratchQty[i]);
+            }
+        }
+        for (size_t i = 0; i < openTs.size(); i++) {
+            if (openTs[i] >= from) fn(openTs[i], openSymbol[i], openQty[i]);
+        }
+    }
+
+    const HistoryScanStats& lastScanStats() const { return lastScan; }
+    long long rows() const { return totalRows; }
+    int sealedBlocks() const { return (int)sealed.size(); }
+
+    size_t compressedBytes() const {
+        size_t total = 0;
+        for (const HistoryBlock& b : sealed) total += b.data.size();
+        return total;
+    }
+
+    size_t memoryBytes() const {
+        size_t total = sealed.capacity() * sizeof(HistoryBlock);
+        for (const HistoryBlock& b : sealed) total += b.data.capacity();
+        total += openTs.capacity() * sizeof(int64_t) + openSymbol.capacity() * sizeof(uint32_t)
+               + openQty.capacity() * sizeof(int32_t) + openSession.capacity() * sizeof(uint32_t);
+        return total;
+    }
+
+    void clear() {
+        sealed.clear();
+        openTs.clear();
+        openSymbol.clear();
+        openQty.clear();
+        openSession.clear();
+        totalRows = 0;
+        nextSession = 1;
+    }
+
+    // ─── Persistence (binary file: symbol names + encoded blocks) ───────────
+
+    bool save(const char* path, const SymbolTable& symbols) const {
+        string tmp = string(path) + ".tmp";
+        FILE* f = fopen(tmp.c_str(), "wb");
+        if (f == nullptr) return false;
+
+        uint32_t symbolCount = symbols.size();
+        fwrite("GRHIST01", 1, 8, f);
+        fwrite(&symbolCount, sizeof(symbolCount), 1, f);
+        for (uint32_t s = 0; s < symbolCount; s++) {
+            uint32_t len = (uint32_t)symbols.name(s).size();
+            fwrite(&len, sizeof(len), 1, f);
+            fwrite(symbols.name(s).data(), 1, len, f);
+        }
+        fwrite(&nextSession, sizeof(nextSession), 1, f);
+
+        // The open block is written encoded, like a sealed one
+        HistoryBlock open;
+        bool hasOpen = !openTs.empty();
+        if (hasOpen) {
+            open = encode(openTs.data(), openSymbol.data(), openQty.data(), openSession.data(),
+                          (int)openTs.size());
+        }
+        uint32_t blockCount = (uint32_t)sealed.size() + (hasOpen ? 1 : 0);
+        fwrite(&blockCount, sizeof(blockCount), 1, f);
+        for (uint32_t i = 0; i < blockCount; i++) {
+            const HistoryBlock& b = (i < sealed.size()) ? sealed[i] : open;
+            uint32_t dataLen = (uint32_t)b.data.size();
+            fwrite(&b.rows, sizeof(b.rows), 1, f);
+            fwrite(&b.minTs, sizeof(b.minTs), 1, f);
+            fwrite(&b.maxTs, sizeof(b.maxTs), 1, f);
+            fwrite(b.symbolMask, sizeof(b.symbolMask), 1, f);
+            fwrite(b.columnOffset, sizeof(b.columnOffset), 1, f);
+            fwrite(&dataLen, sizeof(dataLen), 1, f);
+            fwrite(b.data.data(), 1, dataLen, f);
+        }
+        bool ok = (ferror(f) == 0);
+        ok = (fclose(f) == 0) && ok;
+        return ok && rename(tmp.c_str(), path) == 0;
+    }
+
+    /**
+     * Replace the history with a saved file. Symbols are interned into
+     * `symbols`; blocks are re-encoded only if their ids change.
+     */
+    bool load(const char* path, SymbolTable& symbols) {
+        FILE* f = fopen(path, "rb");
+        if (f == nullptr) return false;
+
+        char magic[8];
+        uint32_t symbolCount = 0;
+        bool ok = fread(magic, 1, 8, f) == 8 && memcmp(magic, "GRHIST01", 8) == 0
+               && fread(&symbolCount, sizeof(symbolCount), 1, f) == 1;
+        vector<uint32_t> remap;
+        bool identity = true;
+        for (uint32_t s = 0; ok && s < symbolCount; s++) {
+            uint32_t len = 0;
+            ok = fread(&len, sizeof(len), 1, f) == 1 && len < (1u << 20);
+            string name(ok ? len : 0, '\0');
+            ok = ok && fread(&name[0], 1, len, f) == len;
+            if (!ok) break;
+            remap.push_back(symbols.intern(name));
+            identity = identity && remap.back() == s;
+        }
+
+        vector<HistoryBlock> blocks;
+        uint32_t session = 1, blockCount = 0;
+        long long rowCount = 0;
+        ok = ok && fread(&session, sizeof(session), 1, f) == 1
+                && fread(&blockCount, sizeof(blockCount), 1, f) == 1;
+        for (uint32_t i = 0; ok && i < blockCount; i++) {
+            HistoryBlock b;
+            uint32_t dataLen = 0;
+            ok = fread(&b.rows, sizeof(b.rows), 1, f) == 1
+              && fread(&b.minTs, sizeof(b.minTs), 1, f) == 1
+              && fread(&b.maxTs, sizeof(b.maxTs), 1, f) == 1
+              && fread(b.symbolMask, sizeof(b.symbolMask), 1, f) == 1
+              && fread(b.columnOffset, sizeof(b.columnOffset), 1, f) == 1
+              && fread(&dataLen, sizeof(dataLen), 1, f) == 1
+              && b.rows > 0 && b.rows <= HISTORY_BLOCK_ROWS
+              && b.columnOffset[HISTORY_COLUMNS] == dataLen;
+            if (!ok) break;
+            b.data.resize(dataLen);
+            ok = fread(b.data.data(), 1, dataLen, f) == dataLen && validBlock(b);
+            rowCount += b.rows;
+            blocks.push_back(std::move(b));
+        }
+        fclose(f);
+        if (!ok) return false;
+
+        if (!identity) {
+            vector<uint32_t> sessionIds(HISTORY_BLOCK_ROWS);
+            for (HistoryBlock& b : blocks) {
+                decodeTs(b);
+                decodeSymbols(b);
+                decodeQty(b);
+                decodeSessions(b, sessionIds.data());
+                for (int r = 0; r < b.rows; r++) {
+                    if (scratchSymbol[r] >= remap.size()) return false;
+                    scratchSymbol[r] = remap[scratchSymbol[r]];
+                }
+                b = encode(scratchTs, scratchSymbol, scratchQty, sessionIds.data(), b.rows);
+            }
+        }
+
+        clear();
+        sealed = std::move(blocks);
+        totalRows = rowCount;
+        nextSession = session;
+        return true;
+    }
+};
+
+#endif
@@ -3,13 +3,27 @@
 
 #include <iostream>
 #include "Node.h"
+#include "MemoryStats.h"
 using namespace std;
 
+/**
+ * Queue<T, Alloc> - FIFO over singly linked nodes
+ * Nodes are T itself when T embeds an SListHook, else Node<T>.
+ * Iteration runs front -> rear.
+ */
+template <typename T, typename Alloc = StateAllocator>
 class Queue {
+public:
+    typedef typename NodeTraits<T>::node_type node_type;
+    typedef SListIterator<T, false> iterator;
+    typedef SListIterator<T, true> const_iterator;
+    typedef NodeChain<T, Alloc> chain_type;
+
 private:
-    Node* queue_front;
-    Node* queue_rear;
+    OffsetPtr<node_type> queue_front;
+    OffsetPtr<node_type> queue_rear;
     int queue_size;
+    MemoryStats mem;
 
 public:
     Queue() {
@@ -19,23 +33,32 @@ public:
     }
     ~Queue() { clear(); }
 
+    Queue(const Queue&) = delete;
+    Queue& operator=(const Queue&) = delete;
+
     bool empty() const { return queue_front == nullptr; }
     int size() const { return queue_size; }
-    Node* front_node() const { return queue_front; }
+    const MemoryStats& memory_stats() const { return mem; }
 
-    Product front() const {
-        if (empty()) return Product();
-        return queue_front->retrieve();
+    iterator begin() { return iterator(queue_front.get()); }
+    iterator end() { return iterator(); }
+    const_iterator begin() const { return const_iterator(queue_front.get()); }
+    const_iterator end() const { return const_iterator(); }
+
+    T front() const {
+        if (empty()) return T();
+        return NodeTraits<T>::value(*queue_front);
     }
 
-    Product rear() const {
-        if (empty()) return Product();
-        return queue_rear->retrieve();
+    T rear() const {
+        if (empty()) return T();
+        return NodeTraits<T>::value(*queue_rear);
     }
 
-    void enqueue(Product val) {
-        Node* new_node = new Node(val, nullptr);
-        
+    void enqueue(const T& val) {
+        node_type* new_node = createNode<node_type, Alloc>(val);
+        mem.onAllocate(sizeof(node_type));
+
         if (empty()) {
             queue_front = new_node;
             queue_rear = new_node;
@@ -46,33 +69,52 @@ public:
         queue_size++;
     }
 
-    Product dequeue() {
-        if (empty()) return Product();
-        
-        Node* temp = queue_front;
-        Product dequeued_item = temp->retrieve();
-        queue_front = queue_front->next();
-        
+    T dequeue() {
+        if (empty()) return T();
+
+        node_type* temp = queue_front;
+        T dequeued_item = NodeTraits<T>::value(*temp);
+        queue_front = temp->next();
+
         if (queue_front == nullptr) {
             queue_rear = nullptr;
         }
-        
-        delete temp;
+
+        mem.onFree(sizeof(node_type));
+        destroyNode<node_type, Alloc>(temp);
         queue_size--;
         return dequeued_item;
     }
 
     void clear() {
-        while (!empty()) {
-            dequeue();
+        node_type* ptr = queue_front;
+        while (ptr != nullptr) {
+            node_type* next = ptr->next();
+            mem.onFree(sizeof(node_type));
+            destroyNode<node_type, Alloc>(ptr);
+            ptr = next;
+        }
+        queue_front = nullptr;
+        queue_rear = nullptr;
+        queue_size = 0;
+    }
+
+    // Link a detached chain (e.g. LinkedList::release_chain) behind the rear - O(1)
+    void append_chain(const chain_type& chain) {
+        if (chain.head == nullptr) return;
+        if (empty()) {
+            queue_front = chain.head;
+        } else {
+            queue_rear->set_next(chain.head);
         }
+        queue_rear = chain.tail;
+        queue_size += chain.count;
+        mem.onAdopt(chain.count, chain.bytes);
     }
 
     int calculate_total_quantity() const {
         int total = 0;
-        for (Node* ptr = queue_front; ptr != nullptr; ptr = ptr->next()) {
-            total += ptr->retrieve().getQuantity();
-        }
+        for (const T& line : *this) total += line.getQuantity();
         return total;
     }
 
@@ -83,25 +125,18 @@ public:
             return;
         }
         cout << "FRONT -> ";
-        for (Node* ptr = queue_front; ptr != nullptr; ptr = ptr->next()) {
-            cout << "[" << ptr->retrieve().getName() << " x" << ptr->retrieve().getQuantity() << "]";
-            if (ptr->next() != nullptr) cout << " -> ";
+        for (const T& line : *this) {
+            cout << "[" << line << "] ";
         }
-        cout << " <- REAR" << endl;
-        cout << "Total Items: " << calculate_total_quantity() << endl;
+        cout << "<- REAR" << endl;
     }
 
     void display_visual() const {
         cout << "FRONT -> ";
-        if (empty()) {
-            cout << "NULL" << endl;
-            return;
-        }
-        for (Node* ptr = queue_front; ptr != nullptr; ptr = ptr->next()) {
-            cout << "[" << ptr->retrieve().getName() << "]";
-            if (ptr->next() != nullptr) cout << " -> ";
+        for (const T& line : *this) {
+            cout << "[" << line << "] ";
         }
-        cout << " <- REAR" << endl;
+        cout << "<- REAR" << endl;
     }
 };
 
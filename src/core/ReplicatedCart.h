@@ -0,0 +1,603 @@
+#ifndef REPLICATEDCART_H
+#define REPLICATEDCART_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "SharedMemory.h"
+#include "Array.h"
+using namespace std;
+
+// First field of every encoded delta
+#define CART_DELTA_MAGIC "GCD1"
+
+// Tombstones kept before the oldest half is collected
+const int CART_TOMBSTONE_LIMIT = 1024;
+
+// One change event: the seq-th change made by a replica
+struct CartDot {
+    uint32_t replica;
+    uint32_t seq;
+};
+
+/**
+ * One replica's contribution to one cart line: how many it added and
+ * removed in total (a PN-counter cell), as of its change `seq`. A removed
+ * cell stays as a tombstone (live = false) so the removal can be sent on.
+ */
+struct CartEntry {
+    uint32_t replica;
+    uint32_t seq;
+    int32_t added;
+    int32_t removed;
+    uint64_t version;   // local version of the last change to this entry
+    int next;           // next entry of the same line, or of the free list (-1 = none)
+    bool live;
+};
+
+struct CartLineState {
+    InlineName name;
+    uint64_t version;   // newest entry version
+    int head;           // first entry (-1 = none)
+    bool used;
+};
+
+// A parsed delta, before it is applied
+struct CartDeltaLine {
+    string name;
+    vector<CartEntry> adds;
+    vector<CartDot> removes;
+};
+
+struct CartDelta {
+    uint32_t sender;
+    uint32_t epoch;     // replica id of the store the sender last synced with
+    uint64_t since;     // that store's version at the sender's last sync
+    uint32_t through;   // sender's own seqs covered by the delta (0 = none)
+    vector<CartDeltaLine> lines;
+};
+
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                    REPLICATED CART (OR-set of PN-counter lines)
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * The cart as a CRDT, so a device can keep editing while offline and merge
+ * later, and two devices editing the same cart converge without a lock.
+ *
+ * - A line is an observed-remove set element keyed by its folded name.
+ * - Its quantity is a PN-counter: each replica keeps one (added, removed)
+ *   cell per line, and the quantity is the sum of added - removed over the
+ *   live cells. A replica only ever grows its own cell, tagging it with a
+ *   new dot (replica, seq).
+ * - Removing a line tombstones the cells it has seen. A concurrent add
+ *   from another replica carries a dot the removal never saw, so it
+ *   survives - add wins.
+ * - Every dot applied is recorded in a causal context (per-replica
+ *   contiguous seq plus a small cloud of out-of-order dots), so a
+ *   re-delivered or stale add is ignored. Merging is idempotent.
+ *
+ * DELTAS: tab-separated text, one record per line
+ *   GCD1 <sender> <epoch> <since>          header (0 0 = first sync)
+ *   L <name>                               following records are for this line
+ *   + <replica> <seq> <added> <removed>    live cell
+ *   - <replica> <seq>                      removed cell
+ *   C <seq>                                the sender's changes up to seq
+ *                                          are all in this delta
+ *
+ * Every change bumps `version` and stamps the entry and its line with it,
+ * so the changes a peer is missing are the lines with a newer version than
+ * its last sync. Merging a delta touches only the lines it names - O(delta).
+ *
+ * A store's replica id doubles as its epoch: a peer that synced with
+ * another epoch, or is behind the tombstone horizon, gets the full state.
+ * Everything is kept in SegmentVectors, so the cart can live in the shared
+ * state segment with the rest of LibraryState.
+ */
+class ReplicatedCart {
+private:
+    SegmentVector<CartLineState> lines;
+    SegmentVector<int> lineSlots;       // open addressing by folded name (line + 1, 0 = free)
+    SegmentVector<int> freeLines;
+    int lineCount;
+    SegmentVector<CartEntry> entries;
+    int freeEntry;                      // head of the free entry list
+    SegmentVector<CartDot> clock;       // per replica: every seq up to this was seen
+    SegmentVector<CartDot> cloud;       // seen dots above a gap in `clock`
+    uint32_t self;
+    uint64_t version;
+    uint64_t horizon;                   // tombstones older than this were collected
+    int tombstones;
+
+    static uint32_t newReplicaId() {
+        uint64_t seed = (uint64_t)chrono::steady_clock::now().time_since_epoch().count()
+                      ^ ((uint64_t)chrono::system_clock::now().time_since_epoch().count() << 17);
+        seed ^= seed >> 33;
+        seed *= 0xff51afd7ed558ccdULL;
+        seed ^= seed >> 33;
+        uint32_t id = (uint32_t)seed;
+        return id != 0 ? id : 1;
+    }
+
+    static uint32_t keyOf(const char* s, size_t n) { return FrequentItemsArray::nameKey(s, n); }
+
+    // ── Causal context ──
+
+    int clockIndex(uint32_t replica) const {
+        for (size_t i = 0; i < clock.size(); i++) {
+            if (clock[i].replica == replica) return (int)i;
+        }
+        return -1;
+    }
+
+    bool seen(CartDot dot) const {
+        int i = clockIndex(dot.replica);
+        if (i >= 0 && dot.seq <= clock[i].seq) return true;
+        for (size_t c = 0; c < cloud.size(); c++) {
+            if (cloud[c].replica == dot.replica && cloud[c].seq == dot.seq) return true;
+        }
+        return false;
+    }
+
+    void see(CartDot dot) {
+        if (seen(dot)) return;
+        int i = clockIndex(dot.replica);
+        if (i < 0) {
+            clock.push_back(CartDot{dot.replica, 0});
+            i = (int)clock.size() - 1;
+        }
+        if (dot.seq != clock[i].seq + 1) {
+            cloud.push_back(dot);
+            return;
+        }
+        clock[i].seq = dot.seq;
+        // The gap may have closed for dots parked in the cloud
+        for (size_t c = 0; c < cloud.size();) {
+            if (cloud[c].replica == dot.replica && cloud[c].seq == clock[i].seq + 1) {
+                clock[i].seq++;
+                cloud[c] = cloud[cloud.size() - 1];
+                cloud.pop_back();
+                c = 0;
+            } else {
+                c++;
+            }
+        }
+    }
+
+    // Every seq of `replica` up to `seq` has been applied or superseded
+    void seeThrough(uint32_t replica, uint32_t seq) {
+        int i = clockIndex(replica);
+        if (i < 0) {
+            clock.push_back(CartDot{replica, 0});
+            i = (int)clock.size() - 1;
+        }
+        if (seq <= clock[i].seq) return;
+        clock[i].seq = seq;
+        for (size_t c = 0; c < cloud.size();) {
+            if (cloud[c].replica == replica && cloud[c].seq <= seq) {
+                cloud[c] = cloud[cloud.size() - 1];
+                cloud.pop_back();
+            } else {
+                c++;
+            }
+        }
+    }
+
+    CartDot nextDot() {
+        int i = clockIndex(self);
+        CartDot dot = {self, (i < 0) ? 1u : clock[i].seq + 1};
+        see(dot);
+        return dot;
+    }
+
+    // ── Line index ──
+
+    void insertSlot(int line) {
+        size_t mask = lineSlots.size() - 1;
+        size_t i = keyOf(lines[line].name.c_str(), lines[line].name.size()) & mask;
+        while (lineSlots[i] != 0) i = (i + 1) & mask;
+        lineSlots[i] = line + 1;
+    }
+
+    int addLine(const char* s, size_t n) {
+        if ((size_t)(lineCount + 1) * 2 > lineSlots.size()) {
+            lineSlots.fill(lineSlots.empty() ? 16 : lineSlots.size() * 2, 0);
+            for (size_t line = 0; line < lines.size(); line++) {
+                if (lines[line].used) insertSlot((int)line);
+            }
+        }
+        int line;
+        if (!freeLines.empty()) {
+            line = freeLines.back();
+            freeLines.pop_back();
+        } else {
+            lines.push_back(CartLineState());
+            line = (int)lines.size() - 1;
+        }
+        CartLineState& state = lines[line];
+        state.name = string(s, n);
+        state.version = 0;
+        state.head = -1;
+        state.used = true;
+        insertSlot(line);
+        lineCount++;
+        return line;
+    }
+
+    // Free a line whose entries were all collected (backward-shift deletion)
+    void dropLine(int line) {
+        size_t mask = lineSlots.size() - 1;
+        size_t hole = keyOf(lines[line].name.c_str(), lines[line].name.size()) & mask;
+        while (lineSlots[hole] != line + 1) hole = (hole + 1) & mask;
+        for (size_t j = (hole + 1) & mask; lineSlots[j] != 0; j = (j + 1) & mask) {
+            const InlineName& name = lines[lineSlots[j] - 1].name;
+            size_t home = keyOf(name.c_str(), name.size()) & mask;
+            if (((j - home) & mask) >= ((j - hole) & mask)) {
+                lineSlots[hole] = lineSlots[j];
+                hole = j;
+            }
+        }
+        lineSlots[hole] = 0;
+        lines[line].used = false;
+        lines[line].name = string();
+        freeLines.push_back(line);
+        lineCount--;
+    }
+
+    // ── Entries ──
+
+    int entryOf(int line, uint32_t replica) const {
+        for (int e = lines[line].head; e >= 0; e = entries[e].next) {
+            if (entries[e].replica == replica) return e;
+        }
+        return -1;
+    }
+
+    int newEntry(int line, uint32_t replica) {
+        CartEntry entry = {replica, 0, 0, 0, 0, lines[line].head, false};
+        int e;
+        if (freeEntry >= 0) {
+            e = freeEntry;
+            freeEntry = entries[e].next;
+            entries[e] = entry;
+        } else {
+            e = (int)entries.size();
+            entries.push_back(entry);
+        }
+        lines[line].head = e;
+        tombstones++;   // counted as live by setLive()
+        return e;
+    }
+
+    void touch(int line, int e) {
+        version++;
+        entries[e].version = version;
+        lines[line].version = version;
+    }
+
+    void setLive(int line, int e, uint32_t seq, int32_t added, int32_t removed) {
+        CartEntry& entry = entries[e];
+        if (!entry.live) tombstones--;
+        entry.seq = seq;
+        entry.added = added;
+        entry.removed = removed;
+        entry.live = true;
+        touch(line, e);
+    }
+
+    void tombstone(int line, int e, uint32_t seq) {
+        CartEntry& entry = entries[e];
+        if (entry.live) tombstones++;
+        entry.seq = seq;
+        entry.live = false;
+        touch(line, e);
+    }
+
+    /**
+     * Forget the older half of the tombstones once there are too many.
+     * Peers that synced before the newest forgotten one get a full state
+     * next time, since a delta could no longer carry those removals.
+     */
+    void collectTombstones() {
+        if (tombstones <= CART_TOMBSTONE_LIMIT) return;
+        vector<uint64_t> ages;
+        ages.reserve(tombstones);
+        for (size_t e = 0; e < entries.size(); e++) {
+            if (!entries[e].live && entries[e].seq != 0) ages.push_back(entries[e].version);
+        }
+        if (ages.empty()) return;
+        size_t half = ages.size() / 2;
+        nth_element(ages.begin(), ages.begin() + half, ages.end());
+        uint64_t cutoff = ages[half];
+
+        for (size_t line = 0; line < lines.size(); line++) {
+            if (!lines[line].used) continue;
+            int* link = &lines[line].head;
+            while (*link >= 0) {
+                int e = *link;
+                if (!entries[e].live && entries[e].version <= cutoff) {
+                    *link = entries[e].next;
+                    entries[e].seq = 0;
+                    entries[e].next = freeEntry;
+                    freeEntry = e;
+                    tombstones--;
+                } else {
+                    link = &entries[e].next;
+                }
+            }
+            if (lines[line].head < 0) dropLine((int)line);
+        }
+        if (cutoff > horizon) horizon = cutoff;
+    }
+
+    static bool parseNumber(const char*& p, const char* end, uint64_t limit, uint64_t& out) {
+        if (p >= end || *p != '\t') return false;
+        p++;
+        if (p >= end || *p < '0' || *p > '9') return false;
+        uint64_t value = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            value = value * 10 + (uint64_t)(*p - '0');
+            if (value > limit) return false;
+            p++;
+        }
+        out = value;
+        return true;
+    }
+
+    static void writeEntry(string& out, const CartEntry& entry) {
+        out += entry.live ? "+\t" : "-\t";
+        out += to_string(entry.replica);
+        out += '\t';
+        out += to_string(entry.seq);
+        if (entry.live) {
+            out += '\t';
+            out += to_string(entry.added);
+            out += '\t';
+            out += to_string(entry.removed);
+        }
+        out += '\n';
+    }
+
+public:
+    ReplicatedCart() : lineCount(0), freeEntry(-1), self(newReplicaId()), version(0), horizon(0), tombstones(0) {}
+
+    ReplicatedCart(const ReplicatedCart&) = delete;
+    ReplicatedCart& operator=(const ReplicatedCart&) = delete;
+
+    uint32_t replica() const { return self; }
+    uint64_t currentVersion() const { return version; }
+    int lineTotal() const { return lineCount; }
+    int tombstoneCount() const { return tombstones; }
+    int replicaCount() const { return (int)clock.size(); }
+
+    // Every line slot; check lineInUse() before reading one
+    int lineCapacity() const { return (int)lines.size(); }
+    bool lineInUse(int line) const { return lines[line].used; }
+    const InlineName& lineName(int line) const { return lines[line].name; }
+
+    int findLine(const char* s, size_t n) const {
+        if (lineSlots.empty()) return -1;
+        size_t mask = lineSlots.size() - 1;
+        for (size_t i = keyOf(s, n) & mask; lineSlots[i] != 0; i = (i + 1) & mask) {
+            int line = lineSlots[i] - 1;
+            if (lines[line].name.equalsIgnoreCase(s, n)) return line;
+        }
+        return -1;
+    }
+
+    // Merged quantity of a line (0 or less = not in the cart)
+    int quantity(int line) const {
+        int total = 0;
+        for (int e = lines[line].head; e >= 0; e = entries[e].next) {
+            if (entries[e].live) total += entries[e].added - entries[e].removed;
+        }
+        return total;
+    }
+
+    /**
+     * Record a local edit: line s[0..n) now holds `quantity` (0 removes it).
+     * Only this replica's own cell changes, by the difference.
+     */
+    void setQuantity(const char* s, size_t n, int quantity) {
+        collectTombstones();
+        int line = findLine(s, n);
+        if (quantity <= 0) {
+            if (line >= 0) removeLine(line);
+            return;
+        }
+        if (line < 0) line = addLine(s, n);
+        int diff = quantity - this->quantity(line);
+        if (diff == 0) return;
+        int e = entryOf(line, self);
+        if (e < 0) e = newEntry(line, self);
+        int32_t added = entries[e].live ? entries[e].added : 0;
+        int32_t removed = entries[e].live ? entries[e].removed : 0;
+        if (diff > 0) added += diff; else removed -= diff;
+        setLive(line, e, nextDot().seq, added, removed);
+    }
+
+    // Tombstone every live cell of a line (observed remove)
+    void removeLine(int line) {
+        for (int e = lines[line].head; e >= 0; e = entries[e].next) {
+            if (entries[e].live) tombstone(line, e, entries[e].seq);
+        }
+    }
+
+    void clear() {
+        for (size_t line = 0; line < lines.size(); line++) {
+            if (lines[line].used) removeLine((int)line);
+        }
+    }
+
+    /**
+     * Parse an encoded delta. Nothing is applied unless the whole text is
+     * well formed; `error` says what was wrong otherwise.
+     */
+    static bool parseDelta(const char* text, CartDelta& out, string& error) {
+        const char* p = text;
+        const char* end = text + strlen(text);
+        size_t magic = strlen(CART_DELTA_MAGIC);
+        uint64_t sender, epoch, since;
+        if ((size_t)(end - p) < magic || memcmp(p, CART_DELTA_MAGIC, magic) != 0) {
+            error = "delta must start with " CART_DELTA_MAGIC;
+            return false;
+        }
+        p += magic;
+        if (!parseNumber(p, end, UINT32_MAX, sender) || !parseNumber(p, end, UINT32_MAX, epoch)
+            || !parseNumber(p, end, UINT64_MAX / 10, since) || (p < end && *p != '\n') || sender == 0) {
+            error = "bad delta header";
+            return false;
+        }
+        out.sender = (uint32_t)sender;
+        out.epoch = (uint32_t)epoch;
+        out.since = since;
+        out.through = 0;
+        out.lines.clear();
+
+        int row = 1;
+        while (p < end) {
+            p++;   // '\n'
+            row++;
+            const char* eol = (const char*)memchr(p, '\n', end - p);
+            if (eol == nullptr) eol = end;
+            if (eol == p) continue;
+            char tag = *p++;
+            uint64_t replica = 0, seq = 0, added = 0, removed = 0;
+            bool ok;
+            if (tag == 'L') {
+                ok = p < eol && *p == '\t' && eol - p > 1;
+                if (ok && (size_t)(eol - p - 1) > MAX_ITEM_NAME_BYTES) {
+                    error = "name longer than " + to_string(MAX_ITEM_NAME_BYTES) + " bytes on line " + to_string(row);
+                    return false;
+                }
+                if (ok) {
+                    out.lines.push_back(CartDeltaLine());
+                    out.lines.back().name.assign(p + 1, eol);
+                    p = eol;
+                }
+            } else if (tag == '+' || tag == '-') {
+                ok = !out.lines.empty() && parseNumber(p, eol, UINT32_MAX, replica)
+                     && parseNumber(p, eol, UINT32_MAX, seq) && replica != 0 && seq != 0;
+                if (ok && tag == '+') {
+                    ok = parseNumber(p, eol, INT32_MAX, added) && parseNumber(p, eol, INT32_MAX, removed);
+                    if (ok) {
+                        CartEntry entry = {(uint32_t)replica, (uint32_t)seq, (int32_t)added, (int32_t)removed, 0, -1, true};
+                        out.lines.back().adds.push_back(entry);
+                    }
+                } else if (ok) {
+                    out.lines.back().removes.push_back(CartDot{(uint32_t)replica, (uint32_t)seq});
+                }
+            } else if (tag == 'C') {
+                ok = parseNumber(p, eol, UINT32_MAX, seq);
+                if (ok && seq > out.through) out.through = (uint32_t)seq;
+            } else {
+                ok = false;
+            }
+            if (!ok || p != eol) {
+                error = "bad delta record on line " + to_string(row);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Merge a parsed delta. `touched` receives every line it changed, so
+     * the caller can bring its own view of those lines up to date.
+     *
+     * A delta built against another epoch (this store restarted since the
+     * sender's last sync) is not applied: its cells count edits this state
+     * may already hold. The sender gets the full state instead and resends
+     * only its unsynced edits. Returns false in that case.
+     */
+    bool apply(const CartDelta& delta, vector<int>& touched) {
+        if (delta.epoch != 0 && delta.epoch != self) return false;
+        collectTombstones();
+        for (const CartDeltaLine& incoming : delta.lines) {
+            const char* name = incoming.name.data();
+            size_t length = incoming.name.size();
+            int line = findLine(name, length);
+            uint64_t before = (line >= 0) ? lines[line].version : 0;
+
+            // Removals: tombstone the cell the sender saw, or a newer one of its replica.
+            // A removal that overtook the add it removes leaves a tombstone too, so
+            // older cells of that replica arriving later stay removed.
+            for (const CartDot& dot : incoming.removes) {
+                if (line < 0) {
+                    line = addLine(name, length);
+                    before = 0;
+                }
+                int e = entryOf(line, dot.replica);
+                if (e < 0) e = newEntry(line, dot.replica);
+                if (entries[e].seq <= dot.seq && (entries[e].live || entries[e].seq < dot.seq)) {
+                    tombstone(line, e, dot.seq);
+                }
+                see(dot);
+            }
+            // Adds: skip what was already seen (and possibly removed since)
+            for (const CartEntry& cell : incoming.adds) {
+                CartDot dot = {cell.replica, cell.seq};
+                if (seen(dot)) continue;
+                see(dot);
+                if (line < 0) {
+                    line = addLine(name, length);
+                    before = 0;
+                }
+                int e = entryOf(line, cell.replica);
+                if (e >= 0 && entries[e].seq > cell.seq) continue;
+                if (e < 0) e = newEntry(line, cell.replica);
+                setLive(line, e, cell.seq, cell.added, cell.removed);
+            }
+            if (line >= 0 && lines[line].version != before && (before != 0 || quantity(line) > 0)) {
+                touched.push_back(line);
+            }
+        }
+        // A sender only sends the newest dot of each cell; the older ones are covered
+        if (delta.through != 0) seeThrough(delta.sender, delta.through);
+        return true;
+    }
+
+    /**
+     * Encode what `peer` is missing. A peer that last synced at `since`
+     * with this store (`epoch`) gets the lines changed after that, minus
+     * its own live cells; any other peer gets the full state (every live
+     * cell - the peer drops whatever else it had from other replicas).
+     */
+    void writeDelta(string& out, uint32_t peer, uint32_t epoch, uint64_t since) const {
+        bool full = epoch != self || since == 0 || since < horizon || since > version;
+        out += CART_DELTA_MAGIC "\t";
+        out += to_string(self);
+        out += '\t';
+        out += to_string(version);
+        out += full ? "\tfull\n" : "\tdelta\n";
+        for (size_t line = 0; line < lines.size(); line++) {
+            if (!lines[line].used || (!full && lines[line].version <= since)) continue;
+            bool named = false;
+            for (int e = lines[line].head; e >= 0; e = entries[e].next) {
+                const CartEntry& entry = entries[e];
+                bool wanted = full ? entry.live
+                                   : entry.version > since && !(entry.live && entry.replica == peer);
+                if (!wanted) continue;
+                if (!named) {
+                    out += "L\t";
+                    out.append(lines[line].name.c_str(), lines[line].name.size());
+                    out += '\n';
+                    named = true;
+                }
+                writeEntry(out, entry);
+            }
+        }
+    }
+
+    size_t memoryBytes() const {
+        return lines.capacity() * sizeof(CartLineState) + entries.capacity() * sizeof(CartEntry)
+             + (lineSlots.capacity() + freeLines.capacity()) * sizeof(int)
+             + (clock.capacity() + cloud.capacity()) * sizeof(CartDot);
+    }
+};
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef ROLLUPS_H
+#define ROLLUPS_H
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+using namespace std;
+
+// Counters per bucket (Space-Saving: exact until a bucket sees more items)
+const int ROLLUP_BUCKET_ITEMS = 32;
+const int ROLLUP_LEVELS = 3;
+
+enum RollupLevelId { ROLLUP_MINUTE = 0, ROLLUP_HOUR = 1, ROLLUP_DAY = 2 };
+
+struct RollupBucket {
+    long long index;       // bucket number (start time / bucket seconds), -1 = empty
+    int used;
+    bool overflowed;       // a counter was taken over: counts are upper bounds
+    uint32_t symbol[ROLLUP_BUCKET_ITEMS];
+    long long count[ROLLUP_BUCKET_ITEMS];
+    long long error[ROLLUP_BUCKET_ITEMS];
+
+    void reset(long long bucketIndex) {
+        index = bucketIndex;
+        used = 0;
+        overflowed = false;
+    }
+
+    void add(uint32_t item, long long quantity) {
+        for (int i = 0; i < used; i++) {
+            if (symbol[i] == item) {
+                count[i] += quantity;
+                return;
+            }
+        }
+        if (used < ROLLUP_BUCKET_ITEMS) {
+            symbol[used] = item;
+            count[used] = quantity;
+            error[used] = 0;
+            used++;
+            return;
+        }
+        // Take over the smallest counter; its count becomes the newcomer's error
+        int smallest = 0;
+        for (int i = 1; i < used; i++) {
+            if (count[i] < count[smallest]) smallest = i;
+        }
+        symbol[smallest] = item;
+        error[smallest] = count[smallest];
+        count[smallest] += quantity;
+        overflowed = true;
+    }
+};
+
+struct RollupLevel {
+    const char* name;
+    long long seconds;            // bucket width
+    int length;                   // buckets kept
+    long long newest;             // newest bucket index seen, -1 = none
+    vector<RollupBucket> ring;    // allocated on first use
+};
+
+struct RollupItem {
+    uint32_t symbol;
+    long long quantity;
+    long long error;              // overcount bound from the buckets that hold the item
+};
+
+// How a window query was answered
+struct RollupWindow {
+    int level;
+    long long from;               // start of the oldest merged bucket
+    int buckets;                  // buckets merged
+    bool exact;
+};
+
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                    PURCHASE ROLLUPS (Minute / Hour / Day Buckets)
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Per-item purchase quantities pre-aggregated into three rings of time
+ * buckets: 120 minutes, 168 hours (a week) and 400 days. Every checkout line
+ * updates the current bucket of each ring - O(levels x ROLLUP_BUCKET_ITEMS).
+ * Ring slots are recycled lazily: a slot whose index is stale is reset when
+ * it is next written, and ignored by reads.
+ *
+ * A "last W seconds" query picks the finest ring that spans W and merges its
+ * newest ceil(W / bucket) buckets, so it costs O(buckets x ROLLUP_BUCKET_ITEMS)
+ * however many purchases were made. The window is bucket-aligned: it starts
+ * at most one bucket earlier than now - W.
+ *
+ * Each bucket keeps ROLLUP_BUCKET_ITEMS Space-Saving counters. Counts are
+ * exact while no merged bucket saw more distinct items than that (the query
+ * reports `exact`); beyond it, items that sell more than 1/ROLLUP_BUCKET_ITEMS
+ * of a bucket always keep their counter, and the rest are estimates.
+ */
+class PurchaseRollups {
+private:
+    RollupLevel levels[ROLLUP_LEVELS];
+
+    // Merge scratch, indexed by symbol (reset through `touched` after each query)
+    vector<long long> mergeCount;
+    vector<long long> mergeError;
+    vector<uint32_t> touched;
+
+    static long long floorDiv(long long a, long long b) {
+        long long q = a / b;
+        return (a % b != 0 && a < 0) ? q - 1 : q;
+    }
+
+    static size_t slotOf(long long index, int length) {
+        return (size_t)(((index % length) + length) % length);
+    }
+
+    // Bucket of `level` holding time ts, or nullptr if it has left the ring
+    RollupBucket* bucketFor(RollupLevel& level, long long ts) {
+        if (level.ring.empty()) {
+            level.ring.resize(level.length);
+            for (RollupBucket& b : level.ring) b.reset(-1);
+        }
+        long long index = floorDiv(ts, level.seconds);
+        if (index > level.newest) level.newest = index;
+        if (level.newest - index >= level.length) return nullptr;
+
+        RollupBucket& slot = level.ring[slotOf(index, level.length)];
+        if (slot.index != index) {
+            if (slot.index > index) return nullptr;
+            slot.reset(index);
+        }
+        return &slot;
+    }
+
+public:
+    PurchaseRollups() {
+        levels[ROLLUP_MINUTE] = {"minute", 60, 120, -1, {}};
+        levels[ROLLUP_HOUR] = {"hour", 3600, 168, -1, {}};
+        levels[ROLLUP_DAY] = {"day", 86400, 400, -1, {}};
+    }
+
+    void record(long long ts, uint32_t symbol, long long quantity) {
+        for (int l = 0; l < ROLLUP_LEVELS; l++) {
+            RollupBucket* bucket = bucketFor(levels[l], ts);
+            if (bucket != nullptr) bucket->add(symbol, quantity);
+        }
+    }
+
+    const RollupLevel& level(int l) const { return levels[l]; }
+
+    // Longest window any ring can answer
+    long long maxWindowSeconds() const {
+        return levels[ROLLUP_DAY].seconds * levels[ROLLUP_DAY].length;
+    }
+
+    /**
+     * Top k items over the last windowSeconds before `now`
+     * Fills `out` (best first) and returns how the window was covered
+     */
+    RollupWindow topItems(long long now, long long windowSeconds, int k, vector<RollupItem>& out) {
+        windowSeconds = max(1LL, min(windowSeconds, maxWindowSeconds()));
+        int l = 0;
+        while (l < ROLLUP_LEVELS - 1 && windowSeconds > levels[l].seconds * levels[l].length) l++;
+        const RollupLevel& level = levels[l];
+
+        long long newestWanted = floorDiv(now, level.seconds);
+        long long span = (windowSeconds + level.seconds - 1) / level.seconds;
+        long long oldestWanted = newestWanted - span + 1;
+        RollupWindow window = {l, oldestWanted * level.seconds, 0, true};
+
+        out.clear();
+        if (level.ring.empty()) return window;
+        for (long long index = oldestWanted; index <= newestWanted; index++) {
+            const RollupBucket& bucket = level.ring[slotOf(index, level.length)];
+            if (bucket.index != index) continue;
+            window.buckets++;
+            window.exact = window.exact && !bucket.overflowed;
+            for (int i = 0; i < bucket.used; i++) {
+                uint32_t s = bucket.symbol[i];
+                if (s >= mergeCount.size()) {
+                    mergeCount.resize(s + 1, 0);
+                    mergeError.resize(s + 1, 0);
+                }
+                if (mergeCount[s] == 0 && mergeError[s] == 0) touched.push_back(s);
+                mergeCount[s] += bucket.count[i];
+                mergeError[s] += bucket.error[i];
+            }
+        }
+
+        for (uint32_t s : touched) out.push_back({s, mergeCount[s], mergeError[s]});
+        size_t shown = min(out.size(), (size_t)max(k, 0));
+        partial_sort(out.begin(), out.begin() + shown, out.end(), [](const RollupItem& a, const RollupItem& b) {
+            return a.quantity != b.quantity ? a.quantity > b.quantity : a.symbol < b.symbol;
+        });
+        out.resize(shown);
+
+        for (uint32_t s : touched) {
+            mergeCount[s] = 0;
+            mergeError[s] = 0;
+        }
+        touched.clear();
+        return window;
+    }
+
+    size_t memoryBytes() const {
+        size_t total = (mergeCount.capacity() + mergeError.capacity()) * sizeof(long long)
+                     + touched.capacity() * sizeof(uint32_t);
+        for (const RollupLevel& level : levels) total += level.ring.capacity() * sizeof(RollupBucket);
+        return total;
+    }
+
+    void clear() {
+        for (RollupLevel& level : levels) {
+            for (RollupBucket& b : level.ring) b.reset(-1);
+            level.newest = -1;
+        }
+    }
+};
+
+#endif
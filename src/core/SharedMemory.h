@@ -0,0 +1,529 @@
+#ifndef SHAREDMEMORY_H
+#define SHAREDMEMORY_H
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <iostream>
+#include <cctype>
+#ifndef _WIN32
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#endif
+using namespace std;
+
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                    SHARED MEMORY (Position-independent State)
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Building blocks that let the item store, cart and queues live in one
+ * shared-memory segment mapped by several processes, each at its own address:
+ *
+ * - OffsetPtr<T>     pointer stored as a distance from itself
+ * - SegmentArena     size-class allocator inside the segment (offsets only)
+ * - SegmentVector<T> growable array on top of stateAllocate / stateFree
+ * - InlineName       fixed-capacity name, no heap pointer
+ * - SharedSegment    create-or-attach a POSIX segment with a process-shared,
+ *                    robust, recursive mutex in its header
+ *
+ * While no segment is attached, stateAllocate / stateFree are plain
+ * operator new / delete, so single-process builds behave as before.
+ */
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  OffsetPtr - self-relative pointer
+// ─────────────────────────────────────────────────────────────────────────────
+
+/**
+ * Stores (target - this) instead of the target's address, so a structure
+ * linked with OffsetPtrs is valid wherever its segment is mapped. Copying
+ * re-bases the offset (never memcpy an object that contains one).
+ * Offset 1 means null: no aligned object lives one byte past a pointer.
+ */
+template <typename T>
+class OffsetPtr {
+private:
+    static const intptr_t NULL_OFFSET = 1;
+    intptr_t offset;
+
+    // Integer arithmetic: a pointer derived from `this` would let the
+    // optimizer assume the target lies inside this object
+    void set(const T* target) {
+        offset = (target == nullptr) ? NULL_OFFSET : (intptr_t)((uintptr_t)target - (uintptr_t)this);
+    }
+
+public:
+    OffsetPtr() : offset(NULL_OFFSET) {}
+    OffsetPtr(T* target) { set(target); }
+    OffsetPtr(const OffsetPtr& other) { set(other.get()); }
+
+    OffsetPtr& operator=(T* target) {
+        set(target);
+        return *this;
+    }
+    OffsetPtr& operator=(const OffsetPtr& other) {
+        set(other.get());
+        return *this;
+    }
+
+    T* get() const {
+        return (offset == NULL_OFFSET) ? nullptr : (T*)((uintptr_t)this + (uintptr_t)offset);
+    }
+    operator T*() const { return get(); }
+    T* operator->() const { return get(); }
+    T& operator*() const { return *get(); }
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  SegmentArena - allocator living inside the segment
+// ─────────────────────────────────────────────────────────────────────────────
+
+// 16-byte classes up to 1 KB, then powers of two
+const int ARENA_SMALL_CLASSES = 64;
+const int ARENA_CLASSES = 96;
+const size_t ARENA_ALIGN = 16;
+
+/**
+ * Bump allocation plus one free list per size class. Every position is an
+ * offset from the arena itself, and a free block stores the offset of the
+ * next one in its first 8 bytes, so all processes share the same lists.
+ * Callers pass the block size back on free (like sized operator delete).
+ * Not synchronized: the segment lock is held around every API call.
+ */
+class SegmentArena {
+private:
+    uint64_t begin;                      // first usable byte
+    uint64_t end;                        // one past the last usable byte
+    uint64_t top;                        // bump pointer
+    uint64_t inUse;                      // bytes handed out (rounded to class)
+    uint64_t freeHead[ARENA_CLASSES];    // 0 = empty
+
+    char* base() const { return (char*)this; }
+
+    static int classOf(size_t bytes, size_t& blockBytes) {
+        if (bytes == 0) bytes = 1;
+        if (bytes <= ARENA_SMALL_CLASSES * ARENA_ALIGN) {
+            int cls = (int)((bytes + ARENA_ALIGN - 1) / ARENA_ALIGN) - 1;
+            blockBytes = (size_t)(cls + 1) * ARENA_ALIGN;
+            return cls;
+        }
+        int shift = 11;
+        while (((size_t)1 << shift) < bytes) shift++;
+        blockBytes = (size_t)1 << shift;
+        return ARENA_SMALL_CLASSES + (shift - 11);
+    }
+
+public:
+    // The arena manages [this + headerBytes, this + totalBytes)
+    void init(size_t totalBytes) {
+        size_t header = (sizeof(SegmentArena) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+        begin = top = header;
+        end = totalBytes;
+        inUse = 0;
+        memset(freeHead, 0, sizeof(freeHead));
+    }
+
+    void* allocate(size_t bytes) {
+        size_t blockBytes;
+        int cls = classOf(bytes, blockBytes);
+        if (cls >= ARENA_CLASSES) throw bad_alloc();
+        uint64_t block = freeHead[cls];
+        if (block != 0) {
+            memcpy(&freeHead[cls], base() + block, sizeof(uint64_t));
+        } else {
+            if (top + blockBytes > end) throw bad_alloc();
+            block = top;
+            top += blockBytes;
+        }
+        inUse += blockBytes;
+        return base() + block;
+    }
+
+    void free(void* p, size_t bytes) {
+        if (p == nullptr) return;
+        size_t blockBytes;
+        int cls = classOf(bytes, blockBytes);
+        uint64_t block = (uint64_t)((char*)p - base());
+        memcpy(base() + block, &freeHead[cls], sizeof(uint64_t));
+        freeHead[cls] = block;
+        inUse -= blockBytes;
+    }
+
+    bool owns(const void* p) const {
+        const char* c = (const char*)p;
+        return c >= base() + begin && c < base() + end;
+    }
+
+    size_t capacityBytes() const { return (size_t)(end - begin); }
+    size_t reservedBytes() const { return (size_t)(top - begin); }   // high-water mark
+    size_t usedBytes() const { return (size_t)inUse; }
+};
+
+// Arena that state containers allocate from in this process (nullptr = heap)
+inline SegmentArena*& activeStateArena() {
+    static SegmentArena* arena = nullptr;
+    return arena;
+}
+
+inline void* stateAllocate(size_t bytes) {
+    SegmentArena* arena = activeStateArena();
+    return (arena != nullptr) ? arena->allocate(bytes) : ::operator new(bytes);
+}
+
+// Frees go back where the block came from, so heap objects created before a
+// segment was attached can still be released afterwards
+inline void stateFree(void* p, size_t bytes) {
+    SegmentArena* arena = activeStateArena();
+    if (arena != nullptr && arena->owns(p)) {
+        arena->free(p, bytes);
+    } else {
+        ::operator delete(p);
+    }
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  SegmentVector - growable array for segment-resident containers
+// ─────────────────────────────────────────────────────────────────────────────
+
+/**
+ * The subset of vector<T> the containers use. Storage comes from
+ * stateAllocate and is reached through an OffsetPtr; elements are moved by
+ * copy construction, so element types may hold OffsetPtrs.
+ */
+template <typename T>
+class SegmentVector {
+private:
+    OffsetPtr<T> items;
+    size_t count;
+    size_t cap;
+
+    void grow(size_t wanted) {
+        size_t newCap = (cap == 0) ? 16 : cap * 2;
+        if (newCap < wanted) newCap = wanted;
+        T* fresh = (T*)stateAllocate(newCap * sizeof(T));
+        T* old = items.get();
+        for (size_t i = 0; i < count; i++) {
+            new (&fresh[i]) T(old[i]);
+            old[i].~T();
+        }
+        if (old != nullptr) stateFree(old, cap * sizeof(T));
+        items = fresh;
+        cap = newCap;
+    }
+
+public:
+    SegmentVector() : count(0), cap(0) {}
+    SegmentVector(const SegmentVector&) = delete;
+    SegmentVector& operator=(const SegmentVector&) = delete;
+
+    ~SegmentVector() {
+        clear();
+        if (items.get() != nullptr) stateFree(items.get(), cap * sizeof(T));
+    }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return cap; }
+    bool empty() const { return count == 0; }
+
+    T& operator[](size_t i) { return items.get()[i]; }
+    const T& operator[](size_t i) const { return items.get()[i]; }
+    T& back() { return items.get()[count - 1]; }
+
+    void reserve(size_t wanted) {
+        if (wanted > cap) grow(wanted);
+    }
+
+    void push_back(const T& value) {
+        if (count == cap) grow(count + 1);
+        new (&items.get()[count]) T(value);
+        count++;
+    }
+
+    void pop_back() {
+        count--;
+        items.get()[count].~T();
+    }
+
+    // Replace the contents with n copies of value
+    void fill(size_t n, const T& value) {
+        clear();
+        reserve(n);
+        for (size_t i = 0; i < n; i++) new (&items.get()[i]) T(value);
+        count = n;
+    }
+
+    // Replace the contents with first[0..n) - one memcpy for plain data
+    void assign(const T* first, size_t n) {
+        clear();
+        reserve(n);
+        if (is_trivially_copyable<T>::value) {
+            if (n > 0) memcpy((void*)items.get(), (const void*)first, n * sizeof(T));
+        } else {
+            for (size_t i = 0; i < n; i++) new (&items.get()[i]) T(first[i]);
+        }
+        count = n;
+    }
+
+    // Keeps the capacity, like vector::clear
+    void clear() {
+        T* data = items.get();
+        for (size_t i = 0; i < count; i++) data[i].~T();
+        count = 0;
+    }
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  InlineName - fixed-capacity item name
+// ─────────────────────────────────────────────────────────────────────────────
+
+// Bytes per stored name, including the terminator
+const int INLINE_NAME_CAPACITY = 64;
+
+// Longest item name the API accepts. Longer names are refused, not cut, so
+// two names that share their first 63 bytes never become one item.
+const size_t MAX_ITEM_NAME_BYTES = INLINE_NAME_CAPACITY - 1;
+
+/**
+ * Item name stored inside the object (a std::string keeps a pointer into
+ * its own buffer or the process heap, neither of which another process can
+ * follow). Callers keep names within MAX_ITEM_NAME_BYTES; anything longer
+ * is still cut at a UTF-8 character boundary rather than overflowing, and
+ * comparisons cut the other side the same way.
+ */
+class InlineName {
+private:
+    unsigned char length;
+    char text[INLINE_NAME_CAPACITY];
+
+public:
+    // Bytes of s[0..n) that a stored name keeps (hash keys must use the same cut)
+    static constexpr size_t storedLength(const char* s, size_t n) {
+        if (n < INLINE_NAME_CAPACITY) return n;
+        size_t cut = INLINE_NAME_CAPACITY - 1;
+        while (cut > 0 && ((unsigned char)s[cut] & 0xC0) == 0x80) cut--;
+        return cut;
+    }
+
+    InlineName() : length(0) { text[0] = '\0'; }
+    InlineName(const string& s) { assign(s); }
+
+    // Compile-time construction from a literal (the base catalog image)
+    constexpr InlineName(const char* s, size_t n) : length(0), text{} {
+        n = storedLength(s, n);
+        for (size_t i = 0; i < n; i++) text[i] = s[i];
+        length = (unsigned char)n;
+    }
+
+    InlineName& operator=(const string& s) {
+        assign(s);
+        return *this;
+    }
+
+    void assign(const string& s) {
+        size_t n = storedLength(s.data(), s.size());
+        memcpy(text, s.data(), n);
+        text[n] = '\0';
+        length = (unsigned char)n;
+    }
+
+    const char* c_str() const { return text; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    string str() const { return string(text, length); }
+    operator string() const { return str(); }
+
+    bool operator==(const InlineName& other) const {
+        return length == other.length && memcmp(text, other.text, length) == 0;
+    }
+
+    bool equalsIgnoreCase(const char* other, size_t n) const {
+        if (storedLength(other, n) != length) return false;
+        for (size_t i = 0; i < length; i++) {
+            if (tolower((unsigned char)text[i]) != tolower((unsigned char)other[i])) return false;
+        }
+        return true;
+    }
+
+    bool equalsIgnoreCase(const string& other) const {
+        return equalsIgnoreCase(other.data(), other.size());
+    }
+
+    friend ostream& operator<<(ostream& os, const InlineName& name) {
+        os.write(name.text, name.length);
+        return os;
+    }
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  SharedSegment - create or attach a named segment
+// ─────────────────────────────────────────────────────────────────────────────
+
+const uint64_t SEGMENT_MAGIC = 0x3130474553524743ULL;   // "CGRSEG01"
+
+enum SegmentOpenResult {
+    SEGMENT_UNSUPPORTED = -1,
+    SEGMENT_FAILED = 0,
+    SEGMENT_CREATED = 1,
+    SEGMENT_ATTACHED = 2
+};
+
+/**
+ * Start of every segment. `layout` fingerprints the structures stored in
+ * it, so a process built with different sizes refuses to attach instead of
+ * misreading them.
+ */
+struct SegmentHeader {
+    uint64_t magic;                 // written last when the segment is created
+    uint64_t layout;
+    uint64_t bytes;
+    uint64_t attaches;              // processes that mapped it (including the creator)
+    uint64_t ownerRecoveries;       // lock taken over from a process that died holding it
+#ifndef _WIN32
+    pthread_mutex_t lock;
+#endif
+    OffsetPtr<char> root;           // the state object, set by the creator
+    SegmentArena arena;             // must stay last: it manages the rest of the segment
+};
+
+/**
+ * Process-local handle on one mapped segment.
+ *
+ * open(): shm_open + flock serialize creators, so exactly one process
+ * initializes a new segment; the others map it and find the existing state
+ * through header->root, without rebuilding anything. A creator that died
+ * mid-initialization leaves magic == 0, and the next opener initializes it.
+ *
+ * lock(): recursive (API calls may nest) and robust - if the holder dies,
+ * the next caller gets the lock and the state as that process left it.
+ */
+class SharedSegment {
+private:
+    SegmentHeader* header;
+    string segmentName;
+    int creatorFd;     // flock held until a new segment is committed
+
+public:
+    SharedSegment() : header(nullptr), creatorFd(-1) {}
+
+    bool attached() const { return header != nullptr; }
+    const string& name() const { return segmentName; }
+    SegmentHeader* segmentHeader() const { return header; }
+    SegmentArena* arena() const { return header ? &header->arena : nullptr; }
+    void* root() const { return header ? (void*)header->root.get() : nullptr; }
+    void setRoot(void* state) { header->root = (char*)state; }
+
+#ifdef _WIN32
+    int open(const string&, size_t, uint64_t) { return SEGMENT_UNSUPPORTED; }
+    void commitCreated() {}
+    void lock() {}
+    void unlock() {}
+#else
+    int open(const string& name, size_t bytes, uint64_t layout) {
+        if (header != nullptr || name.empty() || bytes < sizeof(SegmentHeader) + 4096) return SEGMENT_FAILED;
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+        if (fd < 0) return SEGMENT_FAILED;
+        if (flock(fd, LOCK_EX) != 0) {
+            close(fd);
+            return SEGMENT_FAILED;
+        }
+
+        int result = SEGMENT_FAILED;
+        struct stat info;
+        void* base = MAP_FAILED;
+        bool sized = false;
+        if (fstat(fd, &info) == 0) {
+            if (info.st_size > 0) {
+                bytes = (size_t)info.st_size;   // existing segment: its size wins
+                sized = true;
+            } else {
+                sized = ftruncate(fd, (off_t)bytes) == 0;
+            }
+        }
+        if (sized) base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if (base != MAP_FAILED) {
+            SegmentHeader* h = (SegmentHeader*)base;
+            if (h->magic == 0) {
+                memset((void*)h, 0, sizeof(SegmentHeader));
+                h->layout = layout;
+                h->bytes = bytes;
+                pthread_mutexattr_t attr;
+                pthread_mutexattr_init(&attr);
+                pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+                pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+                pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+                pthread_mutex_init(&h->lock, &attr);
+                pthread_mutexattr_destroy(&attr);
+                new (&h->root) OffsetPtr<char>();
+                h->arena.init(bytes - offsetof(SegmentHeader, arena));
+                result = SEGMENT_CREATED;
+            } else if (h->magic == SEGMENT_MAGIC && h->layout == layout && h->bytes == bytes) {
+                result = SEGMENT_ATTACHED;
+            }
+            if (result == SEGMENT_FAILED) {
+                munmap(base, bytes);
+            } else {
+                header = h;
+                segmentName = name;
+                header->attaches++;
+            }
+        }
+
+        // A new segment is published (magic set) by commitCreated(), under the flock
+        if (result != SEGMENT_CREATED) {
+            flock(fd, LOCK_UN);
+            close(fd);
+        } else {
+            creatorFd = fd;
+        }
+        return result;
+    }
+
+    // Mark a freshly created segment initialized and let other openers in
+    void commitCreated() {
+        if (creatorFd < 0) return;
+        header->magic = SEGMENT_MAGIC;
+        flock(creatorFd, LOCK_UN);
+        close(creatorFd);
+        creatorFd = -1;
+    }
+
+    void lock() {
+        if (header == nullptr) return;
+        if (pthread_mutex_lock(&header->lock) == EOWNERDEAD) {
+            pthread_mutex_consistent(&header->lock);
+            header->ownerRecoveries++;
+        }
+    }
+
+    void unlock() {
+        if (header != nullptr) pthread_mutex_unlock(&header->lock);
+    }
+#endif
+};
+
+// Holds a segment's lock for one scope (no-op while nothing is attached)
+class SegmentLock {
+private:
+    SharedSegment& segment;
+    bool held;
+
+public:
+    explicit SegmentLock(SharedSegment& s) : segment(s), held(s.attached()) {
+        if (held) segment.lock();
+    }
+    ~SegmentLock() {
+        if (held) segment.unlock();
+    }
+};
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                    EPOCH RECLAMATION + ATOMIC SNAPSHOTS
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Lets readers use an immutable object with no lock while writers replace it.
+ *
+ * - Writers build a new object, swap it in with one atomic exchange and
+ *   retire the old one. Writers are serialized by the caller (here: the
+ *   library's state lock), so the retire list needs no synchronization.
+ * - A reader announces the global epoch in its own slot, loads the pointer,
+ *   reads, and clears the slot: two stores and two loads, no loop, no lock
+ *   - wait-free.
+ * - The global epoch only advances once every active reader has announced
+ *   it. An object retired in epoch e is freed once the epoch reaches e + 2:
+ *   by then no reader can still hold it.
+ *
+ * Reader slots are claimed once per thread (first read) and released when
+ * the thread exits; a thread that finds all slots taken gets -1 and must
+ * use a locked path instead.
+ */
+
+const int MAX_EPOCH_READERS = 256;
+
+class EpochDomain {
+private:
+    struct alignas(64) ReaderSlot {
+        atomic<uint64_t> epoch;   // 0 = not reading
+        atomic<bool> taken;
+    };
+
+    struct Retired {
+        void* object;
+        void (*destroy)(void*);
+        uint64_t epoch;
+    };
+
+    ReaderSlot slots[MAX_EPOCH_READERS];
+    atomic<uint64_t> globalEpoch;
+    vector<Retired> retired;          // writer side only
+
+    // Advance if every active reader has seen the current epoch
+    void tryAdvance() {
+        uint64_t current = globalEpoch.load(memory_order_seq_cst);
+        for (int i = 0; i < MAX_EPOCH_READERS; i++) {
+            uint64_t seen = slots[i].epoch.load(memory_order_seq_cst);
+            if (seen != 0 && seen != current) return;
+        }
+        globalEpoch.store(current + 1, memory_order_seq_cst);
+    }
+
+    void collect() {
+        uint64_t current = globalEpoch.load(memory_order_seq_cst);
+        size_t kept = 0;
+        for (size_t i = 0; i < retired.size(); i++) {
+            if (retired[i].epoch + 2 <= current) {
+                retired[i].destroy(retired[i].object);
+            } else {
+                retired[kept++] = retired[i];
+            }
+        }
+        retired.resize(kept);
+    }
+
+public:
+    EpochDomain() : globalEpoch(1) {
+        retired.reserve(16);   // a few in flight is the steady state
+        for (int i = 0; i < MAX_EPOCH_READERS; i++) {
+            slots[i].epoch.store(0, memory_order_relaxed);
+            slots[i].taken.store(false, memory_order_relaxed);
+        }
+    }
+
+    ~EpochDomain() {
+        for (const Retired& r : retired) r.destroy(r.object);
+    }
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    // Claim a reader slot (once per thread); -1 if all are taken
+    int claimSlot() {
+        for (int i = 0; i < MAX_EPOCH_READERS; i++) {
+            bool expected = false;
+            if (!slots[i].taken.load(memory_order_relaxed) &&
+                slots[i].taken.compare_exchange_strong(expected, true, memory_order_acq_rel)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void releaseSlot(int slot) {
+        slots[slot].epoch.store(0, memory_order_release);
+        slots[slot].taken.store(false, memory_order_release);
+    }
+
+    void enter(int slot) {
+        // seq_cst store: must be visible before the pointer load that follows
+        slots[slot].epoch.store(globalEpoch.load(memory_order_seq_cst), memory_order_seq_cst);
+    }
+
+    void exit(int slot) { slots[slot].epoch.store(0, memory_order_release); }
+
+    // Free `object` once no reader can hold it (writers only)
+    template <typename T>
+    void retire(const T* object) {
+        if (object == nullptr) return;
+        retired.push_back({(void*)object, [](void* p) { delete (T*)p; },
+                           globalEpoch.load(memory_order_seq_cst)});
+        tryAdvance();
+        collect();
+    }
+
+    size_t pendingCount() const { return retired.size(); }
+    uint64_t currentEpoch() const { return globalEpoch.load(memory_order_relaxed); }
+};
+
+/**
+ * AtomicSnapshot<T> - the current immutable T, swapped in by writers.
+ * Read it inside an EpochReadGuard on the same domain.
+ */
+template <typename T>
+class AtomicSnapshot {
+private:
+    atomic<const T*> current;
+    EpochDomain& domain;
+
+public:
+    explicit AtomicSnapshot(EpochDomain& d) : current(nullptr), domain(d) {}
+    ~AtomicSnapshot() { delete current.load(memory_order_relaxed); }
+
+    AtomicSnapshot(const AtomicSnapshot&) = delete;
+    AtomicSnapshot& operator=(const AtomicSnapshot&) = delete;
+
+    // Readers: valid until the enclosing guard ends; nullptr before the first publish
+    const T* load() const { return current.load(memory_order_seq_cst); }
+
+    // Writers: take ownership of `next` and retire the previous value
+    void publish(const T* next) {
+        domain.retire(current.exchange(next, memory_order_seq_cst));
+    }
+};
+
+// Reader side of an epoch domain for the current thread's slot (-1 = none)
+class EpochReadGuard {
+private:
+    EpochDomain& domain;
+    int slot;
+
+public:
+    EpochReadGuard(EpochDomain& d, int s) : domain(d), slot(s) {
+        if (slot >= 0) domain.enter(slot);
+    }
+    ~EpochReadGuard() {
+        if (slot >= 0) domain.exit(slot);
+    }
+    bool active() const { return slot >= 0; }
+};
+
+#endif
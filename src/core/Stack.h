@@ -3,12 +3,25 @@
 
 #include <iostream>
 #include "Node.h"
+#include "MemoryStats.h"
 using namespace std;
 
+/**
+ * Stack<T, Alloc> - LIFO over singly linked nodes
+ * Nodes are T itself when T embeds an SListHook, else Node<T>.
+ * Iteration runs top -> bottom.
+ */
+template <typename T, typename Alloc = StateAllocator>
 class Stack {
+public:
+    typedef typename NodeTraits<T>::node_type node_type;
+    typedef SListIterator<T, false> iterator;
+    typedef SListIterator<T, true> const_iterator;
+
 private:
-    Node* stack_top;
+    OffsetPtr<node_type> stack_top;
     int stack_size;
+    MemoryStats mem;
 
 public:
     Stack() {
@@ -17,36 +30,53 @@ public:
     }
     ~Stack() { clear(); }
 
+    Stack(const Stack&) = delete;
+    Stack& operator=(const Stack&) = delete;
+
     bool empty() const { return stack_top == nullptr; }
     int size() const { return stack_size; }
-    Node* top_node() const { return stack_top; }
+    const MemoryStats& memory_stats() const { return mem; }
 
-    Product top() const {
-        if (empty()) return Product();
-        return stack_top->retrieve();
+    iterator begin() { return iterator(stack_top.get()); }
+    iterator end() { return iterator(); }
+    const_iterator begin() const { return const_iterator(stack_top.get()); }
+    const_iterator end() const { return const_iterator(); }
+
+    T top() const {
+        if (empty()) return T();
+        return NodeTraits<T>::value(*stack_top);
     }
 
-    void push(Product val) {
-        Node* new_node = new Node(val, stack_top);
+    void push(const T& val) {
+        node_type* new_node = createNode<node_type, Alloc>(val);
+        new_node->set_next(stack_top);
+        mem.onAllocate(sizeof(node_type));
         stack_top = new_node;
         stack_size++;
     }
 
-    Product pop() {
-        if (empty()) return Product();
-        
-        Node* temp = stack_top;
-        Product popped_item = temp->retrieve();
-        stack_top = stack_top->next();
-        delete temp;
+    T pop() {
+        if (empty()) return T();
+
+        node_type* temp = stack_top;
+        T popped_item = NodeTraits<T>::value(*temp);
+        stack_top = temp->next();
+        mem.onFree(sizeof(node_type));
+        destroyNode<node_type, Alloc>(temp);
         stack_size--;
         return popped_item;
     }
 
     void clear() {
-        while (!empty()) {
-            pop();
+        node_type* ptr = stack_top;
+        while (ptr != nullptr) {
+            node_type* next = ptr->next();
+            mem.onFree(sizeof(node_type));
+            destroyNode<node_type, Alloc>(ptr);
+            ptr = next;
         }
+        stack_top = nullptr;
+        stack_size = 0;
     }
 
     void traverse() const {
@@ -56,23 +86,18 @@ public:
             return;
         }
         cout << "TOP" << endl;
-        for (Node* ptr = stack_top; ptr != nullptr; ptr = ptr->next()) {
-            cout << " | " << ptr->retrieve().getName() << endl;
+        for (const T& entry : *this) {
+            cout << " | " << entry << endl;
         }
         cout << "BOTTOM" << endl;
     }
 
     void display_visual() const {
         cout << "TOP -> ";
-        if (empty()) {
-            cout << "NULL" << endl;
-            return;
+        for (const T& entry : *this) {
+            cout << "[" << entry << "] -> ";
         }
-        for (Node* ptr = stack_top; ptr != nullptr; ptr = ptr->next()) {
-            cout << "[" << ptr->retrieve().getName() << "]";
-            if (ptr->next() != nullptr) cout << " -> ";
-        }
-        cout << " -> BOTTOM" << endl;
+        cout << "BOTTOM" << endl;
     }
 };
 
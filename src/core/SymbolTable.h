@@ -0,0 +1,72 @@
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+#include <string>
+#include <vector>
+#include <cctype>
+#include <cstdint>
+#include <unordered_map>
+#include "MemoryStats.h"
+using namespace std;
+
+/**
+ * SymbolTable - dense integer ids for item names
+ *
+ * Names are matched case-insensitively (like the cart and the frequent
+ * items); the spelling seen first is kept for display. Symbols are never
+ * reused, so they can be stored in history rows and rollup buckets.
+ *
+ * - intern(name): O(1) average (one hash of the folded name)
+ * - name(symbol): O(1)
+ */
+class SymbolTable {
+private:
+    unordered_map<string, uint32_t> symbolOf;   // folded name -> symbol
+    vector<string> names;                       // symbol -> display name
+
+    static string fold(const string& name) {
+        string key = name;
+        for (size_t i = 0; i < key.size(); i++) {
+            key[i] = (char)tolower((unsigned char)key[i]);
+        }
+        return key;
+    }
+
+public:
+    static const uint32_t NO_SYMBOL = 0xFFFFFFFFu;
+
+    uint32_t intern(const string& name) {
+        string key = fold(name);
+        auto it = symbolOf.find(key);
+        if (it != symbolOf.end()) return it->second;
+        uint32_t symbol = (uint32_t)names.size();
+        symbolOf.emplace(key, symbol);
+        names.push_back(name);
+        return symbol;
+    }
+
+    // Symbol of an already interned name, or NO_SYMBOL
+    uint32_t find(const string& name) const {
+        auto it = symbolOf.find(fold(name));
+        return (it == symbolOf.end()) ? NO_SYMBOL : it->second;
+    }
+
+    const string& name(uint32_t symbol) const { return names[symbol]; }
+    uint32_t size() const { return (uint32_t)names.size(); }
+
+    size_t memoryBytes() const {
+        size_t total = names.capacity() * sizeof(string) + symbolOf.bucket_count() * sizeof(void*);
+        for (const string& n : names) total += stringHeapBytes(n);
+        for (const auto& entry : symbolOf) {
+            total += sizeof(entry) + sizeof(void*) + stringHeapBytes(entry.first);
+        }
+        return total;
+    }
+
+    void clear() {
+        symbolOf.clear();
+        names.clear();
+    }
+};
+
+#endif
@@ -0,0 +1,230 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                    EVENT TRACING (compile-time switchable)
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Build with -DGROCERY_TRACING to enable; otherwise the macros below expand to
+ * nothing. Recording also has to be switched on at runtime (setTracing(true)).
+ *
+ * Each thread writes begin/end events into its own ring buffer:
+ * - Single producer per buffer, so recording is a plain store plus one
+ *   release store of the write counter (no locks, no atomics RMW)
+ * - Names must be string literals / __func__ (only the pointer is stored),
+ *   or go through internTraceName()
+ * - When a buffer wraps, the oldest events are overwritten
+ *
+ * dumpTraceJson() copies every buffer out and renders Chrome trace-event JSON
+ * (open it in chrome://tracing or ui.perfetto.dev).
+ */
+
+#ifdef GROCERY_TRACING
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_USE_TSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define TRACE_USE_TSC 1
+#endif
+
+const int TRACE_BUFFER_EVENTS = 16384;   // per thread, power of two
+const int MAX_TRACE_THREADS = 256;
+const int MAX_TRACE_NAMES = 256;
+
+struct TraceEvent {
+    const char* name;
+    uint64_t ticks;   // raw timestamp, converted to time only when dumping
+    char phase;       // 'B' (begin) or 'E' (end)
+};
+
+// Raw timestamp: the CPU timestamp counter where available (a few ns),
+// otherwise steady_clock nanoseconds
+inline uint64_t traceTicks() {
+#ifdef TRACE_USE_TSC
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+struct TraceBuffer {
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+    std::atomic<uint64_t> written;   // events ever written by the owning thread
+    std::atomic<uint64_t> clearedAt; // events before this index were cleared
+    int tid;
+
+    explicit TraceBuffer(int threadIndex) : written(0), clearedAt(0), tid(threadIndex) {}
+};
+
+struct TraceRegistry {
+    std::atomic<bool> enabled;
+    std::atomic<int> threadCount;
+    std::atomic<TraceBuffer*> buffers[MAX_TRACE_THREADS];
+    std::chrono::steady_clock::time_point origin;
+    uint64_t originTicks;
+    std::mutex namesMutex;
+    std::string names[MAX_TRACE_NAMES];
+    int nameCount;
+
+    TraceRegistry() : enabled(false), threadCount(0),
+                      origin(std::chrono::steady_clock::now()), originTicks(traceTicks()),
+                      nameCount(0) {
+        for (int i = 0; i < MAX_TRACE_THREADS; i++) buffers[i].store(nullptr);
+    }
+};
+
+inline TraceRegistry& traceRegistry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+// This thread's buffer (allocated on first use and kept for later dumps)
+inline TraceBuffer* traceBuffer() {
+    static thread_local TraceBuffer* buffer = nullptr;
+    if (buffer == nullptr) {
+        TraceRegistry& registry = traceRegistry();
+        int index = registry.threadCount.fetch_add(1);
+        if (index >= MAX_TRACE_THREADS) return nullptr;
+        buffer = new TraceBuffer(index);
+        registry.buffers[index].store(buffer, std::memory_order_release);
+    }
+    return buffer;
+}
+
+inline void setTracing(bool on) {
+    traceRegistry().enabled.store(on, std::memory_order_relaxed);
+}
+
+inline bool tracingEnabled() {
+    return traceRegistry().enabled.load(std::memory_order_relaxed);
+}
+
+inline void traceEvent(const char* name, char phase) {
+    TraceBuffer* buffer = traceBuffer();
+    if (buffer == nullptr) return;
+    uint64_t index = buffer->written.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer->events[index & (TRACE_BUFFER_EVENTS - 1)];
+    event.name = name;
+    event.ticks = traceTicks();
+    event.phase = phase;
+    buffer->written.store(index + 1, std::memory_order_release);
+}
+
+// Stable copy of a caller-owned name (e.g. from Python); slow path, locked
+inline const char* internTraceName(const char* name) {
+    TraceRegistry& registry = traceRegistry();
+    std::lock_guard<std::mutex> lock(registry.namesMutex);
+    for (int i = 0; i < registry.nameCount; i++) {
+        if (registry.names[i] == name) return registry.names[i].c_str();
+    }
+    if (registry.nameCount >= MAX_TRACE_NAMES) return "(trace name table full)";
+    registry.names[registry.nameCount] = name;
+    return registry.names[registry.nameCount++].c_str();
+}
+
+// Begin event now, end event when the scope exits
+class TraceScope {
+private:
+    const char* name;
+    bool active;
+
+public:
+    explicit TraceScope(const char* n) : name(n), active(tracingEnabled()) {
+        if (active) traceEvent(name, 'B');
+    }
+    ~TraceScope() {
+        if (active) traceEvent(name, 'E');
+    }
+};
+
+/**
+ * Render all buffered events as Chrome trace-event JSON.
+ * Events overwritten while copying are dropped, so the dump never shows a
+ * torn event. Safe to call while other threads keep recording.
+ */
+inline std::string dumpTraceJson() {
+    TraceRegistry& registry = traceRegistry();
+    std::ostringstream json;
+    json << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    std::vector<TraceEvent> copy;
+
+    // Ticks -> ns, calibrated against steady_clock since the registry was made
+    double elapsedNs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - registry.origin).count();
+    uint64_t elapsedTicks = traceTicks() - registry.originTicks;
+    double nsPerTick = (elapsedTicks > 0 && elapsedNs > 0) ? elapsedNs / (double)elapsedTicks : 1.0;
+
+    int threads = std::min(registry.threadCount.load(), MAX_TRACE_THREADS);
+    for (int t = 0; t < threads; t++) {
+        TraceBuffer* buffer = registry.buffers[t].load(std::memory_order_acquire);
+        if (buffer == nullptr) continue;
+
+        uint64_t end = buffer->written.load(std::memory_order_acquire);
+        uint64_t begin = (end > (uint64_t)TRACE_BUFFER_EVENTS) ? end - TRACE_BUFFER_EVENTS : 0;
+        begin = std::max(begin, std::min(end, buffer->clearedAt.load(std::memory_order_acquire)));
+        copy.clear();
+        for (uint64_t i = begin; i < end; i++) {
+            copy.push_back(buffer->events[i & (TRACE_BUFFER_EVENTS - 1)]);
+        }
+        // Anything the writer lapped during the copy may be torn - skip it
+        // (including the slot it may be writing right now, index `after`)
+        uint64_t after = buffer->written.load(std::memory_order_acquire) + 1;
+        uint64_t firstValid = (after > (uint64_t)TRACE_BUFFER_EVENTS) ? after - TRACE_BUFFER_EVENTS : 0;
+        size_t skip = (firstValid > begin) ? (size_t)std::min<uint64_t>(firstValid - begin, copy.size()) : 0;
+
+        for (size_t i = skip; i < copy.size(); i++) {
+            if (!first) json << ",";
+            first = false;
+            json << "{\"name\":\"";
+            for (const char* c = copy[i].name; *c; c++) {
+                if (*c == '"' || *c == '\\') json << '\\';
+                json << *c;
+            }
+            uint64_t ns = (uint64_t)((double)(copy[i].ticks - registry.originTicks) * nsPerTick);
+            json << "\",\"ph\":\"" << copy[i].phase << "\","
+                 << "\"ts\":" << ns / 1000 << "." << (ns % 1000) / 100
+                 << (ns % 100) / 10 << ns % 10 << ","
+                 << "\"pid\":1,\"tid\":" << buffer->tid << "}";
+        }
+    }
+    json << "]}";
+    return json.str();
+}
+
+// Forget recorded events (only the owning thread writes `written`,
+// so clearing just moves each buffer's read watermark)
+inline void clearTrace() {
+    TraceRegistry& registry = traceRegistry();
+    int threads = std::min(registry.threadCount.load(), MAX_TRACE_THREADS);
+    for (int t = 0; t < threads; t++) {
+        TraceBuffer* buffer = registry.buffers[t].load(std::memory_order_acquire);
+        if (buffer == nullptr) continue;
+        buffer->clearedAt.store(buffer->written.load(std::memory_order_acquire),
+                                std::memory_order_release);
+    }
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+#else
+
+#define TRACE_SCOPE(name)
+
+#endif
+
+#endif
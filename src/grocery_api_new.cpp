@@ -14,12 +14,39 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 #include <cstdlib>
+#include <cstdio>
 #include <cstring>
+#include <algorithm>
+#include <mutex>
+#include <ctime>
+#include <atomic>
+#include <unordered_map>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
 #include "core/Array.h"
+#include "core/CatalogImport.h"
+#include "core/ItemSpill.h"
 #include "core/LinkedList.h"
 #include "core/Stack.h"
 #include "core/Queue.h"
+#include "core/ReplicatedCart.h"
+#include "core/ChangeLog.h"
+#include "core/JsonReader.h"
+#include "core/CoPurchase.h"
+#include "core/HeavyHitters.h"
+#include "core/SymbolTable.h"
+#include "core/PurchaseHistory.h"
+#include "core/Rollups.h"
+#include "core/Metrics.h"
+#include "core/Trace.h"
+#include "core/MemoryStats.h"
+#include "core/SharedMemory.h"
+#include "core/GroupCommit.h"
+#include "core/Snapshot.h"
 
 using namespace std;
 
@@ -30,14 +57,138 @@ using namespace std;
     #define EXPORT extern "C"
 #endif
 
+// Instrumentation placed at the top of every exported api_* function; also
+// holds the state lock (see StateLock) for the whole call
+#define API_ENTRY() StateLock stateLock; API_ENTRY_UNLOCKED()
+
+// For the few exports that wait on the persistence thread, which itself needs
+// the state lock to take a snapshot
+#define API_ENTRY_UNLOCKED() METRIC_API_SCOPE(); TRACE_SCOPE(__func__)
+
+// For exports that change persisted state (items, cart): queues a save, and
+// in durable mode waits for it to commit once the state lock is released
+#define API_MUTATION() CommitWait commitWait; API_ENTRY(); commitWait.mark()
+
 // ═══════════════════════════════════════════════════════════════════════════════
 //                         GLOBAL DATA STRUCTURES
 // ═══════════════════════════════════════════════════════════════════════════════
 
-static FrequentItemsArray allItems;        // UNIFIED Array for ALL items (top 10 = frequent)
-static LinkedList cart;                    // Linked List for shopping cart
-static Stack undoStack;                    // Stack for undo operations
-static Queue checkoutQueue;                // Queue for checkout process
+/**
+ * One undo record: what was added, linked in place (no Node wrapper, no id).
+ * Undo removes the cart line by name, so that is all it keeps.
+ */
+struct UndoEntry : SListHook<UndoEntry> {
+    InlineName name;
+    int quantity;
+
+    UndoEntry() : quantity(0) {}
+    explicit UndoEntry(const Product& product) : name(product.nameRef()), quantity(product.getQuantity()) {}
+
+    friend ostream& operator<<(ostream& os, const UndoEntry& entry) {
+        return os << entry.name << " (x" << entry.quantity << ")";
+    }
+};
+
+/**
+ * One shopper's cart, undo stack and checkout queue (see SESSIONS below).
+ * `id` tags its change records.
+ */
+struct CartSession {
+    LinkedList<Product> cart;              // Linked List for shopping cart
+    Stack<UndoEntry> undoStack;            // Stack for undo operations
+    Queue<Product> checkoutQueue;          // Queue for checkout process
+    ReplicatedCart replicatedCart;         // CRDT copy of the cart, merged with offline devices
+    uint32_t id;
+
+    CartSession() : id(MAIN_SESSION) {}
+};
+
+/**
+ * State that api_attach_shared_state() can move into a shared-memory segment.
+ * Everything in it is position-independent (OffsetPtr links, InlineName
+ * names, nodes and index arrays from the segment arena).
+ */
+struct LibraryState {
+    FrequentItemsArray allItems;           // UNIFIED Array for ALL items (top 10 = frequent)
+    CartSession main;                      // The cart of callers that select no session
+    ChangeLog changes;                     // Recent cart/undo/checkout mutations (api_read_changes)
+    bool heavyHitterMode;                  // Route new custom items through customSketch
+
+    LibraryState() : heavyHitterMode(true) {}
+};
+
+static LibraryState localState;            // Used until a segment is attached
+static LibraryState* state = &localState;
+static CartSession* session = &localState.main;   // The caller's cart, set by the outermost StateLock
+static unordered_map<string, CartSession*> sessions;   // Every other cart, by key (SESSIONS, below)
+static SharedSegment sharedState;          // Mapped by api_attach_shared_state
+static recursive_mutex apiLock;            // Callers may be several threads (Flask, native server)
+static GroupCommitWriter persistence;      // Background writer of the data file (api_set_persistence)
+
+static void publish_ranking_if_stale();    // RANKING SNAPSHOTS, below
+static void replicate_cart_line(const string& name);   // CART REPLICATION, below
+static void replicate_whole_cart();
+static bool collect_changes();             // CHANGE NOTIFICATIONS, below
+static void deliver_changes();
+static CartSession* selected_session();    // SESSIONS, below
+static void release_idle_session();
+static void release_if_idle(CartSession* cart);
+static void record_purchase_delta(const Product& item);   // PURCHASE DELTAS, below
+static void count_cart_line(const InlineName& name, int delta);   // ITEM STORE CAPACITY, below
+template <typename Lines> static void count_cart_lines(const Lines& lines, int delta);
+static thread_local int stateLockDepth = 0;
+
+// Hands collected change records to subscribers when it goes out of scope
+struct ChangeDelivery {
+    bool armed;
+
+    ChangeDelivery() : armed(false) {}
+    ~ChangeDelivery() {
+        if (armed) deliver_changes();
+    }
+};
+
+// Serializes API calls and the persistence snapshot: within this process,
+// and across processes once a segment is attached. Recursive, since the
+// audit and batch paths call other exports. The outermost holder publishes
+// a new ranking snapshot if it changed the items (still under the lock),
+// and collects new change records, delivered once both locks are released.
+// The outermost holder also points `session` at the calling thread's cart.
+struct StateLock {
+    ChangeDelivery delivery;               // destroyed last, after the unlocks
+    lock_guard<recursive_mutex> local;
+    SegmentLock shared;
+
+    StateLock() : local(apiLock), shared(sharedState) {
+        if (stateLockDepth++ == 0) session = selected_session();
+    }
+    ~StateLock() {
+        if (--stateLockDepth == 0) {
+            publish_ranking_if_stale();
+            delivery.armed = collect_changes();
+            release_idle_session();
+        }
+    }
+};
+
+// Marks one persisted mutation; in durable mode, waits for its commit on scope exit
+struct CommitWait {
+    uint64_t seq;
+
+    CommitWait() : seq(0) {}
+    void mark() { seq = persistence.markDirty(); }
+    ~CommitWait() {
+        if (seq != 0 && persistence.isDurable()) persistence.waitFor(seq, false);
+    }
+};
+
+// Per-process analytics (not shared between workers)
+static CoPurchaseGraph coPurchases;        // Item-item "bought together" counts
+static HeavyHitterSketch customSketch;     // Fixed-memory counts for unpromoted custom items
+static SymbolTable itemSymbols;            // Item name <-> dense symbol (history rows)
+static PurchaseHistory history;            // Columnar log of every checkout line
+static PurchaseRollups rollups;            // Minute/hour/day per-item totals
+static ItemSpill itemSpill;                // Evicted custom items on disk (api_set_item_spill)
 
 // ═══════════════════════════════════════════════════════════════════════════════
 //                    HELPER: Convert C++ string to C string
@@ -46,6 +197,8 @@ static Queue checkoutQueue;                // Queue for checkout process
 char* string_to_cstr(const string& str) {
     size_t len = str.length() + 1;
     char* result = (char*)malloc(len);
+    METRIC_ADD(METRIC_RESULT_STRINGS, 1);
+    METRIC_ADD(METRIC_RESULT_BYTES, len);
     if (result != nullptr) {
 #ifdef _WIN32
         strcpy_s(result, len, str.c_str());
@@ -56,6 +209,37 @@ char* string_to_cstr(const string& str) {
     return result;
 }
 
+// ═══════════════════════════════════════════════════════════════════════════════
+//          ALLOCATION AUDIT (build with -DGROCERY_ALLOC_AUDIT, test builds only)
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// Replaces global operator new/delete to count heap allocations made by the
+// calling thread, so api_run_allocation_audit() can check each hot-path
+// operation against its declared budget.
+
+#ifdef GROCERY_ALLOC_AUDIT
+#include <new>
+
+static thread_local long long auditAllocations = 0;
+
+void* operator new(size_t size) {
+    auditAllocations++;
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr) throw bad_alloc();
+    return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    auditAllocations++;
+    return malloc(size ? size : 1);
+}
+void* operator new[](size_t size, const nothrow_t& tag) noexcept { return operator new(size, tag); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+#endif
+
 // ═══════════════════════════════════════════════════════════════════════════════
 //                    ARRAY OPERATIONS - Frequent Items
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -64,15 +248,18 @@ char* string_to_cstr(const string& str) {
  * Get number of frequent items (top 10)
  */
 EXPORT int api_get_frequent_items_count() {
-    return allItems.size();  // Returns max 10
+    API_ENTRY();
+    return state->allItems.size();  // Returns max 10
 }
 
 /**
  * Get frequent item at index (O(1) access!)
  */
 EXPORT const char* api_get_frequent_item(int index) {
-    FrequentItem item = allItems[index];
+    API_ENTRY();
+    FrequentItem item = state->allItems[index];
     
+    TRACE_SCOPE("build_json");
     ostringstream json;
     json << "{\"id\":" << item.id << ","
          << "\"name\":\"" << item.name << "\","
@@ -82,54 +269,297 @@ EXPORT const char* api_get_frequent_item(int index) {
 }
 
 /**
- * Get all frequent items as JSON array (top 10 by purchase count)
+ * Serialize one item for the frequent-items listings, in two halves around
+ * recentScore - the only field that changes with time alone
  */
-EXPORT const char* api_get_all_frequent_items() {
-    ostringstream json;
+static void append_frequent_item_head(string& out, const FrequentItem& item) {
+    char piece[160];
+    int length = snprintf(piece, sizeof(piece), "{\"id\":%d,\"name\":\"%s\",\"purchaseCount\":%d,\"recentScore\":",
+                          item.id, item.name.c_str(), item.purchaseCount);
+    out.append(piece, (size_t)length);
+}
+
+static void append_frequent_item_tail(string& out, const FrequentItem& item) {
+    out += ",\"category\":\"";
+    out += catalogCategoryOf(item.id);
+    out += item.isCustom ? "\",\"isCustom\":true}" : "\",\"isCustom\":false}";
+}
+
+static void write_frequent_item_json(ostringstream& json, int index, double now) {
+    FrequentItem item = state->allItems[index];
+    string piece;
+    append_frequent_item_head(piece, item);
+    json << piece << state->allItems.recentScore(index, now);
+    piece.clear();
+    append_frequent_item_tail(piece, item);
+    json << piece;
+}
+
+/**
+ * Indices of the top 10 items, ranked by the given mode:
+ *   RANK_BY_LIFETIME (0) - lifetime purchaseCount (array order)
+ *   RANK_BY_RECENT   (1) - exponentially decayed popularity
+ */
+static int ranked_indices(int mode, int top[MAX_DISPLAY_ITEMS]) {
+    if (mode == RANK_BY_RECENT) {
+        return state->allItems.topRecentIndices(top, MAX_DISPLAY_ITEMS);
+    }
+    int displayCount = state->allItems.size();  // Max 10
+    for (int i = 0; i < displayCount; i++) top[i] = i;
+    return displayCount;
+}
+
+/**
+ * Serialize the top 10 items as a JSON array, ranked by `mode` (see above)
+ */
+static void write_ranked_items_json(ostringstream& json, int mode) {
     json << "[";
     
-    int displayCount = allItems.size();  // Max 10
-    for (int i = 0; i < displayCount; i++) {
-        FrequentItem item = allItems[i];
+    double now = currentTimeSeconds();
+    int top[MAX_DISPLAY_ITEMS];
+    int count = ranked_indices(mode, top);
+    for (int i = 0; i < count; i++) {
         if (i > 0) json << ",";
-        json << "{\"id\":" << item.id << ","
-             << "\"name\":\"" << item.name << "\","
-             << "\"purchaseCount\":" << item.purchaseCount << ","
-             << "\"isCustom\":" << (item.isCustom ? "true" : "false") << "}";
+        write_frequent_item_json(json, top[i], now);
     }
     
     json << "]";
-    return string_to_cstr(json.str());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    RANKING SNAPSHOTS - Lock-free Top-Items Reads
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// GET /api/frequent-items is the most frequent call. Rather than reading the
+// item store under the state lock (and queueing behind checkouts), readers
+// copy an immutable, pre-serialized snapshot of both rankings:
+//
+// - Writers: the outermost StateLock holder compares the store's
+//   changeCount() with the snapshot's and, if they differ, serializes the
+//   top 10 of each mode once and publishes it with one pointer swap.
+// - Readers: pin an epoch, load the pointer, copy, unpin - no lock, no wait.
+//   recentScore is the one time-dependent field: the snapshot keeps each
+//   score as of publishing and ages it on read (decay is one factor for all
+//   items, so the order itself does not change with time).
+// - Old snapshots are freed by epoch reclamation (core/Snapshot.h).
+//
+// With a shared segment, other processes change the store without
+// publishing here; a reader that sees a newer changeCount() refreshes under
+// the lock instead.
+
+// One ranking mode, serialized with a gap where each recentScore goes
+struct RankingDocument {
+    string text;
+    int count;
+    size_t gaps[MAX_DISPLAY_ITEMS];     // offsets into text, ascending
+    double scores[MAX_DISPLAY_ITEMS];   // recentScore of each gap's item at publishedAt
+    FrequentItem items[MAX_DISPLAY_ITEMS];   // the same items, for grocery_native.ranked_items
+};
+
+struct RankingSnapshot {
+    const LibraryState* owner;   // state it was built from
+    uint64_t changeCount;        // owner->allItems.changeCount() when built
+    double publishedAt;
+    double decayRate;            // ages scores: score * exp(-decayRate * (now - publishedAt))
+    RankingDocument byMode[2];   // RANK_BY_LIFETIME, RANK_BY_RECENT
+};
+
+static EpochDomain rankingEpochs;
+static AtomicSnapshot<RankingSnapshot> rankingSnapshot(rankingEpochs);
+
+// This thread's reader slot, released when the thread exits
+struct RankingReader {
+    int slot;
+    RankingReader() : slot(rankingEpochs.claimSlot()) {}
+    ~RankingReader() {
+        if (slot >= 0) rankingEpochs.releaseSlot(slot);
+    }
+};
+static thread_local RankingReader rankingReader;
+
+static void build_ranking_document(RankingDocument& doc, int mode, double now) {
+    int top[MAX_DISPLAY_ITEMS];
+    doc.count = ranked_indices(mode, top);
+    doc.text.reserve(MAX_DISPLAY_ITEMS * 192);   // one allocation for any top 10
+    doc.text = "[";
+    for (int i = 0; i < doc.count; i++) {
+        if (i > 0) doc.text += ",";
+        FrequentItem item = state->allItems[top[i]];
+        doc.items[i] = item;
+        append_frequent_item_head(doc.text, item);
+        doc.gaps[i] = doc.text.size();
+        doc.scores[i] = state->allItems.recentScore(top[i], now);
+        append_frequent_item_tail(doc.text, item);
+    }
+    doc.text += "]";
+}
+
+// Runs as the outermost state lock is released
+static void publish_ranking_if_stale() {
+    const RankingSnapshot* current = rankingSnapshot.load();
+    uint64_t changes = state->allItems.changeCount();
+    if (current != nullptr && current->owner == state && current->changeCount == changes) return;
+
+    TRACE_SCOPE("publish_ranking");
+    try {
+        RankingSnapshot* next = new RankingSnapshot();
+        next->owner = state;
+        next->changeCount = changes;
+        next->publishedAt = currentTimeSeconds();
+        next->decayRate = log(2.0) / state->allItems.getHalfLife();
+        build_ranking_document(next->byMode[RANK_BY_LIFETIME], RANK_BY_LIFETIME, next->publishedAt);
+        build_ranking_document(next->byMode[RANK_BY_RECENT], RANK_BY_RECENT, next->publishedAt);
+        rankingSnapshot.publish(next);
+    } catch (const bad_alloc&) {
+        // Keep serving the previous snapshot; the next writer tries again
+    }
+}
+
+/**
+ * Copy a snapshot's JSON for `mode` into buffer (NUL-terminated). Returns the
+ * length, or -(bytes needed) if capacity is too small.
+ */
+static int copy_ranking(const RankingSnapshot& snapshot, int mode, char* buffer, int capacity) {
+    const RankingDocument& doc = snapshot.byMode[mode == RANK_BY_RECENT ? RANK_BY_RECENT : RANK_BY_LIFETIME];
+    const int SCORE_CHARS = 32;
+    int needed = (int)(doc.text.size() + (size_t)doc.count * SCORE_CHARS) + 1;
+    if (buffer == nullptr || capacity < needed) return -needed;
+
+    double age = exp(-snapshot.decayRate * (currentTimeSeconds() - snapshot.publishedAt));
+    int used = 0;
+    size_t from = 0;
+    for (int i = 0; i < doc.count; i++) {
+        memcpy(buffer + used, doc.text.data() + from, doc.gaps[i] - from);
+        used += (int)(doc.gaps[i] - from);
+        used += snprintf(buffer + used, SCORE_CHARS, "%g", doc.scores[i] * age);
+        from = doc.gaps[i];
+    }
+    memcpy(buffer + used, doc.text.data() + from, doc.text.size() - from);
+    used += (int)(doc.text.size() - from);
+    buffer[used] = '\0';
+    return used;
+}
+
+static int read_ranked_items(int mode, char* buffer, int capacity) {
+    {
+        EpochReadGuard guard(rankingEpochs, rankingReader.slot);
+        const RankingSnapshot* snapshot = guard.active() ? rankingSnapshot.load() : nullptr;
+        if (snapshot != nullptr &&
+            (!sharedState.attached() || snapshot->changeCount == state->allItems.changeCount())) {
+            return copy_ranking(*snapshot, mode, buffer, capacity);
+        }
+    }
+    // First read, no free reader slot, or another process changed the store:
+    // refresh under the lock (writers are excluded, so the snapshot is stable)
+    StateLock lock;
+    publish_ranking_if_stale();
+    const RankingSnapshot* snapshot = rankingSnapshot.load();
+    return (snapshot != nullptr) ? copy_ranking(*snapshot, mode, buffer, capacity) : -1;
+}
+
+/**
+ * Copy the top 10 items (JSON array, ranked by `mode`) into buffer without
+ * taking the state lock. Returns the length, or -(bytes needed) if capacity
+ * is too small.
+ */
+EXPORT int api_read_ranked_items(int mode, char* buffer, int capacity) {
+    API_ENTRY_UNLOCKED();
+    return read_ranked_items(mode, buffer, capacity);
+}
+
+/**
+ * Get the top 10 items as JSON array, ranked by `mode` (see above);
+ * served from the ranking snapshot
+ */
+EXPORT const char* api_get_ranked_frequent_items(int mode) {
+    API_ENTRY_UNLOCKED();
+    char local[8192];
+    int length = read_ranked_items(mode, local, (int)sizeof(local));
+    if (length >= 0) return string_to_cstr(string(local, (size_t)length));
+    vector<char> larger;
+    while (length < -1) {   // -1: no snapshot could be built
+        larger.resize((size_t)-length);
+        length = read_ranked_items(mode, larger.data(), (int)larger.size());
+    }
+    return string_to_cstr(length >= 0 ? string(larger.data(), (size_t)length) : string("[]"));
+}
+
+/**
+ * Get all frequent items as JSON array (top 10 by purchase count)
+ */
+EXPORT const char* api_get_all_frequent_items() {
+    return api_get_ranked_frequent_items(RANK_BY_LIFETIME);
+}
+
+/**
+ * Configure the half-life (in hours) of the recent popularity score
+ */
+EXPORT void api_set_popularity_half_life(double hours) {
+    API_ENTRY();
+    state->allItems.setHalfLife(hours * 3600.0);
+}
+
+/**
+ * Get the half-life (in hours) of the recent popularity score
+ */
+EXPORT double api_get_popularity_half_life() {
+    API_ENTRY();
+    return state->allItems.getHalfLife() / 3600.0;
 }
 
 /**
  * Increment purchase count for item by ID
  */
 EXPORT void api_increment_purchase_count_by_id(int itemId) {
-    allItems.incrementPurchaseCountById(itemId);
+    API_MUTATION();
+    state->allItems.incrementPurchaseCountById(itemId);
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
 //                    LINKED LIST OPERATIONS - Shopping Cart
 // ═══════════════════════════════════════════════════════════════════════════════
 
+// Names are stored inline, so longer ones are refused rather than cut
+static bool item_name_fits(const string& name) {
+    return name.size() <= MAX_ITEM_NAME_BYTES;
+}
+
 /**
  * Add item to cart (Linked List insertion)
+ * Returns the stable handle of the cart line that now holds the item, or
+ * 0 (INVALID_CART_HANDLE) if the name is longer than MAX_ITEM_NAME_BYTES
  */
-EXPORT void api_add_to_cart(const char* name, int quantity, int product_id) {
+EXPORT unsigned long long api_add_to_cart(const char* name, int quantity, int product_id) {
+    CommitWait commitWait;
+    API_ENTRY();
+    if (name == nullptr || !item_name_fits(name)) return INVALID_CART_HANDLE;
+    commitWait.mark();
     Product product(name, quantity, product_id);
-    cart.push_item(product);
+    int linesBefore = session->cart.size();
+    uint64_t handle = session->cart.push_item(product);
+    if (session->cart.size() > linesBefore) count_cart_line(product.nameRef(), 1);
+    replicate_cart_line(product.getName());
     
     // Also push to undo stack (LIFO)
-    undoStack.push(product);
+    session->undoStack.push(UndoEntry(product));
+    state->changes.append(session->id, CHANGE_CART, CHANGE_ADD, product.nameRef(), product.getQuantity());
+    state->changes.append(session->id, CHANGE_UNDO, CHANGE_PUSH, product.nameRef(), product.getQuantity());
+    return handle;
 }
 
 /**
- * Remove item from cart at position (1-indexed)
+ * Remove item from cart at position (1-indexed) - O(log n) via the line index
  */
 EXPORT const char* api_remove_from_cart(int position) {
-    Product removed = cart.delete_at_position(position);
+    API_MUTATION();
+    Product removed = session->cart.delete_at_position(position);
+    if (!removed.getName().empty()) {
+        count_cart_line(removed.nameRef(), -1);
+        replicate_cart_line(removed.getName());
+        state->changes.append(session->id, CHANGE_CART, CHANGE_REMOVE, removed.nameRef());
+    }
     
+    TRACE_SCOPE("build_json");
     ostringstream json;
     json << "{\"name\":\"" << removed.getName() << "\","
          << "\"quantity\":" << removed.getQuantity() << "}";
@@ -137,50 +567,117 @@ EXPORT const char* api_remove_from_cart(int position) {
     return string_to_cstr(json.str());
 }
 
+/**
+ * Remove the cart line with this handle (stable across other edits)
+ */
+EXPORT const char* api_remove_cart_line(unsigned long long handle) {
+    API_MUTATION();
+    int position = session->cart.position_of(handle);
+    Product removed;
+    if (!session->cart.delete_by_handle(handle, &removed)) {
+        return string_to_cstr("{\"error\":\"Unknown cart line\"}");
+    }
+    count_cart_line(removed.nameRef(), -1);
+    replicate_cart_line(removed.getName());
+    state->changes.append(session->id, CHANGE_CART, CHANGE_REMOVE, removed.nameRef());
+    
+    TRACE_SCOPE("build_json");
+    ostringstream json;
+    json << "{\"name\":\"" << removed.getName() << "\","
+         << "\"quantity\":" << removed.getQuantity() << ","
+         << "\"position\":" << position << "}";
+    
+    return string_to_cstr(json.str());
+}
+
+/**
+ * Set the quantity of the cart line with this handle - O(1)
+ * Returns false for an unknown handle or a quantity below 1
+ */
+EXPORT bool api_update_cart_line(unsigned long long handle, int quantity) {
+    API_MUTATION();
+    if (quantity < 1 || !session->cart.update_quantity(handle, quantity)) return false;
+    const InlineName& name = session->cart.find_by_handle(handle)->nameRef();
+    replicate_cart_line(name.str());
+    state->changes.append(session->id, CHANGE_CART, CHANGE_UPDATE, name, quantity);
+    return true;
+}
+
+/**
+ * Get the cart line at position (1-indexed) - O(log n) via the line index
+ */
+EXPORT const char* api_get_cart_item_at(int position) {
+    API_ENTRY();
+    if (position < 1 || position > session->cart.size()) {
+        return string_to_cstr("{\"error\":\"Position out of range\"}");
+    }
+    LinkedList<Product>::const_iterator line = session->cart.line_at(position);
+    const Product& item = *line;
+    
+    TRACE_SCOPE("build_json");
+    ostringstream json;
+    json << "{\"name\":\"" << item.getName() << "\","
+         << "\"quantity\":" << item.getQuantity() << ","
+         << "\"product_id\":" << item.getProductId() << ","
+         << "\"handle\":" << session->cart.handle_of(line) << "}";
+    
+    return string_to_cstr(json.str());
+}
+
 /**
  * Get cart size
  */
 EXPORT int api_get_cart_size() {
-    return cart.size();
+    API_ENTRY();
+    return session->cart.size();
 }
 
 /**
  * Check if cart is empty
  */
 EXPORT bool api_is_cart_empty() {
-    return cart.empty();
+    API_ENTRY();
+    return session->cart.empty();
 }
 
 /**
  * Get total quantity in cart
  */
 EXPORT int api_get_cart_total_quantity() {
-    return cart.total_quantity();
+    API_ENTRY();
+    return session->cart.total_quantity();
 }
 
 /**
- * Get all cart items as JSON array
+ * Serialize all cart items as a JSON array
  */
-EXPORT const char* api_get_cart_items() {
-    ostringstream json;
+static void write_cart_items_json(ostringstream& json, const LinkedList<Product>& cart) {
     json << "[";
     
-    Node* current = cart.head();
     bool first = true;
     
-    while (current != nullptr) {
-        Product item = current->retrieve();
+    for (LinkedList<Product>::const_iterator line = cart.begin(); line != cart.end(); ++line) {
+        const Product& item = *line;
         if (!first) json << ",";
         first = false;
         
-        json << "{\"name\":\"" << item.getName() << "\","
+        json << "{\"name\":\"" << item.nameRef() << "\","
              << "\"quantity\":" << item.getQuantity() << ","
-             << "\"product_id\":" << item.getProductId() << "}";
-        
-        current = current->next();
+             << "\"product_id\":" << item.getProductId() << ","
+             << "\"handle\":" << cart.handle_of(line) << "}";
     }
     
     json << "]";
+}
+
+/**
+ * Get all cart items as JSON array
+ */
+EXPORT const char* api_get_cart_items() {
+    API_ENTRY();
+    TRACE_SCOPE("build_json");
+    ostringstream json;
+    write_cart_items_json(json, session->cart);
     return string_to_cstr(json.str());
 }
 
@@ -188,7 +685,11 @@ EXPORT const char* api_get_cart_items() {
  * Clear the cart
  */
 EXPORT void api_clear_cart() {
-    cart.clear();
+    API_MUTATION();
+    count_cart_lines(session->cart, -1);
+    session->cart.clear();
+    session->replicatedCart.clear();
+    state->changes.append(session->id, CHANGE_CART, CHANGE_CLEAR);
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -199,16 +700,20 @@ EXPORT void api_clear_cart() {
  * Undo last action (Stack pop - LIFO)
  */
 EXPORT const char* api_undo_last_action() {
-    if (undoStack.empty()) {
+    API_MUTATION();
+    if (session->undoStack.empty()) {
         return string_to_cstr("{\"error\":\"No actions to undo\"}");
     }
     
-    Product lastAction = undoStack.pop();
-    cart.delete_by_name(lastAction.getName());
+    UndoEntry lastAction = session->undoStack.pop();
+    if (session->cart.delete_by_name(lastAction.name.str())) count_cart_line(lastAction.name, -1);
+    replicate_cart_line(lastAction.name.str());
+    state->changes.append(session->id, CHANGE_UNDO, CHANGE_POP, lastAction.name, lastAction.quantity);
     
+    TRACE_SCOPE("build_json");
     ostringstream json;
-    json << "{\"name\":\"" << lastAction.getName() << "\","
-         << "\"quantity\":" << lastAction.getQuantity() << "}";
+    json << "{\"name\":\"" << lastAction.name << "\","
+         << "\"quantity\":" << lastAction.quantity << "}";
     
     return string_to_cstr(json.str());
 }
@@ -217,35 +722,35 @@ EXPORT const char* api_undo_last_action() {
  * Get undo stack size
  */
 EXPORT int api_get_undo_stack_size() {
-    return undoStack.size();
+    API_ENTRY();
+    return session->undoStack.size();
 }
 
 /**
  * Check if undo stack is empty
  */
 EXPORT bool api_is_undo_stack_empty() {
-    return undoStack.empty();
+    API_ENTRY();
+    return session->undoStack.empty();
 }
 
 /**
  * Get all stack items (for visualization)
  */
 EXPORT const char* api_get_stack_items() {
+    API_ENTRY();
+    TRACE_SCOPE("build_json");
     ostringstream json;
     json << "[";
     
-    Node* current = undoStack.top_node();
     bool first = true;
     
-    while (current != nullptr) {
-        Product item = current->retrieve();
+    for (const UndoEntry& entry : session->undoStack) {
         if (!first) json << ",";
         first = false;
         
-        json << "{\"name\":\"" << item.getName() << "\","
-             << "\"quantity\":" << item.getQuantity() << "}";
-        
-        current = current->next();
+        json << "{\"name\":\"" << entry.name << "\","
+             << "\"quantity\":" << entry.quantity << "}";
     }
     
     json << "]";
@@ -256,151 +761,1995 @@ EXPORT const char* api_get_stack_items() {
  * Clear the undo stack
  */
 EXPORT void api_clear_undo_stack() {
-    undoStack.clear();
+    API_MUTATION();
+    session->undoStack.clear();
+    state->changes.append(session->id, CHANGE_UNDO, CHANGE_CLEAR);
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
-//                    QUEUE OPERATIONS - Checkout (FIFO)
+//                    BATCH OPERATIONS - Many Cart Changes in One Call
 // ═══════════════════════════════════════════════════════════════════════════════
 
-/**
- * Move all cart items to checkout queue (FIFO)
- * Also updates purchase counts in the UNIFIED allItems array
- */
-EXPORT void api_start_checkout() {
-    Node* current = cart.head();
-    
-    while (current != nullptr) {
-        Product item = current->retrieve();
-        checkoutQueue.enqueue(item);
-        
-        int productId = item.getProductId();
-        string itemName = item.getName();
-        int quantity = item.getQuantity();
-        
-        // UNIFIED APPROACH: All items go into the same array
-        // - If item exists (by ID or name): increment purchase count
-        // - If new custom item: add to array with new ID
-        if (productId >= 0 && productId < 1000) {
-            // Default item (ID 0-9) - increment by ID
-            for (int i = 0; i < quantity; i++) {
-                allItems.incrementPurchaseCountById(productId);
-            }
-        } else {
-            // Custom item - add or update by name
-            allItems.addOrUpdateItem(itemName, quantity, productId);
-        }
-        
-        current = current->next();
+enum CartOpKind {
+    CART_OP_ADD = 0,      // name, quantity, productId (like api_add_to_cart)
+    CART_OP_REMOVE = 1,   // position (1-indexed), or name when position <= 0
+    CART_OP_UNDO = 2,     // like api_undo_last_action
+    CART_OP_CLEAR = 3     // clears cart AND undo stack (like /api/cart/clear)
+};
+
+// One operation of a batch (plain C layout so ctypes can build arrays of it)
+struct CartOp {
+    int kind;
+    const char* name;
+    int quantity;
+    int productId;
+    int position;
+};
+
+// Cart and undo stack contents, kept only while a batch may still fail
+struct CartSnapshot {
+    vector<Product> cartItems;    // head -> tail
+    vector<uint64_t> cartHandles; // handle of each cart line, so a rollback keeps them
+    vector<UndoEntry> stackItems; // top -> bottom
+};
+
+static void take_snapshot(CartSnapshot& snapshot) {
+    const LinkedList<Product>& cart = session->cart;
+    for (LinkedList<Product>::const_iterator line = cart.begin(); line != cart.end(); ++line) {
+        snapshot.cartItems.push_back(*line);
+        snapshot.cartHandles.push_back(cart.handle_of(line));
     }
-    
-    // Sort is already done inside addOrUpdateItem/incrementPurchaseCountById
-    cart.clear();
-    undoStack.clear();
+    for (const UndoEntry& entry : session->undoStack) snapshot.stackItems.push_back(entry);
 }
 
-/**
- * Get checkout queue size
- */
-EXPORT int api_get_queue_size() {
-    return checkoutQueue.size();
+// Rebuild both structures; cart lines get their old handles back
+static void restore_snapshot(const CartSnapshot& snapshot) {
+    count_cart_lines(session->cart, -1);
+    session->cart.clear();
+    session->undoStack.clear();
+    for (size_t i = 0; i < snapshot.cartItems.size(); i++) {
+        session->cart.restore_at_tail(snapshot.cartItems[i], snapshot.cartHandles[i]);
+    }
+    count_cart_lines(session->cart, 1);
+    for (size_t i = snapshot.stackItems.size(); i-- > 0;) session->undoStack.push(snapshot.stackItems[i]);
 }
 
-/**
- * Process checkout - dequeue all items (FIFO) and return receipt
- */
-EXPORT const char* api_process_checkout() {
-    ostringstream json;
-    json << "{\"items\":[";
-    
-    int totalItems = 0;
-    bool first = true;
-    
-    while (!checkoutQueue.empty()) {
-        Product item = checkoutQueue.dequeue();
-        totalItems += item.getQuantity();
-        
-        if (!first) json << ",";
-        first = false;
-        
-        json << "{\"name\":\"" << item.getName() << "\","
-             << "\"quantity\":" << item.getQuantity() << "}";
+static const char* cart_op_name(int kind) {
+    switch (kind) {
+        case CART_OP_ADD: return "add";
+        case CART_OP_REMOVE: return "remove";
+        case CART_OP_UNDO: return "undo";
+        case CART_OP_CLEAR: return "clear";
+        default: return "unknown";
     }
-    
-    json << "],\"totalItems\":" << totalItems << "}";
-    
-    return string_to_cstr(json.str());
 }
 
 /**
- * Get all queue items (for visualization)
+ * Apply `count` operations atomically: either all succeed, or the cart and
+ * undo stack are left exactly as they were.
+ *
+ * Ops that cannot fail once validated (add) are applied directly; if the
+ * batch contains an op that can fail against the current state (remove,
+ * undo) or destroys state (clear), both structures are snapshotted first
+ * and restored on failure.
+ *
+ * Returns {"applied":bool,"failedAt":index|-1,"results":[...],
+ *          "summary":{added,removed,undone,cleared,cartSize,totalQuantity}}
  */
-EXPORT const char* api_get_queue_items() {
+EXPORT const char* api_apply_batch(const CartOp* ops, int count) {
+    CommitWait commitWait;
+    API_ENTRY();
+    if (ops == nullptr || count < 0) count = 0;
+
+    // Stateless validation first - a bad add never touches anything
+    int failedAt = -1;
+    string error;
+    bool needsSnapshot = false;
+    for (int i = 0; i < count && failedAt < 0; i++) {
+        const CartOp& op = ops[i];
+        if (op.kind == CART_OP_ADD) {
+            if (op.name == nullptr || op.name[0] == '\0') { failedAt = i; error = "name is required"; }
+            else if (!item_name_fits(op.name)) { failedAt = i; error = "name is too long"; }
+            else if (op.quantity < 1) { failedAt = i; error = "quantity must be at least 1"; }
+        } else if (op.kind == CART_OP_REMOVE) {
+            if (op.position <= 0 && (op.name == nullptr || op.name[0] == '\0')) {
+                failedAt = i;
+                error = "position or name is required";
+            }
+            needsSnapshot = true;
+        } else if (op.kind == CART_OP_UNDO || op.kind == CART_OP_CLEAR) {
+            needsSnapshot = true;
+        } else {
+            failedAt = i;
+            error = "unknown op kind";
+        }
+    }
+
+    CartSnapshot snapshot;
+    if (failedAt < 0 && needsSnapshot) take_snapshot(snapshot);
+
+    int added = 0, removed = 0, undone = 0;
+    bool cleared = false;
+    TRACE_SCOPE("build_json");
+    ostringstream results;
+    for (int i = 0; i < count && failedAt < 0; i++) {
+        const CartOp& op = ops[i];
+        if (i > 0) results << ",";
+        results << "{\"op\":\"" << cart_op_name(op.kind) << "\"";
+
+        if (op.kind == CART_OP_ADD) {
+            Product product(op.name, op.quantity, op.productId);
+            int linesBefore = session->cart.size();
+            session->cart.push_item(product);
+            if (session->cart.size() > linesBefore) count_cart_line(product.nameRef(), 1);
+            session->undoStack.push(UndoEntry(product));
+            added++;
+            results << ",\"name\":\"" << product.getName() << "\",\"quantity\":" << product.getQuantity();
+        } else if (op.kind == CART_OP_REMOVE) {
+            if (op.position > 0) {
+                if (op.position > session->cart.size()) { failedAt = i; error = "position out of range"; break; }
+                Product gone = session->cart.delete_at_position(op.position);
+                count_cart_line(gone.nameRef(), -1);
+                results << ",\"name\":\"" << gone.getName() << "\",\"quantity\":" << gone.getQuantity();
+            } else {
+                LinkedList<Product>::iterator line = session->cart.find(op.name);
+                if (line == session->cart.end()) { failedAt = i; error = "item not in cart"; break; }
+                Product gone;
+                session->cart.delete_by_handle(session->cart.handle_of(line), &gone);
+                count_cart_line(gone.nameRef(), -1);
+                results << ",\"name\":\"" << gone.getName() << "\",\"quantity\":" << gone.getQuantity();
+            }
+            removed++;
+        } else if (op.kind == CART_OP_UNDO) {
+            if (session->undoStack.empty()) { failedAt = i; error = "No actions to undo"; break; }
+            UndoEntry lastAction = session->undoStack.pop();
+            if (session->cart.delete_by_name(lastAction.name.str())) count_cart_line(lastAction.name, -1);
+            undone++;
+            results << ",\"name\":\"" << lastAction.name << "\",\"quantity\":" << lastAction.quantity;
+        } else {
+            count_cart_lines(session->cart, -1);
+            session->cart.clear();
+            session->undoStack.clear();
+            cleared = true;
+        }
+        results << ",\"ok\":true}";
+    }
+
     ostringstream json;
-    json << "[";
-    
-    Node* current = checkoutQueue.front_node();
-    bool first = true;
-    
-    while (current != nullptr) {
-        Product item = current->retrieve();
-        if (!first) json << ",";
-        first = false;
-        
-        json << "{\"name\":\"" << item.getName() << "\","
-             << "\"quantity\":" << item.getQuantity() << "}";
-        
-        current = current->next();
+    json << "{\"applied\":" << (failedAt < 0 ? "true" : "false")
+         << ",\"failedAt\":" << failedAt;
+    if (failedAt >= 0) {
+        if (needsSnapshot) restore_snapshot(snapshot);
+        // On failure report only the failing op; nothing else took effect
+        json << ",\"error\":\"" << error << "\",\"results\":[{\"op\":\""
+             << cart_op_name(ops[failedAt].kind) << "\",\"ok\":false,\"error\":\"" << error << "\"}]";
+        added = removed = undone = 0;
+        cleared = false;
+    } else {
+        replicate_whole_cart();   // the ops above edited the list directly
+        if (count > 0) {
+            state->changes.append(session->id, CHANGE_ALL, CHANGE_BATCH, string(), count);
+            commitWait.mark();   // a rejected or rolled-back batch left nothing to persist
+        }
+        json << ",\"results\":[" << results.str() << "]";
     }
-    
-    json << "]";
+    json << ",\"summary\":{\"added\":" << added
+         << ",\"removed\":" << removed
+         << ",\"undone\":" << undone
+         << ",\"cleared\":" << (cleared ? "true" : "false")
+         << ",\"cartSize\":" << session->cart.size()
+         << ",\"totalQuantity\":" << session->cart.total_quantity() << "}}";
     return string_to_cstr(json.str());
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
-//                    DATA RESTORATION FUNCTIONS
+//                    CART REPLICATION - CRDT Merge with Offline Devices
 // ═══════════════════════════════════════════════════════════════════════════════
 
-/**
- * Restore an item with its purchase count (for data persistence)
- * Works with UNIFIED storage - all items in one array
+/*
+ * session->replicatedCart mirrors the cart list as a CRDT (ReplicatedCart.h).
+ * Every edit made here is recorded as a change by this store's replica, and
+ * deltas merged from devices are written back into the list, so the list
+ * (handles, positions, undo, checkout) stays the cart everyone else reads.
  */
-EXPORT void api_restore_custom_item(const char* name, int purchaseCount, int itemId) {
-    // Try to find by ID first
-    int index = allItems.findById(itemId);
-    
-    if (index != -1) {
-        // Item found by ID - increment its purchase count
-        for (int j = 0; j < purchaseCount; j++) {
-            allItems.incrementPurchaseCountById(itemId);
+
+// Record the list's current quantity of `name` as this replica's edit
+static void replicate_cart_line(const string& name) {
+    LinkedList<Product>::iterator line = session->cart.find(name);
+    int quantity = (line == session->cart.end()) ? 0 : line->getQuantity();
+    session->replicatedCart.setQuantity(name.data(), name.size(), quantity);
+}
+
+// Same for every line, and drop replicated lines the list no longer has
+static void replicate_whole_cart() {
+    ReplicatedCart& replica = session->replicatedCart;
+    for (LinkedList<Product>::iterator line = session->cart.begin(); line != session->cart.end(); ++line) {
+        const InlineName& name = line->nameRef();
+        replica.setQuantity(name.c_str(), name.size(), line->getQuantity());
+    }
+    for (int line = 0; line < replica.lineCapacity(); line++) {
+        if (!replica.lineInUse(line) || replica.quantity(line) <= 0) continue;
+        if (session->cart.find(replica.lineName(line).str()) == session->cart.end()) replica.removeLine(line);
+    }
+}
+
+// Bring the list line for a merged replicated line up to date (no undo entry)
+static void apply_replicated_line(int line) {
+    string name = session->replicatedCart.lineName(line).str();
+    int quantity = session->replicatedCart.quantity(line);
+    LinkedList<Product>::iterator existing = session->cart.find(name);
+    if (quantity <= 0) {
+        if (existing != session->cart.end()) {
+            count_cart_line(existing->nameRef(), -1);
+            session->cart.delete_by_handle(session->cart.handle_of(existing));
         }
+    } else if (existing != session->cart.end()) {
+        existing->setQuantity(quantity);
     } else {
-        // Item not found - add it as new custom item
-        allItems.addOrUpdateItem(name, purchaseCount, itemId);
+        int rank = state->allItems.findByName(name);
+        Product product(name, quantity, rank < 0 ? -1 : state->allItems.getItem(rank).id);
+        session->cart.push_item(product);
+        count_cart_line(product.nameRef(), 1);
+    }
+}
+
+/**
+ * Merge a cart delta from a device (edits it made, possibly offline) and
+ * return the changes that device has not seen yet, both in the GCD1 text
+ * encoding described in core/ReplicatedCart.h. Only the lines the delta
+ * names are touched, so a merge costs O(delta), not O(cart). A delta built
+ * before this store restarted is answered with the full state, unapplied.
+ *
+ * Returns {"error":...} (JSON, not a delta) if the delta is malformed.
+ */
+EXPORT const char* api_merge_cart_delta(const char* delta) {
+    CommitWait commitWait;
+    API_ENTRY();
+    CartDelta parsed;
+    string error;
+    if (!ReplicatedCart::parseDelta(delta != nullptr ? delta : "", parsed, error)) {
+        return string_to_cstr("{\"error\":\"" + error + "\"}");
     }
+    vector<int> touched;
+    session->replicatedCart.apply(parsed, touched);
+    for (int line : touched) {
+        apply_replicated_line(line);
+        int quantity = session->replicatedCart.quantity(line);
+        state->changes.append(session->id, CHANGE_CART, quantity > 0 ? CHANGE_UPDATE : CHANGE_REMOVE,
+                              session->replicatedCart.lineName(line), quantity > 0 ? quantity : 0);
+    }
+    if (!touched.empty()) commitWait.mark();
+
+    TRACE_SCOPE("build_json");
+    string reply;
+    session->replicatedCart.writeDelta(reply, parsed.sender, parsed.epoch, parsed.since);
+    return string_to_cstr(reply);
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
-//                    UTILITY FUNCTIONS
+//                    CHANGE NOTIFICATIONS - Callbacks and Pollable Handles
 // ═══════════════════════════════════════════════════════════════════════════════
+//
+// Cart, undo and checkout mutations append a compact record to
+// state->changes. When the outermost StateLock is released, records this
+// process has not delivered yet are rendered to JSON (only if someone is
+// listening, so the hot paths stay allocation-free) and handed to every
+// subscribed callback in seq order, outside the state lock. Pollable
+// handles (Linux eventfd) are signalled instead; their owner then calls
+// api_read_changes() with the last seq it saw. With shared state, changes
+// made by other processes reach this process's subscribers on its next
+// API call, so pollers should also read on a timeout.
+
+typedef void (*ChangeCallback)(const char* record, void* context);
+
+struct ChangeSubscriber {
+    int id;
+    ChangeCallback callback;
+    void* context;
+};
+
+static recursive_mutex changeSubscribersLock;   // held while delivering
+static vector<ChangeSubscriber> changeSubscribers;
+static vector<int> changeFds;
+static int nextSubscriberId = 1;
+static atomic<int> changeListeners(0);
+static bool deliveringChanges = false;
+
+static mutex changeQueueLock;                   // rendered, not yet delivered
+static vector<string> changeQueue;
+static uint64_t changesDelivered = 0;           // guarded by the state lock
 
 /**
- * Reset all data structures (keeps items but clears cart/undo/queue)
+ * Queue records added since the last call (runs as the outermost StateLock
+ * is released). Returns whether there is anything to deliver.
  */
-EXPORT void api_reset_all() {
-    cart.clear();
-    undoStack.clear();
-    checkoutQueue.clear();
+static bool collect_changes() {
+    uint64_t from = changesDelivered;
+    uint64_t latest = state->changes.latest();
+    changesDelivered = latest;
+    if (latest == from || changeListeners.load() == 0) return false;
+
+    lock_guard<mutex> guard(changeQueueLock);
+    if (from + 1 < state->changes.oldest() || from > latest) {
+        // Fell out of the ring: subscribers must re-read everything
+        ChangeRecord reset = ChangeRecord();
+        reset.seq = latest;
+        reset.kind = CHANGE_ALL;
+        reset.op = CHANGE_RESET;
+        changeQueue.push_back(string());
+        ChangeLog::writeJson(changeQueue.back(), reset);
+        return true;
+    }
+    for (uint64_t seq = from + 1; seq <= latest; seq++) {
+        changeQueue.push_back(string());
+        ChangeLog::writeJson(changeQueue.back(), state->changes.at(seq));
+    }
+    return true;
 }
 
-/**
- * Factory reset - clear everything and reset purchase counts to zero
+static void deliver_changes() {
+    lock_guard<recursive_mutex> guard(changeSubscribersLock);
+    // A callback that calls back into the API queues its own changes; the
+    // outer loop below delivers them after the current batch, in order
+    if (deliveringChanges) return;
+    deliveringChanges = true;
+    vector<string> batch;
+    for (;;) {
+        {
+            lock_guard<mutex> queued(changeQueueLock);
+            batch.swap(changeQueue);
+        }
+        if (batch.empty()) break;
+        for (const string& record : batch) {
+            for (size_t i = 0; i < changeSubscribers.size(); i++) {
+                changeSubscribers[i].callback(record.c_str(), changeSubscribers[i].context);
+            }
+        }
+#ifdef __linux__
+        uint64_t one = 1;
+        for (int fd : changeFds) {
+            ssize_t ignored = write(fd, &one, sizeof(one));   // EAGAIN: counter already high
+            (void)ignored;
+        }
+#endif
+        batch.clear();
+    }
+    deliveringChanges = false;
+}
+
+/**
+ * Call `callback` with each change record (JSON, valid only during the
+ * call) after the mutation that made it returns. It runs on the thread
+ * that made the change, without the state lock, so it may call the API.
+ * Returns a subscription id for api_unsubscribe_changes.
+ */
+EXPORT int api_subscribe_changes(ChangeCallback callback, void* context) {
+    API_ENTRY_UNLOCKED();
+    if (callback == nullptr) return -1;
+    lock_guard<recursive_mutex> guard(changeSubscribersLock);
+    ChangeSubscriber subscriber = {nextSubscriberId++, callback, context};
+    changeSubscribers.push_back(subscriber);
+    changeListeners++;
+    return subscriber.id;
+}
+
+/**
+ * Remove a subscription. Once this returns, its callback is not running
+ * and will not be called again (unless called from that callback).
+ */
+EXPORT void api_unsubscribe_changes(int id) {
+    API_ENTRY_UNLOCKED();
+    lock_guard<recursive_mutex> guard(changeSubscribersLock);
+    for (size_t i = 0; i < changeSubscribers.size(); i++) {
+        if (changeSubscribers[i].id == id) {
+            changeSubscribers.erase(changeSubscribers.begin() + i);
+            changeListeners--;
+            return;
+        }
+    }
+}
+
+/**
+ * A non-blocking eventfd that becomes readable when changes are made; read
+ * 8 bytes to reset it, then call api_read_changes. Returns -1 where eventfd
+ * is not available (poll api_read_changes instead).
+ */
+EXPORT int api_open_change_fd() {
+    API_ENTRY_UNLOCKED();
+#ifdef __linux__
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0) return -1;
+    lock_guard<recursive_mutex> guard(changeSubscribersLock);
+    changeFds.push_back(fd);
+    changeListeners++;
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+EXPORT void api_close_change_fd(int fd) {
+    API_ENTRY_UNLOCKED();
+    lock_guard<recursive_mutex> guard(changeSubscribersLock);
+    for (size_t i = 0; i < changeFds.size(); i++) {
+        if (changeFds[i] == fd) {
+            changeFds.erase(changeFds.begin() + i);
+            changeListeners--;
+#ifdef __linux__
+            close(fd);
+#endif
+            return;
+        }
+    }
+}
+
+/**
+ * Seq of the latest change (0 before any)
+ */
+EXPORT unsigned long long api_get_change_seq() {
+    API_ENTRY();
+    return state->changes.latest();
+}
+
+/**
+ * Changes after seq `after`: {"seq":latest,"gap":false,"changes":[...]}.
+ * "gap" is true when some of them are no longer kept (or `after` is from
+ * before a restart); the caller should then re-read everything. Only the
+ * selected session's changes are listed (api_select_session).
+ */
+EXPORT const char* api_read_changes(unsigned long long after) {
+    API_ENTRY();
+    uint64_t latest = state->changes.latest();
+    bool gap = after > latest || (after < latest && after + 1 < state->changes.oldest());
+
+    TRACE_SCOPE("build_json");
+    string json = "{\"seq\":" + to_string(latest) + ",\"gap\":" + (gap ? "true" : "false") + ",\"changes\":[";
+    if (!gap) {
+        bool first = true;
+        for (uint64_t seq = after + 1; seq <= latest; seq++) {
+            const ChangeRecord& record = state->changes.at(seq);
+            if (!ChangeLog::visibleTo(record, session->id)) continue;
+            if (!first) json += ",";
+            first = false;
+            ChangeLog::writeJson(json, record);
+        }
+    }
+    json += "]}";
+    return string_to_cstr(json);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    ITEM STORE CAPACITY - LFU Eviction and Spill
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// A cart or checkout-queue line naming `name` appeared (+1) or went away (-1);
+// every place that adds or drops a line calls this, so item_in_use is O(1)
+static void count_cart_line(const InlineName& name, int delta) {
+    state->allItems.countCartLine(name.c_str(), name.size(), delta);
+}
+
+// Every line of a cart or checkout queue (e.g. just before it is cleared)
+template <typename Lines>
+static void count_cart_lines(const Lines& lines, int delta) {
+    for (const Product& line : lines) count_cart_line(line.nameRef(), delta);
+}
+
+// True if any session's cart or checkout queue has a line naming this item
+static bool item_in_use(const FrequentItem& item) {
+    return item.cartLines > 0;
+}
+
+// Evict one custom item that is not in use, spilling it if a spill file is set
+static bool evict_one_item() {
+    FrequentItem victim;
+    if (!state->allItems.evictCustom(item_in_use, &victim)) return false;
+    double now = currentTimeSeconds();
+    itemSpill.spill(victim, state->allItems.recentScoreOf(victim, now), now);
+    return true;
+}
+
+// Make room for one more custom item; false if every custom item is in use
+static bool make_item_room() {
+    while (state->allItems.isFull()) {
+        if (!evict_one_item()) return false;
+    }
+    return true;
+}
+
+/**
+ * Bring an evicted item back from the spill file with its id, lifetime
+ * count and recent score. False if it was not spilled or there is no room.
+ */
+static bool restore_spilled_item(const string& name) {
+    SpilledItem spilled;
+    if (!itemSpill.take(name.data(), name.size(), spilled)) return false;
+    if (!make_item_room()) {
+        FrequentItem item(spilled.id, spilled.name, spilled.purchaseCount, true);
+        itemSpill.spill(item, spilled.recentScore, spilled.spilledAt);
+        return false;
+    }
+    int id = state->allItems.addOrUpdateItem(spilled.name, spilled.purchaseCount, spilled.id, false);
+    state->allItems.restoreRecentScoreById(id, spilled.recentScore, spilled.spilledAt);
+    METRIC_ADD(METRIC_ITEM_RESTORES, 1);
+    return true;
+}
+
+/**
+ * Keep at most `capacity` custom items (clamped to 1..MAX_CUSTOM_ITEMS) and
+ * evict down to it now. Base-catalog items and items in the cart or the
+ * checkout queue are never evicted. Returns the number of items evicted
+ */
+EXPORT int api_set_custom_item_capacity(int capacity) {
+    API_MUTATION();
+    state->allItems.setCustomCapacity(capacity);
+    int evicted = 0;
+    while (state->allItems.overCapacity() && evict_one_item()) evicted++;
+    return evicted;
+}
+
+/**
+ * Spill evicted custom items to the file at `path`, created if missing; items
+ * already in it are restored when bought again. nullptr or "" stops
+ * spilling. The file is per process. Returns false if it cannot be opened
+ */
+EXPORT bool api_set_item_spill(const char* path) {
+    API_ENTRY();
+    if (path == nullptr || path[0] == '\0') {
+        itemSpill.close();
+        return true;
+    }
+    return itemSpill.open(path);
+}
+
+/**
+ * Item store size, capacity, evictions and spill file counters, as JSON
+ */
+EXPORT const char* api_get_item_store_stats() {
+    API_ENTRY();
+    TRACE_SCOPE("build_json");
+    const FrequentItemsArray& items = state->allItems;
+    ostringstream json;
+    json << "{\"items\":" << items.totalSize() << ","
+         << "\"customItems\":" << items.customSize() << ","
+         << "\"customCapacity\":" << items.customCapacity() << ","
+         << "\"evictions\":" << items.evictionCount() << ","
+         << "\"storageBytes\":" << items.storageBytes() << ","
+         << "\"spill\":{\"enabled\":" << (itemSpill.enabled() ? "true" : "false") << ","
+         << "\"path\":\"" << itemSpill.path() << "\","
+         << "\"items\":" << itemSpill.size() << ","
+         << "\"spilled\":" << itemSpill.spilled() << ","
+         << "\"restored\":" << itemSpill.restored() << ","
+         << "\"indexBytes\":" << itemSpill.memoryBytes() << "}}";
+    return string_to_cstr(json.str());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    QUEUE OPERATIONS - Checkout (FIFO)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Count a purchase of a custom item
+ * - Already in state->allItems, or evicted and spilled: exact update (a
+ *   spilled item is restored first)
+ * - Heavy-hitter mode off: added exactly, evicting another custom item if full
+ * - Otherwise: counted in the fixed-memory sketch, and promoted into state->allItems
+ *   once its guaranteed count beats the last displayed frequent item
+ * Returns the item's ID, or -1 while it is only tracked by the sketch (or
+ * the store is full of items in use)
+ */
+static int record_custom_purchase(const string& name, int quantity, int productId) {
+    bool known = state->allItems.findByName(name) != -1 || restore_spilled_item(name);
+    if (!state->heavyHitterMode || known) {
+        if (!known && !make_item_room()) return -1;
+        return state->allItems.addOrUpdateItem(name, quantity, productId);
+    }
+    
+    int slot = customSketch.add(name, quantity);
+    const HeavyHitter& entry = customSketch.get(slot);
+    if (entry.guaranteed() <= state->allItems.getLastItem().purchaseCount) {
+        return -1;
+    }
+    
+    // Promote with the lower-bound count; only this purchase counts as recent
+    if (!make_item_room()) return -1;
+    int id = state->allItems.addOrUpdateItem(entry.name, (int)entry.guaranteed(), productId, false);
+    if (id != -1) {
+        state->allItems.recordRecentPurchase(state->allItems.findById(id), quantity);
+        customSketch.remove(slot);
+    }
+    return id;
+}
+
+/**
+ * Move all cart items to checkout queue (FIFO)
+ * The cart's node chain is spliced onto the queue in O(1) - no node is
+ * copied or freed - and purchase counts in the UNIFIED state->allItems array are
+ * updated by walking the moved chain (which also appends each line to the
+ * purchase history and its rollups)
+ */
+EXPORT void api_start_checkout() {
+    API_MUTATION();
+    TRACE_SCOPE("checkout_loop");
+    LinkedList<Product>::chain_type chain = session->cart.release_chain();
+    session->replicatedCart.clear();
+    state->changes.append(session->id, CHANGE_CHECKOUT, CHANGE_START, string(), (int)chain.count);
+    // Queued first, so eviction (item_in_use) sees this basket's items as in use
+    session->checkoutQueue.append_chain(chain);
+    vector<int> basketIds;
+    basketIds.reserve(chain.count);
+    int64_t checkoutTime = (int64_t)currentTimeSeconds();
+    uint32_t basket = history.beginSession();
+    
+    for (const Product& item : chain) {
+        int productId = item.getProductId();
+        int quantity = item.getQuantity();
+        
+        // UNIFIED APPROACH: All items go into the same array
+        // - If item exists (by ID or name): increment purchase count
+        // - If new custom item: add to array with new ID
+        if (isCatalogId(productId)) {
+            // Base-catalog item - increment by ID
+            state->allItems.incrementPurchaseCountById(productId, quantity);
+            basketIds.push_back(productId);
+        } else {
+            // Custom item - add or update by name
+            basketIds.push_back(record_custom_purchase(item.getName(), quantity, productId));
+        }
+        uint32_t symbol = itemSymbols.intern(item.getName());
+        history.append(checkoutTime, symbol, quantity, basket);
+        rollups.record(checkoutTime, symbol, quantity);
+        record_purchase_delta(item);
+    }
+    
+    // Remember which items were bought together
+    coPurchases.recordBasket(basketIds.data(), (int)basketIds.size());
+    
+    // Sort is already done inside addOrUpdateItem/incrementPurchaseCountById
+    session->undoStack.clear();
+}
+
+/**
+ * Get checkout queue size
+ */
+EXPORT int api_get_queue_size() {
+    API_ENTRY();
+    return session->checkoutQueue.size();
+}
+
+/**
+ * Process checkout - dequeue all items (FIFO) and return receipt
+ */
+EXPORT const char* api_process_checkout() {
+    API_MUTATION();
+    TRACE_SCOPE("build_json");
+    ostringstream json;
+    json << "{\"items\":[";
+    
+    int totalItems = 0;
+    bool first = true;
+    
+    while (!session->checkoutQueue.empty()) {
+        Product item = session->checkoutQueue.dequeue();
+        count_cart_line(item.nameRef(), -1);
+        totalItems += item.getQuantity();
+        
+        if (!first) json << ",";
+        first = false;
+        
+        json << "{\"name\":\"" << item.getName() << "\","
+             << "\"quantity\":" << item.getQuantity() << "}";
+    }
+    
+    json << "],\"totalItems\":" << totalItems << "}";
+    if (!first) state->changes.append(session->id, CHANGE_CHECKOUT, CHANGE_DONE, string(), totalItems);
+    
+    return string_to_cstr(json.str());
+}
+
+/**
+ * Get all queue items (for visualization)
+ */
+EXPORT const char* api_get_queue_items() {
+    API_ENTRY();
+    TRACE_SCOPE("build_json");
+    ostringstream json;
+    json << "[";
+    
+    bool first = true;
+    
+    for (const Product& item : session->checkoutQueue) {
+        if (!first) json << ",";
+        first = false;
+        
+        json << "{\"name\":\"" << item.nameRef() << "\","
+             << "\"quantity\":" << item.getQuantity() << "}";
+    }
+    
+    json << "]";
+    return string_to_cstr(json.str());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    PURCHASE DELTAS - One Ranking Across Shards
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// Each shard of a partitioned deployment counts its own checkouts, but the
+// top items should rank every shard's purchases. Once a router has called
+// api_take_purchase_deltas, checkouts also add their lines to a pending
+// table. The router takes it every second or so and hands each shard the
+// other shards' lines (api_apply_purchase_deltas), which are counted like
+// a checkout's but not recorded again, so nothing echoes back. Only the
+// ranking is shared; history, rollups and bought-together stay per shard.
+
+struct PurchaseDelta {
+    int productId;     // base-catalog id, or -1 (custom ids differ between shards)
+    long long quantity;
+};
+
+const int MAX_DELTA_QUANTITY = 1000000;   // per line applied (counted one by one, like a checkout)
+
+static bool purchaseDeltasOn = false;                        // guarded by the state lock
+static unordered_map<string, PurchaseDelta> purchaseDeltas;  // by item name, since the last take
+
+// Called for each line of a checkout
+static void record_purchase_delta(const Product& item) {
+    if (!purchaseDeltasOn) return;
+    PurchaseDelta& delta = purchaseDeltas[item.getName()];
+    delta.productId = isCatalogId(item.getProductId()) ? item.getProductId() : -1;
+    delta.quantity += item.getQuantity();
+}
+
+/**
+ * Lines bought here since the last call, {"items":[{"name","product_id",
+ * "quantity"}]}, and start recording them if this is the first call
+ */
+EXPORT const char* api_take_purchase_deltas() {
+    API_ENTRY();
+    purchaseDeltasOn = true;
+    TRACE_SCOPE("build_json");
+    ostringstream json;
+    json << "{\"items\":[";
+    bool first = true;
+    for (const auto& entry : purchaseDeltas) {
+        json << (first ? "" : ",") << "{\"name\":\"" << entry.first << "\","
+             << "\"product_id\":" << entry.second.productId << ","
+             << "\"quantity\":" << entry.second.quantity << "}";
+        first = false;
+    }
+    json << "]}";
+    purchaseDeltas.clear();
+    return string_to_cstr(json.str());
+}
+
+/**
+ * Count other shards' purchases in the item store: an
+ * api_take_purchase_deltas document, possibly with several shards' lines
+ * in its one items array. Lines with an empty or over-long name are
+ * skipped. Returns the number of lines counted, or -1 if
+ * the document is malformed.
+ */
+EXPORT int api_apply_purchase_deltas(const char* document) {
+    CommitWait commitWait;
+    API_ENTRY();
+    JsonValue parsed;
+    string text = (document != nullptr) ? document : "";
+    JsonReader reader(text);
+    if (!reader.parse(parsed) || parsed.type != JsonValue::OBJECT) return -1;
+    const JsonValue* items = parsed.get("items");
+    if (items == nullptr || items->type != JsonValue::ARRAY) return -1;
+
+    int counted = 0;
+    for (const JsonValue& item : items->items) {
+        string name = item.stringOr("name", "");
+        int productId = (int)item.numberOr("product_id", -1);
+        double quantity = item.numberOr("quantity", 0);
+        if (name.empty() || !item_name_fits(name) || quantity < 1 || quantity > MAX_DELTA_QUANTITY) continue;
+        if (isCatalogId(productId)) {
+            state->allItems.incrementPurchaseCountById(productId, (int)quantity);
+        } else {
+            record_custom_purchase(name, (int)quantity, -1);
+        }
+        counted++;
+    }
+    if (counted > 0) commitWait.mark();
+    return counted;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    STREAMING - Cart Listings and Receipts in Chunks
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// api_get_cart_items / api_process_checkout build the whole document in one
+// ostringstream plus one malloc'd copy, so memory and time-to-first-byte grow
+// with the order. A stream cursor writes the same JSON into a buffer the
+// caller owns, one bounded chunk per call; the library keeps only the cursor.
+//
+//   int stream = api_stream_open(STREAM_RECEIPT);
+//   while ((n = api_stream_next(stream, buffer, sizeof(buffer))) > 0) send(buffer, n);
+//
+// A receipt dequeues each item only once it is written, so an abandoned
+// receipt leaves the rest in the queue. A cart listing takes the state lock
+// per chunk, not for the whole listing: it resumes from the handle of the
+// next unwritten line, so lines edited between chunks are never repeated.
+// A stream reads the session selected when it was opened.
+
+enum StreamKind {
+    STREAM_CART = 0,       // same array as api_get_cart_items
+    STREAM_RECEIPT = 1     // same object as api_process_checkout
+};
+
+enum StreamStage { STREAM_HEAD, STREAM_BODY, STREAM_TAIL, STREAM_DONE };
+
+const int MAX_STREAMS = 64;             // open cursors per process
+const int STREAM_SLOT_BITS = 8;
+const int STREAM_MIN_CHUNK = 256;       // room for any single line (names are <= 63 bytes)
+
+struct StreamCursor {
+    int kind;              // StreamKind, -1 = free slot
+    int stage;             // StreamStage
+    uint32_t generation;   // high bits of the id, so a reused slot rejects old ids
+    uint64_t nextHandle;   // cart: first line of the next chunk
+    int written;           // elements written so far
+    long long totalItems;  // receipt: summed quantities
+    CartSession* cart;     // the session selected when it was opened (kept while open)
+
+    StreamCursor() : kind(-1), stage(STREAM_HEAD), generation(0),
+                     nextHandle(INVALID_CART_HANDLE), written(0), totalItems(0), cart(nullptr) {}
+};
+
+static StreamCursor streams[MAX_STREAMS];   // per process, guarded by the state lock
+static uint32_t streamGeneration = 0;
+
+// Fills a caller-owned buffer; each piece goes in whole or not at all
+struct ChunkWriter {
+    char* out;
+    int capacity;
+    int used;
+
+    bool put(const char* text, int length) {
+        if (length < 0 || used + length > capacity) return false;
+        memcpy(out + used, text, (size_t)length);
+        used += length;
+        return true;
+    }
+};
+
+static StreamCursor* find_stream(int id) {
+    if (id < 0) return nullptr;
+    int slot = id & ((1 << STREAM_SLOT_BITS) - 1);
+    if (slot >= MAX_STREAMS) return nullptr;
+    StreamCursor& cursor = streams[slot];
+    return (cursor.kind >= 0 && cursor.generation == (uint32_t)(id >> STREAM_SLOT_BITS)) ? &cursor : nullptr;
+}
+
+static void write_cart_chunk(StreamCursor& cursor, ChunkWriter& out) {
+    if (cursor.stage == STREAM_HEAD && out.put("[", 1)) cursor.stage = STREAM_BODY;
+    if (cursor.stage == STREAM_BODY) {
+        const LinkedList<Product>& cart = cursor.cart->cart;
+        LinkedList<Product>::const_iterator line = cart.begin();
+        if (cursor.nextHandle != INVALID_CART_HANDLE) {
+            // Continue at that line; if it was removed, at the same position
+            int position = cart.position_of(cursor.nextHandle);
+            line = cart.line_at(position > 0 ? position : cursor.written + 1);
+        }
+        char piece[STREAM_MIN_CHUNK];
+        for (; line != cart.end(); ++line) {
+            uint64_t handle = cart.handle_of(line);
+            int length = snprintf(piece, sizeof(piece),
+                                  "%s{\"name\":\"%s\",\"quantity\":%d,\"product_id\":%d,\"handle\":%llu}",
+                                  cursor.written > 0 ? "," : "", line->nameRef().c_str(),
+                                  line->getQuantity(), line->getProductId(), (unsigned long long)handle);
+            if (!out.put(piece, length)) {
+                cursor.nextHandle = handle;
+                return;
+            }
+            cursor.written++;
+        }
+        cursor.stage = STREAM_TAIL;
+    }
+    if (cursor.stage == STREAM_TAIL && out.put("]", 1)) cursor.stage = STREAM_DONE;
+}
+
+static void write_receipt_chunk(StreamCursor& cursor, ChunkWriter& out) {
+    const char head[] = "{\"items\":[";
+    if (cursor.stage == STREAM_HEAD && out.put(head, (int)sizeof(head) - 1)) cursor.stage = STREAM_BODY;
+    char piece[STREAM_MIN_CHUNK];
+    if (cursor.stage == STREAM_BODY) {
+        Queue<Product>& queue = cursor.cart->checkoutQueue;
+        while (!queue.empty()) {
+            const Product& item = *queue.begin();
+            int length = snprintf(piece, sizeof(piece), "%s{\"name\":\"%s\",\"quantity\":%d}",
+                                  cursor.written > 0 ? "," : "", item.nameRef().c_str(), item.getQuantity());
+            if (!out.put(piece, length)) return;
+            cursor.written++;
+            cursor.totalItems += item.getQuantity();
+            count_cart_line(item.nameRef(), -1);
+            queue.dequeue();
+        }
+        if (cursor.written > 0) {
+            state->changes.append(cursor.cart->id, CHANGE_CHECKOUT, CHANGE_DONE, string(), (int)cursor.totalItems);
+        }
+        cursor.stage = STREAM_TAIL;
+    }
+    if (cursor.stage == STREAM_TAIL) {
+        int length = snprintf(piece, sizeof(piece), "],\"totalItems\":%lld}", cursor.totalItems);
+        if (out.put(piece, length)) cursor.stage = STREAM_DONE;
+    }
+}
+
+/**
+ * Open a stream (StreamKind); returns its id, or -1 for an unknown kind or
+ * when MAX_STREAMS are already open
+ */
+EXPORT int api_stream_open(int kind) {
+    API_ENTRY();
+    if (kind != STREAM_CART && kind != STREAM_RECEIPT) return -1;
+    for (int slot = 0; slot < MAX_STREAMS; slot++) {
+        if (streams[slot].kind >= 0) continue;
+        streamGeneration = (streamGeneration + 1) & 0x7FFFFF;
+        if (streamGeneration == 0) streamGeneration = 1;
+        streams[slot] = StreamCursor();
+        streams[slot].kind = kind;
+        streams[slot].generation = streamGeneration;
+        streams[slot].cart = session;
+        return (int)(streamGeneration << STREAM_SLOT_BITS) | slot;
+    }
+    return -1;
+}
+
+/**
+ * Write the next chunk (at most `capacity` bytes, not NUL-terminated) into
+ * buffer. Returns its length; 0 once the document is complete (the stream
+ * is then closed); -1 for an unknown stream or capacity < STREAM_MIN_CHUNK.
+ */
+EXPORT int api_stream_next(int stream, char* buffer, int capacity) {
+    CommitWait commitWait;
+    API_ENTRY();
+    StreamCursor* cursor = find_stream(stream);
+    if (cursor == nullptr || buffer == nullptr || capacity < STREAM_MIN_CHUNK) return -1;
+
+    TRACE_SCOPE("stream_chunk");
+    ChunkWriter out = {buffer, capacity, 0};
+    if (cursor->kind == STREAM_CART) {
+        write_cart_chunk(*cursor, out);
+    } else {
+        int written = cursor->written;
+        write_receipt_chunk(*cursor, out);
+        if (cursor->written != written) commitWait.mark();   // lines left the (persisted) queue
+    }
+    if (out.used == 0 && cursor->stage == STREAM_DONE) {
+        cursor->kind = -1;
+        release_if_idle(cursor->cart);
+        return 0;
+    }
+    METRIC_ADD(METRIC_STREAM_CHUNKS, 1);
+    METRIC_ADD(METRIC_STREAM_BYTES, out.used);
+    return out.used;
+}
+
+/**
+ * Close a stream before it is complete (no-op for a finished or unknown id)
+ */
+EXPORT void api_stream_close(int stream) {
+    API_ENTRY();
+    StreamCursor* cursor = find_stream(stream);
+    if (cursor != nullptr) {
+        cursor->kind = -1;
+        release_if_idle(cursor->cart);
+    }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    SESSIONS - Many Carts in One Process
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// In a partitioned deployment (router.cpp) each server process is a shard
+// holding the carts of many shoppers. A caller names its cart with
+// api_select_session(key), per thread: a server selects the request's
+// session before handling it. The outermost StateLock then points `session`
+// at that cart, creating it on first use, and every cart, undo, checkout,
+// change and stream export works on it. Callers that select nothing get
+// state->main, as before. The item store, rankings and analytics are
+// shared by all sessions of a process.
+//
+// A session with nothing in its cart, undo stack or queue, and no device
+// syncing it, is freed as the lock is released, so reads by new visitors
+// leave nothing behind. api_export_session / api_import_session move a session between
+// processes in the data file's JSON form. Sessions are process memory; with
+// a shared segment attached every caller gets the main cart.
+
+const size_t MAX_SESSION_KEY = 64;
+
+static uint32_t nextSessionId = MAIN_SESSION + 1;
+static thread_local string selectedSession;    // api_select_session, "" = main
+
+// 1-64 letters, digits, '-', '_' or '.', so a key is safe in paths, headers and JSON
+static bool valid_session_key(const char* key) {
+    size_t length = strlen(key);
+    if (length == 0 || length > MAX_SESSION_KEY) return false;
+    for (size_t i = 0; i < length; i++) {
+        char c = key[i];
+        if (!isalnum((unsigned char)c) && c != '-' && c != '_' && c != '.') return false;
+    }
+    return true;
+}
+
+// Runs as the outermost state lock is taken
+static CartSession* selected_session() {
+    if (selectedSession.empty() || sharedState.attached()) return &state->main;
+    unordered_map<string, CartSession*>::iterator found = sessions.find(selectedSession);
+    if (found != sessions.end()) return found->second;
+    CartSession* created = new CartSession();
+    created->id = nextSessionId;
+    nextSessionId = (nextSessionId + 1 == ALL_SESSIONS) ? MAIN_SESSION + 1 : nextSessionId + 1;
+    sessions.emplace(selectedSession, created);
+    return created;
+}
+
+// Nothing to keep: no lines, no undo, no queue, and no device has merged into it
+static bool session_idle(const CartSession& cart) {
+    return cart.cart.empty() && cart.undoStack.empty() && cart.checkoutQueue.empty()
+           && cart.replicatedCart.replicaCount() <= 1;
+}
+
+// Free `cart` if it is an idle session that no open stream reads
+static void release_if_idle(CartSession* cart) {
+    if (cart == &state->main || !session_idle(*cart)) return;
+    for (const StreamCursor& cursor : streams) {
+        if (cursor.kind >= 0 && cursor.cart == cart) return;
+    }
+    unordered_map<string, CartSession*>::iterator found = sessions.find(selectedSession);
+    if (found == sessions.end() || found->second != cart) {
+        for (found = sessions.begin(); found != sessions.end() && found->second != cart; ++found) {}
+    }
+    if (found != sessions.end()) sessions.erase(found);
+    if (session == cart) session = &state->main;
+    delete cart;
+}
+
+// Runs as the outermost state lock is released
+static void release_idle_session() {
+    if (session != &state->main) release_if_idle(session);
+}
+
+// Free every session (factory reset); their open streams are closed
+static void drop_all_sessions() {
+    for (StreamCursor& cursor : streams) {
+        if (cursor.kind >= 0 && cursor.cart != &state->main) cursor.kind = -1;
+    }
+    for (const auto& entry : sessions) delete entry.second;
+    sessions.clear();
+    session = &state->main;
+}
+
+// {"cart_items":[...],"undo_stack":[...],"checkout_queue":[...]}; cart_items
+// as in the data file, the undo stack top first, the queue front first
+static void write_session_json(ostringstream& json, const CartSession& cart) {
+    json << "{\"cart_items\":";
+    write_cart_items_json(json, cart.cart);
+    json << ",\"undo_stack\":[";
+    bool first = true;
+    for (const UndoEntry& entry : cart.undoStack) {
+        json << (first ? "" : ",") << "{\"name\":\"" << entry.name << "\",\"quantity\":" << entry.quantity << "}";
+        first = false;
+    }
+    json << "],\"checkout_queue\":[";
+    first = true;
+    for (const Product& line : cart.checkoutQueue) {
+        json << (first ? "" : ",") << "{\"name\":\"" << line.nameRef() << "\","
+             << "\"quantity\":" << line.getQuantity() << ","
+             << "\"product_id\":" << line.getProductId() << "}";
+        first = false;
+    }
+    json << "]}";
+}
+
+/**
+ * Select the cart this thread's later calls work on: `key` names a
+ * session (see valid_session_key), nullptr or "" the main cart. Returns
+ * false for an invalid key or with shared state, which selects the main cart.
+ */
+EXPORT bool api_select_session(const char* key) {
+    API_ENTRY_UNLOCKED();
+    if (key == nullptr || key[0] == '\0' || !valid_session_key(key) || sharedState.attached()) {
+        selectedSession.clear();
+        return key == nullptr || key[0] == '\0';
+    }
+    selectedSession.assign(key);
+    return true;
+}
+
+/**
+ * Keys of the sessions in this process (the main cart is not listed), as a
+ * JSON array
+ */
+EXPORT const char* api_list_sessions() {
+    API_ENTRY();
+    TRACE_SCOPE("build_json");
+    string json = "[";
+    for (const auto& entry : sessions) {
+        if (entry.second == session && session_idle(*session)) continue;   // freed on return
+        if (json.size() > 1) json += ",";
+        json += "\"" + entry.first + "\"";
+    }
+    json += "]";
+    return string_to_cstr(json);
+}
+
+/**
+ * The selected session's cart, undo stack and checkout queue as JSON (see
+ * write_session_json), for api_import_session in another process
+ */
+EXPORT const char* api_export_session() {
+    API_ENTRY();
+    TRACE_SCOPE("build_json");
+    ostringstream json;
+    write_session_json(json, *session);
+    return string_to_cstr(json.str());
+}
+
+/**
+ * Replace the selected session's cart, undo stack and checkout queue with
+ * an api_export_session document. Cart lines keep their handles. Devices
+ * syncing the replicated cart get its full state on their next merge.
+ * Returns false (changing nothing) if the document is malformed or has a
+ * name longer than MAX_ITEM_NAME_BYTES.
+ */
+EXPORT bool api_import_session(const char* document) {
+    CommitWait commitWait;
+    API_ENTRY();
+    JsonValue parsed;
+    string text = (document != nullptr) ? document : "";
+    JsonReader reader(text);
+    if (!reader.parse(parsed) || parsed.type != JsonValue::OBJECT) return false;
+    const char* sections[] = {"cart_items", "undo_stack", "checkout_queue"};
+    for (const char* name : sections) {
+        const JsonValue* section = parsed.get(name);
+        if (section == nullptr) continue;
+        if (section->type != JsonValue::ARRAY) return false;
+        for (const JsonValue& line : section->items) {
+            if (line.type != JsonValue::OBJECT) return false;
+            string name = line.stringOr("name", "");
+            if (name.empty() || !item_name_fits(name)) return false;
+        }
+    }
+
+    count_cart_lines(session->cart, -1);
+    count_cart_lines(session->checkoutQueue, -1);
+    session->cart.clear();
+    session->undoStack.clear();
+    session->checkoutQueue.clear();
+    const JsonValue* cartItems = parsed.get("cart_items");
+    for (size_t i = 0; cartItems != nullptr && i < cartItems->items.size(); i++) {
+        const JsonValue& line = cartItems->items[i];
+        double handle = line.numberOr("handle", 0);
+        // Only handles a list of this size could have issued (slots stay small)
+        uint64_t kept = (handle > 0 && (uint64_t)handle < ((uint64_t)1 << 53)
+                         && ((uint64_t)handle & CART_HANDLE_SLOT_MASK) < (uint64_t)cartItems->items.size() + 1024)
+                        ? (uint64_t)handle : INVALID_CART_HANDLE;
+        Product product(line.stringOr("name", ""), max(1, (int)line.numberOr("quantity", 1)),
+                        (int)line.numberOr("product_id", -1));
+        session->cart.restore_at_tail(product, kept);
+    }
+    const JsonValue* undoStack = parsed.get("undo_stack");
+    for (size_t i = (undoStack != nullptr) ? undoStack->items.size() : 0; i-- > 0;) {
+        const JsonValue& entry = undoStack->items[i];
+        session->undoStack.push(UndoEntry(Product(entry.stringOr("name", ""), (int)entry.numberOr("quantity", 1))));
+    }
+    const JsonValue* queue = parsed.get("checkout_queue");
+    for (size_t i = 0; queue != nullptr && i < queue->items.size(); i++) {
+        const JsonValue& line = queue->items[i];
+        session->checkoutQueue.enqueue(Product(line.stringOr("name", ""), max(1, (int)line.numberOr("quantity", 1)),
+                                               (int)line.numberOr("product_id", -1)));
+    }
+    count_cart_lines(session->cart, 1);
+    count_cart_lines(session->checkoutQueue, 1);
+    session->replicatedCart.clear();
+    replicate_whole_cart();
+    state->changes.append(session->id, CHANGE_ALL, CHANGE_RESET);
+    commitWait.mark();
+    return true;
+}
+
+/**
+ * Empty the selected session (it is then freed); the main cart is only
+ * cleared. Used once a session has been moved to another process.
+ */
+EXPORT void api_drop_session() {
+    API_MUTATION();
+    count_cart_lines(session->cart, -1);
+    count_cart_lines(session->checkoutQueue, -1);
+    session->cart.clear();
+    session->undoStack.clear();
+    session->checkoutQueue.clear();
+    session->replicatedCart.clear();
+    state->changes.append(session->id, CHANGE_ALL, CHANGE_RESET);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    HEAVY HITTERS - Unpromoted Custom Items
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Enable (1) or disable (0) heavy-hitter tracking of new custom items.
+ * When disabled, every custom item goes straight into state->allItems.
+ */
+EXPORT void api_set_heavy_hitter_mode(int enabled) {
+    API_ENTRY();
+    state->heavyHitterMode = (enabled != 0);
+}
+
+/**
+ * Custom items still tracked by the sketch, with their error bounds, as JSON
+ */
+EXPORT const char* api_get_heavy_hitters() {
+    API_ENTRY();
+    TRACE_SCOPE("build_json");
+    ostringstream json;
+    json << "{\"enabled\":" << (state->heavyHitterMode ? "true" : "false") << ","
+         << "\"capacity\":" << customSketch.capacity() << ","
+         << "\"used\":" << customSketch.used() << ","
+         << "\"total\":" << customSketch.total() << ","
+         << "\"errorBound\":" << customSketch.errorBound() << ","
+         << "\"items\":[";
+    
+    bool first = true;
+    for (int slot = 0; slot < customSketch.capacity(); slot++) {
+        const HeavyHitter& entry = customSketch.get(slot);
+        if (entry.key.empty()) continue;
+        if (!first) json << ",";
+        first = false;
+        json << "{\"name\":\"" << entry.name << "\","
+             << "\"count\":" << entry.count << ","
+             << "\"error\":" << entry.error << "}";
+    }
+    
+    json << "]}";
+    return string_to_cstr(json.str());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    RECOMMENDATIONS - Bought Together
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Top `count` items usually bought with the current cart, as JSON array
+ */
+EXPORT const char* api_get_bought_together(int count) {
+    API_ENTRY();
+    if (count < 1) count = 1;
+    if (count > MAX_DISPLAY_ITEMS) count = MAX_DISPLAY_ITEMS;
+    
+    // Resolve cart lines to item IDs (typed custom items have product_id -1)
+    int cartIds[MAX_BASKET_PAIR_ITEMS];
+    int cartCount = 0;
+    for (const Product& item : session->cart) {
+        if (cartCount >= MAX_BASKET_PAIR_ITEMS) break;
+        int id = item.getProductId();
+        if (id < 0) {
+            int index = state->allItems.findByName(item.getName());
+            if (index == -1) continue;
+            id = state->allItems[index].id;
+        }
+        cartIds[cartCount++] = id;
+    }
+    
+    Neighbor top[MAX_DISPLAY_ITEMS];
+    int found = coPurchases.recommend(cartIds, cartCount, top, count);
+    
+    TRACE_SCOPE("build_json");
+    ostringstream json;
+    json << "[";
+    int written = 0;
+    for (int i = 0; i < found; i++) {
+        int index = state->allItems.findById(top[i].id);
+        if (index == -1) continue;
+        if (written++ > 0) json << ",";
+        json << "{\"id\":" << top[i].id << ","
+             << "\"name\":\"" << state->allItems[index].name << "\","
+             << "\"score\":" << top[i].count << "}";
+    }
+    json << "]";
+    return string_to_cstr(json.str());
+}
+
+/**
+ * Size and memory usage of the co-purchase graph, as JSON object
+ */
+EXPORT const char* api_get_copurchase_stats() {
+    API_ENTRY();
+    TRACE_SCOPE("build_json");
+    ostringstream json;
+    json << "{\"baskets\":" << coPurchases.baskets() << ","
+         << "\"trackedItems\":" << coPurchases.trackedItems() << ","
+         << "\"recycledLists\":" << coPurchases.recycledLists() << ","
+         << "\"maxNeighbors\":" << MAX_NEIGHBORS << ","
+         << "\"memoryBytes\":" << coPurchases.memoryBytes() << ","
+         << "\"memoryLimitBytes\":" << CoPurchaseGraph::memoryLimitBytes() << "}";
+    return string_to_cstr(json.str());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    PURCHASE HISTORY - Range Aggregation
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Query bound in whole seconds (rows carry whole seconds), clamped to a sane range
+static int64_t history_seconds(double t, bool roundUp) {
+    if (!(t > 0)) return 0;
+    if (t > 1e12) return (int64_t)1e12;
+    return (int64_t)(roundUp ? ceil(t) : floor(t));
+}
+
+static void write_scan_stats_json(ostringstream& json) {
+    const HistoryScanStats& scan = history.lastScanStats();
+    json << "\"scan\":{\"blocksScanned\":" << scan.blocksScanned << ","
+         << "\"blocksSkipped\":" << scan.blocksSkipped << ","
+         << "\"rowsScanned\":" << scan.rowsScanned << "}";
+}
+
+/**
+ * Top k items by quantity checked out in [from, to) (Unix seconds), as JSON
+ * One scan over the blocks that overlap the range
+ */
+EXPORT const char* api_history_top_items(double from, double to, int k) {
+    API_ENTRY();
+    if (k < 1) k = 1;
+    vector<long long> totals;
+    int64_t start = history_seconds(from, false);
+    int64_t end = history_seconds(to, true);
+    history.sumBySymbol(start, end, itemSymbols.size(), totals);
+    
+    vector<uint32_t> order;
+    for (uint32_t s = 0; s < totals.size(); s++) {
+        if (totals[s] > 0) order.push_back(s);
+    }
+    size_t shown = min(order.size(), (size_t)k);
+    partial_sort(order.begin(), order.begin() + shown, order.end(), [&](uint32_t a, uint32_t b) {
+        return totals[a] != totals[b] ? totals[a] > totals[b] : a < b;
+    });
+    
+    TRACE_SCOPE("build_json");
+    ostringstream json;
+    json << "{\"from\":" << start << ",\"to\":" << end << ",\"items\":[";
+    for (size_t i = 0; i < shown; i++) {
+        if (i > 0) json << ",";
+        json << "{\"name\":\"" << itemSymbols.name(order[i]) << "\","
+             << "\"quantity\":" << totals[order[i]] << "}";
+    }
+    json << "],";
+    write_scan_stats_json(json);
+    json << "}";
+    return string_to_cstr(json.str());
+}
+
+/**
+ * Quantity of one item per bucket of bucketSeconds over [from, to), as JSON
+ * (e.g. bucketSeconds = 604800 for "per week over the last year"). A null or
+ * unknown name gives all-zero buckets.
+ */
+EXPORT const char* api_history_item_series(const char* name, double from, double to, int bucketSeconds) {
+    API_ENTRY();
+    if (name == nullptr) name = "";
+    int64_t start = history_seconds(from, false);
+    int64_t end = history_seconds(to, true);
+    if (bucketSeconds < 1) bucketSeconds = 1;
+    // Cap the response at ~10k buckets
+    if (end > start && (end - start) / bucketSeconds > 10000) {
+        bucketSeconds = (int)((end - start) / 10000) + 1;
+    }
+    vector<long long> buckets;
+    uint32_t symbol = itemSymbols.find(name);
+    if (symbol != SymbolTable::NO_SYMBOL) {
+        history.seriesFor(symbol, start, end, bucketSeconds, buckets);
+    } else if (end > start) {
+        buckets.assign((size_t)((end - start + bucketSeconds - 1) / bucketSeconds), 0);
+    }
+    
+    TRACE_SCOPE("build_json");
+    ostringstream json;
+    long long total = 0;
+    json << "{\"name\":\"" << (symbol != SymbolTable::NO_SYMBOL ? itemSymbols.name(symbol) : string(name)) << "\","
+         << "\"from\":" << start << ",\"bucketSeconds\":" << bucketSeconds << ",\"buckets\":[";
+    for (size_t i = 0; i < buckets.size(); i++) {
+        if (i > 0) json << ",";
+        json << buckets[i];
+        total += buckets[i];
+    }
+    json << "],\"total\":" << total << ",";
+    write_scan_stats_json(json);
+    json << "}";
+    return string_to_cstr(json.str());
+}
+
+/**
+ * Row count, block count and compression of the purchase history, as JSON
+ */
+EXPORT const char* api_history_stats() {
+    API_ENTRY();
+    TRACE_SCOPE("build_json");
+    ostringstream json;
+    long long sealedRows = (long long)history.sealedBlocks() * HISTORY_BLOCK_ROWS;
+    json << "{\"rows\":" << history.rows() << ","
+         << "\"symbols\":" << itemSymbols.size() << ","
+         << "\"sealedBlocks\":" << history.sealedBlocks() << ","
+         << "\"blockRows\":" << HISTORY_BLOCK_ROWS << ","
+         << "\"compressedBytes\":" << history.compressedBytes() << ","
+         << "\"bytesPerRow\":" << (sealedRows > 0 ? (double)history.compressedBytes() / sealedRows : 0.0) << ","
+         << "\"memoryBytes\":" << history.memoryBytes() + itemSymbols.memoryBytes() << "}";
+    return string_to_cstr(json.str());
+}
+
+/**
+ * Write the purchase history to a binary file (atomically, via path.tmp)
+ */
+EXPORT bool api_history_save(const char* path) {
+    API_ENTRY();
+    return history.save(path, itemSymbols);
+}
+
+/**
+ * Replace the purchase history with one saved by api_history_save
+ * The rollups are rebuilt from the rows their rings still cover
+ */
+EXPORT bool api_history_load(const char* path) {
+    API_ENTRY();
+    if (!history.load(path, itemSymbols)) return false;
+    rollups.clear();
+    int64_t from = (int64_t)currentTimeSeconds() - rollups.maxWindowSeconds();
+    history.forEachRow(from, [](int64_t ts, uint32_t symbol, int32_t quantity) {
+        rollups.record(ts, symbol, quantity);
+    });
+    return true;
+}
+
+/**
+ * Top k items over the last windowSeconds (e.g. 86400 = today), as JSON
+ * Merges the pre-aggregated buckets of one rollup ring:
+ * O(buckets x ROLLUP_BUCKET_ITEMS), independent of the number of purchases
+ */
+EXPORT const char* api_top_items_window(int windowSeconds, int k) {
+    API_ENTRY();
+    if (k < 1) k = 1;
+    if (k > ROLLUP_BUCKET_ITEMS) k = ROLLUP_BUCKET_ITEMS;
+    vector<RollupItem> top;
+    RollupWindow window = rollups.topItems((long long)currentTimeSeconds(), windowSeconds, k, top);
+    const RollupLevel& level = rollups.level(window.level);
+    
+    TRACE_SCOPE("build_json");
+    ostringstream json;
+    json << "{\"window\":" << windowSeconds << ","
+         << "\"level\":\"" << level.name << "\","
+         << "\"bucketSeconds\":" << level.seconds << ","
+         << "\"from\":" << window.from << ","
+         << "\"buckets\":" << window.buckets << ","
+         << "\"exact\":" << (window.exact ? "true" : "false") << ","
+         << "\"items\":[";
+    for (size_t i = 0; i < top.size(); i++) {
+        if (i > 0) json << ",";
+        json << "{\"name\":\"" << itemSymbols.name(top[i].symbol) << "\","
+             << "\"quantity\":" << top[i].quantity << ","
+             << "\"error\":" << top[i].error << "}";
+    }
+    json << "]}";
+    return string_to_cstr(json.str());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    DATA RESTORATION FUNCTIONS
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Restore an item with its purchase count (for data persistence)
+ * Works with UNIFIED storage - all items in one array; over-long names are ignored
+ */
+EXPORT void api_restore_custom_item(const char* name, int purchaseCount, int itemId) {
+    API_ENTRY();
+    if (name == nullptr || !item_name_fits(name)) return;
+    // Try to find by ID first
+    int index = state->allItems.findById(itemId);
+    
+    if (index != -1) {
+        // Item found by ID - restore its lifetime purchase count
+        state->allItems.restorePurchaseCountById(itemId, purchaseCount);
+    } else if (make_item_room()) {
+        // Item not found - add it as new custom item
+        state->allItems.addOrUpdateItem(name, purchaseCount, itemId, false);
+    }
+}
+
+/**
+ * Restore an item's recent popularity score saved `secondsAgo` seconds ago
+ */
+EXPORT void api_restore_item_popularity(int itemId, double recentScore, double secondsAgo) {
+    API_ENTRY();
+    state->allItems.restoreRecentScoreById(itemId, recentScore, currentTimeSeconds() - secondsAgo);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    CATALOG IMPORT - Bulk Load From CSV / TSV
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Import a store export (format: see CatalogImport.h) into the item store.
+ * The file is mapped and tokenized on `threads` threads (<= 0 = one per
+ * core) before the state lock is taken; the store is then built in one
+ * pass, ranked once and persisted as a single change.
+ * Returns a JSON report including rows/s and MB/s
+ */
+EXPORT const char* api_import_catalog(const char* path, int threads) {
+    API_ENTRY_UNLOCKED();
+    CatalogImport import;
+    CommitWait commitWait;
+    if (import.parse(path == nullptr ? "" : path, threads)) {
+        StateLock stateLock;
+        import.build(state->allItems);
+        commitWait.mark();
+    }
+    const CatalogImportReport& report = import.report();
+
+    TRACE_SCOPE("build_json");
+    ostringstream json;
+    json << "{\"success\":" << (report.ok ? "true" : "false") << ",";
+    if (report.error != nullptr) json << "\"error\":\"" << report.error << "\",";
+    json << "\"bytes\":" << report.bytes << ","
+         << "\"rows\":" << report.rows << ","
+         << "\"added\":" << report.added << ","
+         << "\"merged\":" << report.merged << ","
+         << "\"skipped\":" << report.skipped << ","
+         << "\"rejected\":" << report.rejected << ","
+         << "\"threads\":" << report.threads << ","
+         << "\"parseMs\":" << report.parseSeconds * 1000.0 << ","
+         << "\"buildMs\":" << report.buildSeconds * 1000.0 << ","
+         << "\"rowsPerSec\":" << (long long)report.rowsPerSecond() << ","
+         << "\"mbPerSec\":" << report.megabytesPerSecond() << ","
+         << "\"items\":" << state->allItems.totalSize() << "}";
+    return string_to_cstr(json.str());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    UTILITY FUNCTIONS
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Reset all data structures (keeps items but clears cart/undo/queue) of
+ * the selected session
+ */
+EXPORT void api_reset_all() {
+    API_MUTATION();
+    count_cart_lines(session->cart, -1);
+    count_cart_lines(session->checkoutQueue, -1);
+    session->cart.clear();
+    session->replicatedCart.clear();
+    session->undoStack.clear();
+    session->checkoutQueue.clear();
+    state->changes.append(session->id, CHANGE_ALL, CHANGE_RESET);
+}
+
+/**
+ * Factory reset - clear everything (every session) and reset purchase
+ * counts to zero
  */
 EXPORT void api_factory_reset() {
-    cart.clear();
-    undoStack.clear();
-    checkoutQueue.clear();
-    allItems.resetToDefaults();
+    API_MUTATION();
+    drop_all_sessions();
+    session->cart.clear();
+    session->replicatedCart.clear();
+    session->undoStack.clear();
+    session->checkoutQueue.clear();
+    state->changes.append(ALL_SESSIONS, CHANGE_ALL, CHANGE_RESET);
+    purchaseDeltas.clear();
+    state->allItems.resetToDefaults();
+    coPurchases.clear();
+    customSketch.clear();
+    history.clear();
+    rollups.clear();
+    itemSymbols.clear();
+    itemSpill.clear();
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    SHARED STATE - Multi-process Deployments
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Fingerprint of what a segment holds; builds with other sizes refuse to attach
+static uint64_t shared_state_layout() {
+    const size_t sizes[] = {sizeof(LibraryState), sizeof(FrequentItem),
+                            sizeof(LinkedList<Product>::node_type), sizeof(UndoEntry),
+                            sizeof(IndexEntry<LinkedList<Product>::node_type>), sizeof(CartEntry),
+                            sizeof(CartLineState), sizeof(SegmentHeader)};
+    uint64_t layout = 1;
+    for (size_t size : sizes) layout = layout * 1000003ULL + size;
+    return layout;
+}
+
+/**
+ * Move the item store, cart, undo stack and checkout queue into the POSIX
+ * shared-memory segment `name` (e.g. "/grocery"), creating it with
+ * `megabytes` of space if it does not exist yet.
+ *
+ * Returns 1 if this process created the segment (its state starts at the
+ * defaults, so load the saved data into it), 2 if it attached to a segment
+ * that was already initialized (nothing is rebuilt), 0 on failure and -1
+ * where shared memory is not supported. Call it once, before anything else:
+ * state built up before the call stays in this process, unused.
+ *
+ * Co-purchase counts, the heavy-hitter sketch, purchase history, rollups,
+ * metrics and traces stay per process. A new segment starts with
+ * heavy-hitter mode off, so custom items are counted in the shared store
+ * instead of one worker's sketch.
+ */
+EXPORT int api_attach_shared_state(const char* name, int megabytes) {
+    API_ENTRY();
+    if (name == nullptr || megabytes <= 0 || sharedState.attached()) return SEGMENT_FAILED;
+    int result = sharedState.open(name, (size_t)megabytes << 20, shared_state_layout());
+    if (result != SEGMENT_CREATED && result != SEGMENT_ATTACHED) return result;
+
+    activeStateArena() = sharedState.arena();
+    if (result == SEGMENT_CREATED) {
+        LibraryState* shared = new (stateAllocate(sizeof(LibraryState))) LibraryState();
+        shared->heavyHitterMode = false;
+        sharedState.setRoot(shared);
+        sharedState.commitCreated();
+    }
+    state = (LibraryState*)sharedState.root();
+    session = &state->main;
+    changesDelivered = state->changes.latest();   // subscribers start from here
+    return result;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    PERSISTENCE - Background Group Commit
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * The data file contents, in the format server.py's load_all_data() reads
+ * (runs on the persistence thread). "sessions" holds each session's
+ * api_export_session document by key.
+ */
+static string persisted_state_json() {
+    StateLock lock;
+    TRACE_SCOPE("persist_snapshot");
+    time_t now = time(nullptr);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
+
+    ostringstream json;
+    json << "{\"frequent_items\":";
+    write_ranked_items_json(json, RANK_BY_LIFETIME);
+    json << ",\"cart_items\":";
+    write_cart_items_json(json, state->main.cart);
+    json << ",\"sessions\":{";
+    bool first = true;
+    for (const auto& entry : sessions) {
+        if (session_idle(*entry.second)) continue;
+        json << (first ? "\"" : ",\"") << entry.first << "\":";
+        write_session_json(json, *entry.second);
+        first = false;
+    }
+    json << "},\"last_updated\":\"" << stamp << "\"}";
+    return json.str();
+}
+
+/**
+ * Persist the items and cart to `path` from a background thread.
+ *
+ * Every export that changes them marks the state dirty and returns at once;
+ * the thread waits windowMs for more changes, then writes one snapshot
+ * (temp file, fsync, rename). With durable != 0 those exports return only
+ * after the commit that covers them. An empty path stops the thread after
+ * a final commit. Call after loading the saved data.
+ */
+EXPORT void api_set_persistence(const char* path, int windowMs, int durable) {
+    API_ENTRY_UNLOCKED();
+    if (path == nullptr || path[0] == '\0') {
+        persistence.stop();
+        return;
+    }
+    persistence.start(path, windowMs, durable != 0, persisted_state_json);
+}
+
+/**
+ * Barrier: returns once every change made before the call is on disk
+ * (true), or its write failed (false). Immediate when persistence is off.
+ */
+EXPORT bool api_flush() {
+    API_ENTRY_UNLOCKED();
+    return persistence.waitFor(persistence.pendingSeq(), true);
+}
+
+/**
+ * Persistence thread settings and counters, as JSON
+ */
+EXPORT const char* api_get_persistence_stats() {
+    API_ENTRY_UNLOCKED();
+    GroupCommitStats stats = persistence.stats();
+    TRACE_SCOPE("build_json");
+    ostringstream json;
+    json << "{\"running\":" << (stats.running ? "true" : "false") << ","
+         << "\"path\":\"" << persistence.target() << "\","
+         << "\"windowMs\":" << stats.windowMs << ","
+         << "\"durable\":" << (stats.durable ? "true" : "false") << ","
+         << "\"pending\":" << stats.pending << ","
+         << "\"mutations\":" << stats.mutations << ","
+         << "\"commits\":" << stats.commits << ","
+         << "\"failures\":" << stats.failures << ","
+         << "\"mutationsPerCommit\":" << (stats.commits ? (double)stats.mutations / stats.commits : 0.0) << ","
+         << "\"lastCommitUs\":" << stats.lastCommitUs << ","
+         << "\"maxCommitUs\":" << stats.maxCommitUs << ","
+         << "\"lastBytes\":" << stats.lastBytes << "}";
+    return string_to_cstr(json.str());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    MEMORY ACCOUNTING
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static void write_memory_stats_json(ostringstream& json, const MemoryStats& stats) {
+    json << "{\"live\":" << stats.live << ","
+         << "\"bytes\":" << stats.bytes << ","
+         << "\"peakLive\":" << stats.peakLive << ","
+         << "\"peakBytes\":" << stats.peakBytes << "}";
+}
+
+/**
+ * Live objects, bytes and high-water marks of every data structure, as JSON
+ */
+EXPORT const char* api_get_memory_stats() {
+    API_ENTRY();
+    TRACE_SCOPE("build_json");
+    ostringstream json;
+    json << "{\"cart\":";
+    write_memory_stats_json(json, session->cart.memory_stats());
+    json << ",\"undoStack\":";
+    write_memory_stats_json(json, session->undoStack.memory_stats());
+    json << ",\"checkoutQueue\":";
+    write_memory_stats_json(json, session->checkoutQueue.memory_stats());
+    json << ",\"items\":{\"slots\":" << MAX_TOTAL_ITEMS << ","
+         << "\"used\":" << state->allItems.totalSize() << ","
+         << "\"peakUsed\":" << state->allItems.peakSize() << ","
+         << "\"capacity\":" << state->allItems.capacity() << ","
+         << "\"bytes\":" << state->allItems.storageBytes() << "}";
+    json << ",\"cartIndex\":{\"lines\":" << session->cart.line_index().size() << ","
+         << "\"bytes\":" << session->cart.line_index().memoryBytes() << "}";
+    json << ",\"replicatedCart\":{\"lines\":" << session->replicatedCart.lineTotal() << ","
+         << "\"tombstones\":" << session->replicatedCart.tombstoneCount() << ","
+         << "\"replicas\":" << session->replicatedCart.replicaCount() << ","
+         << "\"version\":" << session->replicatedCart.currentVersion() << ","
+         << "\"bytes\":" << session->replicatedCart.memoryBytes() << "}";
+    json << ",\"coPurchase\":{\"bytes\":" << coPurchases.memoryBytes() << "}";
+    json << ",\"heavyHitters\":{\"bytes\":" << customSketch.memoryBytes() << "}";
+    json << ",\"history\":{\"rows\":" << history.rows() << ","
+         << "\"bytes\":" << history.memoryBytes() + itemSymbols.memoryBytes() << "}";
+    json << ",\"rollups\":{\"bytes\":" << rollups.memoryBytes() << "}";
+    json << ",\"sessions\":{\"count\":" << sessions.size() << "}";
+    json << ",\"sharedState\":{\"attached\":" << (sharedState.attached() ? "true" : "false");
+    if (sharedState.attached()) {
+        const SegmentHeader* segment = sharedState.segmentHeader();
+        json << ",\"name\":\"" << sharedState.name() << "\","
+             << "\"segmentBytes\":" << segment->bytes << ","
+             << "\"arenaBytes\":" << segment->arena.capacityBytes() << ","
+             << "\"reservedBytes\":" << segment->arena.reservedBytes() << ","
+             << "\"usedBytes\":" << segment->arena.usedBytes() << ","
+             << "\"attaches\":" << segment->attaches << ","
+             << "\"ownerRecoveries\":" << segment->ownerRecoveries;
+    }
+    json << "}}";
+    return string_to_cstr(json.str());
+}
+
+/**
+ * Run the steady-state hot-path operations and count the heap allocations
+ * (operator new) each one makes, against its declared budget.
+ *
+ * WARNING: clears the cart, undo stack and queue, and adds purchases of the
+ * audit items. Only meant for test builds made with -DGROCERY_ALLOC_AUDIT.
+ */
+EXPORT const char* api_run_allocation_audit() {
+#ifdef GROCERY_ALLOC_AUDIT
+    struct AuditResult {
+        const char* operation;
+        long long allocations;
+        long long budget;
+    };
+    // Budgets: one Node per new cart line / undo entry / queue line. Item
+    // names are short enough for the small-string buffer, so they add nothing.
+    // The JSON builders allocate for the ostringstream buffer and its copy.
+    const long long BUDGET_ADD_EXISTING = 1;   // undo node
+    const long long BUDGET_ADD_NEW_LINE = 2;   // cart node + undo node
+    const long long BUDGET_UNDO = 2;           // result JSON
+    const long long BUDGET_CART_READ = 2;      // result JSON
+    const long long BUDGET_CHECKOUT = 4;       // basket ids (cart nodes are spliced, not copied)
+                                               // + ranking snapshot and its two documents
+    const long long BUDGET_STREAM_CHUNK = 0;   // writes into the caller's buffer
+
+    api_reset_all();
+    // Warm-up: make every audit item known so checkout takes the steady path
+    api_add_to_cart("Milk", 1, 0);
+    api_add_to_cart("Bread", 1, 1);
+    api_start_checkout();
+    free((void*)api_process_checkout());
+
+    const int AUDIT_OPERATIONS = 6;
+    AuditResult results[AUDIT_OPERATIONS];
+    long long before;
+
+    api_add_to_cart("Milk", 1, 0);
+    before = auditAllocations;
+    api_add_to_cart("Milk", 1, 0);
+    results[0] = {"add_existing_line", auditAllocations - before, BUDGET_ADD_EXISTING};
+
+    before = auditAllocations;
+    api_add_to_cart("Bread", 1, 1);
+    results[1] = {"add_new_line", auditAllocations - before, BUDGET_ADD_NEW_LINE};
+
+    before = auditAllocations;
+    const char* undone = api_undo_last_action();
+    results[2] = {"undo", auditAllocations - before, BUDGET_UNDO};
+    free((void*)undone);
+
+    before = auditAllocations;
+    const char* items = api_get_cart_items();
+    results[3] = {"cart_read", auditAllocations - before, BUDGET_CART_READ};
+    free((void*)items);
+
+    char chunk[STREAM_MIN_CHUNK];
+    int stream = api_stream_open(STREAM_CART);
+    before = auditAllocations;
+    api_stream_next(stream, chunk, sizeof(chunk));
+    results[5] = {"stream_cart_chunk", auditAllocations - before, BUDGET_STREAM_CHUNK};
+    api_stream_close(stream);
+
+    api_add_to_cart("Bread", 1, 1);
+    before = auditAllocations;
+    api_start_checkout();
+    results[4] = {"start_checkout_2_lines", auditAllocations - before, BUDGET_CHECKOUT};
+    free((void*)api_process_checkout());
+    api_reset_all();
+
+    ostringstream json;
+    bool pass = true;
+    json << "{\"enabled\":true,\"operations\":[";
+    for (int i = 0; i < AUDIT_OPERATIONS; i++) {
+        bool ok = results[i].allocations <= results[i].budget;
+        pass = pass && ok;
+        if (i > 0) json << ",";
+        json << "{\"operation\":\"" << results[i].operation << "\","
+             << "\"allocations\":" << results[i].allocations << ","
+             << "\"budget\":" << results[i].budget << ","
+             << "\"pass\":" << (ok ? "true" : "false") << "}";
+    }
+    json << "],\"pass\":" << (pass ? "true" : "false") << "}";
+    return string_to_cstr(json.str());
+#else
+    return string_to_cstr("{\"enabled\":false}");
+#endif
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    METRICS (build with -DGROCERY_METRICS)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * All counters and per-function latency percentiles as one JSON object
+ */
+EXPORT const char* api_get_metrics() {
+#ifdef GROCERY_METRICS
+    MetricsRegistry& registry = metricsRegistry();
+    TRACE_SCOPE("build_json");
+    ostringstream json;
+    json << "{\"enabled\":true,\"counters\":{";
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+        if (c > 0) json << ",";
+        json << "\"" << metricCounterName(c) << "\":"
+             << registry.counters[c].load(memory_order_relaxed);
+    }
+    json << "},\"functions\":[";
+    
+    int apiCount = min(registry.apiCount.load(), MAX_API_METRICS);
+    bool first = true;
+    for (int i = 0; i < apiCount; i++) {
+        const ApiMetric* metric = registry.apis[i];
+        if (metric == nullptr) continue;
+        uint64_t calls = metric->calls.load(memory_order_relaxed);
+        if (!first) json << ",";
+        first = false;
+        json << "{\"name\":\"" << metric->name << "\","
+             << "\"calls\":" << calls << ","
+             << "\"meanNs\":" << (calls ? metric->totalNs.load(memory_order_relaxed) / calls : 0) << ","
+             << "\"p50Ns\":" << metric->percentileNs(0.50) << ","
+             << "\"p99Ns\":" << metric->percentileNs(0.99) << ","
+             << "\"p999Ns\":" << metric->percentileNs(0.999) << "}";
+    }
+    json << "]}";
+    return string_to_cstr(json.str());
+#else
+    return string_to_cstr("{\"enabled\":false}");
+#endif
+}
+
+/**
+ * Same data in Prometheus text exposition format (for a /metrics route)
+ */
+EXPORT const char* api_get_metrics_text() {
+    ostringstream text;
+#ifdef GROCERY_METRICS
+    MetricsRegistry& registry = metricsRegistry();
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+        text << "# TYPE grocery_" << metricCounterName(c) << "_total counter\n"
+             << "grocery_" << metricCounterName(c) << "_total "
+             << registry.counters[c].load(memory_order_relaxed) << "\n";
+    }
+    
+    int apiCount = min(registry.apiCount.load(), MAX_API_METRICS);
+    text << "# TYPE grocery_api_latency_seconds summary\n";
+    for (int i = 0; i < apiCount; i++) {
+        const ApiMetric* metric = registry.apis[i];
+        if (metric == nullptr) continue;
+        const double quantiles[] = {0.5, 0.99, 0.999};
+        for (double q : quantiles) {
+            text << "grocery_api_latency_seconds{function=\"" << metric->name
+                 << "\",quantile=\"" << q << "\"} "
+                 << metric->percentileNs(q) / 1e9 << "\n";
+        }
+        text << "grocery_api_latency_seconds_sum{function=\"" << metric->name << "\"} "
+             << metric->totalNs.load(memory_order_relaxed) / 1e9 << "\n"
+             << "grocery_api_latency_seconds_count{function=\"" << metric->name << "\"} "
+             << metric->calls.load(memory_order_relaxed) << "\n";
+    }
+#else
+    text << "# grocery_api built without GROCERY_METRICS\n";
+#endif
+    return string_to_cstr(text.str());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    TRACING (build with -DGROCERY_TRACING)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Start (1) or stop (0) recording trace events
+ */
+EXPORT void api_set_tracing(int enabled) {
+#ifdef GROCERY_TRACING
+    setTracing(enabled != 0);
+#else
+    (void)enabled;
+#endif
+}
+
+/**
+ * Record a begin ('B') or end ('E') event from the caller (e.g. Python).
+ * The name is copied once into an intern table.
+ */
+EXPORT void api_trace_event(const char* name, char phase) {
+#ifdef GROCERY_TRACING
+    if (tracingEnabled() && (phase == 'B' || phase == 'E')) {
+        traceEvent(internTraceName(name), phase);
+    }
+#else
+    (void)name;
+    (void)phase;
+#endif
+}
+
+/**
+ * All buffered events as Chrome trace-event JSON
+ */
+EXPORT const char* api_dump_trace() {
+#ifdef GROCERY_TRACING
+    return string_to_cstr(dumpTraceJson());
+#else
+    return string_to_cstr("{\"traceEvents\":[]}");
+#endif
+}
+
+/**
+ * Drop all buffered events
+ */
+EXPORT void api_clear_trace() {
+#ifdef GROCERY_TRACING
+    clearTrace();
+#endif
 }
 
 /**
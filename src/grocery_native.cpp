@@ -0,0 +1,670 @@
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                           SMART GROCERY CART
+ *                    Data Structures Project - Air University
+ *                              3rd Semester
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * FILE: grocery_native.cpp
+ * PURPOSE: CPython extension module - the library without ctypes
+ *
+ * server.py imports this module instead of loading the DLL through ctypes
+ * when it has been built. It compiles the library source in (one shared
+ * object, its own state), and offers the same api_* functions with the same
+ * arguments, so the routes do not care which binding they got:
+ *
+ * - String arguments may be str (read in place as UTF-8) or bytes
+ * - Text results come back as bytes, like ctypes' c_char_p, and the
+ *   library's copy is freed (ctypes leaves it allocated)
+ * - api_get_cart_items, api_get_stack_items and api_get_queue_items return
+ *   lists of dicts built straight from the containers - no JSON in between
+ * - ranked_items(mode) returns the lock-free ranking snapshot as a list of
+ *   dicts (server.py's read_ranked_items)
+ * - api_subscribe_changes takes any Python callable(record, context)
+ * - Buffers (api_read_ranked_items, api_stream_next, api_apply_batch) are
+ *   anything with the buffer protocol, e.g. ctypes string buffers and arrays
+ *
+ * The GIL is released for every library call, as ctypes.CDLL does, so a
+ * checkout, import or durable commit does not stall other request threads.
+ * Builders wait for the state lock without the GIL and take it back only to
+ * create objects, so no thread ever waits on a library lock holding the GIL.
+ *
+ * COMPILATION (Linux, from src/):
+ *   g++ -O2 -std=c++17 -pthread -shared -fPIC -fvisibility=hidden $(python3-config --includes) \
+ *       -o grocery_native$(python3-config --extension-suffix) grocery_native.cpp
+ *
+ * bench/bench_binding.py compares per-call overhead with the ctypes binding.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <unordered_map>
+
+// The whole library, so the builders can walk its containers
+#include "grocery_api_new.cpp"
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                           CONVERSIONS
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Run a library call with the GIL released
+#define WITHOUT_GIL(statement) do { Py_BEGIN_ALLOW_THREADS statement; Py_END_ALLOW_THREADS } while (0)
+
+/**
+ * O& converter for string arguments: str (its cached UTF-8, no copy),
+ * bytes, or None (nullptr). The pointer stays valid while the argument lives.
+ */
+static int textArgument(PyObject* object, void* out) {
+    const char** text = (const char**)out;
+    if (object == Py_None) {
+        *text = nullptr;
+    } else if (PyUnicode_Check(object)) {
+        *text = PyUnicode_AsUTF8(object);
+    } else if (PyBytes_Check(object)) {
+        *text = PyBytes_AS_STRING(object);
+    } else {
+        PyErr_Format(PyExc_TypeError, "expected str or bytes, got %s", Py_TYPE(object)->tp_name);
+        return 0;
+    }
+    return *text != nullptr;
+}
+
+// A library-allocated string as bytes (freed here); None for nullptr
+static PyObject* takeText(const char* text) {
+    if (text == nullptr) Py_RETURN_NONE;
+    PyObject* result = PyBytes_FromString(text);
+    free((void*)text);
+    return result;
+}
+
+static PyObject* nameObject(const InlineName& name) {
+    return PyUnicode_DecodeUTF8(name.c_str(), (Py_ssize_t)name.size(), "replace");
+}
+
+// Dict keys, interned once at import
+static PyObject* keyName;
+static PyObject* keyQuantity;
+static PyObject* keyProductId;
+static PyObject* keyHandle;
+static PyObject* keyId;
+static PyObject* keyPurchaseCount;
+static PyObject* keyRecentScore;
+static PyObject* keyCategory;
+static PyObject* keyIsCustom;
+
+// Store `value` (a new reference, may be NULL) under `key`; false on error
+static bool setField(PyObject* dict, PyObject* key, PyObject* value) {
+    if (value == nullptr) return false;
+    int failed = PyDict_SetItem(dict, key, value);
+    Py_DECREF(value);
+    return failed == 0;
+}
+
+// Append `item` (a new reference, may be NULL) to list; false on error
+static bool appendItem(PyObject* list, PyObject* item) {
+    if (item == nullptr) return false;
+    int failed = PyList_Append(list, item);
+    Py_DECREF(item);
+    return failed == 0;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    BUILDERS - Lists and Dicts From the Containers
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Run `build` under the state lock, holding the GIL only while it runs.
+ * Returns its result (NULL with an exception set on failure).
+ */
+template <typename Build>
+static PyObject* buildLocked(Build build) {
+    PyObject* result = nullptr;
+    PyThreadState* saved = PyEval_SaveThread();
+    {
+        StateLock stateLock;
+        PyEval_RestoreThread(saved);
+        result = build();
+        saved = PyEval_SaveThread();
+    }   // unlocked (and changes delivered) without the GIL
+    PyEval_RestoreThread(saved);
+    return result;
+}
+
+// [{"name", "quantity", "product_id", "handle"}] - same as api_get_cart_items
+static PyObject* cartItems() {
+    const LinkedList<Product>& cart = session->cart;
+    PyObject* list = PyList_New(0);
+    for (LinkedList<Product>::const_iterator line = cart.begin(); list != nullptr && line != cart.end(); ++line) {
+        PyObject* item = PyDict_New();
+        bool ok = item != nullptr
+                  && setField(item, keyName, nameObject(line->nameRef()))
+                  && setField(item, keyQuantity, PyLong_FromLong(line->getQuantity()))
+                  && setField(item, keyProductId, PyLong_FromLong(line->getProductId()))
+                  && setField(item, keyHandle, PyLong_FromUnsignedLongLong(cart.handle_of(line)));
+        if (!ok) Py_XDECREF(item);
+        if (!ok || !appendItem(list, item)) Py_CLEAR(list);
+    }
+    return list;
+}
+
+// [{"name", "quantity"}], top first - same as api_get_stack_items
+static PyObject* stackItems() {
+    PyObject* list = PyList_New(0);
+    for (const UndoEntry& entry : session->undoStack) {
+        if (list == nullptr) break;
+        PyObject* item = PyDict_New();
+        bool ok = item != nullptr
+                  && setField(item, keyName, nameObject(entry.name))
+                  && setField(item, keyQuantity, PyLong_FromLong(entry.quantity));
+        if (!ok) Py_XDECREF(item);
+        if (!ok || !appendItem(list, item)) Py_CLEAR(list);
+    }
+    return list;
+}
+
+// [{"name", "quantity"}], front first - same as api_get_queue_items
+static PyObject* queueItems() {
+    PyObject* list = PyList_New(0);
+    for (const Product& line : session->checkoutQueue) {
+        if (list == nullptr) break;
+        PyObject* item = PyDict_New();
+        bool ok = item != nullptr
+                  && setField(item, keyName, nameObject(line.nameRef()))
+                  && setField(item, keyQuantity, PyLong_FromLong(line.getQuantity()));
+        if (!ok) Py_XDECREF(item);
+        if (!ok || !appendItem(list, item)) Py_CLEAR(list);
+    }
+    return list;
+}
+
+static PyObject* frequentItemObject(const FrequentItem& frequent, double recentScore) {
+    PyObject* item = PyDict_New();
+    bool ok = item != nullptr
+              && setField(item, keyId, PyLong_FromLong(frequent.id))
+              && setField(item, keyName, nameObject(frequent.name))
+              && setField(item, keyPurchaseCount, PyLong_FromLong(frequent.purchaseCount))
+              && setField(item, keyRecentScore, PyFloat_FromDouble(recentScore))
+              && setField(item, keyCategory, PyUnicode_FromString(catalogCategoryOf(frequent.id)))
+              && setField(item, keyIsCustom, PyBool_FromLong(frequent.isCustom));
+    if (!ok) Py_CLEAR(item);
+    return item;
+}
+
+// Top items from the current ranking snapshot, without the state lock
+static PyObject* rankedItemsFromSnapshot(int mode, bool& found) {
+    EpochReadGuard guard(rankingEpochs, rankingReader.slot);
+    const RankingSnapshot* snapshot = guard.active() ? rankingSnapshot.load() : nullptr;
+    found = snapshot != nullptr &&
+            (!sharedState.attached() || snapshot->changeCount == state->allItems.changeCount());
+    if (!found) return nullptr;
+
+    const RankingDocument& doc = snapshot->byMode[mode == RANK_BY_RECENT ? RANK_BY_RECENT : RANK_BY_LIFETIME];
+    double age = exp(-snapshot->decayRate * (currentTimeSeconds() - snapshot->publishedAt));
+    PyObject* list = PyList_New(0);
+    for (int i = 0; list != nullptr && i < doc.count; i++) {
+        if (!appendItem(list, frequentItemObject(doc.items[i], doc.scores[i] * age))) Py_CLEAR(list);
+    }
+    return list;
+}
+
+// Same items read from the store under the lock (no snapshot or reader slot)
+static PyObject* rankedItemsLocked(int mode) {
+    double now = currentTimeSeconds();
+    int top[MAX_DISPLAY_ITEMS];
+    int count = ranked_indices(mode, top);
+    PyObject* list = PyList_New(0);
+    for (int i = 0; list != nullptr && i < count; i++) {
+        FrequentItem item = state->allItems[top[i]];
+        if (!appendItem(list, frequentItemObject(item, state->allItems.recentScore(top[i], now)))) Py_CLEAR(list);
+    }
+    return list;
+}
+
+static PyObject* py_api_get_cart_items(PyObject*, PyObject*) {
+    API_ENTRY_UNLOCKED();
+    return buildLocked(cartItems);
+}
+
+static PyObject* py_api_get_stack_items(PyObject*, PyObject*) {
+    API_ENTRY_UNLOCKED();
+    return buildLocked(stackItems);
+}
+
+static PyObject* py_api_get_queue_items(PyObject*, PyObject*) {
+    API_ENTRY_UNLOCKED();
+    return buildLocked(queueItems);
+}
+
+static PyObject* py_ranked_items(PyObject*, PyObject* args) {
+    API_ENTRY_UNLOCKED();
+    int mode;
+    if (!PyArg_ParseTuple(args, "i", &mode)) return nullptr;
+    bool found = false;
+    PyObject* list = rankedItemsFromSnapshot(mode, found);
+    if (found) return list;
+    return buildLocked([mode]() { return rankedItemsLocked(mode); });
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    CHANGE CALLBACKS - Python Callables
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Subscription id -> (callable, context), owned here; guarded by the GIL
+static unordered_map<int, PyObject*> changeCallbacks;
+
+// Runs on the thread that made the change, after the state lock is released
+static void deliverToPython(const char* record, void* subscription) {
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyObject* pair = (PyObject*)subscription;
+    PyObject* result = PyObject_CallFunction(PyTuple_GET_ITEM(pair, 0), "yO", record, PyTuple_GET_ITEM(pair, 1));
+    if (result == nullptr) {
+        PyErr_WriteUnraisable(PyTuple_GET_ITEM(pair, 0));
+    }
+    Py_XDECREF(result);
+    PyGILState_Release(gil);
+}
+
+static PyObject* py_api_subscribe_changes(PyObject*, PyObject* args) {
+    PyObject* callback;
+    PyObject* context = Py_None;
+    if (!PyArg_ParseTuple(args, "O|O", &callback, &context)) return nullptr;
+    if (!PyCallable_Check(callback)) {
+        PyErr_SetString(PyExc_TypeError, "callback must be callable");
+        return nullptr;
+    }
+    PyObject* pair = PyTuple_Pack(2, callback, context);
+    if (pair == nullptr) return nullptr;
+    int id;
+    WITHOUT_GIL(id = api_subscribe_changes(deliverToPython, pair));
+    if (id < 0) {
+        Py_DECREF(pair);
+    } else {
+        changeCallbacks[id] = pair;
+    }
+    return PyLong_FromLong(id);
+}
+
+static PyObject* py_api_unsubscribe_changes(PyObject*, PyObject* args) {
+    int id;
+    if (!PyArg_ParseTuple(args, "i", &id)) return nullptr;
+    WITHOUT_GIL(api_unsubscribe_changes(id));   // the callback is not running once this returns
+    auto found = changeCallbacks.find(id);
+    if (found != changeCallbacks.end()) {
+        Py_DECREF(found->second);
+        changeCallbacks.erase(found);
+    }
+    Py_RETURN_NONE;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    LIBRARY CALLS - Same Names and Arguments as ctypes
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// fn() returning nothing / int / bool / double / unsigned long long / text
+#define CALL_VOID(fn) \
+    static PyObject* py_##fn(PyObject*, PyObject*) { WITHOUT_GIL(fn()); Py_RETURN_NONE; }
+#define CALL_INT(fn) \
+    static PyObject* py_##fn(PyObject*, PyObject*) { int r; WITHOUT_GIL(r = fn()); return PyLong_FromLong(r); }
+#define CALL_BOOL(fn) \
+    static PyObject* py_##fn(PyObject*, PyObject*) { bool r; WITHOUT_GIL(r = fn()); return PyBool_FromLong(r); }
+#define CALL_DOUBLE(fn) \
+    static PyObject* py_##fn(PyObject*, PyObject*) { double r; WITHOUT_GIL(r = fn()); return PyFloat_FromDouble(r); }
+#define CALL_ULL(fn) \
+    static PyObject* py_##fn(PyObject*, PyObject*) { unsigned long long r; WITHOUT_GIL(r = fn()); return PyLong_FromUnsignedLongLong(r); }
+#define CALL_TEXT(fn) \
+    static PyObject* py_##fn(PyObject*, PyObject*) { const char* r; WITHOUT_GIL(r = fn()); return takeText(r); }
+
+// fn(one argument, parsed with `format` into `type`) returning nothing / int / bool / text
+#define CALL1_VOID(fn, type, format) \
+    static PyObject* py_##fn(PyObject*, PyObject* args) { \
+        type a; if (!PyArg_ParseTuple(args, format, &a)) return nullptr; \
+        WITHOUT_GIL(fn(a)); Py_RETURN_NONE; }
+#define CALL1_INT(fn, type, format) \
+    static PyObject* py_##fn(PyObject*, PyObject* args) { \
+        type a; if (!PyArg_ParseTuple(args, format, &a)) return nullptr; \
+        int r; WITHOUT_GIL(r = fn(a)); return PyLong_FromLong(r); }
+#define CALL1_BOOL(fn, type, format) \
+    static PyObject* py_##fn(PyObject*, PyObject* args) { \
+        type a; if (!PyArg_ParseTuple(args, format, &a)) return nullptr; \
+        bool r; WITHOUT_GIL(r = fn(a)); return PyBool_FromLong(r); }
+#define CALL1_TEXT(fn, type, format) \
+    static PyObject* py_##fn(PyObject*, PyObject* args) { \
+        type a; if (!PyArg_ParseTuple(args, format, &a)) return nullptr; \
+        const char* r; WITHOUT_GIL(r = fn(a)); return takeText(r); }
+#define CALL1_TEXT_ARG(fn, result) \
+    static PyObject* py_##fn(PyObject*, PyObject* args) { \
+        const char* a; if (!PyArg_ParseTuple(args, "O&", textArgument, &a)) return nullptr; \
+        result r; WITHOUT_GIL(r = fn(a)); return CONVERT_##result(r); }
+#define CONVERT_bool(r) PyBool_FromLong(r)
+#define CONVERT_int(r) PyLong_FromLong(r)
+#define CONVERT_text(r) takeText(r)
+typedef const char* text;
+
+// Array
+CALL_INT(api_get_frequent_items_count)
+CALL1_TEXT(api_get_frequent_item, int, "i")
+CALL_TEXT(api_get_all_frequent_items)
+CALL1_TEXT(api_get_ranked_frequent_items, int, "i")
+CALL1_VOID(api_set_popularity_half_life, double, "d")
+CALL_DOUBLE(api_get_popularity_half_life)
+
+static PyObject* py_api_read_ranked_items(PyObject*, PyObject* args) {
+    int mode, capacity;
+    Py_buffer buffer;
+    if (!PyArg_ParseTuple(args, "iw*i", &mode, &buffer, &capacity)) return nullptr;
+    int length;
+    capacity = (int)min((Py_ssize_t)capacity, buffer.len);
+    WITHOUT_GIL(length = api_read_ranked_items(mode, (char*)buffer.buf, capacity));
+    PyBuffer_Release(&buffer);
+    return PyLong_FromLong(length);
+}
+
+// Linked List (cart)
+static PyObject* py_api_add_to_cart(PyObject*, PyObject* args) {
+    const char* name;
+    int quantity, productId;
+    if (!PyArg_ParseTuple(args, "O&ii", textArgument, &name, &quantity, &productId)) return nullptr;
+    unsigned long long handle;
+    WITHOUT_GIL(handle = api_add_to_cart(name, quantity, productId));
+    return PyLong_FromUnsignedLongLong(handle);
+}
+
+CALL1_TEXT(api_remove_from_cart, int, "i")
+CALL1_TEXT(api_remove_cart_line, unsigned long long, "K")
+
+static PyObject* py_api_update_cart_line(PyObject*, PyObject* args) {
+    unsigned long long handle;
+    int quantity;
+    if (!PyArg_ParseTuple(args, "Ki", &handle, &quantity)) return nullptr;
+    bool updated;
+    WITHOUT_GIL(updated = api_update_cart_line(handle, quantity));
+    return PyBool_FromLong(updated);
+}
+
+CALL1_TEXT(api_get_cart_item_at, int, "i")
+CALL_INT(api_get_cart_size)
+CALL_BOOL(api_is_cart_empty)
+CALL_INT(api_get_cart_total_quantity)
+CALL_VOID(api_clear_cart)
+
+// Stack (undo)
+CALL_TEXT(api_undo_last_action)
+CALL_INT(api_get_undo_stack_size)
+CALL_BOOL(api_is_undo_stack_empty)
+CALL_VOID(api_clear_undo_stack)
+
+// Batch: a CartOp array (e.g. a ctypes array of server.py's CartOp)
+static PyObject* py_api_apply_batch(PyObject*, PyObject* args) {
+    Py_buffer ops;
+    int count;
+    if (!PyArg_ParseTuple(args, "y*i", &ops, &count)) return nullptr;
+    if (count < 0 || (size_t)ops.len < (size_t)count * sizeof(CartOp)) {
+        PyBuffer_Release(&ops);
+        PyErr_SetString(PyExc_ValueError, "ops holds fewer than count CartOp records");
+        return nullptr;
+    }
+    const char* result;
+    WITHOUT_GIL(result = api_apply_batch((const CartOp*)ops.buf, count));
+    PyBuffer_Release(&ops);
+    return takeText(result);
+}
+
+// Cart replication and change notifications
+CALL1_TEXT_ARG(api_merge_cart_delta, text)
+CALL_ULL(api_get_change_seq)
+CALL1_TEXT(api_read_changes, unsigned long long, "K")
+CALL_INT(api_open_change_fd)
+CALL1_VOID(api_close_change_fd, int, "i")
+
+// Queue (checkout)
+CALL_VOID(api_start_checkout)
+CALL_INT(api_get_queue_size)
+CALL_TEXT(api_process_checkout)
+
+// Streaming
+CALL1_INT(api_stream_open, int, "i")
+CALL1_VOID(api_stream_close, int, "i")
+
+static PyObject* py_api_stream_next(PyObject*, PyObject* args) {
+    int stream, capacity;
+    Py_buffer buffer;
+    if (!PyArg_ParseTuple(args, "iw*i", &stream, &buffer, &capacity)) return nullptr;
+    int length;
+    capacity = (int)min((Py_ssize_t)capacity, buffer.len);
+    WITHOUT_GIL(length = api_stream_next(stream, (char*)buffer.buf, capacity));
+    PyBuffer_Release(&buffer);
+    return PyLong_FromLong(length);
+}
+
+// Recommendations, history and rollups
+CALL1_TEXT(api_get_bought_together, int, "i")
+CALL_TEXT(api_get_copurchase_stats)
+
+static PyObject* py_api_history_top_items(PyObject*, PyObject* args) {
+    double from, to;
+    int k;
+    if (!PyArg_ParseTuple(args, "ddi", &from, &to, &k)) return nullptr;
+    const char* result;
+    WITHOUT_GIL(result = api_history_top_items(from, to, k));
+    return takeText(result);
+}
+
+static PyObject* py_api_history_item_series(PyObject*, PyObject* args) {
+    const char* name;
+    double from, to;
+    int bucketSeconds;
+    if (!PyArg_ParseTuple(args, "O&ddi", textArgument, &name, &from, &to, &bucketSeconds)) return nullptr;
+    const char* result;
+    WITHOUT_GIL(result = api_history_item_series(name, from, to, bucketSeconds));
+    return takeText(result);
+}
+
+CALL_TEXT(api_history_stats)
+CALL1_TEXT_ARG(api_history_save, bool)
+CALL1_TEXT_ARG(api_history_load, bool)
+
+static PyObject* py_api_top_items_window(PyObject*, PyObject* args) {
+    int windowSeconds, k;
+    if (!PyArg_ParseTuple(args, "ii", &windowSeconds, &k)) return nullptr;
+    const char* result;
+    WITHOUT_GIL(result = api_top_items_window(windowSeconds, k));
+    return takeText(result);
+}
+
+// Heavy hitters, purchase counts and restore
+CALL1_VOID(api_set_heavy_hitter_mode, int, "i")
+CALL_TEXT(api_get_heavy_hitters)
+CALL1_VOID(api_increment_purchase_count_by_id, int, "i")
+
+static PyObject* py_api_restore_custom_item(PyObject*, PyObject* args) {
+    const char* name;
+    int purchaseCount, itemId;
+    if (!PyArg_ParseTuple(args, "O&ii", textArgument, &name, &purchaseCount, &itemId)) return nullptr;
+    WITHOUT_GIL(api_restore_custom_item(name, purchaseCount, itemId));
+    Py_RETURN_NONE;
+}
+
+static PyObject* py_api_restore_item_popularity(PyObject*, PyObject* args) {
+    int itemId;
+    double recentScore, secondsAgo;
+    if (!PyArg_ParseTuple(args, "idd", &itemId, &recentScore, &secondsAgo)) return nullptr;
+    WITHOUT_GIL(api_restore_item_popularity(itemId, recentScore, secondsAgo));
+    Py_RETURN_NONE;
+}
+
+// Catalog import and item store capacity
+static PyObject* py_api_import_catalog(PyObject*, PyObject* args) {
+    const char* path;
+    int threads;
+    if (!PyArg_ParseTuple(args, "O&i", textArgument, &path, &threads)) return nullptr;
+    const char* result;
+    WITHOUT_GIL(result = api_import_catalog(path, threads));
+    return takeText(result);
+}
+
+CALL1_INT(api_set_custom_item_capacity, int, "i")
+CALL1_TEXT_ARG(api_set_item_spill, bool)
+CALL_TEXT(api_get_item_store_stats)
+
+// Memory, metrics and tracing
+CALL_TEXT(api_get_memory_stats)
+CALL_TEXT(api_run_allocation_audit)
+CALL_TEXT(api_get_metrics)
+CALL_TEXT(api_get_metrics_text)
+CALL1_VOID(api_set_tracing, int, "i")
+CALL_TEXT(api_dump_trace)
+CALL_VOID(api_clear_trace)
+
+static PyObject* py_api_trace_event(PyObject*, PyObject* args) {
+    const char* name;
+    char phase;
+    if (!PyArg_ParseTuple(args, "O&c", textArgument, &name, &phase)) return nullptr;
+    WITHOUT_GIL(api_trace_event(name, phase));
+    Py_RETURN_NONE;
+}
+
+// Persistence and shared state
+static PyObject* py_api_set_persistence(PyObject*, PyObject* args) {
+    const char* path;
+    int windowMs, durable;
+    if (!PyArg_ParseTuple(args, "O&ii", textArgument, &path, &windowMs, &durable)) return nullptr;
+    WITHOUT_GIL(api_set_persistence(path, windowMs, durable));
+    Py_RETURN_NONE;
+}
+
+CALL_BOOL(api_flush)
+CALL_TEXT(api_get_persistence_stats)
+
+static PyObject* py_api_attach_shared_state(PyObject*, PyObject* args) {
+    const char* name;
+    int megabytes;
+    if (!PyArg_ParseTuple(args, "O&i", textArgument, &name, &megabytes)) return nullptr;
+    int result;
+    WITHOUT_GIL(result = api_attach_shared_state(name, megabytes));
+    return PyLong_FromLong(result);
+}
+
+// Sessions and purchase deltas (partitioned deployments)
+CALL1_TEXT_ARG(api_select_session, bool)
+CALL_TEXT(api_list_sessions)
+CALL_TEXT(api_export_session)
+CALL1_TEXT_ARG(api_import_session, bool)
+CALL_VOID(api_drop_session)
+CALL_TEXT(api_take_purchase_deltas)
+CALL1_TEXT_ARG(api_apply_purchase_deltas, int)
+
+// Utility
+CALL_VOID(api_reset_all)
+CALL_VOID(api_factory_reset)
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                           MODULE DEFINITION
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define METHOD(fn, flags) {#fn, (PyCFunction)py_##fn, flags, nullptr}
+
+static PyMethodDef groceryMethods[] = {
+    METHOD(api_get_frequent_items_count, METH_NOARGS),
+    METHOD(api_get_frequent_item, METH_VARARGS),
+    METHOD(api_get_all_frequent_items, METH_NOARGS),
+    METHOD(api_get_ranked_frequent_items, METH_VARARGS),
+    METHOD(api_read_ranked_items, METH_VARARGS),
+    METHOD(api_set_popularity_half_life, METH_VARARGS),
+    METHOD(api_get_popularity_half_life, METH_NOARGS),
+    {"ranked_items", (PyCFunction)py_ranked_items, METH_VARARGS,
+     "ranked_items(mode) -> list of dicts: the top items from the lock-free ranking snapshot"},
+    METHOD(api_add_to_cart, METH_VARARGS),
+    METHOD(api_remove_from_cart, METH_VARARGS),
+    METHOD(api_remove_cart_line, METH_VARARGS),
+    METHOD(api_update_cart_line, METH_VARARGS),
+    METHOD(api_get_cart_item_at, METH_VARARGS),
+    METHOD(api_get_cart_size, METH_NOARGS),
+    METHOD(api_is_cart_empty, METH_NOARGS),
+    METHOD(api_get_cart_total_quantity, METH_NOARGS),
+    METHOD(api_get_cart_items, METH_NOARGS),
+    METHOD(api_clear_cart, METH_NOARGS),
+    METHOD(api_undo_last_action, METH_NOARGS),
+    METHOD(api_get_undo_stack_size, METH_NOARGS),
+    METHOD(api_is_undo_stack_empty, METH_NOARGS),
+    METHOD(api_get_stack_items, METH_NOARGS),
+    METHOD(api_clear_undo_stack, METH_NOARGS),
+    METHOD(api_apply_batch, METH_VARARGS),
+    METHOD(api_merge_cart_delta, METH_VARARGS),
+    METHOD(api_subscribe_changes, METH_VARARGS),
+    METHOD(api_unsubscribe_changes, METH_VARARGS),
+    METHOD(api_get_change_seq, METH_NOARGS),
+    METHOD(api_read_changes, METH_VARARGS),
+    METHOD(api_open_change_fd, METH_NOARGS),
+    METHOD(api_close_change_fd, METH_VARARGS),
+    METHOD(api_start_checkout, METH_NOARGS),
+    METHOD(api_get_queue_size, METH_NOARGS),
+    METHOD(api_process_checkout, METH_NOARGS),
+    METHOD(api_get_queue_items, METH_NOARGS),
+    METHOD(api_stream_open, METH_VARARGS),
+    METHOD(api_stream_next, METH_VARARGS),
+    METHOD(api_stream_close, METH_VARARGS),
+    METHOD(api_get_bought_together, METH_VARARGS),
+    METHOD(api_get_copurchase_stats, METH_NOARGS),
+    METHOD(api_history_top_items, METH_VARARGS),
+    METHOD(api_history_item_series, METH_VARARGS),
+    METHOD(api_history_stats, METH_NOARGS),
+    METHOD(api_history_save, METH_VARARGS),
+    METHOD(api_history_load, METH_VARARGS),
+    METHOD(api_top_items_window, METH_VARARGS),
+    METHOD(api_set_heavy_hitter_mode, METH_VARARGS),
+    METHOD(api_get_heavy_hitters, METH_NOARGS),
+    METHOD(api_increment_purchase_count_by_id, METH_VARARGS),
+    METHOD(api_restore_custom_item, METH_VARARGS),
+    METHOD(api_restore_item_popularity, METH_VARARGS),
+    METHOD(api_import_catalog, METH_VARARGS),
+    METHOD(api_set_custom_item_capacity, METH_VARARGS),
+    METHOD(api_set_item_spill, METH_VARARGS),
+    METHOD(api_get_item_store_stats, METH_NOARGS),
+    METHOD(api_get_memory_stats, METH_NOARGS),
+    METHOD(api_run_allocation_audit, METH_NOARGS),
+    METHOD(api_get_metrics, METH_NOARGS),
+    METHOD(api_get_metrics_text, METH_NOARGS),
+    METHOD(api_set_tracing, METH_VARARGS),
+    METHOD(api_trace_event, METH_VARARGS),
+    METHOD(api_dump_trace, METH_NOARGS),
+    METHOD(api_clear_trace, METH_NOARGS),
+    METHOD(api_set_persistence, METH_VARARGS),
+    METHOD(api_flush, METH_NOARGS),
+    METHOD(api_get_persistence_stats, METH_NOARGS),
+    METHOD(api_attach_shared_state, METH_VARARGS),
+    METHOD(api_select_session, METH_VARARGS),
+    METHOD(api_list_sessions, METH_NOARGS),
+    METHOD(api_export_session, METH_NOARGS),
+    METHOD(api_import_session, METH_VARARGS),
+    METHOD(api_drop_session, METH_NOARGS),
+    METHOD(api_take_purchase_deltas, METH_NOARGS),
+    METHOD(api_apply_purchase_deltas, METH_VARARGS),
+    METHOD(api_reset_all, METH_NOARGS),
+    METHOD(api_factory_reset, METH_NOARGS),
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static struct PyModuleDef groceryModule = {
+    PyModuleDef_HEAD_INIT,
+    "grocery_native",
+    "Smart Grocery Cart data structures, without ctypes (see grocery_native.cpp)",
+    -1,
+    groceryMethods,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr
+};
+
+PyMODINIT_FUNC PyInit_grocery_native() {
+    struct { PyObject** key; const char* name; } keys[] = {
+        {&keyName, "name"}, {&keyQuantity, "quantity"}, {&keyProductId, "product_id"},
+        {&keyHandle, "handle"}, {&keyId, "id"}, {&keyPurchaseCount, "purchaseCount"},
+        {&keyRecentScore, "recentScore"}, {&keyCategory, "category"}, {&keyIsCustom, "isCustom"},
+    };
+    for (auto& key : keys) {
+        *key.key = PyUnicode_InternFromString(key.name);
+        if (*key.key == nullptr) return nullptr;
+    }
+    return PyModule_Create(&groceryModule);
+}
@@ -0,0 +1,1172 @@
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                           SMART GROCERY CART
+ *                    Data Structures Project - Air University
+ *                              3rd Semester
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * FILE: native_server.cpp
+ * PURPOSE: Optional native HTTP server (Linux) - same routes as server.py
+ *
+ * Serves the same /api/... routes and JSON shapes as server.py plus the static
+ * files in web/, but calls the data structures directly instead of going
+ * through Flask -> ctypes -> json.loads -> jsonify.
+ *
+ * DESIGN:
+ * - The main thread accepts connections and hands them out round-robin
+ * - Each worker thread owns one epoll instance and its connections
+ *   (non-blocking sockets, HTTP/1.1 keep-alive, pipelined requests)
+ * - Library calls are serialized by the library's own state lock
+ * - cart_data.json is written by the library's persistence thread (group
+ *   commit, see api_set_persistence), in the same format as server.py, so
+ *   both servers can be used on the same data
+ * - GET /api/events connections stay open as server-sent event streams; a
+ *   worker with streams polls a library change fd (api_open_change_fd) in
+ *   its epoll set and pushes new change records to them
+ * - An X-Session header selects the cart a request works on
+ *   (api_select_session), so one process can be a shard behind router.cpp;
+ *   without it every client shares the main cart, as with server.py
+ *
+ * COMPILATION (Linux):
+ *   g++ -O2 -std=c++17 -pthread -o native_server native_server.cpp grocery_api_new.cpp
+ *
+ * USAGE (from src/, like server.py):
+ *   ./native_server [port=8080] [workers=4] [web_dir=../web] [data_file=cart_data.json]
+ *
+ * GROCERY_SHARED_STATE=/name (and GROCERY_SHARED_STATE_MB) share the item
+ * store, cart and queue with other processes, GROCERY_PERSIST_WINDOW_MS /
+ * GROCERY_DURABLE tune persistence, and GROCERY_CUSTOM_ITEM_CAPACITY /
+ * GROCERY_ITEM_SPILL bound the item store, exactly as with server.py.
+ */
+
+#ifndef __linux__
+#error "native_server uses epoll and only builds on Linux - use server.py elsewhere"
+#endif
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <unordered_map>
+#include <functional>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <cerrno>
+#include <csignal>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "core/JsonReader.h"
+
+using namespace std;
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    LIBRARY FUNCTIONS (grocery_api_new.cpp)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Same layout as struct CartOp in grocery_api_new.cpp
+struct CartOp {
+    int kind;
+    const char* name;
+    int quantity;
+    int productId;
+    int position;
+};
+
+extern "C" {
+    const char* api_get_ranked_frequent_items(int mode);
+    int api_read_ranked_items(int mode, char* buffer, int capacity);
+    const char* api_get_all_frequent_items();
+    void api_set_popularity_half_life(double hours);
+    double api_get_popularity_half_life();
+    unsigned long long api_add_to_cart(const char* name, int quantity, int product_id);
+    const char* api_remove_from_cart(int position);
+    const char* api_remove_cart_line(unsigned long long handle);
+    bool api_update_cart_line(unsigned long long handle, int quantity);
+    int api_get_cart_size();
+    int api_get_cart_total_quantity();
+    const char* api_get_cart_items();
+    void api_clear_cart();
+    const char* api_undo_last_action();
+    int api_get_undo_stack_size();
+    const char* api_get_stack_items();
+    void api_clear_undo_stack();
+    const char* api_apply_batch(const CartOp* ops, int count);
+    const char* api_merge_cart_delta(const char* delta);
+    int api_open_change_fd();
+    void api_close_change_fd(int fd);
+    unsigned long long api_get_change_seq();
+    const char* api_read_changes(unsigned long long after);
+    void api_start_checkout();
+    int api_get_queue_size();
+    const char* api_process_checkout();
+    const char* api_get_queue_items();
+    int api_stream_open(int kind);
+    int api_stream_next(int stream, char* buffer, int capacity);
+    void api_stream_close(int stream);
+    const char* api_get_bought_together(int count);
+    const char* api_get_copurchase_stats();
+    const char* api_get_heavy_hitters();
+    const char* api_history_top_items(double from, double to, int k);
+    const char* api_history_item_series(const char* name, double from, double to, int bucketSeconds);
+    const char* api_history_stats();
+    bool api_history_save(const char* path);
+    bool api_history_load(const char* path);
+    const char* api_top_items_window(int windowSeconds, int k);
+    const char* api_get_memory_stats();
+    const char* api_get_metrics();
+    const char* api_get_metrics_text();
+    void api_set_tracing(int enabled);
+    const char* api_dump_trace();
+    void api_clear_trace();
+    void api_restore_custom_item(const char* name, int purchaseCount, int itemId);
+    void api_restore_item_popularity(int itemId, double recentScore, double secondsAgo);
+    void api_factory_reset();
+    int api_attach_shared_state(const char* name, int megabytes);
+    void api_set_persistence(const char* path, int windowMs, int durable);
+    bool api_flush();
+    const char* api_get_persistence_stats();
+    const char* api_import_catalog(const char* path, int threads);
+    int api_set_custom_item_capacity(int capacity);
+    bool api_set_item_spill(const char* path);
+    const char* api_get_item_store_stats();
+    bool api_select_session(const char* key);
+    const char* api_list_sessions();
+    const char* api_export_session();
+    bool api_import_session(const char* document);
+    void api_drop_session();
+    const char* api_take_purchase_deltas();
+    int api_apply_purchase_deltas(const char* document);
+    void api_free_string(char* str);
+}
+
+// Take ownership of a malloc'd library string
+static string take(const char* cstr) {
+    string result = cstr ? cstr : "";
+    api_free_string((char*)cstr);
+    return result;
+}
+
+// Stream kinds understood by api_stream_open (StreamKind)
+const int STREAM_CART = 0;
+const int STREAM_RECEIPT = 1;
+
+/**
+ * Append a library stream straight onto a response body - no intermediate
+ * malloc'd copy of the document. Returns false if no stream could be opened.
+ */
+static bool appendStream(string& body, int kind) {
+    int stream = api_stream_open(kind);
+    if (stream < 0) return false;
+    char chunk[16384];
+    int length;
+    while ((length = api_stream_next(stream, chunk, (int)sizeof(chunk))) > 0) {
+        body.append(chunk, (size_t)length);
+    }
+    return true;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    JSON WRITING (parsing: core/JsonReader.h)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static string jsonEscape(const string& s) {
+    string out;
+    out.reserve(s.size() + 2);
+    for (char c : s) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
+
+// Number of elements in a JSON array produced by the library
+static int jsonArrayLength(const string& json) {
+    JsonValue value;
+    JsonReader reader(json);
+    if (!reader.parse(value) || value.type != JsonValue::ARRAY) return 0;
+    return (int)value.items.size();
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    HTTP TYPES
+// ═══════════════════════════════════════════════════════════════════════════════
+
+struct HttpRequest {
+    string method;
+    string path;
+    unordered_map<string, string> query;
+    string body;
+    string lastEventId;      // EventSource reconnects (GET /api/events)
+    string session;          // X-Session: the cart this request works on ("" = main)
+    bool keepAlive = true;
+};
+
+struct HttpResponse {
+    int status = 200;
+    string contentType = "application/json";
+    string body;
+    vector<pair<string, string>> extraHeaders;
+};
+
+static const char* statusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default: return "OK";
+    }
+}
+
+static string urlDecode(const string& s) {
+    string out;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '%' && i + 2 < s.size()) {
+            out += (char)strtol(s.substr(i + 1, 2).c_str(), nullptr, 16);
+            i += 2;
+        } else if (s[i] == '+') {
+            out += ' ';
+        } else {
+            out += s[i];
+        }
+    }
+    return out;
+}
+
+static HttpResponse jsonResponse(int status, const string& body) {
+    HttpResponse response;
+    response.status = status;
+    response.body = body;
+    return response;
+}
+
+static HttpResponse errorResponse(int status, const string& message) {
+    return jsonResponse(status, "{\"success\":false,\"error\":\"" + jsonEscape(message) + "\"}");
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    SERVER STATE
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static string webDir = "../web";
+static string dataFile = "cart_data.json";
+static string historyFile = "purchase_history.bin";   // next to dataFile
+static string importDir = "catalog";                  // /api/catalog/import reads only from here
+
+// api_attach_shared_state results; anything else means process-local state
+const int SHARED_STATE_CREATED = 1;
+const int SHARED_STATE_ATTACHED = 2;
+static bool sharedState = false;   // history is per process, so not saved when shared
+
+static void loadHistory() {
+    if (access(historyFile.c_str(), F_OK) == 0 && !api_history_load(historyFile.c_str())) {
+        cout << "Could not read purchase history, starting with an empty one" << endl;
+    }
+}
+
+// Same restore rules as server.py's load_all_data()
+static void loadAllData() {
+    loadHistory();
+    ifstream in(dataFile, ios::binary);
+    if (!in) {
+        cout << "No saved data found, starting fresh" << endl;
+        return;
+    }
+    stringstream buffer;
+    buffer << in.rdbuf();
+    string text = buffer.str();
+
+    JsonValue data;
+    JsonReader reader(text);
+    if (!reader.parse(data) || data.type != JsonValue::OBJECT) {
+        cout << "Failed to load data: invalid JSON in " << dataFile << endl;
+        return;
+    }
+
+    double secondsAgo = 0;
+    struct tm saved = {};
+    string stamp = data.stringOr("last_updated", "");
+    if (strptime(stamp.c_str(), "%Y-%m-%d %H:%M:%S", &saved) != nullptr) {
+        saved.tm_isdst = -1;
+        secondsAgo = difftime(time(nullptr), mktime(&saved));
+        if (secondsAgo < 0) secondsAgo = 0;
+    }
+
+    int itemCount = 0;
+    int cartCount = 0;
+    const JsonValue* items = data.get("frequent_items");
+    if (items && items->type == JsonValue::ARRAY) {
+        for (const JsonValue& item : items->items) {
+            int id = (int)item.numberOr("id", -1);
+            int count = (int)item.numberOr("purchaseCount", 0);
+            string name = item.stringOr("name", "");
+            if (id >= 0 && count > 0 && !name.empty()) {
+                api_restore_custom_item(name.c_str(), count, id);
+            }
+            double score = item.numberOr("recentScore", 0);
+            if (id >= 0 && score > 0) {
+                api_restore_item_popularity(id, score, secondsAgo);
+            }
+            itemCount++;
+        }
+    }
+    const JsonValue* cartItems = data.get("cart_items");
+    if (cartItems && cartItems->type == JsonValue::ARRAY) {
+        for (const JsonValue& item : cartItems->items) {
+            string name = item.stringOr("name", "");
+            if (name.empty()) continue;
+            api_add_to_cart(name.c_str(), (int)item.numberOr("quantity", 1),
+                            (int)item.numberOr("product_id", -1));
+            cartCount++;
+        }
+    }
+    int sessionCount = 0;
+    const JsonValue* sessions = data.get("sessions");
+    if (sessions && sessions->type == JsonValue::OBJECT) {
+        for (const auto& entry : sessions->fields) {
+            if (!api_select_session(entry.first.c_str())) continue;
+            if (api_import_session(text.substr(entry.second.offset, entry.second.length).c_str())) sessionCount++;
+        }
+        api_select_session("");
+    }
+    cout << "Data loaded: " << itemCount << " items, " << cartCount << " cart items, "
+         << sessionCount << " sessions" << endl;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    API ROUTES (mirror server.py)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static bool parseBody(const HttpRequest& request, JsonValue& body) {
+    if (request.body.empty()) return false;
+    JsonReader reader(request.body);
+    return reader.parse(body) && body.type == JsonValue::OBJECT;
+}
+
+// Unix time with sub-second precision (like Python's time.time())
+static double unixNow() {
+    return chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Numeric query parameter, or fallback when absent / not a number (like Flask's type=float)
+static double queryNumber(const HttpRequest& request, const string& key, double fallback) {
+    auto it = request.query.find(key);
+    if (it == request.query.end() || it->second.empty()) return fallback;
+    char* end = nullptr;
+    double value = strtod(it->second.c_str(), &end);
+    return (*end == '\0') ? value : fallback;
+}
+
+static HttpResponse handleApi(const HttpRequest& request) {
+    const string& path = request.path;
+    const string& method = request.method;
+    if (path == "/api/frequent-items" && method == "GET") {
+        auto it = request.query.find("rank");
+        string rank = (it == request.query.end()) ? "lifetime" : it->second;
+        if (rank != "lifetime" && rank != "recent") {
+            return errorResponse(400, "Unknown rank mode: " + rank);
+        }
+        // Lock-free read of the library's ranking snapshot
+        thread_local char ranking[8192];
+        int length = api_read_ranked_items(rank == "recent" ? 1 : 0, ranking, (int)sizeof(ranking));
+        string items = (length >= 0) ? string(ranking, (size_t)length)
+                                     : take(api_get_ranked_frequent_items(rank == "recent" ? 1 : 0));
+        return jsonResponse(200, "{\"success\":true,\"data\":" + items
+                                 + ",\"count\":" + to_string(jsonArrayLength(items))
+                                 + ",\"rank\":\"" + rank + "\"}");
+    }
+    if (path == "/api/popularity/half-life" && (method == "GET" || method == "POST")) {
+        if (method == "POST") {
+            JsonValue body;
+            parseBody(request, body);
+            const JsonValue* hours = body.get("hours");
+            if (hours == nullptr || hours->type != JsonValue::NUMBER || hours->number <= 0) {
+                return errorResponse(400, "hours must be a positive number");
+            }
+            api_set_popularity_half_life(hours->number);
+        }
+        ostringstream json;
+        json << "{\"success\":true,\"hours\":" << api_get_popularity_half_life() << "}";
+        return jsonResponse(200, json.str());
+    }
+    if (path == "/api/cart/add" && method == "POST") {
+        JsonValue body;
+        parseBody(request, body);
+        string name = body.stringOr("name", "");
+        int quantity = (int)body.numberOr("quantity", 1);
+        int productId = (int)body.numberOr("product_id", -1);
+        unsigned long long handle = api_add_to_cart(name.c_str(), quantity, productId);
+        if (handle == 0) return errorResponse(400, "Item name is longer than 63 bytes");
+        return jsonResponse(200, "{\"success\":true,\"message\":\"Added " + to_string(quantity)
+                                 + "x " + jsonEscape(name) + " to cart\",\"handle\":" + to_string(handle) + "}");
+    }
+    if (path.compare(0, 24, "/api/cart/remove/handle/") == 0 && method == "DELETE") {
+        string digits = path.substr(24);
+        if (digits.empty() || digits.find_first_not_of("0123456789") != string::npos) {
+            return errorResponse(404, "Not found");
+        }
+        string removed = take(api_remove_cart_line(strtoull(digits.c_str(), nullptr, 10)));
+        if (removed.find("\"error\"") != string::npos) return errorResponse(404, "Unknown cart line");
+        return jsonResponse(200, "{\"success\":true,\"removed\":" + removed + "}");
+    }
+    if (path.compare(0, 19, "/api/cart/quantity/") == 0 && method == "POST") {
+        string digits = path.substr(19);
+        if (digits.empty() || digits.find_first_not_of("0123456789") != string::npos) {
+            return errorResponse(404, "Not found");
+        }
+        JsonValue body;
+        parseBody(request, body);
+        const JsonValue* quantity = body.get("quantity");
+        if (quantity == nullptr || quantity->type != JsonValue::NUMBER || quantity->number < 1
+            || quantity->number != (double)(int)quantity->number) {
+            return errorResponse(400, "quantity must be a positive integer");
+        }
+        unsigned long long handle = strtoull(digits.c_str(), nullptr, 10);
+        if (!api_update_cart_line(handle, (int)quantity->number)) return errorResponse(404, "Unknown cart line");
+        return jsonResponse(200, "{\"success\":true,\"handle\":" + digits
+                                 + ",\"quantity\":" + to_string((int)quantity->number) + "}");
+    }
+    if (path.compare(0, 17, "/api/cart/remove/") == 0 && method == "DELETE") {
+        string digits = path.substr(17);
+        if (digits.empty() || digits.find_first_not_of("0123456789") != string::npos) {
+            return errorResponse(404, "Not found");
+        }
+        string removed = take(api_remove_from_cart(atoi(digits.c_str())));
+        return jsonResponse(200, "{\"success\":true,\"removed\":" + removed + "}");
+    }
+    if (path == "/api/cart/batch" && method == "POST") {
+        JsonValue body;
+        parseBody(request, body);
+        const JsonValue* ops = body.get("ops");
+        if (ops != nullptr && ops->type != JsonValue::ARRAY) return errorResponse(400, "ops must be a list");
+
+        static const char* kinds[] = {"add", "remove", "undo", "clear"};
+        size_t count = ops ? ops->items.size() : 0;
+        vector<string> names(count);
+        vector<CartOp> batch(count);
+        for (size_t i = 0; i < count; i++) {
+            const JsonValue& op = ops->items[i];
+            string kind = op.stringOr("op", "");
+            int k = 0;
+            while (k < 4 && kind != kinds[k]) k++;
+            if (k == 4) return errorResponse(400, "Unknown op at index " + to_string(i) + ": " + kind);
+            const JsonValue* name = op.get("name");
+            names[i] = (name && name->type == JsonValue::STRING) ? name->str : "";
+            batch[i].kind = k;
+            batch[i].name = (name && name->type == JsonValue::STRING) ? names[i].c_str() : nullptr;
+            batch[i].quantity = (int)op.numberOr("quantity", 1);
+            batch[i].productId = (int)op.numberOr("product_id", -1);
+            batch[i].position = (int)op.numberOr("position", 0);
+        }
+
+        string outcome = take(api_apply_batch(batch.data(), (int)count));
+        JsonValue parsed;
+        JsonReader reader(outcome);
+        reader.parse(parsed);
+        const JsonValue* applied = parsed.get("applied");
+        bool ok = applied && applied->boolean;
+
+        // {"applied":..,"failedAt":..,["error":..,]"results":..,"summary":..} -> route shape
+        string fields = outcome.substr(1, outcome.size() - 2);
+        return jsonResponse(200, string("{\"success\":") + (ok ? "true" : "false") + ","
+                                 + fields + ",\"data\":" + take(api_get_cart_items()) + "}");
+    }
+    if (path == "/api/cart" && method == "GET") {
+        string body = "{\"success\":true,\"data\":";
+        if (!appendStream(body, STREAM_CART)) return errorResponse(503, "Too many open streams");
+        return jsonResponse(200, body + ",\"size\":" + to_string(api_get_cart_size())
+                                 + ",\"totalQuantity\":" + to_string(api_get_cart_total_quantity()) + "}");
+    }
+    if (path == "/api/cart/sync" && method == "POST") {
+        // GCD1 text in and out (core/ReplicatedCart.h); a JSON reply is a parse error
+        string reply = take(api_merge_cart_delta(request.body.c_str()));
+        if (!reply.empty() && reply[0] == '{') return jsonResponse(400, "{\"success\":false," + reply.substr(1));
+        HttpResponse response;
+        response.contentType = "text/plain";
+        response.body = reply;
+        return response;
+    }
+    if (path == "/api/cart/clear" && method == "DELETE") {
+        api_clear_cart();
+        api_clear_undo_stack();
+        return jsonResponse(200, "{\"success\":true,\"message\":\"Cart cleared\"}");
+    }
+    if (path == "/api/undo" && method == "POST") {
+        string undone = take(api_undo_last_action());
+        JsonValue parsed;
+        JsonReader reader(undone);
+        if (reader.parse(parsed) && parsed.get("error") != nullptr) {
+            return jsonResponse(200, "{\"success\":false,\"error\":\""
+                                     + jsonEscape(parsed.stringOr("error", "")) + "\"}");
+        }
+        return jsonResponse(200, "{\"success\":true,\"undone\":" + undone + "}");
+    }
+    if (path == "/api/stack" && method == "GET") {
+        string items = take(api_get_stack_items());
+        return jsonResponse(200, "{\"success\":true,\"data\":" + items
+                                 + ",\"size\":" + to_string(api_get_undo_stack_size()) + "}");
+    }
+    if (path == "/api/checkout/start" && method == "POST") {
+        api_start_checkout();
+        if (!sharedState) api_history_save(historyFile.c_str());
+        return jsonResponse(200, "{\"success\":true,\"message\":\"Checkout started\"}");
+    }
+    if (path == "/api/checkout/process" && method == "POST") {
+        string body = "{\"success\":true,\"receipt\":";
+        if (!appendStream(body, STREAM_RECEIPT)) return errorResponse(503, "Too many open streams");
+        return jsonResponse(200, body + "}");
+    }
+    if (path == "/api/queue" && method == "GET") {
+        string items = take(api_get_queue_items());
+        return jsonResponse(200, "{\"success\":true,\"data\":" + items
+                                 + ",\"size\":" + to_string(api_get_queue_size()) + "}");
+    }
+    if (path == "/api/recommendations" && method == "GET") {
+        auto it = request.query.find("n");
+        int count = (it == request.query.end()) ? 5 : atoi(it->second.c_str());
+        string items = take(api_get_bought_together(count));
+        string stats = take(api_get_copurchase_stats());
+        return jsonResponse(200, "{\"success\":true,\"data\":" + items + ",\"stats\":" + stats + "}");
+    }
+    if (path == "/api/history/top" && method == "GET") {
+        // Unix seconds; defaults to the last 7 days
+        double to = queryNumber(request, "to", unixNow());
+        double from = queryNumber(request, "from", to - 7 * 86400);
+        int k = (int)queryNumber(request, "k", 10);
+        return jsonResponse(200, "{\"success\":true,\"data\":" + take(api_history_top_items(from, to, k)) + "}");
+    }
+    if (path == "/api/history/item" && method == "GET") {
+        auto it = request.query.find("name");
+        string name = (it == request.query.end()) ? "" : it->second;
+        size_t first = name.find_first_not_of(" \t");
+        name = (first == string::npos) ? "" : name.substr(first, name.find_last_not_of(" \t") - first + 1);
+        if (name.empty()) return errorResponse(400, "Item name is required");
+        // Unix seconds; defaults to weekly buckets over the last year
+        double to = queryNumber(request, "to", unixNow());
+        double from = queryNumber(request, "from", to - 365 * 86400);
+        int bucket = (int)queryNumber(request, "bucket", 7 * 86400);
+        string series = take(api_history_item_series(name.c_str(), from, to, bucket));
+        return jsonResponse(200, "{\"success\":true,\"data\":" + series + "}");
+    }
+    if (path == "/api/top-items" && method == "GET") {
+        auto it = request.query.find("window");
+        string window = (it == request.query.end()) ? "day" : it->second;
+        long long seconds = 0;
+        if (window == "hour") seconds = 3600;
+        else if (window == "day") seconds = 86400;
+        else if (window == "week") seconds = 7 * 86400;
+        else if (window == "month") seconds = 30 * 86400;
+        else if (!window.empty() && window.size() < 19 && window.find_first_not_of("0123456789") == string::npos) {
+            seconds = min(atoll(window.c_str()), 2147483647LL);
+        }
+        if (seconds < 1) return errorResponse(400, "Unknown window: " + window);
+        int k = (int)queryNumber(request, "k", 10);
+        return jsonResponse(200, "{\"success\":true,\"data\":" + take(api_top_items_window((int)seconds, k)) + "}");
+    }
+    if (path == "/api/history/stats" && method == "GET") {
+        return jsonResponse(200, "{\"success\":true,\"data\":" + take(api_history_stats()) + "}");
+    }
+    if (path == "/api/heavy-hitters" && method == "GET") {
+        return jsonResponse(200, "{\"success\":true,\"data\":" + take(api_get_heavy_hitters()) + "}");
+    }
+    if (path == "/api/persistence" && method == "GET") {
+        return jsonResponse(200, "{\"success\":true,\"data\":" + take(api_get_persistence_stats()) + "}");
+    }
+    if (path == "/api/flush" && method == "POST") {
+        if (!api_flush()) return errorResponse(500, "Could not write data file");
+        return jsonResponse(200, "{\"success\":true}");
+    }
+    if (path == "/api/catalog/import" && method == "POST") {
+        JsonValue body;
+        parseBody(request, body);
+        string file = body.stringOr("file", "");
+        double threads = body.numberOr("threads", 0);
+        if (file.empty() || file[0] == '.' || file.find_first_of("/\\") != string::npos) {
+            return errorResponse(400, "file must name a file in the import directory");
+        }
+        if (threads < 0 || threads != (int)threads) {
+            return errorResponse(400, "threads must be a non-negative integer");
+        }
+        string report = take(api_import_catalog((importDir + "/" + file).c_str(), (int)threads));
+        if (report.compare(0, 15, "{\"success\":true") != 0) {
+            size_t at = report.find("\"error\":\"");
+            string error = (at == string::npos) ? "Import failed" : report.substr(at + 9, report.find('"', at + 9) - at - 9);
+            return jsonResponse(400, "{\"success\":false,\"error\":\"" + error + "\",\"data\":" + report + "}");
+        }
+        return jsonResponse(200, "{\"success\":true,\"data\":" + report + "}");
+    }
+    if (path == "/api/catalog/capacity" && (method == "GET" || method == "POST")) {
+        int evicted = 0;
+        if (method == "POST") {
+            JsonValue body;
+            parseBody(request, body);
+            double capacity = body.numberOr("capacity", 0);
+            if (capacity <= 0 || capacity != (int)capacity) {
+                return errorResponse(400, "capacity must be a positive integer");
+            }
+            evicted = api_set_custom_item_capacity((int)capacity);
+        }
+        return jsonResponse(200, "{\"success\":true,\"evicted\":" + to_string(evicted)
+                                 + ",\"data\":" + take(api_get_item_store_stats()) + "}");
+    }
+    if (path == "/api/memory" && method == "GET") {
+        return jsonResponse(200, "{\"success\":true,\"data\":" + take(api_get_memory_stats()) + "}");
+    }
+    if (path == "/api/metrics" && method == "GET") {
+        return jsonResponse(200, "{\"success\":true,\"data\":" + take(api_get_metrics()) + "}");
+    }
+    if (path == "/metrics" && method == "GET") {
+        HttpResponse response;
+        response.contentType = "text/plain; version=0.0.4";
+        response.body = take(api_get_metrics_text());
+        return response;
+    }
+    if (path == "/api/debug/trace") {
+        if (method == "POST") {
+            JsonValue body;
+            parseBody(request, body);
+            const JsonValue* enabled = body.get("enabled");
+            bool on = (enabled == nullptr) || (enabled->type == JsonValue::BOOL ? enabled->boolean
+                                                                                  : enabled->number != 0);
+            api_set_tracing(on ? 1 : 0);
+            return jsonResponse(200, string("{\"success\":true,\"enabled\":") + (on ? "true" : "false") + "}");
+        }
+        if (method == "DELETE") {
+            api_clear_trace();
+            return jsonResponse(200, "{\"success\":true,\"message\":\"Trace cleared\"}");
+        }
+        if (method == "GET") {
+            HttpResponse response = jsonResponse(200, take(api_dump_trace()));
+            response.extraHeaders.emplace_back("Content-Disposition", "attachment; filename=grocery_trace.json");
+            return response;
+        }
+    }
+    // Shard routes, for router.cpp (it does not forward them from clients)
+    if (path == "/api/shard/sessions" && method == "GET") {
+        return jsonResponse(200, "{\"success\":true,\"data\":" + take(api_list_sessions()) + "}");
+    }
+    if (path == "/api/shard/session") {
+        if (request.session.empty() && method != "GET") return errorResponse(400, "X-Session is required");
+        if (method == "GET") {
+            return jsonResponse(200, "{\"success\":true,\"data\":" + take(api_export_session()) + "}");
+        }
+        if (method == "PUT") {
+            if (!api_import_session(request.body.c_str())) return errorResponse(400, "Invalid session document");
+            return jsonResponse(200, "{\"success\":true}");
+        }
+        if (method == "DELETE") {
+            api_drop_session();
+            return jsonResponse(200, "{\"success\":true}");
+        }
+    }
+    if (path == "/api/shard/deltas/take" && method == "POST") {
+        return jsonResponse(200, "{\"success\":true,\"data\":" + take(api_take_purchase_deltas()) + "}");
+    }
+    if (path == "/api/shard/deltas/apply" && method == "POST") {
+        int counted = api_apply_purchase_deltas(request.body.c_str());
+        if (counted < 0) return errorResponse(400, "Invalid deltas document");
+        return jsonResponse(200, "{\"success\":true,\"counted\":" + to_string(counted) + "}");
+    }
+    if (path == "/api/factory-reset" && method == "POST") {
+        api_factory_reset();
+        remove(historyFile.c_str());
+        return jsonResponse(200, "{\"success\":true,\"message\":\"Factory reset complete\"}");
+    }
+    return errorResponse(404, "Not found");
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    STATIC FILES (web/)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static const char* contentTypeFor(const string& path) {
+    size_t dot = path.rfind('.');
+    string ext = (dot == string::npos) ? "" : path.substr(dot + 1);
+    if (ext == "html") return "text/html; charset=utf-8";
+    if (ext == "css") return "text/css; charset=utf-8";
+    if (ext == "js") return "application/javascript; charset=utf-8";
+    if (ext == "json") return "application/json";
+    if (ext == "svg") return "image/svg+xml";
+    if (ext == "png") return "image/png";
+    if (ext == "ico") return "image/x-icon";
+    return "application/octet-stream";
+}
+
+static HttpResponse handleStatic(const HttpRequest& request) {
+    if (request.method != "GET" && request.method != "HEAD") return errorResponse(405, "Method not allowed");
+    string path = (request.path == "/") ? "/index.html" : request.path;
+    if (path.find("..") != string::npos) return errorResponse(404, "Not found");
+
+    string full = webDir + path;
+    struct stat info;
+    if (stat(full.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) return errorResponse(404, "Not found");
+
+    ifstream in(full, ios::binary);
+    stringstream buffer;
+    buffer << in.rdbuf();
+
+    HttpResponse response;
+    response.contentType = contentTypeFor(path);
+    response.body = buffer.str();
+    return response;
+}
+
+static HttpResponse route(const HttpRequest& request) {
+    if (request.path.compare(0, 5, "/api/") == 0 || request.path == "/metrics") {
+        return handleApi(request);
+    }
+    return handleStatic(request);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    CONNECTIONS (one epoll loop per worker)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+const size_t MAX_HEADER_BYTES = 16 * 1024;
+const size_t MAX_BODY_BYTES = 1024 * 1024;
+
+struct Connection {
+    int fd;
+    string in;
+    string out;
+    size_t outSent = 0;
+    bool closeAfterWrite = false;
+    bool eventStream = false;           // GET /api/events: open until the client leaves
+    unsigned long long lastSeq = 0;     // last change sent on it
+    string session;                     // whose cart changes it is sent
+};
+
+static void appendResponse(Connection& conn, const HttpResponse& response, bool keepAlive, bool head) {
+    ostringstream header;
+    header << "HTTP/1.1 " << response.status << " " << statusText(response.status) << "\r\n"
+           << "Content-Type: " << response.contentType << "\r\n"
+           << "Content-Length: " << response.body.size() << "\r\n"
+           << "Access-Control-Allow-Origin: *\r\n"
+           << "Connection: " << (keepAlive ? "keep-alive" : "close") << "\r\n";
+    for (const auto& extra : response.extraHeaders) {
+        header << extra.first << ": " << extra.second << "\r\n";
+    }
+    header << "\r\n";
+    conn.out += header.str();
+    if (!head) conn.out += response.body;
+    if (!keepAlive) conn.closeAfterWrite = true;
+}
+
+/**
+ * Parse one complete request from the front of conn.in
+ * Returns 1 when a request was consumed, 0 when more bytes are needed,
+ * -1 on a malformed or oversized request
+ */
+static int parseRequest(Connection& conn, HttpRequest& request) {
+    size_t headerEnd = conn.in.find("\r\n\r\n");
+    if (headerEnd == string::npos) {
+        return (conn.in.size() > MAX_HEADER_BYTES) ? -1 : 0;
+    }
+
+    size_t lineEnd = conn.in.find("\r\n");
+    string requestLine = conn.in.substr(0, lineEnd);
+    size_t sp1 = requestLine.find(' ');
+    size_t sp2 = requestLine.find(' ', sp1 + 1);
+    if (sp1 == string::npos || sp2 == string::npos) return -1;
+    request.method = requestLine.substr(0, sp1);
+    string target = requestLine.substr(sp1 + 1, sp2 - sp1 - 1);
+    string version = requestLine.substr(sp2 + 1);
+    request.keepAlive = (version == "HTTP/1.1");
+
+    size_t contentLength = 0;
+    size_t pos = lineEnd + 2;
+    while (pos < headerEnd) {
+        size_t next = conn.in.find("\r\n", pos);
+        string line = conn.in.substr(pos, next - pos);
+        pos = next + 2;
+        size_t colon = line.find(':');
+        if (colon == string::npos) continue;
+        string name = line.substr(0, colon);
+        string value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        for (char& c : name) c = (char)tolower((unsigned char)c);
+        if (name == "content-length") {
+            contentLength = strtoul(value.c_str(), nullptr, 10);
+        } else if (name == "last-event-id") {
+            request.lastEventId = value;
+        } else if (name == "x-session") {
+            request.session = value;
+        } else if (name == "connection") {
+            for (char& c : value) c = (char)tolower((unsigned char)c);
+            if (value == "close") request.keepAlive = false;
+            if (value == "keep-alive") request.keepAlive = true;
+        }
+    }
+    if (contentLength > MAX_BODY_BYTES) return -1;
+    if (conn.in.size() < headerEnd + 4 + contentLength) return 0;
+
+    request.body = conn.in.substr(headerEnd + 4, contentLength);
+    conn.in.erase(0, headerEnd + 4 + contentLength);
+
+    size_t question = target.find('?');
+    request.path = urlDecode(target.substr(0, question));
+    if (question != string::npos) {
+        stringstream query(target.substr(question + 1));
+        string pair;
+        while (getline(query, pair, '&')) {
+            size_t eq = pair.find('=');
+            if (eq == string::npos) request.query[urlDecode(pair)] = "";
+            else request.query[urlDecode(pair.substr(0, eq))] = urlDecode(pair.substr(eq + 1));
+        }
+    }
+    return 1;
+}
+
+// Event streams: re-read the change log this often without a wakeup (other
+// processes' changes with shared state), and send a keepalive comment this
+// often when idle
+const int EVENTS_POLL_MS = 1000;
+const int EVENTS_KEEPALIVE_SECONDS = 15;
+
+// Latest seq in an api_read_changes() reply: {"seq":N,...
+static unsigned long long changesSeq(const string& changes) {
+    return strtoull(changes.c_str() + 7, nullptr, 10);
+}
+
+/**
+ * Append one server-sent event per record in an api_read_changes() reply.
+ * Records are flat objects, each starting with {"seq":
+ */
+static void appendChangeEvents(string& out, const string& changes) {
+    size_t pos = changes.find("\"changes\":[");
+    if (changes.find("\"gap\":true") != string::npos) {
+        // Some changes are gone: one "all" event tells the client to re-read
+        string seq = to_string(changesSeq(changes));
+        out += "id: " + seq + "\nevent: all\ndata: {\"seq\":" + seq
+             + ",\"kind\":\"all\",\"op\":\"reset\",\"quantity\":0}\n\n";
+        return;
+    }
+    const string marker = "{\"seq\":";
+    size_t start = changes.find(marker, pos);
+    while (start != string::npos) {
+        size_t next = changes.find("," + marker, start);
+        size_t end = (next == string::npos) ? changes.rfind("]}") : next;
+        string record = changes.substr(start, end - start);
+        size_t kind = record.find("\"kind\":\"") + 8;
+        out += "id: " + record.substr(marker.size(), record.find(',') - marker.size())
+             + "\nevent: " + record.substr(kind, record.find('"', kind) - kind)
+             + "\ndata: " + record + "\n\n";
+        start = (next == string::npos) ? string::npos : next + 1;
+    }
+}
+
+class Worker {
+private:
+    int epollFd;
+    int changeFd = -1;                  // open while there are event streams
+    vector<Connection*> streams;
+    time_t lastKeepalive = 0;
+    thread loop;
+
+    void closeConnection(Connection* conn) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->fd, nullptr);
+        close(conn->fd);
+        if (conn->eventStream) {
+            streams.erase(find(streams.begin(), streams.end(), conn));
+            if (streams.empty()) {
+                // No listeners left: the library stops rendering change records
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, changeFd, nullptr);
+                api_close_change_fd(changeFd);
+                changeFd = -1;
+            }
+        }
+        delete conn;
+    }
+
+    // Turn the connection into an event stream, starting after request's seq
+    void startEventStream(Connection* conn, const HttpRequest& request) {
+        string since = request.lastEventId;
+        if (since.empty() && request.query.count("since")) since = request.query.at("since");
+        bool numeric = !since.empty() && since.find_first_not_of("0123456789") == string::npos;
+        if (changeFd < 0) {
+            changeFd = api_open_change_fd();
+            epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.ptr = nullptr;      // marks the change fd in run()
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, changeFd, &ev);
+        }
+        conn->eventStream = true;
+        conn->session = request.session;
+        conn->lastSeq = numeric ? strtoull(since.c_str(), nullptr, 10) : api_get_change_seq();
+        conn->in.clear();
+        streams.push_back(conn);
+        // No Content-Length: the body runs until either side closes
+        conn->out += "HTTP/1.1 200 OK\r\n"
+                     "Content-Type: text/event-stream\r\n"
+                     "Cache-Control: no-cache\r\n"
+                     "Access-Control-Allow-Origin: *\r\n"
+                     "Connection: close\r\n\r\n"
+                     "retry: 2000\n\n";
+        string changes = take(api_read_changes(conn->lastSeq));
+        appendChangeEvents(conn->out, changes);
+        conn->lastSeq = changesSeq(changes);
+    }
+
+    // Send every stream the changes it has not seen, or a keepalive when idle
+    void pushEvents() {
+        if (changeFd >= 0) {
+            uint64_t count;
+            ssize_t ignored = read(changeFd, &count, sizeof(count));   // reset the counter
+            (void)ignored;
+        }
+        unsigned long long latest = api_get_change_seq();
+        bool keepalive = time(nullptr) - lastKeepalive >= EVENTS_KEEPALIVE_SECONDS;
+        if (keepalive) lastKeepalive = time(nullptr);
+        unsigned long long readFrom = 0;
+        const string* readSession = nullptr;
+        string changes;
+        vector<Connection*> current = streams;   // flush() may close some
+        for (Connection* conn : current) {
+            if (conn->lastSeq != latest) {
+                // Streams usually share lastSeq, so usually one read per session per wakeup
+                if (changes.empty() || readFrom != conn->lastSeq || *readSession != conn->session) {
+                    readFrom = conn->lastSeq;
+                    readSession = &conn->session;
+                    api_select_session(conn->session.c_str());
+                    changes = take(api_read_changes(readFrom));
+                }
+                appendChangeEvents(conn->out, changes);
+                conn->lastSeq = changesSeq(changes);
+            } else if (keepalive) {
+                conn->out += ": keepalive\n\n";
+            } else {
+                continue;
+            }
+            flush(conn);
+        }
+    }
+
+    // Returns false once the connection has been closed
+    bool flush(Connection* conn) {
+        while (conn->outSent < conn->out.size()) {
+            ssize_t n = send(conn->fd, conn->out.data() + conn->outSent,
+                             conn->out.size() - conn->outSent, MSG_NOSIGNAL);
+            if (n > 0) {
+                conn->outSent += (size_t)n;
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                epoll_event ev = {};
+                ev.events = EPOLLIN | EPOLLOUT;
+                ev.data.ptr = conn;
+                epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->fd, &ev);
+                return true;
+            }
+            closeConnection(conn);
+            return false;
+        }
+        conn->out.clear();
+        conn->outSent = 0;
+        if (conn->closeAfterWrite) {
+            closeConnection(conn);
+            return false;
+        }
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->fd, &ev);
+        return true;
+    }
+
+    void onReadable(Connection* conn) {
+        char buffer[16384];
+        while (true) {
+            ssize_t n = recv(conn->fd, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                conn->in.append(buffer, (size_t)n);
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            closeConnection(conn);   // peer closed or error
+            return;
+        }
+        if (conn->eventStream) {
+            conn->in.clear();        // nothing more is read from an event stream
+            return;
+        }
+
+        while (!conn->closeAfterWrite && !conn->eventStream) {
+            HttpRequest request;
+            int parsed = parseRequest(*conn, request);
+            if (parsed == 0) break;
+            if (parsed < 0) {
+                appendResponse(*conn, errorResponse(400, "Bad request"), false, false);
+                break;
+            }
+            if (!api_select_session(request.session.c_str())) {
+                appendResponse(*conn, errorResponse(400, "Invalid session"), request.keepAlive, false);
+                continue;
+            }
+            if (request.path == "/api/events" && request.method == "GET") {
+                startEventStream(conn, request);
+                break;
+            }
+            HttpResponse response = route(request);
+            appendResponse(*conn, response, request.keepAlive, request.method == "HEAD");
+        }
+        flush(conn);
+    }
+
+    void run() {
+        epoll_event events[128];
+        while (true) {
+            int n = epoll_wait(epollFd, events, 128, streams.empty() ? -1 : EVENTS_POLL_MS);
+            if (n < 0 && errno == EINTR) continue;
+            if (n == 0) pushEvents();
+            for (int i = 0; i < n; i++) {
+                Connection* conn = (Connection*)events[i].data.ptr;
+                if (conn == nullptr) {
+                    pushEvents();
+                } else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    closeConnection(conn);
+                } else if (events[i].events & EPOLLIN) {
+                    onReadable(conn);
+                } else if (events[i].events & EPOLLOUT) {
+                    flush(conn);
+                }
+            }
+        }
+    }
+
+public:
+    Worker() : epollFd(epoll_create1(0)) {
+        loop = thread(&Worker::run, this);
+    }
+
+    void adopt(int fd) {
+        Connection* conn = new Connection();
+        conn->fd = fd;
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+};
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                           SERVER STARTUP
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Ctrl-C / SIGTERM: commit the changes still in the persistence window, then exit
+static void waitForShutdown(sigset_t signals) {
+    int sig = 0;
+    sigwait(&signals, &sig);
+    cout << "\nShutting down, flushing " << dataFile << endl;
+    api_flush();
+    _exit(0);
+}
+
+int main(int argc, char* argv[]) {
+    int port = (argc > 1) ? atoi(argv[1]) : 8080;
+    int workerCount = (argc > 2) ? atoi(argv[2]) : 4;
+    if (argc > 3) webDir = argv[3];
+    if (argc > 4) dataFile = argv[4];
+    size_t slash = dataFile.rfind('/');
+    historyFile = (slash == string::npos ? "" : dataFile.substr(0, slash + 1)) + "purchase_history.bin";
+    importDir = (slash == string::npos ? "" : dataFile.substr(0, slash + 1)) + "catalog";
+    if (getenv("GROCERY_IMPORT_DIR") != nullptr) importDir = getenv("GROCERY_IMPORT_DIR");
+    if (workerCount < 1) workerCount = 1;
+    signal(SIGPIPE, SIG_IGN);
+    // Blocked here so every thread inherits the mask and only the waiter sees them
+    sigset_t shutdownSignals;
+    sigemptyset(&shutdownSignals);
+    sigaddset(&shutdownSignals, SIGINT);
+    sigaddset(&shutdownSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &shutdownSignals, nullptr);
+    thread(waitForShutdown, shutdownSignals).detach();
+
+    cout << "\n" << string(60, '=') << "\n       SMART GROCERY CART (native server)\n" << string(60, '=') << endl;
+    {
+        const char* sharedName = getenv("GROCERY_SHARED_STATE");
+        int attach = 0;
+        if (sharedName != nullptr && sharedName[0] != '\0') {
+            const char* megabytes = getenv("GROCERY_SHARED_STATE_MB");
+            attach = api_attach_shared_state(sharedName, megabytes ? atoi(megabytes) : 64);
+            sharedState = (attach == SHARED_STATE_CREATED || attach == SHARED_STATE_ATTACHED);
+            cout << (attach == SHARED_STATE_CREATED ? "Shared state created: "
+                     : attach == SHARED_STATE_ATTACHED ? "Shared state attached: "
+                     : "Could not attach shared state, using process-local state: ")
+                 << sharedName << endl;
+        }
+        const char* capacity = getenv("GROCERY_CUSTOM_ITEM_CAPACITY");
+        if (capacity != nullptr && atoi(capacity) > 0) api_set_custom_item_capacity(atoi(capacity));
+        // The spill file is per process, so shared state goes without it
+        const char* spill = getenv("GROCERY_ITEM_SPILL");
+        if (spill != nullptr && spill[0] != '\0' && !sharedState && !api_set_item_spill(spill)) {
+            cout << "Could not open item spill file " << spill << ", evicted items are dropped" << endl;
+        }
+        // An existing segment already holds the saved data
+        if (attach == SHARED_STATE_ATTACHED) {
+            loadHistory();
+        } else {
+            loadAllData();
+        }
+        const char* windowMs = getenv("GROCERY_PERSIST_WINDOW_MS");
+        const char* durable = getenv("GROCERY_DURABLE");
+        api_set_persistence(dataFile.c_str(), windowMs ? atoi(windowMs) : 20,
+                            (durable != nullptr && strcmp(durable, "1") == 0) ? 1 : 0);
+    }
+
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+    if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd, 1024) != 0) {
+        cerr << "Cannot listen on port " << port << ": " << strerror(errno) << endl;
+        return 1;
+    }
+
+    vector<Worker*> workers;
+    for (int i = 0; i < workerCount; i++) workers.push_back(new Worker());
+    cout << "Open http://localhost:" << port << " (" << workerCount << " workers)" << endl;
+
+    size_t next = 0;
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            cerr << "accept failed: " << strerror(errno) << endl;
+            continue;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        workers[next++ % workers.size()]->adopt(fd);
+    }
+}
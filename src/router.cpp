@@ -0,0 +1,894 @@
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                           SMART GROCERY CART
+ *                    Data Structures Project - Air University
+ *                              3rd Semester
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * FILE: router.cpp
+ * PURPOSE: Session router (Linux) for a partitioned deployment
+ *
+ * One server process holds one item store and serves from one machine. In
+ * a partitioned deployment several servers (native_server or server.py,
+ * the "shards") each hold the carts of some shoppers, and this router
+ * sends every request to the shard that owns its session.
+ *
+ * DESIGN:
+ * - A session is named by the X-Session header or the grocery_session
+ *   cookie; a browser without either gets a new key in a cookie
+ * - Sessions map to shards by consistent hashing (HASH RING below), so
+ *   adding or removing a shard moves only the sessions it gains or loses
+ * - Requests are forwarded with X-Session set, which selects the cart on
+ *   the shard (api_select_session); one thread per client connection,
+ *   with a keep-alive connection per shard
+ * - POST /router/nodes (from this machine only) changes the shard list:
+ *   sessions that change owner are exported from the old shard, imported
+ *   into the new one (the data file's session JSON) and then dropped
+ * - A background thread takes each shard's purchase counts every
+ *   sync_ms and hands them to the other shards, so every shard ranks the
+ *   purchases of all of them (see PURCHASE DELTAS in grocery_api_new.cpp)
+ * - Routes under /api/shard/ are for the router only; clients get 403
+ *
+ * COMPILATION (Linux):
+ *   g++ -O2 -std=c++17 -pthread -o router router.cpp
+ *
+ * USAGE (shards already running, e.g. ./native_server 8001 2 ../web shard1.json):
+ *   ./router [port=8000] [nodes=127.0.0.1:8001] [sync_ms=1000]
+ *   nodes is a comma-separated list of host:port
+ */
+
+#ifndef __linux__
+#error "router uses Linux sockets and only builds on Linux"
+#endif
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cerrno>
+#include <csignal>
+
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "core/JsonReader.h"
+
+using namespace std;
+
+const size_t MAX_HEADER_BYTES = 16 * 1024;
+const size_t MAX_BODY_BYTES = 1024 * 1024;
+const size_t MAX_SESSION_KEY = 64;               // as valid_session_key in grocery_api_new.cpp
+const char* SESSION_COOKIE = "grocery_session";
+const int CLIENT_IDLE_SECONDS = 60;              // keep-alive connections idle longer are closed
+const int SHARD_TIMEOUT_SECONDS = 30;            // one request to a shard
+const size_t MAX_PENDING_DELTAS = 100000;        // lines kept for a shard that cannot be reached
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    HASH RING (consistent hashing of sessions)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+struct Node {
+    string name;     // host:port, as given
+    string host;
+    string port;
+};
+
+// FNV-1a, then the MurmurHash3 finalizer to spread the short keys' bits
+static uint64_t hashKey(const string& key) {
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : key) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * Each node is placed at VIRTUAL_NODES points on a 64-bit circle; a
+ * session belongs to the first point at or after its hash. Removing a node
+ * hands its sessions to the nodes after its points, adding one takes about
+ * 1/n of the sessions from the others, and nothing else moves.
+ */
+class HashRing {
+private:
+    static const int VIRTUAL_NODES = 128;
+    vector<Node> nodes;
+    vector<pair<uint64_t, int>> points;   // sorted by hash; second = index in nodes
+
+public:
+    explicit HashRing(const vector<Node>& list) : nodes(list) {
+        for (int i = 0; i < (int)nodes.size(); i++) {
+            for (int v = 0; v < VIRTUAL_NODES; v++) {
+                points.emplace_back(hashKey(nodes[i].name + "#" + to_string(v)), i);
+            }
+        }
+        sort(points.begin(), points.end());
+    }
+
+    const vector<Node>& members() const { return nodes; }
+
+    const Node& owner(const string& session) const {
+        auto it = lower_bound(points.begin(), points.end(), make_pair(hashKey(session), 0));
+        if (it == points.end()) it = points.begin();
+        return nodes[it->second];
+    }
+};
+
+// "host:port,host:port" -> nodes; false if empty or malformed
+static bool parseNodes(const string& list, vector<Node>& nodes) {
+    stringstream in(list);
+    string entry;
+    while (getline(in, entry, ',')) {
+        size_t colon = entry.rfind(':');
+        if (colon == string::npos || colon == 0 || colon + 1 == entry.size()) return false;
+        if (entry.find_first_not_of("0123456789", colon + 1) != string::npos) return false;
+        for (const Node& existing : nodes) {
+            if (existing.name == entry) return false;
+        }
+        nodes.push_back(Node{entry, entry.substr(0, colon), entry.substr(colon + 1)});
+    }
+    return !nodes.empty();
+}
+
+// Requests hold it shared while they use the ring; a rebalance holds it exclusively
+static shared_mutex ringMutex;
+static shared_ptr<const HashRing> ring;
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    SOCKETS AND HTTP MESSAGES
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static int connectTo(const Node& node) {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = nullptr;
+    if (getaddrinfo(node.host.c_str(), node.port.c_str(), &hints, &found) != 0) return -1;
+    int fd = -1;
+    for (addrinfo* a = found; a != nullptr && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+        if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    timeval timeout = {SHARD_TIMEOUT_SECONDS, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+static bool sendAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+static bool sendAll(int fd, const string& data) {
+    return sendAll(fd, data.data(), data.size());
+}
+
+// Read until `buffer` holds at least `size` bytes
+static bool fill(int fd, string& buffer, size_t size) {
+    char chunk[16384];
+    while (buffer.size() < size) {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buffer.append(chunk, (size_t)n);
+    }
+    return true;
+}
+
+// Read until the peer closes the connection
+static void readToClose(int fd, string& buffer) {
+    char chunk[16384];
+    while (true) {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        buffer.append(chunk, (size_t)n);
+    }
+}
+
+// Read until `buffer` holds a whole header block; returns where it ends (at \r\n\r\n)
+static size_t readHead(int fd, string& buffer) {
+    char chunk[16384];
+    size_t end;
+    while ((end = buffer.find("\r\n\r\n")) == string::npos) {
+        if (buffer.size() > MAX_HEADER_BYTES) return string::npos;
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return string::npos;
+        buffer.append(chunk, (size_t)n);
+    }
+    return end;
+}
+
+static string lower(string text) {
+    for (char& c : text) c = (char)tolower((unsigned char)c);
+    return text;
+}
+
+struct Message {
+    string startLine;
+    vector<pair<string, string>> headers;
+
+    // Value of the header `name` (lower case), or ""
+    string header(const string& name) const {
+        for (const auto& h : headers) {
+            if (strcasecmp(h.first.c_str(), name.c_str()) == 0) return h.second;
+        }
+        return "";
+    }
+};
+
+static Message parseHead(const string& head) {
+    Message message;
+    size_t lineEnd = head.find("\r\n");
+    message.startLine = head.substr(0, lineEnd);
+    size_t pos = (lineEnd == string::npos) ? head.size() : lineEnd + 2;
+    while (pos < head.size()) {
+        size_t next = head.find("\r\n", pos);
+        if (next == string::npos) next = head.size();
+        string line = head.substr(pos, next - pos);
+        pos = next + 2;
+        size_t colon = line.find(':');
+        if (colon == string::npos) continue;
+        string value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t") + 1);
+        message.headers.emplace_back(line.substr(0, colon), value);
+    }
+    return message;
+}
+
+// Hop-by-hop headers, and the ones the router sets itself
+static bool forwardedHeader(const string& header) {
+    string name = lower(header);
+    return name != "connection" && name != "keep-alive" && name != "transfer-encoding"
+        && name != "content-length" && name != "expect" && name != "x-session";
+}
+
+// How a response body ends
+enum Framing { NO_BODY, BY_LENGTH, CHUNKED, UNTIL_CLOSE };
+
+struct ResponseHead {
+    int status = 0;
+    Message message;
+    Framing framing = UNTIL_CLOSE;
+    size_t length = 0;
+    bool closes = false;    // the shard closes the connection after it
+};
+
+static bool readResponseHead(int fd, string& buffer, bool headRequest, ResponseHead& response) {
+    size_t end = readHead(fd, buffer);
+    if (end == string::npos) return false;
+    response.message = parseHead(buffer.substr(0, end));
+    buffer.erase(0, end + 4);
+    const string& line = response.message.startLine;
+    if (line.compare(0, 5, "HTTP/") != 0 || line.size() < 12) return false;
+    response.status = atoi(line.c_str() + 9);
+    string connection = lower(response.message.header("connection"));
+    response.closes = connection == "close" || (line.compare(0, 8, "HTTP/1.0") == 0 && connection != "keep-alive");
+    string length = response.message.header("content-length");
+    if (headRequest || response.status == 204 || response.status == 304 || response.status < 200) {
+        response.framing = NO_BODY;
+    } else if (lower(response.message.header("transfer-encoding")).find("chunked") != string::npos) {
+        response.framing = CHUNKED;
+    } else if (!length.empty()) {
+        response.framing = BY_LENGTH;
+        response.length = strtoull(length.c_str(), nullptr, 10);
+    } else {
+        response.framing = UNTIL_CLOSE;
+        response.closes = true;
+    }
+    return true;
+}
+
+/**
+ * Pass a BY_LENGTH or CHUNKED body to `sink`, starting with the bytes
+ * already in `buffer`. Chunk framing is passed on as it is, or stripped
+ * with `decode`. Returns false if the shard stops early or `sink` fails.
+ */
+static bool readBody(int fd, string& buffer, const ResponseHead& response, bool decode,
+                     const function<bool(const char*, size_t)>& sink) {
+    if (response.framing == NO_BODY) return true;
+    if (response.framing == BY_LENGTH) {
+        size_t left = response.length;
+        char chunk[16384];
+        size_t now = min(left, buffer.size());
+        if (now > 0 && !sink(buffer.data(), now)) return false;
+        buffer.erase(0, now);
+        left -= now;
+        while (left > 0) {
+            ssize_t n = recv(fd, chunk, min(left, sizeof(chunk)), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0 || !sink(chunk, (size_t)n)) return false;
+            left -= (size_t)n;
+        }
+        return true;
+    }
+    while (true) {
+        size_t lineEnd;
+        while ((lineEnd = buffer.find("\r\n")) == string::npos) {
+            if (buffer.size() > MAX_HEADER_BYTES || !fill(fd, buffer, buffer.size() + 1)) return false;
+        }
+        size_t size = strtoull(buffer.c_str(), nullptr, 16);
+        if (size == 0) {
+            // Last chunk, then optional trailers up to an empty line
+            size_t end;
+            while ((end = buffer.find("\r\n\r\n", lineEnd)) == string::npos) {
+                if (buffer.size() > MAX_HEADER_BYTES || !fill(fd, buffer, buffer.size() + 1)) return false;
+            }
+            end += 4;
+            if (!decode && !sink(buffer.data(), end)) return false;
+            buffer.erase(0, end);
+            return true;
+        }
+        size_t total = lineEnd + 2 + size + 2;
+        if (!fill(fd, buffer, total)) return false;
+        bool sent = decode ? sink(buffer.data() + lineEnd + 2, size) : sink(buffer.data(), total);
+        if (!sent) return false;
+        buffer.erase(0, total);
+    }
+}
+
+/**
+ * One request to a shard on a new connection (rebalancing, purchase
+ * deltas). Returns true with the decoded body on a 200 response.
+ */
+static bool shardCall(const Node& node, const string& method, const string& path,
+                      const string& session, const string& body, string& reply) {
+    int fd = connectTo(node);
+    if (fd < 0) return false;
+    string request = method + " " + path + " HTTP/1.1\r\nHost: " + node.name + "\r\n"
+                   + (session.empty() ? "" : "X-Session: " + session + "\r\n")
+                   + "Content-Type: application/json\r\nContent-Length: " + to_string(body.size())
+                   + "\r\nConnection: close\r\n\r\n" + body;
+    string buffer;
+    ResponseHead response;
+    reply.clear();
+    bool ok = sendAll(fd, request) && readResponseHead(fd, buffer, false, response);
+    if (ok && response.framing == UNTIL_CLOSE) {
+        readToClose(fd, buffer);
+        reply.swap(buffer);
+    } else if (ok) {
+        ok = readBody(fd, buffer, response, true, [&reply](const char* data, size_t size) {
+            reply.append(data, size);
+            return true;
+        });
+    }
+    close(fd);
+    return ok && response.status == 200;
+}
+
+// The "data" member of a shard's {"success":true,"data":...} reply, as text
+static bool replyData(const string& reply, string& data, JsonValue* parsedData = nullptr) {
+    JsonValue parsed;
+    JsonReader reader(reply);
+    if (!reader.parse(parsed) || parsed.type != JsonValue::OBJECT) return false;
+    const JsonValue* value = parsed.get("data");
+    if (value == nullptr) return false;
+    data = reply.substr(value->offset, value->length);
+    if (parsedData != nullptr) *parsedData = *value;
+    return true;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    SESSIONS AND OPEN EVENT STREAMS
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Same rule as the library's: 1-64 of [A-Za-z0-9._-]
+static bool validSessionKey(const string& key) {
+    if (key.empty() || key.size() > MAX_SESSION_KEY) return false;
+    for (char c : key) {
+        if (!isalnum((unsigned char)c) && c != '-' && c != '_' && c != '.') return false;
+    }
+    return true;
+}
+
+static string newSessionKey() {
+    static mutex randomMutex;
+    static mt19937_64 random(random_device{}() ^ (uint64_t)chrono::steady_clock::now().time_since_epoch().count());
+    lock_guard<mutex> guard(randomMutex);
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", (unsigned long long)random());
+    return key;
+}
+
+static string cookieValue(const string& cookies, const string& name) {
+    stringstream in(cookies);
+    string pair;
+    while (getline(in, pair, ';')) {
+        pair.erase(0, pair.find_first_not_of(' '));
+        if (pair.compare(0, name.size() + 1, name + "=") == 0) return pair.substr(name.size() + 1);
+    }
+    return "";
+}
+
+// GET /api/events connections being relayed, so a rebalance can close those
+// of the sessions it moves (EventSource then reconnects to the new shard)
+static mutex streamsMutex;
+static multimap<string, int> openStreams;      // session -> client fd
+static set<string> movedStreams;               // next stream of these restarts from seq 0
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    PURCHASE DELTAS (one ranking across shards)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Lines taken from other shards, not yet applied on this one (by node name)
+static mutex deltaMutex;
+static map<string, vector<string>> pendingDeltas;
+
+/**
+ * One round: take each shard's new purchase lines and apply them on every
+ * other shard. Lines a shard could not take stay pending for the next
+ * round. The caller holds ringMutex.
+ */
+static void syncDeltas(const HashRing& current) {
+    lock_guard<mutex> guard(deltaMutex);
+    const vector<Node>& nodes = current.members();
+    vector<vector<string>> taken(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        string reply;
+        string data;
+        JsonValue parsed;
+        if (!shardCall(nodes[i], "POST", "/api/shard/deltas/take", "", "", reply)
+            || !replyData(reply, data, &parsed)) {
+            continue;   // the lines stay on the shard until it answers
+        }
+        const JsonValue* items = parsed.get("items");
+        if (items == nullptr || items->type != JsonValue::ARRAY) continue;
+        for (const JsonValue& item : items->items) {
+            taken[i].push_back(reply.substr(item.offset, item.length));
+        }
+    }
+    map<string, vector<string>> kept;
+    for (size_t j = 0; j < nodes.size(); j++) {
+        vector<string>& pending = pendingDeltas[nodes[j].name];
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (i != j) pending.insert(pending.end(), taken[i].begin(), taken[i].end());
+        }
+        if (!pending.empty()) {
+            string document = "{\"items\":[";
+            for (size_t k = 0; k < pending.size(); k++) document += (k ? "," : "") + pending[k];
+            document += "]}";
+            string reply;
+            if (shardCall(nodes[j], "POST", "/api/shard/deltas/apply", "", document, reply)) {
+                pending.clear();
+            } else if (pending.size() > MAX_PENDING_DELTAS) {
+                cerr << "Dropping " << pending.size() - MAX_PENDING_DELTAS << " purchase lines for "
+                     << nodes[j].name << endl;
+                pending.erase(pending.begin(), pending.end() - MAX_PENDING_DELTAS);
+            }
+        }
+        kept[nodes[j].name].swap(pending);
+    }
+    pendingDeltas.swap(kept);   // forget shards no longer in the ring
+}
+
+static void syncDeltasForever(int intervalMs) {
+    while (true) {
+        this_thread::sleep_for(chrono::milliseconds(intervalMs));
+        shared_lock<shared_mutex> lock(ringMutex);
+        syncDeltas(*ring);
+    }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    REBALANCING (POST /router/nodes)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+struct SessionMove {
+    string key;
+    const Node* from;
+    const Node* to;
+    string document;    // api_export_session JSON
+};
+
+static string nodesJson(const HashRing& current) {
+    string json = "[";
+    for (const Node& node : current.members()) {
+        json += (json.size() > 1 ? ",\"" : "\"") + node.name + "\"";
+    }
+    return json + "]";
+}
+
+/**
+ * Switch to `nodes`, moving each session whose owner changes: all are
+ * copied to their new shards first, and only if every copy succeeds does
+ * the ring change and the old copies go. On failure nothing changes.
+ * Returns the JSON reply and its status.
+ */
+static string rebalance(const vector<Node>& nodes, int& status) {
+    unique_lock<shared_mutex> lock(ringMutex);
+    syncDeltas(*ring);   // shards leaving the ring hand over their last purchases
+    shared_ptr<const HashRing> next = make_shared<HashRing>(nodes);
+
+    vector<SessionMove> moves;
+    for (const Node& node : ring->members()) {
+        string reply;
+        string data;
+        JsonValue keys;
+        if (!shardCall(node, "GET", "/api/shard/sessions", "", "", reply)
+            || !replyData(reply, data, &keys) || keys.type != JsonValue::ARRAY) {
+            status = 502;
+            return "{\"success\":false,\"error\":\"Could not list sessions on " + node.name + "\"}";
+        }
+        for (const JsonValue& key : keys.items) {
+            if (key.type != JsonValue::STRING) continue;
+            const Node& owner = next->owner(key.str);
+            if (owner.name == node.name) continue;
+            SessionMove move{key.str, &node, &owner, ""};
+            if (!shardCall(node, "GET", "/api/shard/session", key.str, "", reply)
+                || !replyData(reply, move.document)) {
+                status = 502;
+                return "{\"success\":false,\"error\":\"Could not export session " + key.str + "\"}";
+            }
+            moves.push_back(move);
+        }
+    }
+
+    string reply;
+    for (size_t i = 0; i < moves.size(); i++) {
+        if (!shardCall(*moves[i].to, "PUT", "/api/shard/session", moves[i].key, moves[i].document, reply)) {
+            for (size_t k = 0; k < i; k++) {
+                shardCall(*moves[k].to, "DELETE", "/api/shard/session", moves[k].key, "", reply);
+            }
+            status = 502;
+            return "{\"success\":false,\"error\":\"Could not import session " + moves[i].key
+                   + " on " + moves[i].to->name + "\"}";
+        }
+    }
+    for (const SessionMove& move : moves) {
+        if (!shardCall(*move.from, "DELETE", "/api/shard/session", move.key, "", reply)) {
+            cerr << "Could not drop moved session " << move.key << " on " << move.from->name << endl;
+        }
+    }
+    {
+        lock_guard<mutex> guard(streamsMutex);
+        for (const SessionMove& move : moves) {
+            movedStreams.insert(move.key);
+            auto range = openStreams.equal_range(move.key);
+            for (auto it = range.first; it != range.second; ++it) shutdown(it->second, SHUT_RDWR);
+        }
+    }
+    ring = next;
+    syncDeltas(*ring);   // new shards record purchases from their first request
+    cout << "Nodes: " << nodesJson(*ring) << ", " << moves.size() << " sessions moved" << endl;
+    status = 200;
+    return "{\"success\":true,\"nodes\":" + nodesJson(*ring) + ",\"moved\":" + to_string(moves.size()) + "}";
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    CLIENT CONNECTIONS (one thread each)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static const char* statusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 413: return "Payload Too Large";
+        case 502: return "Bad Gateway";
+        default: return "OK";
+    }
+}
+
+static bool sendJson(int fd, int status, const string& body, bool keepAlive) {
+    return sendAll(fd, "HTTP/1.1 " + to_string(status) + " " + statusText(status) + "\r\n"
+                       "Content-Type: application/json\r\nContent-Length: " + to_string(body.size()) + "\r\n"
+                       "Access-Control-Allow-Origin: *\r\n"
+                       "Connection: " + (keepAlive ? "keep-alive" : "close") + "\r\n\r\n" + body);
+}
+
+static bool sendError(int fd, int status, const string& message, bool keepAlive) {
+    return sendJson(fd, status, "{\"success\":false,\"error\":\"" + message + "\"}", keepAlive);
+}
+
+// Admin routes are only served to clients on this machine
+static bool fromLoopback(int fd) {
+    sockaddr_storage peer = {};
+    socklen_t size = sizeof(peer);
+    if (getpeername(fd, (sockaddr*)&peer, &size) != 0) return false;
+    if (peer.ss_family == AF_INET) {
+        return (ntohl(((sockaddr_in*)&peer)->sin_addr.s_addr) >> 24) == 127;
+    }
+    return peer.ss_family == AF_INET6 && IN6_IS_ADDR_LOOPBACK(&((sockaddr_in6*)&peer)->sin6_addr);
+}
+
+// GET /router/nodes lists the shards; POST {"nodes":["host:port",...]} sets them
+static bool handleAdmin(int fd, const string& method, const string& path, const string& body, bool keepAlive) {
+    if (!fromLoopback(fd)) return sendError(fd, 403, "Forbidden", keepAlive);
+    if (path != "/router/nodes") return sendError(fd, 404, "Not found", keepAlive);
+    if (method == "GET") {
+        shared_lock<shared_mutex> lock(ringMutex);
+        return sendJson(fd, 200, "{\"success\":true,\"nodes\":" + nodesJson(*ring) + "}", keepAlive);
+    }
+    if (method != "POST") return sendError(fd, 404, "Not found", keepAlive);
+    JsonValue parsed;
+    JsonReader reader(body);
+    const JsonValue* list = reader.parse(parsed) ? parsed.get("nodes") : nullptr;
+    string joined;
+    for (size_t i = 0; list != nullptr && list->type == JsonValue::ARRAY && i < list->items.size(); i++) {
+        joined += (i ? "," : "") + list->items[i].str;
+    }
+    vector<Node> nodes;
+    if (!parseNodes(joined, nodes)) return sendError(fd, 400, "nodes must be a list of host:port", keepAlive);
+    int status = 200;
+    string reply = rebalance(nodes, status);
+    return sendJson(fd, status, reply, keepAlive);
+}
+
+// Shard connections of one client thread, kept open between its requests
+struct ShardPool {
+    map<string, int> open;   // node name -> fd
+
+    ~ShardPool() {
+        for (const auto& entry : open) close(entry.second);
+    }
+
+    int take(const Node& node, bool& reused) {
+        auto it = open.find(node.name);
+        reused = (it != open.end());
+        if (!reused) return connectTo(node);
+        int fd = it->second;
+        open.erase(it);
+        return fd;
+    }
+
+    void give(const Node& node, int fd) {
+        open[node.name] = fd;
+    }
+};
+
+// Copy bytes both ways until either side closes (event streams, unframed bodies)
+static void relayUntilClose(int client, int shard, const string& already) {
+    if (!already.empty() && !sendAll(client, already)) return;
+    pollfd fds[2] = {{shard, POLLIN, 0}, {client, POLLIN, 0}};
+    char chunk[16384];
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents) {
+            // The client sends nothing more on this connection: data or EOF both end it
+            break;
+        }
+        if (fds[0].revents) {
+            ssize_t n = recv(shard, chunk, sizeof(chunk), 0);
+            if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+            if (n <= 0 || !sendAll(client, chunk, (size_t)n)) break;
+        }
+    }
+}
+
+/**
+ * Forward one request to the owner of its session and relay the answer.
+ * Returns false when the client connection must be closed.
+ */
+static bool proxy(int client, ShardPool& pool, const Message& request, const string& method,
+                  string target, const string& path, const string& body, bool keepAlive) {
+    string session = request.header("x-session");
+    bool newSession = false;
+    if (!session.empty() && !validSessionKey(session)) return sendError(client, 400, "Invalid session", keepAlive);
+    if (session.empty()) {
+        session = cookieValue(request.header("cookie"), SESSION_COOKIE);
+        if (!validSessionKey(session)) {
+            session = newSessionKey();
+            newSession = true;
+        }
+    }
+    bool eventStream = (method == "GET" && path == "/api/events");
+    string lastEventId = request.header("last-event-id");
+    if (eventStream) {
+        lock_guard<mutex> guard(streamsMutex);
+        if (movedStreams.erase(session) > 0) {
+            // Sequence numbers are per shard: start over on the new one
+            target = "/api/events";
+            lastEventId = "0";
+        }
+    }
+
+    shared_lock<shared_mutex> lock(ringMutex);
+    Node node = ring->owner(session);
+    string forward = method + " " + target + " HTTP/1.1\r\n";
+    for (const auto& h : request.headers) {
+        if (forwardedHeader(h.first) && lower(h.first) != "last-event-id") forward += h.first + ": " + h.second + "\r\n";
+    }
+    if (!lastEventId.empty()) forward += "Last-Event-ID: " + lastEventId + "\r\n";
+    forward += "X-Session: " + session + "\r\n";
+    if (!body.empty() || (method != "GET" && method != "HEAD")) {
+        forward += "Content-Length: " + to_string(body.size()) + "\r\n";
+    }
+    forward += "Connection: keep-alive\r\n\r\n" + body;
+
+    // A pooled connection the shard has since closed fails at once: retry on a new one
+    int shard = -1;
+    string buffer;
+    ResponseHead response;
+    for (int attempt = 0; attempt < 2 && shard < 0; attempt++) {
+        bool reused = false;
+        shard = pool.take(node, reused);
+        if (shard < 0) break;
+        buffer.clear();
+        if (sendAll(shard, forward) && readResponseHead(shard, buffer, method == "HEAD", response)) break;
+        close(shard);
+        shard = -1;
+        if (!reused) break;
+    }
+    if (shard < 0) return sendError(client, 502, "Shard " + node.name + " unavailable", keepAlive);
+
+    bool clientKeepAlive = keepAlive && response.framing != UNTIL_CLOSE;
+    string head = "HTTP/1.1" + response.message.startLine.substr(response.message.startLine.find(' ')) + "\r\n";
+    for (const auto& h : response.message.headers) {
+        if (lower(h.first) != "connection" && lower(h.first) != "keep-alive") head += h.first + ": " + h.second + "\r\n";
+    }
+    if (newSession) {
+        head += string("Set-Cookie: ") + SESSION_COOKIE + "=" + session + "; Path=/; HttpOnly; SameSite=Lax\r\n";
+    }
+    head += string("Connection: ") + (clientKeepAlive ? "keep-alive" : "close") + "\r\n\r\n";
+    if (!sendAll(client, head)) {
+        close(shard);
+        return false;
+    }
+
+    if (response.framing == UNTIL_CLOSE) {
+        // Open-ended: do not hold up a rebalance, which closes moved streams instead
+        {
+            lock_guard<mutex> guard(streamsMutex);
+            if (eventStream) openStreams.emplace(session, client);
+        }
+        lock.unlock();
+        relayUntilClose(client, shard, buffer);
+        close(shard);
+        lock_guard<mutex> guard(streamsMutex);
+        for (auto it = openStreams.begin(); it != openStreams.end(); ++it) {
+            if (it->second == client) {
+                openStreams.erase(it);
+                break;
+            }
+        }
+        return false;
+    }
+
+    bool relayed = readBody(shard, buffer, response, false, [client](const char* data, size_t size) {
+        return sendAll(client, data, size);
+    });
+    if (relayed && !response.closes && buffer.empty()) {
+        pool.give(node, shard);
+    } else {
+        close(shard);
+    }
+    return relayed && clientKeepAlive;
+}
+
+static void serveClient(int client) {
+    timeval idle = {CLIENT_IDLE_SECONDS, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+    ShardPool pool;
+    string in;
+    while (true) {
+        size_t end = readHead(client, in);
+        if (end == string::npos) {
+            if (in.size() > MAX_HEADER_BYTES) sendError(client, 400, "Bad request", false);
+            break;
+        }
+        Message request = parseHead(in.substr(0, end));
+        size_t sp1 = request.startLine.find(' ');
+        size_t sp2 = request.startLine.find(' ', sp1 + 1);
+        if (sp1 == string::npos || sp2 == string::npos || !request.header("transfer-encoding").empty()) {
+            sendError(client, 400, "Bad request", false);
+            break;
+        }
+        string method = request.startLine.substr(0, sp1);
+        string target = request.startLine.substr(sp1 + 1, sp2 - sp1 - 1);
+        string version = request.startLine.substr(sp2 + 1);
+        string connection = lower(request.header("connection"));
+        bool keepAlive = (version == "HTTP/1.1") ? connection != "close" : connection == "keep-alive";
+
+        size_t length = strtoull(request.header("content-length").c_str(), nullptr, 10);
+        if (length > MAX_BODY_BYTES) {
+            sendError(client, 413, "Payload too large", false);
+            break;
+        }
+        if (lower(request.header("expect")) == "100-continue" && in.size() < end + 4 + length) {
+            sendAll(client, "HTTP/1.1 100 Continue\r\n\r\n");
+        }
+        if (!fill(client, in, end + 4 + length)) break;
+        string body = in.substr(end + 4, length);
+        in.erase(0, end + 4 + length);
+
+        string path = target.substr(0, target.find('?'));
+        bool open;
+        if (path.compare(0, 8, "/router/") == 0) {
+            open = handleAdmin(client, method, path, body, keepAlive) && keepAlive;
+        } else if (path.compare(0, 11, "/api/shard/") == 0) {
+            open = sendError(client, 403, "Forbidden", keepAlive) && keepAlive;
+        } else {
+            open = proxy(client, pool, request, method, target, path, body, keepAlive);
+        }
+        if (!open) break;
+    }
+    close(client);
+}
+
+int main(int argc, char* argv[]) {
+    int port = (argc > 1) ? atoi(argv[1]) : 8000;
+    string nodeList = (argc > 2) ? argv[2] : "127.0.0.1:8001";
+    int syncMs = (argc > 3) ? atoi(argv[3]) : 1000;
+    vector<Node> nodes;
+    if (!parseNodes(nodeList, nodes)) {
+        cerr << "nodes must be a comma-separated list of host:port, got " << nodeList << endl;
+        return 1;
+    }
+    if (syncMs < 10) syncMs = 10;
+    signal(SIGPIPE, SIG_IGN);
+    ring = make_shared<HashRing>(nodes);
+
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+    if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd, 1024) != 0) {
+        cerr << "Cannot listen on port " << port << ": " << strerror(errno) << endl;
+        return 1;
+    }
+
+    cout << "\n" << string(60, '=') << "\n       SMART GROCERY CART (router)\n" << string(60, '=') << endl;
+    cout << "Nodes: " << nodesJson(*ring) << ", purchase counts synced every " << syncMs << " ms" << endl;
+    cout << "Open http://localhost:" << port << endl;
+    syncDeltas(*ring);   // shards record purchases only once they have been asked for them
+    thread(syncDeltasForever, syncMs).detach();
+
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            cerr << "accept failed: " << strerror(errno) << endl;
+            continue;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        thread(serveClient, fd).detach();
+    }
+}
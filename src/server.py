@@ -12,12 +12,14 @@ This is a shopping list reminder app - helps users remember what to buy
 NO PRICES - just item names and quantities
 """
 
-from flask import Flask, jsonify, request, send_from_directory
+from flask import Flask, jsonify, request, send_from_directory, Response
 from flask_cors import CORS
 import ctypes
 import os
 import sys
 import json
+import threading
+import time
 from datetime import datetime
 
 # ═══════════════════════════════════════════════════════════════════════════════
@@ -38,7 +40,20 @@ else:
 
 dll_path = os.path.join(os.path.dirname(__file__), dll_name)
 
-try:
+# Mirrors struct CartOp in grocery_api_new.cpp (one op of api_apply_batch)
+class CartOp(ctypes.Structure):
+    _fields_ = [
+        ('kind', ctypes.c_int),
+        ('name', ctypes.c_char_p),
+        ('quantity', ctypes.c_int),
+        ('product_id', ctypes.c_int),
+        ('position', ctypes.c_int),
+    ]
+
+# Signature of api_subscribe_changes callbacks: (record JSON, context)
+CHANGE_CALLBACK = ctypes.CFUNCTYPE(None, ctypes.c_char_p, ctypes.c_void_p)
+
+def load_ctypes_library():
     grocery_lib = ctypes.CDLL(dll_path)
     
     # Array functions
@@ -46,12 +61,25 @@ try:
     grocery_lib.api_get_frequent_item.argtypes = [ctypes.c_int]
     grocery_lib.api_get_frequent_item.restype = ctypes.c_char_p
     grocery_lib.api_get_all_frequent_items.restype = ctypes.c_char_p
+    grocery_lib.api_get_ranked_frequent_items.argtypes = [ctypes.c_int]
+    grocery_lib.api_get_ranked_frequent_items.restype = ctypes.c_char_p
+    grocery_lib.api_read_ranked_items.argtypes = [ctypes.c_int, ctypes.c_char_p, ctypes.c_int]
+    grocery_lib.api_read_ranked_items.restype = ctypes.c_int
+    grocery_lib.api_set_popularity_half_life.argtypes = [ctypes.c_double]
+    grocery_lib.api_set_popularity_half_life.restype = None
+    grocery_lib.api_get_popularity_half_life.restype = ctypes.c_double
     
     # Linked List (Cart) functions - NO PRICE
     grocery_lib.api_add_to_cart.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_int]
-    grocery_lib.api_add_to_cart.restype = None
+    grocery_lib.api_add_to_cart.restype = ctypes.c_uint64
     grocery_lib.api_remove_from_cart.argtypes = [ctypes.c_int]
     grocery_lib.api_remove_from_cart.restype = ctypes.c_char_p
+    grocery_lib.api_remove_cart_line.argtypes = [ctypes.c_uint64]
+    grocery_lib.api_remove_cart_line.restype = ctypes.c_char_p
+    grocery_lib.api_update_cart_line.argtypes = [ctypes.c_uint64, ctypes.c_int]
+    grocery_lib.api_update_cart_line.restype = ctypes.c_bool
+    grocery_lib.api_get_cart_item_at.argtypes = [ctypes.c_int]
+    grocery_lib.api_get_cart_item_at.restype = ctypes.c_char_p
     grocery_lib.api_get_cart_size.restype = ctypes.c_int
     grocery_lib.api_is_cart_empty.restype = ctypes.c_bool
     grocery_lib.api_get_cart_total_quantity.restype = ctypes.c_int
@@ -65,12 +93,58 @@ try:
     grocery_lib.api_get_stack_items.restype = ctypes.c_char_p
     grocery_lib.api_clear_undo_stack.restype = None
     
+    # Batch (many cart/undo operations in one call)
+    grocery_lib.api_apply_batch.argtypes = [ctypes.POINTER(CartOp), ctypes.c_int]
+    grocery_lib.api_apply_batch.restype = ctypes.c_char_p
+    
+    # Cart replication (CRDT deltas from offline / other devices)
+    grocery_lib.api_merge_cart_delta.argtypes = [ctypes.c_char_p]
+    grocery_lib.api_merge_cart_delta.restype = ctypes.c_char_p
+    
+    # Change notifications (cart, undo and checkout mutations)
+    grocery_lib.api_subscribe_changes.argtypes = [CHANGE_CALLBACK, ctypes.c_void_p]
+    grocery_lib.api_subscribe_changes.restype = ctypes.c_int
+    grocery_lib.api_get_change_seq.restype = ctypes.c_ulonglong
+    grocery_lib.api_read_changes.argtypes = [ctypes.c_ulonglong]
+    grocery_lib.api_read_changes.restype = ctypes.c_char_p
+    
     # Queue (Checkout) functions
     grocery_lib.api_start_checkout.restype = None
     grocery_lib.api_get_queue_size.restype = ctypes.c_int
     grocery_lib.api_process_checkout.restype = ctypes.c_char_p
     grocery_lib.api_get_queue_items.restype = ctypes.c_char_p
     
+    # Streaming (cart listings and receipts in bounded chunks)
+    grocery_lib.api_stream_open.argtypes = [ctypes.c_int]
+    grocery_lib.api_stream_open.restype = ctypes.c_int
+    grocery_lib.api_stream_next.argtypes = [ctypes.c_int, ctypes.c_char_p, ctypes.c_int]
+    grocery_lib.api_stream_next.restype = ctypes.c_int
+    grocery_lib.api_stream_close.argtypes = [ctypes.c_int]
+    grocery_lib.api_stream_close.restype = None
+    
+    # Recommendation (co-purchase) functions
+    grocery_lib.api_get_bought_together.argtypes = [ctypes.c_int]
+    grocery_lib.api_get_bought_together.restype = ctypes.c_char_p
+    grocery_lib.api_get_copurchase_stats.restype = ctypes.c_char_p
+    
+    # Purchase history (columnar checkout log) functions
+    grocery_lib.api_history_top_items.argtypes = [ctypes.c_double, ctypes.c_double, ctypes.c_int]
+    grocery_lib.api_history_top_items.restype = ctypes.c_char_p
+    grocery_lib.api_history_item_series.argtypes = [ctypes.c_char_p, ctypes.c_double, ctypes.c_double, ctypes.c_int]
+    grocery_lib.api_history_item_series.restype = ctypes.c_char_p
+    grocery_lib.api_history_stats.restype = ctypes.c_char_p
+    grocery_lib.api_history_save.argtypes = [ctypes.c_char_p]
+    grocery_lib.api_history_save.restype = ctypes.c_bool
+    grocery_lib.api_history_load.argtypes = [ctypes.c_char_p]
+    grocery_lib.api_history_load.restype = ctypes.c_bool
+    grocery_lib.api_top_items_window.argtypes = [ctypes.c_int, ctypes.c_int]
+    grocery_lib.api_top_items_window.restype = ctypes.c_char_p
+    
+    # Heavy-hitter (custom item sketch) functions
+    grocery_lib.api_set_heavy_hitter_mode.argtypes = [ctypes.c_int]
+    grocery_lib.api_set_heavy_hitter_mode.restype = None
+    grocery_lib.api_get_heavy_hitters.restype = ctypes.c_char_p
+    
     # Purchase count update function
     grocery_lib.api_increment_purchase_count_by_id.argtypes = [ctypes.c_int]
     grocery_lib.api_increment_purchase_count_by_id.restype = None
@@ -78,59 +152,261 @@ try:
     # Custom item restoration function - NO PRICE
     grocery_lib.api_restore_custom_item.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_int]
     grocery_lib.api_restore_custom_item.restype = None
+    grocery_lib.api_restore_item_popularity.argtypes = [ctypes.c_int, ctypes.c_double, ctypes.c_double]
+    grocery_lib.api_restore_item_popularity.restype = None
+    
+    # Bulk catalog import (CSV / TSV)
+    grocery_lib.api_import_catalog.argtypes = [ctypes.c_char_p, ctypes.c_int]
+    grocery_lib.api_import_catalog.restype = ctypes.c_char_p
+    
+    # Item store capacity (LFU eviction of custom items, spill file)
+    grocery_lib.api_set_custom_item_capacity.argtypes = [ctypes.c_int]
+    grocery_lib.api_set_custom_item_capacity.restype = ctypes.c_int
+    grocery_lib.api_set_item_spill.argtypes = [ctypes.c_char_p]
+    grocery_lib.api_set_item_spill.restype = ctypes.c_bool
+    grocery_lib.api_get_item_store_stats.restype = ctypes.c_char_p
+    
+    # Memory accounting functions
+    grocery_lib.api_get_memory_stats.restype = ctypes.c_char_p
+    grocery_lib.api_run_allocation_audit.restype = ctypes.c_char_p
+    
+    # Metrics functions (populated when built with -DGROCERY_METRICS)
+    grocery_lib.api_get_metrics.restype = ctypes.c_char_p
+    grocery_lib.api_get_metrics_text.restype = ctypes.c_char_p
+    
+    # Tracing functions (active when built with -DGROCERY_TRACING)
+    grocery_lib.api_set_tracing.argtypes = [ctypes.c_int]
+    grocery_lib.api_set_tracing.restype = None
+    grocery_lib.api_trace_event.argtypes = [ctypes.c_char_p, ctypes.c_char]
+    grocery_lib.api_trace_event.restype = None
+    grocery_lib.api_dump_trace.restype = ctypes.c_char_p
+    grocery_lib.api_clear_trace.restype = None
+    
+    # Persistence (background group commit of DATA_FILE)
+    grocery_lib.api_set_persistence.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_int]
+    grocery_lib.api_set_persistence.restype = None
+    grocery_lib.api_flush.restype = ctypes.c_bool
+    grocery_lib.api_get_persistence_stats.restype = ctypes.c_char_p
+    
+    # Shared-memory state (multi-process deployments)
+    grocery_lib.api_attach_shared_state.argtypes = [ctypes.c_char_p, ctypes.c_int]
+    grocery_lib.api_attach_shared_state.restype = ctypes.c_int
+    
+    # Sessions and purchase deltas (partitioned deployments, see router.cpp)
+    grocery_lib.api_select_session.argtypes = [ctypes.c_char_p]
+    grocery_lib.api_select_session.restype = ctypes.c_bool
+    grocery_lib.api_list_sessions.restype = ctypes.c_char_p
+    grocery_lib.api_export_session.restype = ctypes.c_char_p
+    grocery_lib.api_import_session.argtypes = [ctypes.c_char_p]
+    grocery_lib.api_import_session.restype = ctypes.c_bool
+    grocery_lib.api_drop_session.restype = None
+    grocery_lib.api_take_purchase_deltas.restype = ctypes.c_char_p
+    grocery_lib.api_apply_purchase_deltas.argtypes = [ctypes.c_char_p]
+    grocery_lib.api_apply_purchase_deltas.restype = ctypes.c_int
     
     # Utility functions
     grocery_lib.api_reset_all.restype = None
     grocery_lib.api_factory_reset.restype = None
     grocery_lib.api_free_string.argtypes = [ctypes.c_char_p]
     grocery_lib.api_free_string.restype = None
+    return grocery_lib
+
+# The grocery_native extension module (grocery_native.cpp), when built, has the
+# same api_* functions without ctypes marshalling, and returns cart, stack and
+# queue listings as lists. GROCERY_BINDING=ctypes loads the DLL regardless.
+NATIVE_BINDING = False
+if os.environ.get('GROCERY_BINDING', 'native') != 'ctypes':
+    try:
+        import grocery_native
+        NATIVE_BINDING = True
+    except ImportError:
+        pass
+
+try:
+    if NATIVE_BINDING:
+        grocery_lib = grocery_native
+        loaded_from = grocery_native.__file__
+    else:
+        grocery_lib = load_ctypes_library()
+        loaded_from = dll_path
     
     DLL_LOADED = True
-    print(f"✅ C++ Library loaded successfully: {dll_path}")
+    print(f"✅ C++ Library loaded successfully: {loaded_from}")
     
 except OSError as e:
     DLL_LOADED = False
     print(f"⚠️  Warning: Could not load C++ library: {e}")
 
+def c_text(text):
+    """A string argument for the library (grocery_native reads str as it is)"""
+    return text if NATIVE_BINDING else text.encode('utf-8')
+
+# ═══════════════════════════════════════════════════════════════════════════════
+#                    SHARED STATE (Multi-process Deployments)
+# ═══════════════════════════════════════════════════════════════════════════════
+
+# Set GROCERY_SHARED_STATE to a segment name (e.g. /grocery) so every worker
+# process (e.g. gunicorn -w 4 server:app) shares one item store, cart and
+# queue. The first worker creates the segment and loads the saved data; the
+# others attach to it as it is. Purchase history and recommendations stay per
+# worker, so the history file is not written in this mode.
+SHARED_STATE_NAME = os.environ.get('GROCERY_SHARED_STATE', '')
+SHARED_STATE_MB = int(os.environ.get('GROCERY_SHARED_STATE_MB', '64'))
+SHARED_STATE_CREATED = 1
+SHARED_STATE_ATTACHED = 2
+
+shared_state = 0
+if DLL_LOADED and SHARED_STATE_NAME:
+    shared_state = grocery_lib.api_attach_shared_state(c_text(SHARED_STATE_NAME), SHARED_STATE_MB)
+    if shared_state == SHARED_STATE_CREATED:
+        print(f"🔗 Shared state created: {SHARED_STATE_NAME}")
+    elif shared_state == SHARED_STATE_ATTACHED:
+        print(f"🔗 Shared state attached: {SHARED_STATE_NAME}")
+    else:
+        print(f"⚠️  Could not attach shared state {SHARED_STATE_NAME}, using process-local state")
+
 # ═══════════════════════════════════════════════════════════════════════════════
 #                           HELPER FUNCTIONS
 # ═══════════════════════════════════════════════════════════════════════════════
 
 def parse_json_response(c_string):
+    if isinstance(c_string, (list, dict)):
+        return c_string   # built directly by grocery_native
     if c_string:
         return json.loads(c_string.decode('utf-8'))
     return {}
 
+# Ranking modes understood by api_get_ranked_frequent_items / api_read_ranked_items
+RANK_MODES = {'lifetime': 0, 'recent': 1}
+
+# One read buffer per request thread for api_read_ranked_items
+ranking_buffers = threading.local()
+
+def read_ranked_items(mode):
+    """Top items from the library's lock-free ranking snapshot (parsed JSON)"""
+    if NATIVE_BINDING:
+        return grocery_lib.ranked_items(mode)
+    buffer = getattr(ranking_buffers, 'buffer', None)
+    if buffer is None:
+        buffer = ranking_buffers.buffer = ctypes.create_string_buffer(8192)
+    length = grocery_lib.api_read_ranked_items(mode, buffer, len(buffer))
+    while length < -1:
+        buffer = ranking_buffers.buffer = ctypes.create_string_buffer(-length)
+        length = grocery_lib.api_read_ranked_items(mode, buffer, len(buffer))
+    return json.loads(buffer.raw[:length]) if length >= 0 else []
+
+# Op names understood by api_apply_batch (CartOpKind)
+CART_OP_KINDS = {'add': 0, 'remove': 1, 'undo': 2, 'clear': 3}
+
+# Stream kinds understood by api_stream_open (StreamKind)
+STREAM_CART = 0
+STREAM_RECEIPT = 1
+
+# Largest chunk asked of api_stream_next; the library holds no more than this
+STREAM_CHUNK_BYTES = 16 * 1024
+
+def stream_document(stream, prefix, suffix):
+    """
+    Yield prefix, the stream's JSON chunk by chunk, then suffix() - called
+    once the stream is drained, so it can report on what was streamed.
+    The stream is closed even if the client goes away halfway.
+    """
+    buffer = ctypes.create_string_buffer(STREAM_CHUNK_BYTES)
+    try:
+        yield prefix
+        while True:
+            length = grocery_lib.api_stream_next(stream, buffer, STREAM_CHUNK_BYTES)
+            if length <= 0:
+                break
+            yield buffer.raw[:length]
+        yield suffix()
+    finally:
+        grocery_lib.api_stream_close(stream)
+
+# /api/events: how long a stream waits for a change before re-reading the log
+# (catches other workers' changes with shared state) and sending a keepalive
+EVENTS_POLL_SECONDS = 1.0
+EVENTS_KEEPALIVE_SECONDS = 15.0
+
+# Woken by the library after every mutation made in this process
+changes_ready = threading.Condition()
+
+def on_library_change(record, context):
+    with changes_ready:
+        changes_ready.notify_all()
+
+if DLL_LOADED:
+    # Must outlive the subscription; grocery_native takes the function itself
+    change_callback = on_library_change if NATIVE_BINDING else CHANGE_CALLBACK(on_library_change)
+    grocery_lib.api_subscribe_changes(change_callback, None)
+
+def change_events(since, session):
+    """
+    Server-sent events for each change after seq `since` to `session`'s
+    cart: `event:` is the record's kind (cart, undo, checkout, all), `data:`
+    the record. After a gap (the log moved on, or the server restarted) one
+    `all` event tells the client to re-read everything.
+    """
+    yield 'retry: 2000\n\n'
+    last_sent = time.time()
+    while True:
+        grocery_lib.api_select_session(c_text(session))
+        changes = parse_json_response(grocery_lib.api_read_changes(since))
+        if changes['gap']:
+            changes['changes'] = [{'seq': changes['seq'], 'kind': 'all', 'op': 'reset', 'quantity': 0}]
+        for change in changes['changes']:
+            yield f"id: {change['seq']}\nevent: {change['kind']}\ndata: {json.dumps(change)}\n\n"
+            last_sent = time.time()
+        since = changes['seq']
+        if time.time() - last_sent >= EVENTS_KEEPALIVE_SECONDS:
+            yield ': keepalive\n\n'
+            last_sent = time.time()
+        with changes_ready:
+            if grocery_lib.api_get_change_seq() == since:
+                changes_ready.wait(EVENTS_POLL_SECONDS)
+
+# Named windows for api_top_items_window (seconds); plain numbers also accepted
+TOP_WINDOWS = {'hour': 3600, 'day': 86400, 'week': 7 * 86400, 'month': 30 * 86400}
+
 # ═══════════════════════════════════════════════════════════════════════════════
 #                    DATA PERSISTENCE (JSON File Storage)
 # ═══════════════════════════════════════════════════════════════════════════════
 
 DATA_FILE = os.path.join(os.path.dirname(__file__), 'cart_data.json')
+# Binary file written by api_history_save (checkout lines only change at checkout)
+HISTORY_FILE = os.path.join(os.path.dirname(__file__), 'purchase_history.bin')
 
-def save_all_data():
-    if not DLL_LOADED:
-        return False
-    
-    try:
-        result = grocery_lib.api_get_all_frequent_items()
-        frequent_items = parse_json_response(result)
-        
-        cart_result = grocery_lib.api_get_cart_items()
-        cart_items = parse_json_response(cart_result)
-        
-        data = {
-            'frequent_items': frequent_items,
-            'cart_items': cart_items,
-            'last_updated': datetime.now().strftime('%Y-%m-%d %H:%M:%S')
-        }
-        
-        with open(DATA_FILE, 'w', encoding='utf-8') as f:
-            json.dump(data, f, indent=2, ensure_ascii=False)
-        
-        return True
-    except Exception as e:
-        print(f"❌ Failed to save data: {e}")
-        return False
+# DATA_FILE is written by the library's persistence thread: changes are
+# coalesced for PERSIST_WINDOW_MS into one write + fsync. With
+# GROCERY_DURABLE=1 a request returns only once its change is on disk.
+PERSIST_WINDOW_MS = int(os.environ.get('GROCERY_PERSIST_WINDOW_MS', '20'))
+PERSIST_DURABLE = os.environ.get('GROCERY_DURABLE', '0') == '1'
+
+# /api/catalog/import only reads files from this directory
+IMPORT_DIR = os.environ.get('GROCERY_IMPORT_DIR', os.path.join(os.path.dirname(__file__), 'catalog'))
+
+# Custom items kept in the item store (0 = the library's maximum); past it the
+# least frequently used custom item not in the cart or checkout queue is
+# evicted. With GROCERY_ITEM_SPILL set to a file, evicted items are kept there
+# and restored when bought again. The file is per process, so it is not used
+# with GROCERY_SHARED_STATE.
+CUSTOM_ITEM_CAPACITY = int(os.environ.get('GROCERY_CUSTOM_ITEM_CAPACITY', '0'))
+ITEM_SPILL_FILE = os.environ.get('GROCERY_ITEM_SPILL', '')
+
+def configure_item_store():
+    if CUSTOM_ITEM_CAPACITY > 0:
+        grocery_lib.api_set_custom_item_capacity(CUSTOM_ITEM_CAPACITY)
+    if ITEM_SPILL_FILE and not SHARED_STATE_NAME:
+        if not grocery_lib.api_set_item_spill(c_text(ITEM_SPILL_FILE)):
+            print(f"⚠️  Could not open item spill file {ITEM_SPILL_FILE}, evicted items are dropped")
+
+def start_persistence():
+    grocery_lib.api_set_persistence(c_text(DATA_FILE), PERSIST_WINDOW_MS, int(PERSIST_DURABLE))
+
+def load_history():
+    if os.path.exists(HISTORY_FILE):
+        if not grocery_lib.api_history_load(c_text(HISTORY_FILE)):
+            print("⚠️  Could not read purchase history, starting with an empty one")
 
 def load_all_data():
     """
@@ -140,6 +416,8 @@ def load_all_data():
     if not DLL_LOADED:
         return False
     
+    load_history()
+    
     if not os.path.exists(DATA_FILE):
         print("📂 No saved data found, starting fresh")
         return False
@@ -148,6 +426,13 @@ def load_all_data():
         with open(DATA_FILE, 'r', encoding='utf-8') as f:
             data = json.load(f)
         
+        # Seconds since the file was written (ages the recent popularity scores)
+        try:
+            saved_at = datetime.strptime(data.get('last_updated', ''), '%Y-%m-%d %H:%M:%S')
+            seconds_ago = max(0.0, (datetime.now() - saved_at).total_seconds())
+        except ValueError:
+            seconds_ago = 0.0
+        
         # Load all items (unified storage - both default and custom)
         items = data.get('frequent_items', [])
         for item in items:
@@ -157,11 +442,19 @@ def load_all_data():
             
             if item_id >= 0 and purchase_count > 0 and name:
                 # Use api_restore_custom_item for ALL items
-                # It handles both default (id 0-9) and custom (id >= 1000) items
+                # It handles both base-catalog and custom items
                 grocery_lib.api_restore_custom_item(
-                    name.encode('utf-8'),
-                    ctypes.c_int(purchase_count),
-                    ctypes.c_int(item_id)
+                    c_text(name),
+                    purchase_count,
+                    item_id
+                )
+            
+            recent_score = item.get('recentScore', 0)
+            if item_id >= 0 and recent_score > 0:
+                grocery_lib.api_restore_item_popularity(
+                    item_id,
+                    recent_score,
+                    seconds_ago
                 )
         
         # Restore cart items
@@ -173,19 +466,67 @@ def load_all_data():
             
             if name:
                 grocery_lib.api_add_to_cart(
-                    name.encode('utf-8'),
-                    ctypes.c_int(quantity),
-                    ctypes.c_int(product_id)
+                    c_text(name),
+                    quantity,
+                    product_id
                 )
         
+        # Restore the sessions of a shard (documents from api_export_session)
+        sessions = data.get('sessions', {})
+        for key, document in sessions.items():
+            if grocery_lib.api_select_session(c_text(key)):
+                grocery_lib.api_import_session(c_text(json.dumps(document)))
+        grocery_lib.api_select_session(c_text(''))
+        
         cart_count = len(cart_items)
-        print(f"✅ Data loaded: {len(items)} items, {cart_count} cart items")
+        print(f"✅ Data loaded: {len(items)} items, {cart_count} cart items, {len(sessions)} sessions")
         print("📊 Previous data restored (top 10 shown as frequent items)!")
         return True
     except Exception as e:
         print(f"❌ Failed to load data: {e}")
         return False
 
+def init_app():
+    """
+    Restore the saved data and start the persistence writer. Runs at import,
+    so WSGI servers (gunicorn server:app) get it as well as `python server.py`.
+    A shared segment is loaded once, by the worker that created it.
+    """
+    if not DLL_LOADED:
+        return
+    configure_item_store()
+    if shared_state == SHARED_STATE_ATTACHED:
+        load_history()
+    elif not load_all_data():
+        print("📂 Starting with default items")
+    start_persistence()
+
+# Under `python server.py` the debug reloader's first process only watches the
+# sources and restarts a child (WERKZEUG_RUN_MAIN=true) that serves requests;
+# only that child may own the data file
+if __name__ != '__main__' or os.environ.get('WERKZEUG_RUN_MAIN') == 'true':
+    init_app()
+
+# ═══════════════════════════════════════════════════════════════════════════════
+#                    TRACING (Python side of each request)
+# ═══════════════════════════════════════════════════════════════════════════════
+
+@app.before_request
+def trace_request_begin():
+    if DLL_LOADED:
+        grocery_lib.api_trace_event(c_text(f'flask {request.endpoint}'), b'B')
+
+@app.before_request
+def select_session():
+    """An X-Session header picks the cart the request works on (router.cpp shards)"""
+    if DLL_LOADED and not grocery_lib.api_select_session(c_text(request.headers.get('X-Session', ''))):
+        return jsonify({'success': False, 'error': 'Invalid session'}), 400
+
+@app.teardown_request
+def trace_request_end(exc):
+    if DLL_LOADED:
+        grocery_lib.api_trace_event(c_text(f'flask {request.endpoint}'), b'E')
+
 # ═══════════════════════════════════════════════════════════════════════════════
 #                           API ROUTES
 # ═══════════════════════════════════════════════════════════════════════════════
@@ -199,13 +540,34 @@ def get_frequent_items():
     if not DLL_LOADED:
         return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
     
-    result = grocery_lib.api_get_all_frequent_items()
-    items = parse_json_response(result)
+    rank = request.args.get('rank', 'lifetime')
+    if rank not in RANK_MODES:
+        return jsonify({'success': False, 'error': f'Unknown rank mode: {rank}'}), 400
+    
+    items = read_ranked_items(RANK_MODES[rank])
     
     return jsonify({
         'success': True,
         'data': items,
-        'count': len(items)
+        'count': len(items),
+        'rank': rank
+    })
+
+@app.route('/api/popularity/half-life', methods=['GET', 'POST'])
+def popularity_half_life():
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    if request.method == 'POST':
+        data = request.get_json() or {}
+        hours = data.get('hours', 0)
+        if not isinstance(hours, (int, float)) or hours <= 0:
+            return jsonify({'success': False, 'error': 'hours must be a positive number'}), 400
+        grocery_lib.api_set_popularity_half_life(hours)
+    
+    return jsonify({
+        'success': True,
+        'hours': grocery_lib.api_get_popularity_half_life()
     })
 
 @app.route('/api/cart/add', methods=['POST'])
@@ -218,17 +580,18 @@ def add_to_cart():
     quantity = data.get('quantity', 1)
     product_id = data.get('product_id', -1)
     
-    grocery_lib.api_add_to_cart(
-        name.encode('utf-8'),
-        ctypes.c_int(quantity),
-        ctypes.c_int(product_id)
+    handle = grocery_lib.api_add_to_cart(
+        c_text(name),
+        quantity,
+        product_id
     )
-    
-    save_all_data()
+    if handle == 0:
+        return jsonify({'success': False, 'error': 'Item name is longer than 63 bytes'}), 400
     
     return jsonify({
         'success': True,
-        'message': f'Added {quantity}x {name} to cart'
+        'message': f'Added {quantity}x {name} to cart',
+        'handle': handle
     })
 
 @app.route('/api/cart/remove/<int:position>', methods=['DELETE'])
@@ -239,30 +602,129 @@ def remove_from_cart(position):
     result = grocery_lib.api_remove_from_cart(position)
     removed = parse_json_response(result)
     
-    save_all_data()
-    
     return jsonify({
         'success': True,
         'removed': removed
     })
 
-@app.route('/api/cart', methods=['GET'])
-def get_cart():
+@app.route('/api/cart/remove/handle/<int:handle>', methods=['DELETE'])
+def remove_cart_line(handle):
+    """Remove by stable line handle - unaffected by other lines moving"""
     if not DLL_LOADED:
         return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
     
-    result = grocery_lib.api_get_cart_items()
-    items = parse_json_response(result)
-    size = grocery_lib.api_get_cart_size()
-    total_qty = grocery_lib.api_get_cart_total_quantity()
+    removed = parse_json_response(grocery_lib.api_remove_cart_line(handle))
+    if 'error' in removed:
+        return jsonify({'success': False, 'error': removed['error']}), 404
     
     return jsonify({
         'success': True,
-        'data': items,
-        'size': size,
-        'totalQuantity': total_qty
+        'removed': removed
+    })
+
+@app.route('/api/cart/quantity/<int:handle>', methods=['POST'])
+def update_cart_line(handle):
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    data = request.get_json() or {}
+    quantity = data.get('quantity', 0)
+    if not isinstance(quantity, int) or quantity < 1:
+        return jsonify({'success': False, 'error': 'quantity must be a positive integer'}), 400
+    if not grocery_lib.api_update_cart_line(handle, quantity):
+        return jsonify({'success': False, 'error': 'Unknown cart line'}), 404
+    
+    return jsonify({'success': True, 'handle': handle, 'quantity': quantity})
+
+@app.route('/api/cart/batch', methods=['POST'])
+def apply_cart_batch():
+    """
+    Apply many operations atomically with one library call and one save.
+    Body: {"ops": [{"op": "add", "name": ..., "quantity": ..., "product_id": ...},
+                   {"op": "remove", "position": 2} or {"op": "remove", "name": ...},
+                   {"op": "undo"}, {"op": "clear"}]}
+    """
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    data = request.get_json() or {}
+    ops = data.get('ops', [])
+    if not isinstance(ops, list):
+        return jsonify({'success': False, 'error': 'ops must be a list'}), 400
+    
+    batch = (CartOp * len(ops))()
+    for i, op in enumerate(ops):
+        kind = op.get('op') if isinstance(op, dict) else None
+        if kind not in CART_OP_KINDS:
+            return jsonify({'success': False, 'error': f'Unknown op at index {i}: {kind}'}), 400
+        name = op.get('name')
+        try:
+            batch[i].kind = CART_OP_KINDS[kind]
+            batch[i].name = name.encode('utf-8') if isinstance(name, str) else None
+            batch[i].quantity = op.get('quantity', 1)
+            batch[i].product_id = op.get('product_id', -1)
+            batch[i].position = op.get('position', 0)
+        except TypeError:
+            return jsonify({'success': False, 'error': f'Bad field type in op {i}'}), 400
+    
+    outcome = parse_json_response(grocery_lib.api_apply_batch(batch, len(ops)))
+    # applied / failedAt / error / results / summary, plus the cart itself
+    # so the page does not need a refetch
+    return jsonify({
+        'success': bool(outcome.get('applied')),
+        **outcome,
+        'data': parse_json_response(grocery_lib.api_get_cart_items())
     })
 
+@app.route('/api/cart', methods=['GET'])
+def get_cart():
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    stream = grocery_lib.api_stream_open(STREAM_CART)
+    if stream < 0:
+        return jsonify({'success': False, 'error': 'Too many open streams'}), 503
+    
+    # Same shape as before, sent as it is produced
+    def totals():
+        return (f',"size":{grocery_lib.api_get_cart_size()},'
+                f'"totalQuantity":{grocery_lib.api_get_cart_total_quantity()}}}').encode('utf-8')
+    
+    return Response(stream_document(stream, b'{"success":true,"data":', totals),
+                    mimetype='application/json')
+
+@app.route('/api/cart/sync', methods=['POST'])
+def sync_cart():
+    """
+    Merge a device's cart delta and answer with the changes it is missing.
+    Body and response are the GCD1 text encoding (core/ReplicatedCart.h).
+    """
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    delta = request.get_data(as_text=True)
+    reply = grocery_lib.api_merge_cart_delta(c_text(delta)).decode('utf-8')
+    if reply.startswith('{'):
+        return jsonify({'success': False, 'error': json.loads(reply)['error']}), 400
+    
+    return Response(reply, mimetype='text/plain')
+
+@app.route('/api/events', methods=['GET'])
+def change_stream():
+    """
+    Push cart, undo and checkout changes as server-sent events, so pages
+    need not poll. Resumes after the Last-Event-ID header (sent by
+    EventSource on reconnect) or ?since=<seq>; by default starts from now.
+    """
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    since = request.headers.get('Last-Event-ID', request.args.get('since', ''))
+    since = int(since) if since.isdigit() else grocery_lib.api_get_change_seq()
+    
+    return Response(change_events(since, request.headers.get('X-Session', '')), mimetype='text/event-stream',
+                    headers={'Cache-Control': 'no-cache', 'X-Accel-Buffering': 'no'})
+
 @app.route('/api/cart/clear', methods=['DELETE'])
 def clear_cart():
     if not DLL_LOADED:
@@ -270,7 +732,6 @@ def clear_cart():
     
     grocery_lib.api_clear_cart()
     grocery_lib.api_clear_undo_stack()
-    save_all_data()
     
     return jsonify({'success': True, 'message': 'Cart cleared'})
 
@@ -285,8 +746,6 @@ def undo_action():
     if 'error' in undone:
         return jsonify({'success': False, 'error': undone['error']})
     
-    save_all_data()
-    
     return jsonify({
         'success': True,
         'undone': undone
@@ -312,7 +771,8 @@ def start_checkout():
         return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
     
     grocery_lib.api_start_checkout()
-    save_all_data()
+    if not shared_state:
+        grocery_lib.api_history_save(c_text(HISTORY_FILE))
     
     return jsonify({'success': True, 'message': 'Checkout started'})
 
@@ -321,15 +781,13 @@ def process_checkout():
     if not DLL_LOADED:
         return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
     
-    result = grocery_lib.api_process_checkout()
-    receipt = parse_json_response(result)
+    stream = grocery_lib.api_stream_open(STREAM_RECEIPT)
+    if stream < 0:
+        return jsonify({'success': False, 'error': 'Too many open streams'}), 503
     
-    save_all_data()
-    
-    return jsonify({
-        'success': True,
-        'receipt': receipt
-    })
+    # Items leave the queue only as their chunk is produced
+    return Response(stream_document(stream, b'{"success":true,"receipt":', lambda: b'}'),
+                    mimetype='application/json')
 
 @app.route('/api/queue', methods=['GET'])
 def get_queue():
@@ -345,6 +803,251 @@ def get_queue():
         'size': grocery_lib.api_get_queue_size()
     })
 
+@app.route('/api/recommendations', methods=['GET'])
+def get_recommendations():
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    count = request.args.get('n', 5, type=int)
+    result = grocery_lib.api_get_bought_together(count)
+    items = parse_json_response(result)
+    stats = parse_json_response(grocery_lib.api_get_copurchase_stats())
+    
+    return jsonify({
+        'success': True,
+        'data': items,
+        'stats': stats
+    })
+
+@app.route('/api/history/top', methods=['GET'])
+def get_history_top_items():
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    # Unix seconds; defaults to the last 7 days
+    to = request.args.get('to', time.time(), type=float)
+    start = request.args.get('from', to - 7 * 86400, type=float)
+    k = request.args.get('k', 10, type=int)
+    result = grocery_lib.api_history_top_items(start, to, k)
+    
+    return jsonify({
+        'success': True,
+        'data': parse_json_response(result)
+    })
+
+@app.route('/api/history/item', methods=['GET'])
+def get_history_item_series():
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    name = request.args.get('name', '').strip()
+    if not name:
+        return jsonify({'success': False, 'error': 'Item name is required'}), 400
+    
+    # Unix seconds; defaults to weekly buckets over the last year
+    to = request.args.get('to', time.time(), type=float)
+    start = request.args.get('from', to - 365 * 86400, type=float)
+    bucket = request.args.get('bucket', 7 * 86400, type=int)
+    result = grocery_lib.api_history_item_series(
+        c_text(name), start, to, bucket)
+    
+    return jsonify({
+        'success': True,
+        'data': parse_json_response(result)
+    })
+
+@app.route('/api/top-items', methods=['GET'])
+def get_top_items_window():
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    window = request.args.get('window', 'day')
+    seconds = TOP_WINDOWS.get(window)
+    if seconds is None:
+        if not window.isdigit() or int(window) < 1:
+            return jsonify({'success': False, 'error': f'Unknown window: {window}'}), 400
+        seconds = min(int(window), 2**31 - 1)
+    k = request.args.get('k', 10, type=int)
+    result = grocery_lib.api_top_items_window(seconds, k)
+    
+    return jsonify({
+        'success': True,
+        'data': parse_json_response(result)
+    })
+
+@app.route('/api/history/stats', methods=['GET'])
+def get_history_stats():
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    return jsonify({
+        'success': True,
+        'data': parse_json_response(grocery_lib.api_history_stats())
+    })
+
+@app.route('/api/heavy-hitters', methods=['GET'])
+def get_heavy_hitters():
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    result = grocery_lib.api_get_heavy_hitters()
+    
+    return jsonify({
+        'success': True,
+        'data': parse_json_response(result)
+    })
+
+@app.route('/api/persistence', methods=['GET'])
+def get_persistence_stats():
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    return jsonify({
+        'success': True,
+        'data': parse_json_response(grocery_lib.api_get_persistence_stats())
+    })
+
+@app.route('/api/flush', methods=['POST'])
+def flush_data():
+    """Return once every change made so far is on disk"""
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    if not grocery_lib.api_flush():
+        return jsonify({'success': False, 'error': 'Could not write data file'}), 500
+    return jsonify({'success': True})
+
+@app.route('/api/catalog/import', methods=['POST'])
+def import_catalog():
+    """Bulk-load a CSV/TSV file from IMPORT_DIR into the item store"""
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    data = request.get_json(silent=True) or {}
+    file_name = str(data.get('file', ''))
+    threads = data.get('threads', 0)
+    if not file_name or os.path.basename(file_name) != file_name or file_name.startswith('.'):
+        return jsonify({'success': False, 'error': 'file must name a file in the import directory'}), 400
+    if not isinstance(threads, int) or isinstance(threads, bool) or threads < 0:
+        return jsonify({'success': False, 'error': 'threads must be a non-negative integer'}), 400
+    
+    path = os.path.join(IMPORT_DIR, file_name)
+    report = parse_json_response(grocery_lib.api_import_catalog(c_text(path), threads))
+    if not report.get('success'):
+        return jsonify({'success': False, 'error': report.get('error', 'Import failed'), 'data': report}), 400
+    return jsonify({'success': True, 'data': report})
+
+@app.route('/api/catalog/capacity', methods=['GET', 'POST'])
+def catalog_capacity():
+    """Item store size and custom-item capacity; POST {capacity} changes it"""
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    evicted = 0
+    if request.method == 'POST':
+        data = request.get_json(silent=True) or {}
+        capacity = data.get('capacity', 0)
+        if not isinstance(capacity, int) or isinstance(capacity, bool) or capacity <= 0:
+            return jsonify({'success': False, 'error': 'capacity must be a positive integer'}), 400
+        evicted = grocery_lib.api_set_custom_item_capacity(capacity)
+    
+    stats = parse_json_response(grocery_lib.api_get_item_store_stats())
+    return jsonify({'success': True, 'evicted': evicted, 'data': stats})
+
+@app.route('/api/memory', methods=['GET'])
+def get_memory_stats():
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    return jsonify({
+        'success': True,
+        'data': parse_json_response(grocery_lib.api_get_memory_stats())
+    })
+
+@app.route('/api/metrics', methods=['GET'])
+def get_metrics():
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    return jsonify({
+        'success': True,
+        'data': parse_json_response(grocery_lib.api_get_metrics())
+    })
+
+@app.route('/metrics', methods=['GET'])
+def get_metrics_text():
+    if not DLL_LOADED:
+        return Response('# C++ library not loaded\n', status=500, mimetype='text/plain')
+    
+    text = grocery_lib.api_get_metrics_text().decode('utf-8')
+    return Response(text, mimetype='text/plain; version=0.0.4')
+
+@app.route('/api/debug/trace', methods=['GET', 'POST', 'DELETE'])
+def debug_trace():
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    if request.method == 'POST':
+        data = request.get_json() or {}
+        grocery_lib.api_set_tracing(1 if data.get('enabled', True) else 0)
+        return jsonify({'success': True, 'enabled': bool(data.get('enabled', True))})
+    
+    if request.method == 'DELETE':
+        grocery_lib.api_clear_trace()
+        return jsonify({'success': True, 'message': 'Trace cleared'})
+    
+    # Chrome trace-event JSON, ready for chrome://tracing or ui.perfetto.dev
+    trace = grocery_lib.api_dump_trace().decode('utf-8')
+    return Response(trace, mimetype='application/json',
+                    headers={'Content-Disposition': 'attachment; filename=grocery_trace.json'})
+
+# ═══════════════════════════════════════════════════════════════════════════════
+#                    SHARD ROUTES (router.cpp, not forwarded from clients)
+# ═══════════════════════════════════════════════════════════════════════════════
+
+@app.route('/api/shard/sessions', methods=['GET'])
+def list_shard_sessions():
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    return jsonify({'success': True, 'data': parse_json_response(grocery_lib.api_list_sessions())})
+
+@app.route('/api/shard/session', methods=['GET', 'PUT', 'DELETE'])
+def shard_session():
+    """The X-Session session's cart, undo stack and queue: export, import or drop"""
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    if request.method == 'GET':
+        return jsonify({'success': True, 'data': parse_json_response(grocery_lib.api_export_session())})
+    if not request.headers.get('X-Session'):
+        return jsonify({'success': False, 'error': 'X-Session is required'}), 400
+    
+    if request.method == 'PUT':
+        if not grocery_lib.api_import_session(c_text(request.get_data(as_text=True))):
+            return jsonify({'success': False, 'error': 'Invalid session document'}), 400
+    else:
+        grocery_lib.api_drop_session()
+    
+    return jsonify({'success': True})
+
+@app.route('/api/shard/deltas/take', methods=['POST'])
+def take_purchase_deltas():
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    return jsonify({'success': True, 'data': parse_json_response(grocery_lib.api_take_purchase_deltas())})
+
+@app.route('/api/shard/deltas/apply', methods=['POST'])
+def apply_purchase_deltas():
+    if not DLL_LOADED:
+        return jsonify({'success': False, 'error': 'C++ library not loaded'}), 500
+    
+    counted = grocery_lib.api_apply_purchase_deltas(c_text(request.get_data(as_text=True)))
+    if counted < 0:
+        return jsonify({'success': False, 'error': 'Invalid deltas document'}), 400
+    
+    return jsonify({'success': True, 'counted': counted})
+
 @app.route('/api/factory-reset', methods=['POST'])
 def factory_reset():
     if not DLL_LOADED:
@@ -352,8 +1055,8 @@ def factory_reset():
     
     grocery_lib.api_factory_reset()
     
-    if os.path.exists(DATA_FILE):
-        os.remove(DATA_FILE)
+    if os.path.exists(HISTORY_FILE):
+        os.remove(HISTORY_FILE)
     
     return jsonify({
         'success': True,
@@ -371,10 +1074,6 @@ if __name__ == '__main__':
     
     if DLL_LOADED:
         print("\n📦 C++ Backend: ✅ Loaded")
-        if load_all_data():
-            pass
-        else:
-            print("📂 Starting with default items")
     else:
         print("\n📦 C++ Backend: ❌ Not loaded")
     
@@ -0,0 +1,173 @@
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                           SMART GROCERY CART
+ *                    Test: Cart Line Handles Across Batch Rollback
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * A batch that fails part-way restores the cart from a snapshot. Clients
+ * hold on to line handles across that, so after a rollback:
+ *
+ * - every line is back with its old handle, quantity and position, and
+ *   updates / removals by those handles act on the right line
+ * - the undo stack is back as it was
+ * - handles retired before the batch stay unknown, and lines added later
+ *   never reuse any handle issued before
+ *
+ * Runs against the library through its C API, on a fresh in-process state.
+ *
+ * COMPILATION (links the library source):
+ *   clang++ -O2 -std=c++17 -pthread -o test_batch_handles test_batch_handles.cpp ../grocery_api_new.cpp
+ *
+ * USAGE:
+ *   test_batch_handles      exits 1 if any check fails
+ */
+
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+#include "../core/JsonReader.h"
+using namespace std;
+
+// Same layout as the library's CartOp
+struct CartOp {
+    int kind;
+    const char* name;
+    int quantity;
+    int productId;
+    int position;
+};
+
+enum { OP_ADD = 0, OP_REMOVE = 1, OP_UNDO = 2, OP_CLEAR = 3 };
+
+extern "C" {
+    unsigned long long api_add_to_cart(const char* name, int quantity, int product_id);
+    const char* api_remove_cart_line(unsigned long long handle);
+    bool api_update_cart_line(unsigned long long handle, int quantity);
+    const char* api_get_cart_items();
+    const char* api_get_stack_items();
+    const char* api_apply_batch(const CartOp* ops, int count);
+    void api_free_string(char* str);
+}
+
+static int checks = 0;
+static int failures = 0;
+
+static void check(bool ok, const string& what) {
+    checks++;
+    if (!ok) {
+        failures++;
+        cout << "  FAIL: " << what << "\n";
+    }
+}
+
+// Take ownership of a library string
+static string take(const char* text) {
+    string copy = (text != nullptr) ? text : "";
+    api_free_string((char*)text);
+    return copy;
+}
+
+struct Line {
+    string name;
+    int quantity;
+    unsigned long long handle;
+
+    bool operator==(const Line& other) const {
+        return name == other.name && quantity == other.quantity && handle == other.handle;
+    }
+};
+
+static vector<Line> cartLines() {
+    string text = take(api_get_cart_items());
+    JsonValue parsed;
+    JsonReader reader(text);
+    vector<Line> lines;
+    if (!reader.parse(parsed) || parsed.type != JsonValue::ARRAY) {
+        check(false, "cart listing is not a JSON array");
+        return lines;
+    }
+    for (const JsonValue& item : parsed.items) {
+        lines.push_back(Line{item.stringOr("name", ""), (int)item.numberOr("quantity", 0),
+                             (unsigned long long)item.numberOr("handle", 0)});
+    }
+    return lines;
+}
+
+static bool batchApplied(const vector<CartOp>& ops) {
+    string reply = take(api_apply_batch(ops.data(), (int)ops.size()));
+    return reply.find("\"applied\":true") != string::npos;
+}
+
+static CartOp add(const char* name, int quantity) { return CartOp{OP_ADD, name, quantity, -1, 0}; }
+static CartOp removeAt(int position) { return CartOp{OP_REMOVE, nullptr, 0, -1, position}; }
+static CartOp removeNamed(const char* name) { return CartOp{OP_REMOVE, name, 0, -1, 0}; }
+static CartOp undo() { return CartOp{OP_UNDO, nullptr, 0, -1, 0}; }
+static CartOp clearAll() { return CartOp{OP_CLEAR, nullptr, 0, -1, 0}; }
+
+int main() {
+    set<unsigned long long> issued;
+    const char* names[] = {"Milk", "Bread", "Eggs", "Apples", "Tea"};
+    for (int i = 0; i < 5; i++) issued.insert(api_add_to_cart(names[i], i + 1, -1));
+    check(issued.size() == 5 && issued.count(0) == 0, "adds should return five distinct handles");
+
+    // Retire one handle before any batch runs
+    vector<Line> lines = cartLines();
+    unsigned long long retired = lines[2].handle;   // Eggs
+    take(api_remove_cart_line(retired));
+    check(api_update_cart_line(lines[1].handle, 7), "update by handle");
+
+    // Each batch changes the cart, then fails on its last op
+    vector<vector<CartOp>> failing = {
+        {removeAt(1), add("Kiwi", 2), removeAt(99)},
+        {add("Mango", 1), undo(), removeNamed("Bread"), removeNamed("Nothing Here")},
+        {clearAll(), add("Milk", 4), removeAt(3)},
+        {removeAt(2), removeAt(1), add("Tea", 5), clearAll(), undo()},
+    };
+    for (size_t b = 0; b < failing.size(); b++) {
+        string label = "batch " + to_string(b + 1) + ": ";
+        vector<Line> before = cartLines();
+        string stackBefore = take(api_get_stack_items());
+
+        check(!batchApplied(failing[b]), label + "should fail");
+        check(cartLines() == before, label + "rollback changed the cart lines or their handles");
+        check(take(api_get_stack_items()) == stackBefore, label + "rollback changed the undo stack");
+        check(take(api_remove_cart_line(retired)).find("\"error\"") != string::npos,
+              label + "a handle retired before the batch came back");
+    }
+
+    // The restored handles still address their own lines
+    lines = cartLines();
+    for (size_t i = 0; i < lines.size(); i++) {
+        check(api_update_cart_line(lines[i].handle, 10 + (int)i), "update restored line " + lines[i].name);
+    }
+    lines = cartLines();
+    for (size_t i = 0; i < lines.size(); i++) {
+        check(lines[i].quantity == 10 + (int)i, "update by restored handle hit another line: " + lines[i].name);
+    }
+    string removed = take(api_remove_cart_line(lines[1].handle));
+    check(removed.find("\"name\":\"" + lines[1].name + "\"") != string::npos
+              && removed.find("\"position\":2") != string::npos,
+          "removing a restored handle should remove its line at its position");
+
+    // New lines never reuse a handle, including ones handed out inside failed batches
+    for (const Line& line : cartLines()) issued.insert(line.handle);
+    issued.insert(retired);
+    for (int i = 0; i < 50; i++) {
+        string name = "Fresh " + to_string(i);
+        unsigned long long handle = api_add_to_cart(name.c_str(), 1, -1);
+        check(issued.insert(handle).second, "handle reused by " + name);
+    }
+
+    // A batch that succeeds keeps the handles of lines it did not touch
+    lines = cartLines();
+    check(batchApplied({add("Bread", 1), removeNamed("Fresh 0")}), "successful batch");
+    for (const Line& line : cartLines()) {
+        for (const Line& old : lines) {
+            if (old.name == line.name) check(old.handle == line.handle, "successful batch moved " + line.name);
+        }
+    }
+
+    cout << (checks - failures) << "/" << checks << " checks passed\n";
+    return failures == 0 ? 0 : 1;
+}
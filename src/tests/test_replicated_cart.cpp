@@ -0,0 +1,346 @@
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                           SMART GROCERY CART
+ *                    Test: Replicated Cart Convergence
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * Checks the merge rules of core/ReplicatedCart.h with GCD1 deltas built
+ * the way web/js/cart-replica.js builds them (every unacknowledged cell and
+ * removal of the device, then "C <seq>"):
+ *
+ * - convergence: three store replicas merge the same device deltas in
+ *   different orders, with duplicates, and end with the same cart as a
+ *   store that merged them in the order they were made
+ * - idempotent replay: merging a delta a second time changes nothing
+ * - add wins: an add the removing device never saw survives its removal,
+ *   whichever arrives first
+ * - tombstone GC: past CART_TOMBSTONE_LIMIT the oldest tombstones go, and a
+ *   peer that synced before them is sent the full state
+ * - epoch rebase: a delta for a store that restarted is refused and, once
+ *   rebased on the full state, counts only the unsynced edits
+ *
+ * COMPILATION:
+ *   clang++ -O2 -std=c++17 -o test_replicated_cart test_replicated_cart.cpp
+ *
+ * USAGE:
+ *   test_replicated_cart [seed=1]      exits 1 if any check fails
+ */
+
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdlib>
+#include "../core/ReplicatedCart.h"
+using namespace std;
+
+static int checks = 0;
+static int failures = 0;
+
+static void check(bool ok, const string& what) {
+    checks++;
+    if (!ok) {
+        failures++;
+        cout << "  FAIL: " << what << "\n";
+    }
+}
+
+// Quantity per line name (lines with quantity 0 or less are not in the cart)
+typedef map<string, int> CartContents;
+
+static CartContents contents(const ReplicatedCart& store) {
+    CartContents cart;
+    for (int line = 0; line < store.lineCapacity(); line++) {
+        if (store.lineInUse(line) && store.quantity(line) > 0) cart[store.lineName(line).str()] = store.quantity(line);
+    }
+    return cart;
+}
+
+// Merge an encoded delta as api_merge_cart_delta does; false if refused
+static bool merge(ReplicatedCart& store, const string& text, vector<int>* touched = nullptr) {
+    CartDelta delta;
+    string error;
+    if (!ReplicatedCart::parseDelta(text.c_str(), delta, error)) {
+        check(false, "parse: " + error);
+        return false;
+    }
+    vector<int> lines;
+    bool applied = store.apply(delta, lines);
+    if (touched != nullptr) *touched = lines;
+    return applied;
+}
+
+// Live cells of a full-state reply, summed per line
+static CartContents decodeFull(const string& reply) {
+    CartContents cart;
+    string name;
+    size_t start = reply.find('\n') + 1;
+    while (start < reply.size()) {
+        size_t end = reply.find('\n', start);
+        string row = reply.substr(start, end - start);
+        start = end + 1;
+        if (row.compare(0, 2, "L\t") == 0) {
+            name = row.substr(2);
+        } else if (row.compare(0, 2, "+\t") == 0) {
+            unsigned replica, seq;
+            int added, removed;
+            if (sscanf(row.c_str() + 2, "%u\t%u\t%d\t%d", &replica, &seq, &added, &removed) == 4) {
+                cart[name] += added - removed;
+            }
+        }
+    }
+    for (CartContents::iterator it = cart.begin(); it != cart.end();) {
+        if (it->second <= 0) it = cart.erase(it); else ++it;
+    }
+    return cart;
+}
+
+static string replyKind(const string& reply) {
+    size_t tab = reply.rfind('\t', reply.find('\n'));
+    return reply.substr(tab + 1, reply.find('\n') - tab - 1);
+}
+
+// Newest seq of each replica's cell per line, as a device that just synced knows them
+typedef map<string, map<uint32_t, uint32_t>> SeenCells;
+
+/**
+ * One device, reduced to what it sends: its own (added, removed) cell per
+ * line and the dots it removed. Nothing is acknowledged, so every delta
+ * carries all of them and "C <seq>" covers every seq it ever used.
+ */
+struct Device {
+    struct Cell {
+        uint32_t seq;
+        int added;
+        int removed;
+    };
+
+    uint32_t id;
+    uint32_t seq;
+    map<string, Cell> own;
+    map<string, map<uint32_t, uint32_t>> removals;
+
+    explicit Device(uint32_t replica) : id(replica), seq(0) {}
+
+    void add(const string& name, int quantity) {
+        Cell& cell = own[name];   // a new line starts from {0, 0, 0}
+        cell.seq = ++seq;
+        cell.added += quantity;
+    }
+
+    void decrease(const string& name, int quantity) {
+        map<string, Cell>::iterator cell = own.find(name);
+        if (cell == own.end()) return;
+        cell->second.seq = ++seq;
+        cell->second.removed += quantity;
+    }
+
+    // Observed remove: every cell of the line this device has seen
+    void remove(const string& name, const SeenCells& seen) {
+        SeenCells::const_iterator line = seen.find(name);
+        if (line != seen.end()) {
+            for (const auto& cell : line->second) {
+                uint32_t& dot = removals[name][cell.first];
+                if (cell.second > dot) dot = cell.second;
+            }
+        }
+        own.erase(name);
+    }
+
+    void publish(SeenCells& seen) const {
+        for (const auto& cell : own) seen[cell.first][id] = cell.second.seq;
+    }
+
+    string encode(uint32_t epoch = 0, uint64_t since = 0) const {
+        string text = CART_DELTA_MAGIC "\t" + to_string(id) + "\t" + to_string(epoch) + "\t" + to_string(since) + "\n";
+        set<string> names;
+        for (const auto& cell : own) names.insert(cell.first);
+        for (const auto& removal : removals) names.insert(removal.first);
+        for (const string& name : names) {
+            text += "L\t" + name + "\n";
+            map<string, Cell>::const_iterator cell = own.find(name);
+            if (cell != own.end()) {
+                text += "+\t" + to_string(id) + "\t" + to_string(cell->second.seq) + "\t"
+                      + to_string(cell->second.added) + "\t" + to_string(cell->second.removed) + "\n";
+            }
+            map<string, map<uint32_t, uint32_t>>::const_iterator removal = removals.find(name);
+            if (removal == removals.end()) continue;
+            for (const auto& dot : removal->second) {
+                text += "-\t" + to_string(dot.first) + "\t" + to_string(dot.second) + "\n";
+            }
+        }
+        if (seq > 0) text += "C\t" + to_string(seq) + "\n";
+        return text;
+    }
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+
+// Three devices edit five lines; every edit is sent as one delta
+static vector<string> randomEdits(mt19937& rng, int edits) {
+    const char* names[] = {"Milk", "Bread", "Eggs", "Apples", "Green Tea"};
+    vector<Device> devices = {Device(101), Device(202), Device(303)};
+    SeenCells seen;
+    vector<string> deltas;
+    for (int i = 0; i < edits; i++) {
+        Device& device = devices[rng() % devices.size()];
+        string name = names[rng() % 5];
+        int op = (int)(rng() % 100);
+        if (op < 60) device.add(name, 1 + (int)(rng() % 3));
+        else if (op < 75) device.decrease(name, 1);
+        else device.remove(name, seen);
+        device.publish(seen);
+        deltas.push_back(device.encode());
+    }
+    return deltas;
+}
+
+static void testConvergence(unsigned seed) {
+    cout << "convergence (3 replicas, permuted and duplicated deltas)\n";
+    mt19937 rng(seed);
+    for (int round = 0; round < 50; round++) {
+        vector<string> deltas = randomEdits(rng, 40 + (int)(rng() % 80));
+
+        ReplicatedCart reference;
+        for (const string& delta : deltas) merge(reference, delta);
+        CartContents expected = contents(reference);
+
+        ReplicatedCart replicas[3];
+        for (ReplicatedCart& replica : replicas) {
+            vector<string> order = deltas;
+            for (size_t i = 0; i < deltas.size() / 3; i++) order.push_back(deltas[rng() % deltas.size()]);
+            shuffle(order.begin(), order.end(), rng);
+            for (const string& delta : order) merge(replica, delta);
+        }
+        for (int r = 0; r < 3; r++) {
+            check(contents(replicas[r]) == expected,
+                  "round " + to_string(round) + ": replica " + to_string(r) + " differs from in-order merge");
+        }
+    }
+}
+
+static void testIdempotentReplay(unsigned seed) {
+    cout << "idempotent replay\n";
+    mt19937 rng(seed + 1);
+    vector<string> deltas = randomEdits(rng, 200);
+    ReplicatedCart once, twice;
+    for (const string& delta : deltas) {
+        merge(once, delta);
+        merge(twice, delta);
+        uint64_t version = twice.currentVersion();
+        vector<int> touched;
+        merge(twice, delta, &touched);
+        check(touched.empty() && twice.currentVersion() == version, "a replayed delta changed the store");
+    }
+    check(contents(once) == contents(twice), "replayed store differs");
+    // Replaying the whole history in reverse is also a no-op
+    for (size_t i = deltas.size(); i-- > 0;) merge(twice, deltas[i]);
+    check(contents(once) == contents(twice), "store changed after replaying history backwards");
+}
+
+static void testAddWins() {
+    cout << "add wins over a concurrent remove\n";
+    Device phone(11), laptop(22);
+    SeenCells seen;
+    phone.add("Milk", 1);
+    phone.publish(seen);
+    string firstAdd = phone.encode();
+
+    laptop.remove("Milk", seen);   // saw only the phone's first add
+    string removal = laptop.encode();
+    phone.add("Milk", 2);          // concurrent, unseen by the laptop
+    string secondAdd = phone.encode();
+
+    ReplicatedCart a, b, c;
+    merge(a, firstAdd); merge(a, removal); merge(a, secondAdd);
+    merge(b, firstAdd); merge(b, secondAdd); merge(b, removal);
+    merge(c, removal); merge(c, secondAdd); merge(c, firstAdd);
+    CartContents expected = {{"Milk", 3}};
+    check(contents(a) == expected, "remove, then concurrent add: Milk should stay");
+    check(contents(b) == expected, "concurrent add, then remove: Milk should stay");
+    check(contents(c) == expected, "remove before the adds it observed: Milk should stay");
+
+    // A remove that did see the newest add takes the line out
+    laptop.remove("Milk", SeenCells{{"Milk", {{11, phone.seq}}}});
+    merge(a, laptop.encode());
+    check(contents(a).empty(), "a remove that observed every add should empty the line");
+}
+
+static void testTombstoneCollection() {
+    cout << "tombstone GC past " << CART_TOMBSTONE_LIMIT << " with full-state fallback\n";
+    ReplicatedCart store;
+    Device device(7);
+    device.add("Keep", 2);
+    merge(store, device.encode());
+    uint64_t synced = store.currentVersion();
+
+    string reply;
+    store.writeDelta(reply, device.id, store.replica(), synced);
+    check(replyKind(reply) == "delta", "an up-to-date peer should get a delta");
+
+    for (int i = 0; i < CART_TOMBSTONE_LIMIT + 200; i++) {
+        string name = "Gone " + to_string(i);
+        store.setQuantity(name.data(), name.size(), 1);
+        store.setQuantity(name.data(), name.size(), 0);
+    }
+    check(store.tombstoneCount() <= CART_TOMBSTONE_LIMIT + 1,
+          "tombstones not collected: " + to_string(store.tombstoneCount()));
+    check(store.lineTotal() < CART_TOMBSTONE_LIMIT + 1, "collected lines were not freed");
+
+    reply.clear();
+    store.writeDelta(reply, device.id, store.replica(), synced);
+    check(replyKind(reply) == "full", "a peer behind the tombstone horizon should get the full state");
+    check(decodeFull(reply) == CartContents({{"Keep", 2}}), "full state should hold exactly the live lines");
+
+    reply.clear();
+    store.writeDelta(reply, device.id, store.replica(), store.currentVersion());
+    check(replyKind(reply) == "delta" && reply.find("\nL\t") == string::npos,
+          "a peer past the horizon should get an empty delta");
+}
+
+static void testEpochRebase() {
+    cout << "epoch rebase after a store restart\n";
+    ReplicatedCart before;
+    Device device(9);
+    device.add("Eggs", 2);
+    merge(before, device.encode());
+    uint64_t since = before.currentVersion();
+    uint32_t epoch = before.replica();
+    uint32_t synced = device.own["Eggs"].added;   // acknowledged by `before`
+
+    // The store restarts: its list is replicated again under a new replica id
+    ReplicatedCart after;
+    after.setQuantity("Eggs", 4, 2);
+    device.add("Eggs", 1);   // offline edit, never synced
+
+    vector<int> touched;
+    check(!merge(after, device.encode(epoch, since), &touched) && touched.empty(),
+          "a delta for another epoch should be refused");
+    check(contents(after) == CartContents({{"Eggs", 2}}), "a refused delta changed the store");
+
+    string reply;
+    after.writeDelta(reply, device.id, epoch, since);
+    check(replyKind(reply) == "full", "a refused peer should get the full state");
+
+    // Rebase as cart-replica.js does: resend only the unsynced edits, under a new dot
+    Device::Cell& own = device.own["Eggs"];
+    own.added -= synced;
+    own.seq = ++device.seq;
+    merge(after, device.encode(after.replica(), after.currentVersion()));
+    check(contents(after) == CartContents({{"Eggs", 3}}), "rebased edits should count once");
+}
+
+int main(int argc, char* argv[]) {
+    unsigned seed = (argc > 1) ? (unsigned)atoi(argv[1]) : 1;
+
+    testConvergence(seed);
+    testIdempotentReplay(seed);
+    testAddWins();
+    testTombstoneCollection();
+    testEpochRebase();
+
+    cout << (checks - failures) << "/" << checks << " checks passed\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+"""
+═══════════════════════════════════════════════════════════════════════════════
+                    CATALOG GENERATOR - CSV -> core/CatalogData.h
+═══════════════════════════════════════════════════════════════════════════════
+
+Turns the base catalog (one `id,name,category` row per SKU) into constexpr
+tables the C++ library compiles in, plus a minimal perfect hash over the
+case-folded names (hash and displace):
+
+    h      = FNV-1a 32 of the ASCII-lowercased name
+    bucket = h % BUCKETS
+    slot   = (h + DISPLACEMENT[bucket] * ((h >> 16) | 1)) % SLOTS
+
+Buckets are placed largest first; each gets the smallest displacement that
+sends all its names to free slots. SLOTS starts at the item count and grows
+only if some bucket cannot be placed. core/Catalog.h must use the same
+formula - it static_asserts that the tables round-trip.
+
+USAGE:
+    python tools/gen_catalog.py [--check] [catalog/default_catalog.csv] [core/CatalogData.h]
+
+Run from src/ after editing the catalog, then rebuild the library (build.bat
+runs it before compiling). The header is only rewritten when it changes.
+--check writes nothing and exits 1 if the header is out of date.
+"""
+
+import csv
+import math
+import sys
+
+NAME_CAPACITY = 63          # InlineName keeps 63 bytes + NUL
+FIRST_CUSTOM_ID = 1000      # custom items were always numbered from here
+MAX_DISPLACEMENT = 1 << 16
+
+
+def fold(name):
+    return bytes(b + 32 if 65 <= b <= 90 else b for b in name.encode('utf-8'))
+
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h ^= b
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def slot_of(h, displacement, slots):
+    return (h + displacement * ((h >> 16) | 1)) % slots
+
+
+def build_perfect_hash(hashes):
+    n = len(hashes)
+    buckets = max(1, math.ceil(n / 4))
+    slots = n
+    while True:
+        members = [[] for _ in range(buckets)]
+        for index, h in enumerate(hashes):
+            members[h % buckets].append(index)
+        table = [-1] * slots
+        displacement = [0] * buckets
+        placed_all = True
+        for b in sorted(range(buckets), key=lambda b: -len(members[b])):
+            if not members[b]:
+                break
+            for d in range(MAX_DISPLACEMENT):
+                wanted = [slot_of(hashes[i], d, slots) for i in members[b]]
+                if len(set(wanted)) == len(wanted) and all(table[s] < 0 for s in wanted):
+                    for i, s in zip(members[b], wanted):
+                        table[s] = i
+                    displacement[b] = d
+                    break
+            else:
+                placed_all = False
+                break
+        if placed_all:
+            return buckets, slots, displacement, table
+        slots = math.ceil(slots * 1.05) + 1
+
+
+def c_string(text):
+    return '"' + text.replace('\\', '\\\\').replace('"', '\\"') + '"'
+
+
+def read_catalog(path):
+    items = []
+    with open(path, newline='', encoding='utf-8') as f:
+        for row in csv.DictReader(f):
+            name = row['name'].strip()
+            category = row['category'].strip()
+            if not name:
+                sys.exit(f"{path}: empty name for id {row['id']}")
+            if len(name.encode('utf-8')) > NAME_CAPACITY:
+                sys.exit(f"{path}: '{name}' is longer than {NAME_CAPACITY} bytes")
+            if any(ord(c) < 32 for c in name + category):
+                sys.exit(f"{path}: control character in '{name}'")
+            items.append((int(row['id']), name, category))
+    if not items:
+        sys.exit(f"{path}: the catalog is empty")
+    items.sort()
+    ids = [i[0] for i in items]
+    if ids[0] < 0 or len(set(ids)) != len(ids):
+        sys.exit(f"{path}: ids must be unique and non-negative")
+    if len(set(fold(i[1]) for i in items)) != len(items):
+        sys.exit(f"{path}: names must be unique ignoring case")
+    return items
+
+
+def main():
+    args = [a for a in sys.argv[1:] if a != '--check']
+    check = len(args) != len(sys.argv) - 1
+    source = args[0] if len(args) > 0 else 'catalog/default_catalog.csv'
+    target = args[1] if len(args) > 1 else 'core/CatalogData.h'
+    items = read_catalog(source)
+
+    categories = []
+    for _, _, category in items:
+        if category not in categories:
+            categories.append(category)
+    hashes = [fnv1a(fold(name)) for _, name, _ in items]
+    if len(set(hashes)) != len(hashes):
+        sys.exit(f"{source}: two names share a 32-bit hash - rename one")
+    buckets, slots, displacement, table = build_perfect_hash(hashes)
+
+    out = []
+    out.append('// Generated by tools/gen_catalog.py from ' + source.replace('\\', '/') + ' - do not edit.')
+    out.append('// Included by Catalog.h, which defines CatalogEntry.')
+    out.append('#ifndef CATALOGDATA_H')
+    out.append('#define CATALOGDATA_H')
+    out.append('')
+    out.append(f'constexpr int CATALOG_SIZE = {len(items)};')
+    out.append(f'constexpr int CATALOG_FIRST_CUSTOM_ID = {max(FIRST_CUSTOM_ID, items[-1][0] + 1)};')
+    out.append(f'constexpr int CATALOG_CATEGORY_COUNT = {len(categories)};')
+    out.append(f'constexpr uint32_t CATALOG_HASH_BUCKETS = {buckets};')
+    out.append(f'constexpr uint32_t CATALOG_HASH_SLOTS = {slots};')
+    out.append('')
+    out.append('constexpr const char* CATALOG_CATEGORIES[CATALOG_CATEGORY_COUNT] = {')
+    out.extend(f'    {c_string(c)},' for c in categories)
+    out.append('};')
+    out.append('')
+    out.append('// Sorted by id')
+    out.append('constexpr CatalogEntry CATALOG_ITEMS[CATALOG_SIZE] = {')
+    for item_id, name, category in items:
+        out.append(f'    {{{item_id}, {c_string(name)}, {len(name.encode("utf-8"))}, {categories.index(category)}}},')
+    out.append('};')
+    out.append('')
+    out.append('constexpr uint32_t CATALOG_HASH_DISPLACEMENT[CATALOG_HASH_BUCKETS] = {')
+    for start in range(0, buckets, 16):
+        out.append('    ' + ', '.join(str(d) for d in displacement[start:start + 16]) + ',')
+    out.append('};')
+    out.append('')
+    out.append('// Slot -> index into CATALOG_ITEMS, -1 = free')
+    out.append('constexpr int CATALOG_HASH_TABLE[CATALOG_HASH_SLOTS] = {')
+    for start in range(0, slots, 16):
+        out.append('    ' + ', '.join(str(s) for s in table[start:start + 16]) + ',')
+    out.append('};')
+    out.append('')
+    out.append('#endif')
+
+    text = '\n'.join(out) + '\n'
+    try:
+        with open(target, encoding='utf-8', newline='') as f:
+            current = f.read()
+    except FileNotFoundError:
+        current = None
+    if check:
+        if current != text:
+            sys.exit(f"{target} is out of date - run: python tools/gen_catalog.py")
+        print(f"{target}: up to date")
+        return
+    if current != text:
+        with open(target, 'w', encoding='utf-8', newline='\n') as f:
+            f.write(text)
+    print(f"{target}: {len(items)} items, {len(categories)} categories, "
+          f"{buckets} buckets, {slots} slots" + ("" if current != text else " (unchanged)"))
+
+
+if __name__ == '__main__':
+    main()
@@ -18,6 +18,16 @@ let resetModal;
 
 let frequentItemsCache = [];
 
+// This device's copy of the cart (cart-replica.js); edits queue here while offline
+const cartReplica = new CartReplica('grocery-cart-replica');
+let renderedCartLines = [];
+let cartSync = null;
+
+// Server-sent change events (/api/events): other tabs and devices show up live
+let changeEvents = null;
+let liveRefresh = null;
+let itemsChanged = false;
+
 // ═══════════════════════════════════════════════════════════════════════════════
 //                         INITIALIZATION
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -27,6 +37,7 @@ document.addEventListener('DOMContentLoaded', function() {
     loadFrequentItems();
     setupEventListeners();
     restoreCartFromStorage();
+    listenForChanges();
     hideLoadingScreen();
 });
 
@@ -80,6 +91,14 @@ function setupEventListeners() {
             undoLastAction();
         }
     });
+
+    // Send edits queued while offline as soon as the network is back
+    window.addEventListener('online', async function() {
+        if (await syncCart()) {
+            await updateCartUI();
+            await updateVisualization();
+        }
+    });
 }
 
 function updateActiveNavLink() {
@@ -204,7 +223,8 @@ async function addToCart(index) {
         }
     } catch (error) {
         console.error('Failed to add to cart:', error);
-        showToast('Failed to add item', 'error');
+        qtyInput.value = 1;
+        addOffline(item.name, quantity);
     }
 }
 
@@ -240,30 +260,26 @@ async function addCustomItem() {
             await updateCartUI();
             await updateVisualization();
             showToast(`Added ${quantity}x ${name} to cart`, 'success');
+        } else {
+            showToast(result.error || 'Could not add item', 'error');
         }
     } catch (error) {
         console.error('Failed to add custom item:', error);
-        showToast('Failed to add item', 'error');
+        nameInput.value = '';
+        qtyInput.value = '1';
+        addOffline(name, quantity);
     }
 }
 
-async function removeFromCart(position) {
-    try {
-        const response = await fetch(`${API_BASE}/cart/remove/${position}`, {
-            method: 'DELETE'
-        });
-        
-        const result = await response.json();
-        
-        if (result.success) {
-            await updateCartUI();
-            await updateVisualization();
-            showToast(`Removed ${result.removed.name} from cart`, 'warning');
-        }
-    } catch (error) {
-        console.error('Failed to remove from cart:', error);
-        showToast('Failed to remove item', 'error');
-    }
+async function removeFromCart(index) {
+    const item = renderedCartLines[index];
+    if (!item) return;
+
+    // Through the replica: works offline, and another device's concurrent add survives
+    cartReplica.remove(item.name);
+    await updateCartUI();
+    await updateVisualization();
+    showToast(`Removed ${item.name} from cart`, 'warning');
 }
 
 async function clearCart() {
@@ -281,8 +297,80 @@ async function clearCart() {
         }
     } catch (error) {
         console.error('Failed to clear cart:', error);
-        showToast('Failed to clear cart', 'error');
+        cartReplica.clear();
+        renderReplicaCart();
+        showToast('Offline: cart cleared on this device, will sync', 'warning');
+    }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    CART SYNC - Offline Edits (cart-replica.js)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Send this device's queued cart edits and merge what it is missing.
+// Resolves false if the server is unreachable; the edits stay queued.
+function syncCart() {
+    if (!cartSync) {
+        cartSync = runCartSync().finally(() => { cartSync = null; });
     }
+    return cartSync;
+}
+
+async function runCartSync() {
+    try {
+        // Another round if edits were made meanwhile or the server restarted
+        for (let round = 0; round < 3; round++) {
+            const request = cartReplica.encodePending();
+            const response = await fetch(`${API_BASE}/cart/sync`, {
+                method: 'POST',
+                headers: { 'Content-Type': 'text/plain' },
+                body: request.text
+            });
+            if (!response.ok) throw new Error(`Cart sync failed (${response.status})`);
+            if (!cartReplica.merge(await response.text(), request)) break;
+        }
+        return true;
+    } catch (error) {
+        console.error('Failed to sync cart:', error);
+        return false;
+    }
+}
+
+function addOffline(name, quantity) {
+    cartReplica.add(name, quantity);
+    renderReplicaCart();
+    showToast(`Offline: ${quantity}x ${name} saved on this device, will sync`, 'warning');
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                    LIVE UPDATES - Server-Sent Change Events
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// EventSource reconnects by itself, resuming after the last event id it saw
+function listenForChanges() {
+    if (!window.EventSource) return;
+    changeEvents = new EventSource(`${API_BASE}/events`);
+    ['cart', 'undo', 'checkout', 'all'].forEach(kind => {
+        changeEvents.addEventListener(kind, function() {
+            // Checkouts and resets change purchase counts too
+            if (kind === 'checkout' || kind === 'all') itemsChanged = true;
+            scheduleLiveRefresh();
+        });
+    });
+}
+
+// A burst of changes (a batch, a checkout) is redrawn once
+function scheduleLiveRefresh() {
+    if (liveRefresh) return;
+    liveRefresh = setTimeout(async function() {
+        liveRefresh = null;
+        if (itemsChanged) {
+            itemsChanged = false;
+            await loadFrequentItems();
+        }
+        await updateCartUI();
+        await updateVisualization();
+    }, 100);
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -430,17 +518,15 @@ function generateReceipt(receipt) {
 // ═══════════════════════════════════════════════════════════════════════════════
 
 async function updateCartUI() {
-    try {
-        const response = await fetch(`${API_BASE}/cart`);
-        const result = await response.json();
-        
-        if (result.success) {
-            if (cartCount) cartCount.textContent = result.size;
-            renderCartItems(result.data);
-        }
-    } catch (error) {
-        console.error('Failed to update cart UI:', error);
-    }
+    // Offline, this shows the device's last synced cart plus its queued edits
+    await syncCart();
+    renderReplicaCart();
+}
+
+function renderReplicaCart() {
+    renderedCartLines = cartReplica.items();
+    if (cartCount) cartCount.textContent = renderedCartLines.length;
+    renderCartItems(renderedCartLines);
 }
 
 function renderCartItems(items) {
@@ -466,7 +552,7 @@ function renderCartItems(items) {
                 <div class="cart-item-name">${item.name}</div>
                 <div class="cart-item-qty">Quantity: ${item.quantity}</div>
             </div>
-            <button class="remove-item" onclick="removeFromCart(${index + 1})">
+            <button class="remove-item" onclick="removeFromCart(${index})">
                 <i class="fas fa-trash"></i>
             </button>
         `;
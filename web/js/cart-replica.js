@@ -0,0 +1,239 @@
+/**
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *                           SMART GROCERY CART
+ *                    Cart Replica - Offline Edits and Sync
+ * ═══════════════════════════════════════════════════════════════════════════════
+ *
+ * This device's copy of the cart, kept in localStorage. Edits made while
+ * the server is unreachable land here and are sent to POST /api/cart/sync
+ * later, where they merge with edits from other devices (see
+ * src/core/ReplicatedCart.h for the merge rules and the GCD1 encoding).
+ *
+ * Each line holds one cell per replica: [seq, added, removed]. Quantity is
+ * the sum of added - removed. This device only grows its own cell; removing
+ * a line drops the cells it has seen and sends their dots as removals.
+ */
+
+const CART_DELTA_MAGIC = 'GCD1';
+
+class CartReplica {
+    constructor(storageKey) {
+        this.storageKey = storageKey;
+        let saved = null;
+        try {
+            saved = JSON.parse(localStorage.getItem(storageKey) || 'null');
+        } catch (error) {
+            saved = null;
+        }
+        this.replica = (saved && saved.replica) || CartReplica.newReplicaId();
+        this.seq = saved ? saved.seq : 0;
+        this.epoch = saved ? saved.epoch : 0;       // server replica we last synced with
+        this.since = saved ? saved.since : 0;       // its version at that sync
+        this.lines = new Map(saved ? saved.lines : []);       // key -> {name, cells, base}
+        this.removals = new Map(saved ? saved.removals : []); // key -> {name, dots}
+        this.dirty = new Set(saved ? saved.dirty : []);
+    }
+
+    static newReplicaId() {
+        const id = new Uint32Array(1);
+        do {
+            crypto.getRandomValues(id);
+        } while (id[0] === 0);
+        return id[0];
+    }
+
+    static keyOf(name) {
+        return name.trim().toLowerCase();
+    }
+
+    save() {
+        localStorage.setItem(this.storageKey, JSON.stringify({
+            replica: this.replica,
+            seq: this.seq,
+            epoch: this.epoch,
+            since: this.since,
+            lines: [...this.lines],
+            removals: [...this.removals],
+            dirty: [...this.dirty]
+        }));
+    }
+
+    hasPending() {
+        return this.dirty.size > 0;
+    }
+
+    quantityOf(line) {
+        let total = 0;
+        for (const replica in line.cells) {
+            total += line.cells[replica][1] - line.cells[replica][2];
+        }
+        return total;
+    }
+
+    items() {
+        const items = [];
+        this.lines.forEach(line => {
+            const quantity = this.quantityOf(line);
+            if (quantity > 0) items.push({ name: line.name, quantity: quantity });
+        });
+        return items;
+    }
+
+    // ─── Local edits ─────────────────────────────────────────────────────────
+
+    add(name, quantity) {
+        const key = CartReplica.keyOf(name);
+        if (!this.lines.has(key)) this.lines.set(key, { name: name.trim(), cells: {}, base: [0, 0] });
+        const line = this.lines.get(key);
+        const own = line.cells[this.replica] || [0, 0, 0];
+        line.cells[this.replica] = [++this.seq, own[1] + quantity, own[2]];
+        this.dirty.add(key);
+        this.save();
+    }
+
+    remove(name) {
+        const key = CartReplica.keyOf(name);
+        const line = this.lines.get(key);
+        if (!line) return;
+        // A new object each time, so acknowledge() can tell it from one in flight
+        const previous = this.removals.get(key);
+        const removal = { name: line.name, dots: Object.assign({}, previous && previous.dots) };
+        for (const replica in line.cells) {
+            removal.dots[replica] = Math.max(removal.dots[replica] || 0, line.cells[replica][0]);
+        }
+        this.removals.set(key, removal);
+        this.lines.delete(key);
+        this.dirty.add(key);
+        this.save();
+    }
+
+    clear() {
+        [...this.lines.values()].forEach(line => this.remove(line.name));
+    }
+
+    // ─── Sync ────────────────────────────────────────────────────────────────
+
+    // Delta of every unsynced edit, plus what it covers (for acknowledge())
+    encodePending() {
+        let text = `${CART_DELTA_MAGIC}\t${this.replica}\t${this.epoch}\t${this.since}\n`;
+        const sent = new Map();
+        this.dirty.forEach(key => {
+            const line = this.lines.get(key);
+            const removal = this.removals.get(key);
+            const own = line && line.cells[this.replica];
+            text += `L\t${line ? line.name : removal.name}\n`;
+            if (own) text += `+\t${this.replica}\t${own[0]}\t${own[1]}\t${own[2]}\n`;
+            if (removal) {
+                for (const replica in removal.dots) text += `-\t${replica}\t${removal.dots[replica]}\n`;
+            }
+            sent.set(key, { own: own ? own[0] : 0, removal: removal });
+        });
+        if (this.seq > 0) text += `C\t${this.seq}\n`;
+        return { text: text, sent: sent, epoch: this.epoch };
+    }
+
+    /**
+     * Merge the server's reply to encodePending(). Returns true if edits
+     * still need sending: ones made while the request was in flight, or
+     * ones the server refused because it restarted since the last sync.
+     */
+    merge(reply, request) {
+        const rows = reply.split('\n');
+        const header = rows[0].split('\t');
+        if (header[0] !== CART_DELTA_MAGIC) throw new Error('Bad sync reply');
+        const epoch = Number(header[1]);
+        const full = header[3] === 'full';
+        const refused = request.epoch !== 0 && request.epoch !== epoch;
+
+        if (refused) {
+            this.rebase();
+        } else {
+            this.acknowledge(request.sent);
+        }
+        if (full) {
+            // The reply is every live cell; keep only our own unsent edits
+            this.lines.forEach((line, key) => {
+                const own = this.dirty.has(key) ? line.cells[this.replica] : null;
+                line.cells = own ? { [this.replica]: own } : {};
+            });
+        }
+
+        let key = null;
+        for (let i = 1; i < rows.length; i++) {
+            const fields = rows[i].split('\t');
+            if (fields[0] === 'L') {
+                const name = rows[i].slice(2);
+                key = CartReplica.keyOf(name);
+                if (!this.lines.has(key)) this.lines.set(key, { name: name, cells: {}, base: [0, 0] });
+            } else if ((fields[0] === '+' || fields[0] === '-') && key !== null) {
+                this.applyCell(this.lines.get(key), this.removals.get(key), fields);
+            }
+        }
+
+        if (refused) {
+            // Removals named the old server's cells; apply them to the new ones
+            this.removals.forEach((removal, key) => {
+                const line = this.lines.get(key);
+                if (!line) return;
+                for (const replica in line.cells) {
+                    if (Number(replica) === this.replica) continue;
+                    removal.dots[replica] = line.cells[replica][0];
+                    delete line.cells[replica];
+                }
+            });
+        }
+        this.lines.forEach((line, key) => {
+            if (Object.keys(line.cells).length === 0) this.lines.delete(key);
+        });
+        this.epoch = epoch;
+        this.since = Number(header[2]);
+        this.save();
+        return this.hasPending();
+    }
+
+    applyCell(line, removal, fields) {
+        const replica = Number(fields[1]);
+        const seq = Number(fields[2]);
+        const cell = line.cells[replica];
+        if (fields[0] === '-') {
+            if (cell && cell[0] <= seq) delete line.cells[replica];
+            return;
+        }
+        // Skip cells we removed locally (not sent yet) or already hold newer
+        if (removal && (removal.dots[replica] || 0) >= seq) return;
+        if (cell && cell[0] >= seq) return;
+        line.cells[replica] = [seq, Number(fields[3]), Number(fields[4])];
+        if (replica === this.replica) line.base = [Number(fields[3]), Number(fields[4])];
+    }
+
+    // The server holds what was sent; keep only edits made since
+    acknowledge(sent) {
+        sent.forEach((what, key) => {
+            const line = this.lines.get(key);
+            const own = line && line.cells[this.replica];
+            if (own && own[0] === what.own) line.base = [own[1], own[2]];
+            if (this.removals.get(key) === what.removal) this.removals.delete(key);
+            if ((own ? own[0] : 0) === what.own && !this.removals.has(key)) this.dirty.delete(key);
+        });
+    }
+
+    // The server restarted: resend only what it has not seen from us
+    rebase() {
+        this.lines.forEach((line, key) => {
+            const own = line.cells[this.replica];
+            if (!own) return;
+            const added = own[1] - line.base[0];
+            const removed = own[2] - line.base[1];
+            line.base = [0, 0];
+            if (added === 0 && removed === 0) {
+                delete line.cells[this.replica];
+                this.dirty.delete(key);
+            } else {
+                // A new dot: the old one may already be in the new server's context
+                line.cells[this.replica] = [++this.seq, added, removed];
+                this.dirty.add(key);
+            }
+        });
+        this.removals.forEach((removal, key) => this.dirty.add(key));
+    }
+}
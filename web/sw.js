@@ -12,7 +12,7 @@
  */
 
 const CACHE_NAME = 'smart-grocery-cart-v1';
-const STATIC_CACHE = 'static-v1';
+const STATIC_CACHE = 'static-v4';
 const DYNAMIC_CACHE = 'dynamic-v1';
 
 // Assets to cache immediately on install
@@ -20,6 +20,7 @@ const STATIC_ASSETS = [
     '/',
     '/index.html',
     '/css/styles.css',
+    '/js/cart-replica.js',
     '/js/app.js',
     '/manifest.json',
     '/icons/icon.svg'
@@ -93,6 +94,11 @@ self.addEventListener('fetch', (event) => {
         return;
     }
     
+    // Change stream - left to the browser, it stays open and reconnects itself
+    if (url.pathname === '/api/events') {
+        return;
+    }
+    
     // API calls - Network first, no cache (we need fresh data)
     if (url.pathname.startsWith('/api/')) {
         event.respondWith(